@@ -18,6 +18,9 @@
 // sensor pipeline
 #include <quanergy/pipelines/sensor_pipeline.h>
 
+// metrics endpoint
+#include <quanergy/client/metrics_server.h>
+
 int main(int argc, char** argv)
 {
   namespace po = boost::program_options;
@@ -63,7 +66,15 @@ int main(int argc, char** argv)
       "minimum cloud size; produces an error and ignores clouds smaller than this.")
     ("max-cloud-size", po::value<std::int32_t>(&pipeline_settings.max_cloud_size)->
       default_value(pipeline_settings.max_cloud_size),
-      "maximum cloud size; produces an error and ignores clouds larger than this.");
+      "maximum cloud size; produces an error and ignores clouds larger than this.")
+    ("metrics-port", po::value<std::uint16_t>(&pipeline_settings.metrics_port)->
+      default_value(pipeline_settings.metrics_port),
+      "local port serving metrics in Prometheus text format; 0 doesn't serve.")
+    ("trace-file", po::value<std::string>(&pipeline_settings.trace_file),
+      "write a Chrome trace of pipeline activity to this file on exit; view it in chrome://tracing or Perfetto.")
+    ("trace-window", po::value<double>(&pipeline_settings.trace_window)->
+      default_value(pipeline_settings.trace_window),
+      "seconds of activity up to exit to include in the trace; 0 includes all that is retained.");
 
   try
   {
@@ -147,9 +158,13 @@ int main(int argc, char** argv)
   /// if you'd like to parse the packets yourself, connect here
   ////////////////////////////////////////////
   // connect the packets from the client to the sensor pipeline
-  connections.push_back(client.connect(
+  client.connectCallback(
       [&pipeline](const std::shared_ptr<std::vector<char>>& packet){ pipeline.slot(packet); }
-  ));
+  );
+  // with shedFrames, the client holds the socket rather than drop packets and the pipeline skips whole frames
+  // once half the client queue is backed up
+  client.setBlockWhenFull(pipeline_settings.shed_frames);
+  pipeline.packet_backlog = [&client]{ return client.getQueueDepth() > client.getMaxQueueSize() / 2; };
   
   ////////////////////////////////////////////
   /// connect application specific logic here to consume the point cloud
@@ -157,10 +172,24 @@ int main(int argc, char** argv)
   // here we'll simply count the number of packets and output every 100
   unsigned int cloud_count = 0;
   connections.push_back(pipeline.connect_cloud(
-      [&cloud_count](const boost::shared_ptr<pcl::PointCloud<quanergy::PointXYZIR>>& /*pc*/)
+      [&cloud_count](const quanergy::PointCloudXYZIRConstPtr& /*pc*/)
       { ++cloud_count; if(cloud_count % 100 == 0) std::cout << "clouds received: " << cloud_count << std::endl; }
   ));
 
+  // serve metrics for monitoring if requested
+  std::unique_ptr<quanergy::client::MetricsServer> metrics_server;
+  if (pipeline_settings.metrics_port != 0)
+  {
+    quanergy::MetricLabels labels = {{"sensor", pipeline_settings.host}};
+    metrics_server.reset(new quanergy::client::MetricsServer(pipeline_settings.metrics_port));
+    metrics_server->addCollector([&client, &pipeline, labels](quanergy::MetricsWriter& writer)
+                                 {
+                                   client.writeMetrics(writer, labels);
+                                   pipeline.writeMetrics(writer, labels);
+                                 });
+    metrics_server->start();
+  }
+
   // variables to help with control flow
   std::mutex state_mutex;
   std::condition_variable state_condition;
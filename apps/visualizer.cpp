@@ -161,16 +161,20 @@ int main(int argc, char** argv)
   /// if you'd like to parse the packets yourself, connect here
   ////////////////////////////////////////////
   // connect the packets from the client to the sensor pipeline
-  connections.push_back(client->connect(
+  client->connectCallback(
       [&pipeline](const std::shared_ptr<std::vector<char>>& packet){ pipeline->slot(packet); }
-  ));
+  );
+  // with shedFrames, the client holds the socket rather than drop packets and the pipeline skips whole frames
+  // once half the client queue is backed up
+  client->setBlockWhenFull(pipeline_settings.shed_frames);
+  pipeline->packet_backlog = [&client]{ return client->getQueueDepth() > client->getMaxQueueSize() / 2; };
   
   ////////////////////////////////////////////
   /// connect application specific logic here to consume the point cloud
   ////////////////////////////////////////////
   // connect the pipeline to the visualizer
   connections.push_back(pipeline->connect_cloud(
-      [&visualizer](const boost::shared_ptr<pcl::PointCloud<quanergy::PointXYZIR>>& pc){ visualizer->slot(pc); }
+      [&visualizer](const quanergy::PointCloudXYZIRConstPtr& pc){ visualizer->slot(pc); }
   ));
 
   // run the client in a separate thread
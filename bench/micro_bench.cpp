@@ -0,0 +1,442 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file micro_bench.cpp
+ *
+ *  \brief Per function benchmarks of the parsers and modules.
+ *
+ *  Fixtures are generated in process with synthetic_packets, so numbers are
+ *  comparable between machines and releases. Packet benchmarks cycle through
+ *  one revolution; cloud benchmarks use a full M8 revolution (41600 points).
+ *  Filter them as usual, e.g. --benchmark_filter=Parse.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include <quanergy/parsers/data_packet_00.h>
+#include <quanergy/parsers/data_packet_01.h>
+#include <quanergy/parsers/data_packet_04.h>
+#include <quanergy/parsers/data_packet_06.h>
+
+#include <quanergy/parsers/data_packet_parser_00.h>
+#include <quanergy/parsers/data_packet_parser_01.h>
+#include <quanergy/parsers/data_packet_parser_04.h>
+#include <quanergy/parsers/data_packet_parser_06.h>
+
+#include <quanergy/modules/distance_filter.h>
+#include <quanergy/modules/ring_intensity_filter.h>
+#include <quanergy/modules/polar_to_cart_converter.h>
+#include <quanergy/modules/encoder_angle_calibration.h>
+
+#include <quanergy/pipelines/async.h>
+#include <quanergy/pipelines/ring_async.h>
+#include <quanergy/pipelines/static_pipeline.h>
+
+#include <quanergy/common/callback_chain.h>
+#include <quanergy/common/logger.h>
+
+#include "synthetic_packets.h"
+
+namespace
+{
+  using namespace quanergy;
+
+  /// one revolution of packets, generated once per type and return
+  const std::vector<bench::Packet>& revolution(std::uint8_t packet_type, int return_id)
+  {
+    static std::map<std::pair<std::uint8_t, int>, std::vector<bench::Packet>> revolutions;
+    auto& packets = revolutions[std::make_pair(packet_type, return_id)];
+    if (packets.empty())
+      packets = bench::makeRevolution(packet_type, return_id);
+    return packets;
+  }
+
+  /// one M8 revolution of 0x04 packets parsed into a polar cloud
+  PointCloudHVDIRPtr revolutionCloud()
+  {
+    client::DataPacketParser04 parser;
+    parser.setVerticalAngles(client::SensorType::M8);
+
+    // the first pass ends at the wrap with a partial cloud; the second completes a revolution
+    PointCloudHVDIRPtr result;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      for (const auto& packet : revolution(0x04, 0))
+        parser.parse(*packet, result);
+    }
+    return result;
+  }
+
+  /// report throughput per packet and per byte
+  void setPacketCounters(benchmark::State& state, const std::vector<bench::Packet>& packets)
+  {
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * packets.front()->size());
+  }
+
+  void setPointCounters(benchmark::State& state, std::size_t points)
+  {
+    state.SetItemsProcessed(state.iterations() * points);
+  }
+
+  /////////////////
+  // deserialize //
+  /////////////////
+
+  /// deserialize the OBJECT at offset into each packet; the OBJECT argument only selects the overload
+  template <class OBJECT>
+  void BM_Deserialize(benchmark::State& state, OBJECT, std::uint8_t packet_type, int return_id, std::size_t offset)
+  {
+    const auto& packets = revolution(packet_type, return_id);
+    OBJECT object;
+    std::size_t i = 0;
+
+    for (auto _ : state)
+    {
+      client::deserialize(packets[i]->data() + offset, object);
+      benchmark::DoNotOptimize(object);
+      benchmark::ClobberMemory();
+      i = (i + 1) % packets.size();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  const std::size_t HEADER = sizeof(client::PacketHeader);
+
+  BENCHMARK_CAPTURE(BM_Deserialize, header, client::PacketHeader{}, 0x04, 0, 0);
+  BENCHMARK_CAPTURE(BM_Deserialize, firing_00, client::MSeriesFiringData{}, 0x00, 0, HEADER);
+  BENCHMARK_CAPTURE(BM_Deserialize, body_00, client::MSeriesDataPacket{}, 0x00, 0, HEADER);
+  BENCHMARK_CAPTURE(BM_Deserialize, packet_00, client::DataPacket00{}, 0x00, 0, 0);
+  BENCHMARK_CAPTURE(BM_Deserialize, data_header_01, client::DataHeader01{}, 0x01, 0, HEADER);
+  BENCHMARK_CAPTURE(BM_Deserialize, point_01, client::DataPoint01{}, 0x01, 0,
+                    HEADER + sizeof(client::DataHeader01));
+  BENCHMARK_CAPTURE(BM_Deserialize, packet_01, client::DataPacket01{}, 0x01, 0, 0);
+  BENCHMARK_CAPTURE(BM_Deserialize, body_04, client::MSeriesDataPacket04{}, 0x04, 0, HEADER);
+  BENCHMARK_CAPTURE(BM_Deserialize, packet_04, client::DataPacket04{}, 0x04, 0, 0);
+  BENCHMARK_CAPTURE(BM_Deserialize, data_header_06, client::M1DataHeader{}, 0x06, 0, HEADER);
+  BENCHMARK_CAPTURE(BM_Deserialize, body_06_single, client::M1DataPacket<1>{}, 0x06, 0,
+                    HEADER + sizeof(client::M1DataHeader));
+  BENCHMARK_CAPTURE(BM_Deserialize, body_06_all, client::M1DataPacket<3>{}, 0x06, 3,
+                    HEADER + sizeof(client::M1DataHeader));
+  BENCHMARK_CAPTURE(BM_Deserialize, packet_06_single, client::DataPacket06<1>{}, 0x06, 0, 0);
+  BENCHMARK_CAPTURE(BM_Deserialize, packet_06_all, client::DataPacket06<3>{}, 0x06, 3, 0);
+
+  ///////////
+  // parse //
+  ///////////
+
+  /// parse packets of one revolution in a loop, as a sensor sends them
+  template <class PARSER>
+  void BM_Parse(benchmark::State& state, PARSER& parser, std::uint8_t packet_type, int return_id)
+  {
+    const auto& packets = revolution(packet_type, return_id);
+    PointCloudHVDIRPtr result;
+    std::size_t i = 0;
+
+    for (auto _ : state)
+    {
+      benchmark::DoNotOptimize(parser.parse(*packets[i], result));
+      i = (i + 1) % packets.size();
+    }
+
+    setPacketCounters(state, packets);
+  }
+
+  /// M-series parser for M8 packets with the return selection
+  template <class PARSER>
+  PARSER& mSeriesParser(int return_selection)
+  {
+    static PARSER parser;
+    parser.setVerticalAngles(client::SensorType::M8);
+    parser.setReturnSelection(return_selection);
+    return parser;
+  }
+
+  void BM_Parse00(benchmark::State& state)
+  {
+    auto selection = static_cast<int>(state.range(0));
+    BM_Parse(state, mSeriesParser<client::DataPacketParser00>(selection), 0x00, 0);
+  }
+  BENCHMARK(BM_Parse00)->Arg(0)->Arg(1)->Arg(2)->Arg(client::ALL_RETURNS);
+
+  void BM_Parse01(benchmark::State& state)
+  {
+    client::DataPacketParser01 parser;
+    BM_Parse(state, parser, 0x01, 0);
+    setPointCounters(state, bench::POINTS_PER_RING_01 * client::M_SERIES_NUM_LASERS);
+  }
+  BENCHMARK(BM_Parse01);
+
+  void BM_Parse04(benchmark::State& state)
+  {
+    auto selection = static_cast<int>(state.range(0));
+    BM_Parse(state, mSeriesParser<client::DataPacketParser04>(selection), 0x04, selection);
+  }
+  BENCHMARK(BM_Parse04)->Arg(0)->Arg(1)->Arg(2);
+
+  void BM_Parse06(benchmark::State& state)
+  {
+    static client::DataPacketParser06 parser;
+    auto selection = static_cast<int>(state.range(0));
+    parser.setReturnSelection(selection);
+    BM_Parse(state, parser, 0x06, selection == client::ALL_RETURNS ? client::M_SERIES_NUM_RETURNS : selection);
+  }
+  BENCHMARK(BM_Parse06)->Arg(0)->Arg(1)->Arg(2)->Arg(client::ALL_RETURNS);
+
+  /// exposes the protected organizeCloud
+  struct OrganizingParser : public client::DataPacketParser04
+  {
+    using client::DataPacketParser04::organizeCloud;
+  };
+
+  void BM_OrganizeCloud(benchmark::State& state)
+  {
+    OrganizingParser parser;
+    PointCloudHVDIRPtr cloud(new PointCloudHVDIR(*revolutionCloud()));
+    PointCloudHVDIRPtr worker(new PointCloudHVDIR());
+
+    for (auto _ : state)
+    {
+      // transposes into worker and swaps; each call permutes the previous result, which costs the same
+      parser.organizeCloud(cloud, worker);
+      benchmark::DoNotOptimize(cloud);
+    }
+
+    setPointCounters(state, cloud->size());
+  }
+  BENCHMARK(BM_OrganizeCloud)->Unit(benchmark::kMicrosecond);
+
+  /////////////
+  // modules //
+  /////////////
+
+  /// run a module slot on a revolution cloud; the subscriber only keeps the result alive
+  template <class MODULE>
+  void BM_Module(benchmark::State& state, MODULE& module)
+  {
+    PointCloudHVDIRPtr cloud = revolutionCloud();
+
+    typename MODULE::ResultType result;
+    auto connection = module.connect([&result](const typename MODULE::ResultType& r){ result = r; });
+
+    for (auto _ : state)
+    {
+      module.slot(cloud);
+      benchmark::DoNotOptimize(result);
+    }
+
+    connection.disconnect();
+    setPointCounters(state, cloud->size());
+  }
+
+  void BM_DistanceFilter(benchmark::State& state)
+  {
+    client::DistanceFilter filter;
+    filter.setMinimumDistanceThreshold(1.5f);
+    filter.setMaximumDistanceThreshold(8.f);
+    BM_Module(state, filter);
+  }
+  BENCHMARK(BM_DistanceFilter)->Unit(benchmark::kMicrosecond);
+
+  void BM_RingIntensityFilter(benchmark::State& state)
+  {
+    client::RingIntensityFilter filter;
+    for (int ring = 0; ring < client::M_SERIES_NUM_LASERS; ++ring)
+    {
+      filter.setRingFilterMinimumRangeThreshold(ring, 4.f);
+      filter.setRingFilterMinimumIntensityThreshold(ring, 100);
+    }
+    BM_Module(state, filter);
+  }
+  BENCHMARK(BM_RingIntensityFilter)->Unit(benchmark::kMicrosecond);
+
+  void BM_PolarToCartConverter(benchmark::State& state)
+  {
+    client::PolarToCartConverter converter;
+    BM_Module(state, converter);
+  }
+  BENCHMARK(BM_PolarToCartConverter)->Unit(benchmark::kMicrosecond);
+
+  /// slot with parameters set goes straight to applyCalibration
+  void BM_EncoderApplyCalibration(benchmark::State& state)
+  {
+    calibration::EncoderAngleCalibration calibration;
+    calibration.setParams(0.02, -2.0);
+
+    PointCloudHVDIRPtr cloud = revolutionCloud();
+    auto connection = calibration.connect([](const calibration::EncoderAngleCalibration::ResultType&){});
+
+    for (auto _ : state)
+    {
+      // corrects in place; the small correction keeps the angles in range
+      calibration.slot(cloud);
+      benchmark::ClobberMemory();
+    }
+
+    connection.disconnect();
+    setPointCounters(state, cloud->size());
+  }
+  BENCHMARK(BM_EncoderApplyCalibration)->Unit(benchmark::kMicrosecond);
+
+  void BM_EncoderCalculate(benchmark::State& state)
+  {
+    calibration::EncoderAngleCalibration calibration;
+
+    // one revolution of encoder angles with a sinusoidal error and noise
+    std::vector<double> encoder_angles;
+    std::default_random_engine engine;
+    std::uniform_real_distribution<> noise(-0.002, 0.002);
+    const double rads_per_encoder = 2. * M_PI / (client::M_SERIES_NUM_ROT_ANGLES / bench::POSITION_STEP);
+    for (double angle = M_PI; angle > -M_PI; angle -= rads_per_encoder)
+      encoder_angles.push_back(angle + 0.02 * std::sin(angle - 2.) + noise(engine));
+
+    for (auto _ : state)
+      benchmark::DoNotOptimize(calibration.calculate(encoder_angles));
+
+    state.SetItemsProcessed(state.iterations() * encoder_angles.size());
+  }
+  BENCHMARK(BM_EncoderCalculate)->Unit(benchmark::kMicrosecond);
+
+  /// filter settings shared by the chain benchmarks
+  void configure(client::DistanceFilter& distance_filter, client::RingIntensityFilter& ring_filter)
+  {
+    distance_filter.setMinimumDistanceThreshold(1.5f);
+    distance_filter.setMaximumDistanceThreshold(8.f);
+    for (int ring = 0; ring < client::M_SERIES_NUM_LASERS; ++ring)
+    {
+      ring_filter.setRingFilterMinimumRangeThreshold(ring, 4.f);
+      ring_filter.setRingFilterMinimumIntensityThreshold(ring, 100);
+    }
+  }
+
+  /// distance filter, ring filter and Cartesian conversion connected at run time; each makes its own cloud
+  void BM_ModuleChain(benchmark::State& state)
+  {
+    client::DistanceFilter distance_filter;
+    client::RingIntensityFilter ring_filter;
+    client::PolarToCartConverter converter;
+    configure(distance_filter, ring_filter);
+
+    PointCloudXYZIRConstPtr result;
+    distance_filter.connectCallback([&](const PointCloudHVDIRConstPtr& pc){ ring_filter.slot(pc); });
+    ring_filter.connectCallback([&](const PointCloudHVDIRConstPtr& pc){ converter.slot(pc); });
+    converter.connectCallback([&result](const PointCloudXYZIRConstPtr& pc){ result = pc; });
+
+    PointCloudHVDIRPtr cloud = revolutionCloud();
+    for (auto _ : state)
+    {
+      distance_filter.slot(cloud);
+      benchmark::DoNotOptimize(result);
+    }
+
+    setPointCounters(state, cloud->size());
+  }
+  BENCHMARK(BM_ModuleChain)->Unit(benchmark::kMicrosecond);
+
+  /// the same stages fused into one pass by StaticPipeline
+  void BM_StaticPipeline(benchmark::State& state)
+  {
+    pipeline::StaticPipeline<client::DataPacketParser04,
+                             client::DistanceFilter,
+                             client::RingIntensityFilter,
+                             client::PolarToCartConverter> composed;
+    configure(composed.get<0>(), composed.get<1>());
+
+    PointCloudHVDIRPtr cloud = revolutionCloud();
+    for (auto _ : state)
+      benchmark::DoNotOptimize(composed.process(*cloud));
+
+    setPointCounters(state, cloud->size());
+  }
+  BENCHMARK(BM_StaticPipeline)->Unit(benchmark::kMicrosecond);
+
+  //////////////
+  // dispatch //
+  //////////////
+
+  using PacketPtr = std::shared_ptr<std::vector<char>>;
+
+  /// cost of handing a packet to one subscriber; the stage handoff before any work is done
+  void BM_DispatchSignal(benchmark::State& state)
+  {
+    boost::signals2::signal<void (const PacketPtr&)> signal;
+    std::size_t count = 0;
+    signal.connect([&count](const PacketPtr& packet){ count += packet->size(); });
+
+    PacketPtr packet(new std::vector<char>(6632));
+    for (auto _ : state)
+    {
+      // what the modules did per call: check for subscribers, then signal
+      if (signal.num_slots() != 0)
+        signal(packet);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  BENCHMARK(BM_DispatchSignal);
+
+  void BM_DispatchCallback(benchmark::State& state)
+  {
+    CallbackChain<PacketPtr> chain;
+    std::size_t count = 0;
+    chain.add([&count](const PacketPtr& packet){ count += packet->size(); });
+
+    PacketPtr packet(new std::vector<char>(6632));
+    for (auto _ : state)
+    {
+      if (!chain.empty())
+        chain(packet);
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  BENCHMARK(BM_DispatchCallback);
+
+  /// time from slot on this thread to the subscriber running on the async thread
+  template <class ASYNC>
+  void BM_AsyncHandoff(benchmark::State& state)
+  {
+    using CloudPtr = boost::shared_ptr<PointCloudXYZIR>;
+    ASYNC async;
+
+    std::atomic<std::uint64_t> received {0};
+    async.connect([&received](const CloudPtr&){ received.fetch_add(1, std::memory_order_release); });
+
+    CloudPtr cloud(new PointCloudXYZIR());
+    std::uint64_t sent = 0;
+
+    for (auto _ : state)
+    {
+      async.slot(cloud);
+      ++sent;
+      // yield so the signal thread can run when they share a core
+      while (received.load(std::memory_order_acquire) != sent)
+        std::this_thread::yield();
+    }
+  }
+  BENCHMARK_TEMPLATE(BM_AsyncHandoff, pipeline::AsyncModule<boost::shared_ptr<PointCloudXYZIR>>)->UseRealTime();
+  BENCHMARK_TEMPLATE(BM_AsyncHandoff, pipeline::RingAsyncModule<boost::shared_ptr<PointCloudXYZIR>>)->UseRealTime();
+}
+
+int main(int argc, char** argv)
+{
+  // status and error messages would interleave with the results
+  quanergy::Logger::instance().setLevel(quanergy::LogLevel::ERR);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
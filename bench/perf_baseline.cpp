@@ -0,0 +1,343 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include "perf_baseline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+namespace quanergy
+{
+  namespace bench
+  {
+    namespace
+    {
+      /// firings and lasers in an M8 revolution of 0x04 packets
+      const std::size_t CALIBRATION_FIRINGS = 5200;
+      const std::size_t CALIBRATION_LASERS = 8;
+      const std::size_t CALIBRATION_POINTS = CALIBRATION_FIRINGS * CALIBRATION_LASERS;
+
+      struct CalibrationPoint
+      {
+        float h;
+        float v;
+        float d;
+        float intensity;
+        std::uint16_t ring;
+      };
+
+      /// a revolution as the sensor sends it: big endian position, ranges and intensities per firing
+      struct CalibrationFiring
+      {
+        std::uint16_t position;
+        std::uint32_t range[CALIBRATION_LASERS];
+        std::uint8_t intensity[CALIBRATION_LASERS];
+      };
+
+      std::uint32_t swap32(std::uint32_t x)
+      {
+        return (x >> 24) | ((x >> 8) & 0xFF00u) | ((x << 8) & 0xFF0000u) | (x << 24);
+      }
+
+      std::uint16_t swap16(std::uint16_t x)
+      {
+        return static_cast<std::uint16_t>((x >> 8) | (x << 8));
+      }
+
+      /** \brief one frame of the work the pipeline does, frozen so code changes don't move it
+       *  \details decodes into a freshly allocated cloud with table lookups, hands it to another thread
+       *           and there organizes it by ring into a second cloud and converts that to Cartesian
+       */
+      class CalibrationFrame
+      {
+      public:
+        CalibrationFrame()
+          : firings_(CALIBRATION_FIRINGS)
+          , horizontal_(CALIBRATION_FIRINGS)
+          , worker_([this]{ work(); })
+        {
+          for (std::size_t i = 0; i < CALIBRATION_FIRINGS; ++i)
+          {
+            firings_[i].position = swap16(static_cast<std::uint16_t>(2 * i));
+            horizontal_[i] = static_cast<float>(-M_PI + 2. * M_PI * i / CALIBRATION_FIRINGS);
+            for (std::size_t laser = 0; laser < CALIBRATION_LASERS; ++laser)
+            {
+              firings_[i].range[laser] = swap32(static_cast<std::uint32_t>(100000 + (i * 8 + laser) % 1000 * 1000));
+              firings_[i].intensity[laser] = static_cast<std::uint8_t>(i + laser);
+            }
+            vertical_[i % CALIBRATION_LASERS] = static_cast<float>((static_cast<int>(i % 8) - 4) * 0.05);
+          }
+        }
+
+        ~CalibrationFrame()
+        {
+          {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stop_ = true;
+          }
+          conditional_.notify_all();
+          worker_.join();
+        }
+
+        /// decode, hand off and wait for the converted frame; returns a value that depends on all of it
+        float run()
+        {
+          std::unique_ptr<std::vector<CalibrationPoint>> cloud(new std::vector<CalibrationPoint>());
+          cloud->reserve(CALIBRATION_POINTS);
+          for (const auto& firing : firings_)
+          {
+            float h = horizontal_[swap16(firing.position) / 2];
+            for (std::size_t laser = 0; laser < CALIBRATION_LASERS; ++laser)
+            {
+              cloud->push_back({h, vertical_[laser], swap32(firing.range[laser]) * 0.00001f,
+                                static_cast<float>(firing.intensity[laser]), static_cast<std::uint16_t>(laser)});
+            }
+          }
+
+          std::unique_lock<std::mutex> lk(mutex_);
+          input_ = std::move(cloud);
+          done_ = false;
+          conditional_.notify_all();
+          conditional_.wait(lk, [this]{ return done_; });
+          return sum_;
+        }
+
+      private:
+        void work()
+        {
+          std::unique_lock<std::mutex> lk(mutex_);
+          while (true)
+          {
+            conditional_.wait(lk, [this]{ return stop_ || input_; });
+            if (stop_)
+              return;
+
+            auto cloud = std::move(input_);
+            lk.unlock();
+
+            // one row per ring
+            std::vector<CalibrationPoint> organized(cloud->size());
+            for (std::size_t i = 0; i < cloud->size(); ++i)
+              organized[(i % CALIBRATION_LASERS) * CALIBRATION_FIRINGS + i / CALIBRATION_LASERS] = (*cloud)[i];
+            cloud.reset();
+
+            std::vector<float> xyz(3 * organized.size());
+            float sum = 0.f;
+            for (std::size_t i = 0; i < organized.size(); ++i)
+            {
+              const auto& pt = organized[i];
+              float cos_v = std::cos(pt.v);
+              xyz[3 * i] = pt.d * cos_v * std::cos(pt.h);
+              xyz[3 * i + 1] = pt.d * cos_v * std::sin(pt.h);
+              xyz[3 * i + 2] = pt.d * std::sin(pt.v);
+              sum += xyz[3 * i + 2];
+            }
+
+            lk.lock();
+            sum_ = sum;
+            done_ = true;
+            conditional_.notify_all();
+          }
+        }
+
+        std::vector<CalibrationFiring> firings_;
+        std::vector<float> horizontal_;
+        float vertical_[CALIBRATION_LASERS];
+
+        std::mutex mutex_;
+        std::condition_variable conditional_;
+        std::unique_ptr<std::vector<CalibrationPoint>> input_;
+        bool done_ = false;
+        bool stop_ = false;
+        float sum_ = 0.f;
+
+        std::thread worker_;
+      };
+
+      /// relative change from baseline to current
+      double change(double baseline, double current)
+      {
+        return baseline > 0. ? current / baseline - 1. : 0.;
+      }
+
+      /// a negative limit leaves its column empty
+      void writeRow(std::ostream& report, const std::string& name, const std::string& unit,
+                    double baseline, double current, double normalized_change, double limit, const char* verdict)
+      {
+        report << std::left << std::setw(20) << name << std::right
+               << std::setw(16) << baseline << std::setw(16) << current << " " << std::left << std::setw(10) << unit
+               << std::right << std::showpos << std::setw(9) << normalized_change * 100. << "%" << std::noshowpos;
+        if (limit >= 0.)
+          report << std::setw(8) << limit * 100. << "%";
+        else
+          report << std::setw(9) << "";
+        report << "  " << verdict << "\n";
+      }
+
+      /// standard deviation of a metric over sorted runs relative to its median, estimated from the median
+      /// absolute deviation so a single outlying run doesn't dominate it
+      double noise(const std::vector<PerfMetrics>& sorted, double PerfMetrics::* metric)
+      {
+        double median = sorted[sorted.size() / 2].*metric;
+        std::vector<double> deviations;
+        for (const auto& run : sorted)
+          deviations.push_back(std::abs(run.*metric - median));
+        std::nth_element(deviations.begin(), deviations.begin() + deviations.size() / 2, deviations.end());
+        return median > 0. ? 1.4826 * deviations[deviations.size() / 2] / median : 0.;
+      }
+    }
+
+    double calibrate(int repetitions)
+    {
+      CalibrationFrame frame;
+
+      // let the allocator and the worker thread settle first
+      volatile float sink = 0.f;
+      for (int r = 0; r < 10; ++r)
+        sink = sink + frame.run();
+
+      // many short repetitions; the median follows the machine's sustained speed rather than its
+      // best moments. the sum goes to a volatile so the work can't be dropped
+      std::vector<double> times;
+      for (int r = 0; r < std::max(repetitions, 1); ++r)
+      {
+        auto start = std::chrono::steady_clock::now();
+        sink = sink + frame.run();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(static_cast<double>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+      }
+
+      std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+      return times[times.size() / 2];
+    }
+
+    PerfMetrics summarize(const std::vector<PerfMetrics>& runs)
+    {
+      if (runs.empty())
+        throw std::runtime_error("No runs to summarize");
+
+      std::vector<PerfMetrics> sorted(runs);
+      for (auto& run : sorted)
+      {
+        if (run.calibration_ns <= 0.)
+          throw std::runtime_error("Run without a calibration");
+        run.normalized_throughput = run.points_per_second * run.calibration_ns * 1e-9;
+        run.normalized_p99 = run.p99_us * 1e3 / run.calibration_ns;
+      }
+
+      auto by = [](double PerfMetrics::* metric)
+      {
+        return [metric](const PerfMetrics& a, const PerfMetrics& b){ return a.*metric < b.*metric; };
+      };
+
+      std::sort(sorted.begin(), sorted.end(), by(&PerfMetrics::normalized_p99));
+      double p99 = sorted[sorted.size() / 2].normalized_p99;
+      double p99_noise = noise(sorted, &PerfMetrics::normalized_p99);
+
+      std::sort(sorted.begin(), sorted.end(), by(&PerfMetrics::normalized_throughput));
+      PerfMetrics summary = sorted[sorted.size() / 2];
+      summary.throughput_noise = noise(sorted, &PerfMetrics::normalized_throughput);
+      summary.normalized_p99 = p99;
+      summary.p99_noise = p99_noise;
+
+      return summary;
+    }
+
+    PerfMetrics loadBaseline(const std::string& file_name)
+    {
+      boost::property_tree::ptree tree;
+      try
+      {
+        boost::property_tree::json_parser::read_json(file_name, tree);
+      }
+      catch (boost::property_tree::json_parser_error& e)
+      {
+        throw std::runtime_error("Unable to read baseline " + file_name + ": " + e.what());
+      }
+
+      PerfMetrics metrics;
+      try
+      {
+        metrics.packet_type = tree.get<std::string>("packet_type");
+        metrics.return_selection = tree.get<std::string>("return");
+        metrics.points_per_second = tree.get<double>("points_per_second");
+        metrics.p99_us = tree.get<double>("frame_latency.p99_us");
+        metrics.calibration_ns = tree.get<double>("calibration_ns");
+        metrics.normalized_throughput = tree.get<double>("normalized.throughput");
+        metrics.normalized_p99 = tree.get<double>("normalized.p99");
+        metrics.throughput_noise = tree.get<double>("noise.throughput");
+        metrics.p99_noise = tree.get<double>("noise.p99");
+        metrics.tolerance = tree.get<double>("tolerance", 0.);
+      }
+      catch (boost::property_tree::ptree_error& e)
+      {
+        throw std::runtime_error("Invalid baseline " + file_name + ": " + e.what());
+      }
+
+      if (metrics.calibration_ns <= 0. || metrics.normalized_throughput <= 0. || metrics.normalized_p99 <= 0.)
+        throw std::runtime_error("Invalid baseline " + file_name + ": calibration and normalized metrics must be positive");
+
+      return metrics;
+    }
+
+    bool comparePerf(const PerfMetrics& baseline, const PerfMetrics& current,
+                     double tolerance, std::ostream& report)
+    {
+      if (baseline.packet_type != current.packet_type || baseline.return_selection != current.return_selection)
+      {
+        throw std::runtime_error("Baseline is for packet type " + baseline.packet_type + " return " +
+                                 baseline.return_selection + ", run is packet type " + current.packet_type +
+                                 " return " + current.return_selection);
+      }
+
+      // a change within two standard deviations of the baseline's repetitions isn't a regression
+      double throughput_limit = std::max(tolerance, NOISE_DEVIATIONS * baseline.throughput_noise);
+      double latency_limit = std::max(tolerance, NOISE_DEVIATIONS * baseline.p99_noise);
+
+      double throughput_change = change(baseline.normalized_throughput, current.normalized_throughput);
+      double latency_change = change(baseline.normalized_p99, current.normalized_p99);
+
+      bool throughput_ok = throughput_change >= -throughput_limit;
+      bool latency_ok = latency_change <= latency_limit;
+
+      auto flags = report.flags();
+      report << std::fixed << std::setprecision(1)
+             << "perf gate: packet type " << current.packet_type << ", return " << current.return_selection
+             << ", tolerance " << tolerance * 100. << "%, baseline noise " << baseline.throughput_noise * 100.
+             << "% points/s, " << baseline.p99_noise * 100. << "% p99\n"
+             << std::left << std::setw(20) << "" << std::right << std::setw(16) << "baseline"
+             << std::setw(16) << "current" << std::setw(21) << "normalized" << std::setw(9) << "limit" << "\n";
+
+      writeRow(report, "calibration", "us", baseline.calibration_ns * 1e-3, current.calibration_ns * 1e-3,
+               current.calibration_ns / baseline.calibration_ns - 1., -1., "machine");
+      writeRow(report, "points/s", "", baseline.points_per_second, current.points_per_second,
+               throughput_change, throughput_limit, throughput_ok ? "ok" : "REGRESSION");
+      writeRow(report, "p99 frame latency", "us", baseline.p99_us, current.p99_us,
+               latency_change, latency_limit, latency_ok ? "ok" : "REGRESSION");
+
+      report << "result: " << (throughput_ok && latency_ok ? "PASS" : "FAIL") << "\n";
+      report.flags(flags);
+
+      return throughput_ok && latency_ok;
+    }
+
+  } // namespace bench
+
+} // namespace quanergy
@@ -0,0 +1,89 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file perf_baseline.h
+ *
+ *  \brief Comparison of a benchmark run against a stored baseline.
+ *
+ *  Raw throughput depends on the machine as much as on the code, so both runs
+ *  are scaled by a calibration loop timed on their own machine: points/s is
+ *  compared as points per calibration loop and latency in calibration loops.
+ *  Each repetition is scaled by the loop timed around it and the medians over
+ *  the repetitions are compared. A baseline stores the noise of its
+ *  repetitions and the tolerance it was recorded with.
+ *  The loop is a frozen copy of the work of one frame through the pipeline:
+ *  byte swapping and table lookups into a freshly allocated cloud, a handoff
+ *  to another thread, organizing by ring and polar to Cartesian conversion.
+ *  Trig alone tracked compute but not the allocator, memory and thread
+ *  handoffs the pipeline spends much of its time in.
+ */
+
+#ifndef QUANERGY_BENCH_PERF_BASELINE_H
+#define QUANERGY_BENCH_PERF_BASELINE_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace quanergy
+{
+  namespace bench
+  {
+    /// the metrics the regression gate compares
+    struct PerfMetrics
+    {
+      std::string packet_type;
+      std::string return_selection;
+
+      double points_per_second = 0.;
+      double p99_us = 0.;
+
+      /// nanoseconds for one calibration frame on the machine that ran the benchmark
+      double calibration_ns = 0.;
+
+      /// points per calibration frame and p99 latency in calibration frames; medians over the repetitions
+      double normalized_throughput = 0.;
+      double normalized_p99 = 0.;
+
+      /// standard deviation of one repetition's normalized metrics, as a fraction of their median
+      double throughput_noise = 0.;
+      double p99_noise = 0.;
+
+      /// allowed regression stored with a baseline; 0 if none is
+      double tolerance = 0.;
+    };
+
+    /// a metric may regress by this many times its baseline noise when that is more than the tolerance
+    const double NOISE_DEVIATIONS = 2.;
+
+    /// median time of the calibration frame over repetitions, in nanoseconds
+    double calibrate(int repetitions = 200);
+
+    /** \brief summarize repetitions, each with its raw metrics and the calibration timed around it
+     *  \return the repetition with median normalized throughput, with the medians and noise of the normalized
+     *          metrics over all of them
+     */
+    PerfMetrics summarize(const std::vector<PerfMetrics>& runs);
+
+    /** \brief read metrics from pipeline_bench JSON output
+     *  \throws std::runtime_error if the file can't be read or lacks a metric
+     */
+    PerfMetrics loadBaseline(const std::string& file_name);
+
+    /** \brief compare normalized metrics and write a report
+     *  \param tolerance is the allowed regression as a fraction, e.g. 0.15; a metric is allowed
+     *         NOISE_DEVIATIONS times its baseline noise instead when that is more
+     *  \return true if neither points/s nor p99 latency regressed beyond what is allowed
+     */
+    bool comparePerf(const PerfMetrics& baseline, const PerfMetrics& current,
+                     double tolerance, std::ostream& report);
+
+  } // namespace bench
+
+} // namespace quanergy
+
+#endif
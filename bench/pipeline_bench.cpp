@@ -0,0 +1,562 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file pipeline_bench.cpp
+ *
+ *  \brief End to end SensorPipeline throughput benchmark.
+ *
+ *  Packets, generated in memory or read from a capture, are fed to the
+ *  pipeline as fast as it accepts them. The pipeline is configured from
+ *  device info instead of a sensor. Reported per run:
+ *    - packets/s and points/s (points out of the Cartesian converter)
+ *    - frame latency: slot call of the packet completing a cloud to the
+ *      Cartesian cloud; exact when decoding on the calling thread
+ *    - process CPU time and heap allocations per frame
+ *    - optionally per stage latencies from SensorPipeline::latency_stats
+ *    - the time of a calibration loop, to normalize results between machines
+ *  --json prints the same as JSON for comparing runs. --baseline compares
+ *  against such JSON and fails on a regression; see perf_baseline.h.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <thread>
+
+// console parser
+#include <boost/program_options.hpp>
+
+// sensor pipeline
+#include <quanergy/pipelines/sensor_pipeline.h>
+
+#include <quanergy/common/latency_histogram.h>
+#include <quanergy/common/logger.h>
+
+#include "perf_baseline.h"
+#include "synthetic_packets.h"
+
+namespace
+{
+  /// heap allocations made anywhere in the process
+  std::atomic<std::uint64_t> allocations {0};
+}
+
+#if defined(__GLIBC__)
+
+// count at malloc so allocations that don't go through operator new, like the Eigen aligned
+// allocator of the PCL clouds, are counted too; operator new allocates with malloc
+extern "C"
+{
+  void* __libc_malloc(std::size_t size);
+  void* __libc_calloc(std::size_t count, std::size_t size);
+  void* __libc_realloc(void* p, std::size_t size);
+  void* __libc_memalign(std::size_t alignment, std::size_t size);
+
+  void* malloc(std::size_t size)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+  }
+
+  void* calloc(std::size_t count, std::size_t size)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* p, std::size_t size)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+  }
+
+  void* memalign(std::size_t alignment, std::size_t size)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+  }
+
+  void* aligned_alloc(std::size_t alignment, std::size_t size)
+  {
+    return memalign(alignment, size);
+  }
+
+  int posix_memalign(void** p, std::size_t alignment, std::size_t size)
+  {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+      return EINVAL;
+
+    void* q = memalign(alignment, size);
+    if (!q)
+      return ENOMEM;
+
+    *p = q;
+    return 0;
+  }
+}
+
+#else
+
+// elsewhere only operator new is counted.
+// the replacements below pair malloc and free, which GCC can't see through
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+#endif
+
+namespace
+{
+  struct BenchResult
+  {
+    std::string input;
+    std::string packet_type;
+    std::string return_selection;
+    std::size_t decode_threads = 0;
+    std::size_t repetitions = 1;
+
+    std::uint64_t packets = 0;
+    std::uint64_t frames = 0;
+    std::uint64_t points = 0;
+    double seconds = 0.;
+    double cpu_seconds = 0.;
+    std::uint64_t allocations = 0;
+    double calibration_ns = 0.;
+
+    /// medians and noise over the repetitions of the calibration normalized metrics, and the tolerance
+    /// the gate used; written so the output can be a baseline
+    quanergy::bench::PerfMetrics perf;
+
+    quanergy::LatencySummary frame_latency;
+    std::map<std::string, quanergy::LatencySummary> stages;
+
+    double packetsPerSecond() const { return seconds > 0. ? packets / seconds : 0.; }
+    double pointsPerSecond() const { return seconds > 0. ? points / seconds : 0.; }
+    double framesPerSecond() const { return seconds > 0. ? frames / seconds : 0.; }
+    double cpuMicrosPerFrame() const { return frames > 0 ? cpu_seconds * 1e6 / frames : 0.; }
+    double allocationsPerFrame() const { return frames > 0 ? static_cast<double>(allocations) / frames : 0.; }
+  };
+
+  void writeLatency(std::ostream& out, const quanergy::LatencySummary& latency)
+  {
+    out << "{\"count\": " << latency.count
+        << ", \"p50_us\": " << latency.p50 * 1e-3
+        << ", \"p99_us\": " << latency.p99 * 1e-3
+        << ", \"p999_us\": " << latency.p999 * 1e-3
+        << ", \"max_us\": " << latency.max * 1e-3
+        << ", \"mean_us\": " << latency.mean * 1e-3 << "}";
+  }
+
+  void writeJson(std::ostream& out, const BenchResult& result)
+  {
+    out << std::fixed << std::setprecision(3);
+    out << "{\n"
+        << "  \"input\": \"" << result.input << "\",\n"
+        << "  \"packet_type\": \"" << result.packet_type << "\",\n"
+        << "  \"return\": \"" << result.return_selection << "\",\n"
+        << "  \"decode_threads\": " << result.decode_threads << ",\n"
+        << "  \"repetitions\": " << result.repetitions << ",\n"
+        << "  \"packets\": " << result.packets << ",\n"
+        << "  \"frames\": " << result.frames << ",\n"
+        << "  \"points\": " << result.points << ",\n"
+        << "  \"seconds\": " << result.seconds << ",\n"
+        << "  \"packets_per_second\": " << result.packetsPerSecond() << ",\n"
+        << "  \"frames_per_second\": " << result.framesPerSecond() << ",\n"
+        << "  \"points_per_second\": " << result.pointsPerSecond() << ",\n"
+        << "  \"cpu_us_per_frame\": " << result.cpuMicrosPerFrame() << ",\n"
+        << "  \"allocations_per_frame\": " << result.allocationsPerFrame() << ",\n"
+        << "  \"calibration_ns\": " << result.calibration_ns << ",\n"
+        << "  \"normalized\": {\"throughput\": " << result.perf.normalized_throughput
+        << ", \"p99\": " << result.perf.normalized_p99 << "},\n"
+        << "  \"noise\": {\"throughput\": " << result.perf.throughput_noise
+        << ", \"p99\": " << result.perf.p99_noise << "},\n"
+        << "  \"tolerance\": " << result.perf.tolerance << ",\n"
+        << "  \"frame_latency\": ";
+    writeLatency(out, result.frame_latency);
+    out << ",\n  \"stages\": {";
+
+    const char* separator = "\n";
+    for (const auto& stage : result.stages)
+    {
+      out << separator << "    \"" << stage.first << "\": ";
+      writeLatency(out, stage.second);
+      separator = ",\n";
+    }
+    out << (result.stages.empty() ? "}\n" : "\n  }\n") << "}\n";
+  }
+
+  void writeText(std::ostream& out, const BenchResult& result)
+  {
+    auto latency = [](const quanergy::LatencySummary& l)
+    {
+      std::ostringstream s;
+      s << std::fixed << std::setprecision(1) << "p50 " << l.p50 * 1e-3 << " us, p99 " << l.p99 * 1e-3
+        << " us, p99.9 " << l.p999 * 1e-3 << " us, max " << l.max * 1e-3 << " us";
+      return s.str();
+    };
+
+    out << std::fixed << std::setprecision(1)
+        << "input:             " << result.input << " (packet type " << result.packet_type
+        << ", return " << result.return_selection << ", " << result.decode_threads << " decode threads)\n"
+        << "repetitions:       " << result.repetitions << ", median reported\n"
+        << "packets:           " << result.packets << " in " << result.seconds << " s, "
+        << result.packetsPerSecond() << " packets/s\n"
+        << "frames:            " << result.frames << ", " << result.framesPerSecond() << " frames/s\n"
+        << "points:            " << result.points << ", " << result.pointsPerSecond() << " points/s\n"
+        << "frame latency:     " << latency(result.frame_latency) << "\n"
+        << "CPU per frame:     " << result.cpuMicrosPerFrame() << " us\n"
+        << "allocs per frame:  " << result.allocationsPerFrame() << "\n"
+        << "calibration loop:  " << result.calibration_ns * 1e-3 << " us\n"
+        << std::setprecision(3)
+        << "normalized:        " << result.perf.normalized_throughput << " points, p99 "
+        << result.perf.normalized_p99 << " per calibration loop\n"
+        << std::setprecision(1)
+        << "noise:             " << result.perf.throughput_noise * 100. << "% points/s, "
+        << result.perf.p99_noise * 100. << "% p99 standard deviation of a repetition\n";
+
+    for (const auto& stage : result.stages)
+      out << "  " << std::left << std::setw(24) << stage.first << latency(stage.second) << "\n";
+  }
+
+  std::string hex(std::uint8_t packet_type)
+  {
+    std::ostringstream s;
+    s << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(packet_type);
+    return s.str();
+  }
+}
+
+int main(int argc, char** argv)
+{
+  namespace po = boost::program_options;
+
+  po::options_description description("Quanergy Client Pipeline Benchmark");
+
+  quanergy::pipeline::SensorPipelineSettings pipeline_settings;
+  std::string type_string = "04";
+  std::string return_string = "0";
+  std::string capture_file;
+  std::string device_info_file;
+  std::string output_file;
+  std::string baseline_file;
+  double tolerance = 0.15;
+  std::size_t passes = 0;
+  std::size_t warmup = 5;
+  std::size_t repetitions = 1;
+  bool stages = false;
+  bool json = false;
+
+  description.add_options()
+    ("help,h", "Display this help message.")
+    ("settings-file,s", po::value<std::string>(),
+      "Settings file configuring the pipeline; host is ignored.")
+    ("type,t", po::value<std::string>(&type_string)->default_value(type_string),
+      "Packet type to generate: 00, 01, 04 or 06.")
+    ("return,r", po::value<std::string>(&return_string)->default_value(return_string),
+      "Return selection: 0, 1, 2 or all. Generated 04 and 06 packets carry this return; "
+      "06 packets carry all returns for 'all', which 04 packets can't.")
+    ("capture,c", po::value<std::string>(&capture_file),
+      "Replay a raw capture of the sensor TCP stream (e.g. from 'nc <sensor> 4141') instead of generating packets.")
+    ("device-info", po::value<std::string>(&device_info_file),
+      "Device info XML to configure the pipeline with; defaults to a model matching the packet type.")
+    ("passes,n", po::value<std::size_t>(&passes)->default_value(passes),
+      "Measured passes over the input; a generated pass is one revolution. 0 uses 200 generated or 1 captured.")
+    ("warmup,w", po::value<std::size_t>(&warmup)->default_value(warmup),
+      "Unmeasured passes before measuring.")
+    ("repetitions", po::value<std::size_t>(&repetitions)->default_value(repetitions),
+      "Measure this many times and report the repetition with median normalized points/s.")
+    ("decode-threads", po::value<std::uint16_t>(&pipeline_settings.decode_threads)->
+      default_value(pipeline_settings.decode_threads),
+      "Threads used to decode packets.")
+    ("stages", po::bool_switch(&stages),
+      "Also report per stage latencies; adds clock reads to every stage.")
+    ("json", po::bool_switch(&json),
+      "Print JSON instead of text.")
+    ("output,o", po::value<std::string>(&output_file),
+      "Also write JSON to this file.")
+    ("baseline", po::value<std::string>(&baseline_file),
+      "Compare machine normalized points/s and p99 frame latency with this JSON output of an earlier run; "
+      "exit with 1 on a regression.")
+    ("tolerance", po::value<double>(&tolerance)->default_value(tolerance),
+      "Allowed regression against the baseline, as a fraction; defaults to the baseline's tolerance if it has one. "
+      "Written with the results.");
+
+  std::vector<quanergy::bench::Packet> packets;
+  std::string device_info_xml;
+  quanergy::bench::PerfMetrics baseline;
+  BenchResult result;
+
+  try
+  {
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, description), vm);
+
+    if (vm.count("help"))
+    {
+      std::cout << description << std::endl;
+      return 0;
+    }
+
+    if (vm.count("settings-file"))
+    {
+      quanergy::pipeline::SettingsFileLoader file_loader;
+      file_loader.loadXML(vm["settings-file"].as<std::string>());
+      pipeline_settings.load(file_loader);
+    }
+
+    po::notify(vm);
+
+    pipeline_settings.return_selection_set = true;
+    pipeline_settings.return_selection = pipeline_settings.returnFromString(return_string);
+    result.return_selection = return_string;
+
+    std::uint8_t packet_type;
+    if (!capture_file.empty())
+    {
+      packets = quanergy::bench::readCapture(capture_file);
+      if (packets.empty())
+        throw std::runtime_error("No packets in capture " + capture_file);
+
+      packet_type = quanergy::bench::packetType(*packets.front());
+      result.input = capture_file;
+      if (passes == 0)
+        passes = 1;
+    }
+    else
+    {
+      packet_type = static_cast<std::uint8_t>(std::stoul(type_string, nullptr, 16));
+      bool all_returns = pipeline_settings.return_selection == quanergy::client::ALL_RETURNS;
+      // 04 packets carry a single return
+      if (packet_type == 0x04 && all_returns)
+        throw po::error("Generated 04 packets carry a single return; use --return 0, 1 or 2");
+
+      // 00 packets carry all returns and 01 packets have none to select
+      int return_id = all_returns ? quanergy::client::M_SERIES_NUM_RETURNS : pipeline_settings.return_selection;
+      packets = quanergy::bench::makeRevolution(packet_type,
+                                                packet_type == 0x04 || packet_type == 0x06 ? return_id : 0);
+
+      result.input = "generated";
+      if (passes == 0)
+        passes = 200;
+    }
+    result.packet_type = hex(packet_type);
+
+    if (!device_info_file.empty())
+    {
+      std::ifstream in(device_info_file);
+      std::stringstream contents;
+      contents << in.rdbuf();
+      device_info_xml = contents.str();
+    }
+    else
+    {
+      device_info_xml = quanergy::bench::deviceInfoFor(packet_type);
+    }
+
+    if (!baseline_file.empty())
+    {
+      baseline = quanergy::bench::loadBaseline(baseline_file);
+      if (vm["tolerance"].defaulted() && baseline.tolerance > 0.)
+        tolerance = baseline.tolerance;
+    }
+  }
+  catch (po::error& e)
+  {
+    std::cout << "Boost Program Options Error: " << e.what() << std::endl << std::endl;
+    std::cout << description << std::endl;
+    return -1;
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "Error: " << e.what() << std::endl;
+    return -2;
+  }
+
+  // keep the pipeline's own info messages out of the results
+  quanergy::Logger::instance().setLevel(quanergy::LogLevel::WARNING);
+
+  std::istringstream device_info_stream(device_info_xml);
+  quanergy::client::DeviceInfo device_info(device_info_stream);
+  quanergy::pipeline::SensorPipeline pipeline(pipeline_settings, device_info);
+  pipeline.setLatencyInstrumentation(stages);
+  result.decode_threads = pipeline.parser.getDecodeThreads();
+
+  // when the last packet was handed to the pipeline and when the last cloud came out, in steady clock nanoseconds
+  std::atomic<std::int64_t> last_slot {0};
+  std::atomic<std::int64_t> last_output {0};
+  std::atomic<std::uint64_t> frames {0};
+  std::atomic<std::uint64_t> points {0};
+  quanergy::LatencyHistogram frame_latency;
+
+  auto now = []
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  };
+
+  pipeline.connections.push_back(pipeline.cartesian_converter.connect(
+    [&](const quanergy::client::PolarToCartConverter::ResultType& pc)
+    {
+      std::int64_t output = now();
+      last_output.store(output, std::memory_order_relaxed);
+
+      std::int64_t latency = output - last_slot.load(std::memory_order_relaxed);
+      frame_latency.record(static_cast<std::uint64_t>(latency > 0 ? latency : 0));
+      frames.fetch_add(1, std::memory_order_relaxed);
+      points.fetch_add(pc->size(), std::memory_order_relaxed);
+    }
+  ));
+
+  auto feed = [&](std::size_t count)
+  {
+    for (std::size_t pass = 0; pass < count; ++pass)
+    {
+      for (const auto& packet : packets)
+      {
+        last_slot.store(now(), std::memory_order_relaxed);
+        pipeline.slot(packet);
+      }
+    }
+
+    // let decode threads finish what is in flight
+    if (result.decode_threads > 0)
+    {
+      std::uint64_t seen;
+      do
+      {
+        seen = frames;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      } while (frames != seen);
+    }
+  };
+
+  try
+  {
+    feed(warmup);
+
+    // each repetition is a complete measurement, normalized by calibrations on both sides of it to follow
+    // the machine's speed while it runs; the one with median normalized throughput is reported
+    double calibration = quanergy::bench::calibrate();
+    std::vector<BenchResult> runs;
+    std::vector<quanergy::bench::PerfMetrics> metrics;
+    for (std::size_t repetition = 0; repetition < std::max<std::size_t>(repetitions, 1); ++repetition)
+    {
+      frames = 0;
+      points = 0;
+      frame_latency.reset();
+      pipeline.latency_stats.reset();
+
+      std::uint64_t allocations_start = allocations;
+      std::clock_t cpu_start = std::clock();
+      std::int64_t start = now();
+
+      feed(passes);
+
+      // with decode threads, the run ends with the last cloud rather than after waiting for it
+      std::int64_t end = result.decode_threads > 0 ? std::max<std::int64_t>(last_output, start) : now();
+
+      BenchResult run = result;
+      run.cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+      run.allocations = allocations - allocations_start;
+      run.seconds = (end - start) * 1e-9;
+      run.packets = passes * packets.size();
+      run.frames = frames;
+      run.points = points;
+      run.frame_latency = frame_latency.summary();
+      if (stages)
+        run.stages = pipeline.latency_stats.snapshot();
+
+      double calibration_after = quanergy::bench::calibrate();
+      run.calibration_ns = (calibration + calibration_after) / 2.;
+      calibration = calibration_after;
+      runs.push_back(run);
+
+      quanergy::bench::PerfMetrics run_metrics;
+      run_metrics.packet_type = run.packet_type;
+      run_metrics.return_selection = run.return_selection;
+      run_metrics.points_per_second = run.pointsPerSecond();
+      run_metrics.p99_us = run.frame_latency.p99 * 1e-3;
+      run_metrics.calibration_ns = run.calibration_ns;
+      metrics.push_back(run_metrics);
+    }
+
+    std::sort(runs.begin(), runs.end(), [](const BenchResult& a, const BenchResult& b)
+    {
+      return a.pointsPerSecond() * a.calibration_ns < b.pointsPerSecond() * b.calibration_ns;
+    });
+    result = runs[runs.size() / 2];
+    result.repetitions = runs.size();
+    result.perf = quanergy::bench::summarize(metrics);
+    result.perf.tolerance = tolerance;
+  }
+  catch (std::exception& e)
+  {
+    std::cout << "Error: " << e.what() << std::endl;
+    return -2;
+  }
+
+  if (json)
+    writeJson(std::cout, result);
+  else
+    writeText(std::cout, result);
+
+  if (!output_file.empty())
+  {
+    std::ofstream out(output_file);
+    writeJson(out, result);
+    if (!out)
+    {
+      std::cout << "Error: unable to write " << output_file << std::endl;
+      return -2;
+    }
+  }
+
+  if (!baseline_file.empty())
+  {
+    try
+    {
+      // the report goes to stderr so --json output stays valid
+      std::ostream& report = json ? std::cerr : std::cout;
+      report << "\n";
+      if (!quanergy::bench::comparePerf(baseline, result.perf, tolerance, report))
+        return 1;
+    }
+    catch (std::exception& e)
+    {
+      std::cout << "Error: " << e.what() << std::endl;
+      return -2;
+    }
+  }
+
+  return 0;
+}
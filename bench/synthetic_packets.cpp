@@ -0,0 +1,259 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include "synthetic_packets.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <quanergy/parsers/data_packet_00.h>
+#include <quanergy/parsers/data_packet_01.h>
+#include <quanergy/parsers/data_packet_04.h>
+#include <quanergy/parsers/data_packet_06.h>
+#include <quanergy/parsers/data_packet_parser_m_series.h>
+
+namespace quanergy
+{
+  namespace bench
+  {
+    namespace
+    {
+      /// firings in one revolution
+      const int FIRINGS_PER_REV = client::M_SERIES_NUM_ROT_ANGLES / POSITION_STEP;
+      const int PACKETS_PER_REV = FIRINGS_PER_REV / client::M_SERIES_FIRING_PER_PKT;
+
+      /// range in 10 um units; varies with laser, return and position so returns are distinct
+      std::uint32_t range(int laser, int return_index, int position)
+      {
+        return static_cast<std::uint32_t>(100000 * (laser + 2) + 50000 * return_index + 10 * (position % 1000));
+      }
+
+      std::uint8_t intensity(int laser, int return_index, int position)
+      {
+        return static_cast<std::uint8_t>((laser * 31 + return_index * 17 + position) % 255);
+      }
+
+      void setHeader(client::PacketHeader& header, std::uint8_t packet_type, std::size_t size, int packet)
+      {
+        header.signature = htonl(client::SIGNATURE);
+        header.size = htonl(static_cast<std::uint32_t>(size));
+        // 10 Hz
+        header.seconds = htonl(1600000000u + packet / (10 * PACKETS_PER_REV));
+        header.nanoseconds = htonl(static_cast<std::uint32_t>(
+          (packet % (10 * PACKETS_PER_REV)) * (100000000ull / PACKETS_PER_REV)));
+        header.version_major = 0x00;
+        header.version_minor = 0x01;
+        header.version_patch = 0x00;
+        header.packet_type = packet_type;
+      }
+
+      template <class PACKET>
+      Packet copy(const PACKET& packet)
+      {
+        auto buffer = std::make_shared<std::vector<char>>(sizeof(PACKET));
+        std::memcpy(buffer->data(), &packet, sizeof(PACKET));
+        return buffer;
+      }
+
+      int position(int packet, int firing)
+      {
+        return ((packet * client::M_SERIES_FIRING_PER_PKT + firing) * POSITION_STEP) % client::M_SERIES_NUM_ROT_ANGLES;
+      }
+
+      Packet makePacket00(int packet_index)
+      {
+        client::DataPacket00 packet = client::DataPacket00();
+        setHeader(packet.packet_header, 0x00, sizeof(packet), packet_index);
+
+        for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+        {
+          auto& firing = packet.data_body.data[i];
+          int p = position(packet_index, i);
+          firing.position = htons(static_cast<std::uint16_t>(p));
+          for (int r = 0; r < client::M_SERIES_NUM_RETURNS; ++r)
+          {
+            for (int laser = 0; laser < client::M_SERIES_NUM_LASERS; ++laser)
+            {
+              firing.returns_distances[r][laser] = htonl(range(laser, r, p));
+              firing.returns_intensities[r][laser] = intensity(laser, r, p);
+            }
+          }
+        }
+
+        // version 5 uses 10 um distance units
+        packet.data_body.version = htons(5);
+        return copy(packet);
+      }
+
+      Packet makePacket04(int packet_index, int return_id)
+      {
+        client::DataPacket04 packet = client::DataPacket04();
+        setHeader(packet.packet_header, 0x04, sizeof(packet), packet_index);
+        packet.data.data_header.return_id = static_cast<std::uint8_t>(return_id);
+
+        for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+        {
+          auto& firing = packet.data.firings[i];
+          int p = position(packet_index, i);
+          firing.position = htons(static_cast<std::uint16_t>(p));
+          for (int laser = 0; laser < client::M_SERIES_NUM_LASERS; ++laser)
+          {
+            firing.radius[laser] = htonl(range(laser, return_id, p));
+            firing.intensity[laser] = intensity(laser, return_id, p);
+          }
+        }
+
+        return copy(packet);
+      }
+
+      template <std::uint8_t R>
+      Packet makePacket06(int packet_index, int return_id)
+      {
+        client::DataPacket06<R> packet = client::DataPacket06<R>();
+        setHeader(packet.packet_header, 0x06, sizeof(packet), packet_index);
+        packet.data_header.return_id = static_cast<std::uint8_t>(return_id);
+
+        for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+        {
+          auto& firing = packet.data.firings[i];
+          int p = position(packet_index, i);
+          firing.position = htons(static_cast<std::uint16_t>(p));
+          for (int r = 0; r < R; ++r)
+          {
+            int return_index = R == 1 ? return_id : r;
+            firing.radius[r] = htonl(range(0, return_index, p));
+            firing.intensity[r] = intensity(0, return_index, p);
+          }
+        }
+
+        return copy(packet);
+      }
+
+      Packet makePacket01()
+      {
+        const std::uint32_t rings = client::M_SERIES_NUM_LASERS;
+        const std::uint32_t point_count = rings * POINTS_PER_RING_01;
+        const std::size_t size = sizeof(client::PacketHeader) + sizeof(client::DataHeader01)
+                                 + point_count * sizeof(client::DataPoint01);
+
+        auto buffer = std::make_shared<std::vector<char>>(size, 0);
+
+        client::PacketHeader header;
+        setHeader(header, 0x01, size, 0);
+        std::memcpy(buffer->data(), &header, sizeof(header));
+
+        client::DataHeader01 data_header;
+        data_header.sequence = 0;
+        data_header.status = 0;
+        data_header.point_count = htonl(point_count);
+        data_header.reserved = 0;
+        std::memcpy(buffer->data() + sizeof(header), &data_header, sizeof(data_header));
+
+        char* point_buffer = buffer->data() + sizeof(header) + sizeof(data_header);
+        for (std::uint32_t ring = 0; ring < rings; ++ring)
+        {
+          for (int i = 0; i < POINTS_PER_RING_01; ++i)
+          {
+            client::DataPoint01 point;
+            // 1/10,000 radians; sweep [-pi, pi) horizontally, rings 2 degrees apart
+            point.horizontal_angle = htons(static_cast<std::uint16_t>(
+              static_cast<std::int16_t>(-31416 + i * 62832 / POINTS_PER_RING_01)));
+            point.vertical_angle = htons(static_cast<std::uint16_t>(
+              static_cast<std::int16_t>((static_cast<int>(ring) - 4) * 349)));
+            point.range = htonl(range(ring, 0, i) * 10); // micrometers
+            point.intensity = htons(intensity(ring, 0, i));
+            point.status = 0;
+            point.reserved = 0;
+
+            std::memcpy(point_buffer, &point, sizeof(point));
+            point_buffer += sizeof(point);
+          }
+        }
+
+        return buffer;
+      }
+    }
+
+    std::vector<Packet> makeRevolution(std::uint8_t packet_type, int return_id)
+    {
+      std::vector<Packet> packets;
+
+      if (packet_type == 0x01)
+      {
+        packets.push_back(makePacket01());
+        return packets;
+      }
+
+      if (packet_type != 0x00 && packet_type != 0x04 && packet_type != 0x06)
+        throw std::invalid_argument("Unsupported packet type " + std::to_string(packet_type));
+
+      if (return_id < 0 || return_id > 3 || (return_id == 3 && packet_type != 0x06))
+        throw std::invalid_argument("Invalid return id " + std::to_string(return_id));
+
+      for (int p = 0; p < PACKETS_PER_REV; ++p)
+      {
+        if (packet_type == 0x00)
+          packets.push_back(makePacket00(p));
+        else if (packet_type == 0x04)
+          packets.push_back(makePacket04(p, return_id));
+        else if (return_id == 3)
+          packets.push_back(makePacket06<client::M_SERIES_NUM_RETURNS>(p, return_id));
+        else
+          packets.push_back(makePacket06<1>(p, return_id));
+      }
+
+      return packets;
+    }
+
+    std::vector<Packet> readCapture(const std::string& file_name)
+    {
+      std::ifstream in(file_name, std::ios::binary);
+      if (!in)
+        throw std::runtime_error("Unable to open capture " + file_name);
+
+      std::vector<Packet> packets;
+      for (;;)
+      {
+        client::PacketHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+          break;
+
+        std::size_t size = client::getPacketSize(header);
+        if (!client::validateHeader(header) || size < sizeof(header))
+          throw std::runtime_error("Invalid packet header in capture " + file_name);
+
+        auto packet = std::make_shared<std::vector<char>>(size);
+        std::memcpy(packet->data(), &header, sizeof(header));
+        if (!in.read(packet->data() + sizeof(header), size - sizeof(header)))
+          break; // capture ended mid packet
+
+        packets.push_back(packet);
+      }
+
+      return packets;
+    }
+
+    std::uint8_t packetType(const std::vector<char>& packet)
+    {
+      if (packet.size() < sizeof(client::PacketHeader))
+        throw std::runtime_error("Packet too small for a header");
+
+      return reinterpret_cast<const client::PacketHeader*>(packet.data())->packet_type;
+    }
+
+    std::string deviceInfoFor(std::uint8_t packet_type)
+    {
+      // M8 without vertical angles uses the M8 defaults
+      const char* model = packet_type == 0x06 ? "M1" : packet_type == 0x01 ? "S3-2" : "M8";
+      return std::string("<DeviceInfo><model>") + model + "</model></DeviceInfo>";
+    }
+
+  } // namespace bench
+
+} // namespace quanergy
@@ -0,0 +1,60 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file synthetic_packets.h
+ *
+ *  \brief Packets for benchmarks, generated in memory or read from a capture.
+ *
+ *  Generated packets are in network byte order and exactly as a sensor sends
+ *  them, so they exercise the same code as live data. A capture is a raw dump
+ *  of the sensor's TCP data stream, e.g. `nc <sensor> 4141 > capture.bin`.
+ */
+
+#ifndef QUANERGY_BENCH_SYNTHETIC_PACKETS_H
+#define QUANERGY_BENCH_SYNTHETIC_PACKETS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace quanergy
+{
+  namespace bench
+  {
+    typedef std::shared_ptr<std::vector<char>> Packet;
+
+    /// encoder positions advance this much per firing; about 10 Hz on an M8
+    const int POSITION_STEP = 2;
+
+    /// points per ring in a generated 0x01 packet
+    const int POINTS_PER_RING_01 = 1000;
+
+    /** \brief packets covering exactly one revolution; cycling through them yields one cloud per revolution
+     *  \param packet_type is 0x00, 0x01, 0x04 or 0x06
+     *  \param return_id is the return in single return packets (0x04, 0x06); 3 makes 0x06 packets with all returns.
+     *         0x00 packets always carry all returns and 0x01 has none
+     *  \note 0x01 packets are a full cloud each, so the revolution is a single packet
+     */
+    std::vector<Packet> makeRevolution(std::uint8_t packet_type, int return_id = 0);
+
+    /** \brief split a capture of the sensor TCP stream into packets
+     *  \throws std::runtime_error if the file can't be read or a header is invalid
+     */
+    std::vector<Packet> readCapture(const std::string& file_name);
+
+    /// packet type from the packet header
+    std::uint8_t packetType(const std::vector<char>& packet);
+
+    /// device info XML of a sensor model that sends packet_type, so a pipeline can be created without a sensor
+    std::string deviceInfoFor(std::uint8_t packet_type);
+
+  } // namespace bench
+
+} // namespace quanergy
+
+#endif
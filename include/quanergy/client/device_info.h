@@ -5,8 +5,13 @@
  **                                                            **
  ****************************************************************/
 
+#ifndef QUANERGY_CLIENT_DEVICE_INFO_H
+#define QUANERGY_CLIENT_DEVICE_INFO_H
+
 #include <boost/optional.hpp>
 
+#include <istream>
+#include <string>
 #include <vector>
 
 namespace quanergy
@@ -23,6 +28,11 @@ namespace quanergy
        */
       DeviceInfo(const std::string& host);
 
+      /** \brief Constructor reading the device info XML from a stream, e.g. a saved copy
+       *  \param device_info_xml is the document the sensor serves at /PSIA/System/deviceInfo
+       */
+      DeviceInfo(std::istream& device_info_xml);
+
       /// \brief get the model; empty string indicates an error loading the device info */
       const std::string& model() const { return model_; }
 
@@ -36,6 +46,9 @@ namespace quanergy
       const std::vector<double>& verticalAngles() const { return vertical_angles_; }
 
     private:
+      /// parse the device info XML
+      void load(std::istream& device_info_xml);
+
       const std::string device_info_path_ {"/PSIA/System/deviceInfo"};
 
       std::string model_;
@@ -46,3 +59,4 @@ namespace quanergy
   }
 }
 
+#endif
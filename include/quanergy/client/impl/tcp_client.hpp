@@ -9,10 +9,11 @@
 
 #include <quanergy/client/tcp_client.h>
 
-#include <iostream>
-
 #include <boost/version.hpp>
 
+#include <quanergy/common/logger.h>
+#include <quanergy/common/trace.h>
+
 namespace quanergy
 {
   namespace client
@@ -42,6 +43,12 @@ namespace quanergy
       return signal_.connect(subscriber);
     }
 
+    template <class HEADER>
+    void TCPClient<HEADER>::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
     template <class HEADER>
     void TCPClient<HEADER>::run()
     {
@@ -49,6 +56,7 @@ namespace quanergy
         return;
 
       kill_ = false;
+      Tracer::instance().setThreadName(std::this_thread::get_id(), "tcp_read");
       read_socket_.reset(new boost::asio::ip::tcp::socket(io_service_));
       io_service_.reset();
 
@@ -70,6 +78,7 @@ namespace quanergy
                                                 stop();
                                               }
                                             }));
+        Tracer::instance().setThreadName(signal_thread_->get_id(), "tcp_signal");
 
         // Add this thread to the pool to handle data
         io_service_.run();
@@ -102,6 +111,12 @@ namespace quanergy
         return;
 
       kill_ = true;
+      // release a read waiting for room; locking orders this after its check of kill_
+      {
+        std::lock_guard<std::mutex> lk(buff_queue_mutex_);
+      }
+      buff_queue_space_conditional_.notify_all();
+
       // close socket before stopping service to cancel async operations
       read_socket_->close();
       // guarantee we recognize the closed socket before stopping
@@ -112,11 +127,21 @@ namespace quanergy
       buff_queue_conditional_.notify_one();
     }
 
+    template <class HEADER>
+    void TCPClient<HEADER>::writeMetrics(MetricsWriter& writer, const MetricLabels& labels) const
+    {
+      writer.counter("packets_received_total", "Packets received from the sensor", getPacketsReceived(), labels);
+      writer.counter("bytes_received_total", "Bytes received from the sensor", getBytesReceived(), labels);
+      writer.counter("packets_dropped_total", "Packets dropped because the client queue was full",
+                     getPacketsDropped(), labels);
+      writer.gauge("client_queue_depth", "Packets waiting in the client queue", getQueueDepth(), labels);
+    }
+
     template <class HEADER>
     void TCPClient<HEADER>::startDataConnect()
     {
-      std::cout << "Attempting to connect (" << host_query_.host_name()
-                << ":" << host_query_.service_name() << ")..." << std::endl;
+      QUANERGY_LOG(INFO, "Attempting to connect (" << host_query_.host_name()
+                   << ":" << host_query_.service_name() << ")...");
       boost::asio::ip::tcp::resolver resolver(io_service_);
 
       try
@@ -138,23 +163,23 @@ namespace quanergy
                                      }
                                      else if (error)
                                      {
-                                       std::cerr << "Unable to bind to socket (" << host_query_.host_name()
-                                                 << ":" << host_query_.service_name() << ")! "
-                                                 << error.message() << std::endl;
+                                       QUANERGY_LOG(ERR, "Unable to bind to socket (" << host_query_.host_name()
+                                                    << ":" << host_query_.service_name() << ")! "
+                                                    << error.message());
                                        throw SocketBindError(error.message());
                                      }
                                      else
                                      {
-                                       std::cout << "Connection established" << std::endl;
+                                       QUANERGY_LOG(INFO, "Connection established");
                                        startDataRead();
                                      }
                                    });
       }
       catch (boost::system::system_error& e)
       {
-        std::cerr << "Unable to resolve host (" << host_query_.host_name()
-                  << ":" << host_query_.service_name() << ")! "
-                  << e.what() << std::endl;
+        QUANERGY_LOG(ERR, "Unable to resolve host (" << host_query_.host_name()
+                     << ":" << host_query_.service_name() << ")! "
+                     << e.what());
         throw SocketBindError(e.what());
       }
     }
@@ -177,12 +202,14 @@ namespace quanergy
       }
       else if (error)
       {
-        std::cerr << "Error reading header: "
-                  << error.message() << std::endl;
+        QUANERGY_LOG(ERR, "Error reading header: " << error.message());
         throw SocketReadError(error.message());
       }
       else
       {
+        if (Tracer::instance().enabled())
+          read_start_ = Tracer::now();
+
         HEADER* h = reinterpret_cast<HEADER*>(buff_.data());
 
         // validate
@@ -213,22 +240,42 @@ namespace quanergy
       }
       else if (error)
       {
-        std::cerr << "Error reading body: "
-                  << error.message() << std::endl;
+        QUANERGY_LOG(ERR, "Error reading body: " << error.message());
         throw SocketReadError(error.message());
       }
       else
       {
+        Tracer& tracer = Tracer::instance();
+        std::uint64_t trace_id = 0;
+        if (tracer.enabled())
+        {
+          tracer.complete("packet_read", read_start_ ? read_start_ : Tracer::now(), Tracer::now());
+          trace_id = tracer.newFlowId();
+          tracer.flowBegin("client_queue", trace_id);
+        }
+
         std::unique_lock<std::mutex> lk(buff_queue_mutex_);
 
+        if (block_when_full_)
+        {
+          // hold the socket until the signal thread takes the queue rather than drop a packet
+          buff_queue_space_conditional_.wait(lk, [this]{ return buff_queue_.size() < max_queue_size_ || kill_; });
+          if (kill_)
+            return;
+        }
+
         // copy into shared_ptr
-        buff_queue_.push(std::make_shared<std::vector<char>>(buff_));
+        buff_queue_.push(QueuedPacket{std::make_shared<std::vector<char>>(buff_), trace_id});
+        packets_received_.fetch_add(1, std::memory_order_relaxed);
+        bytes_received_.fetch_add(buff_.size(), std::memory_order_relaxed);
 
         while (buff_queue_.size() > max_queue_size_)
         {
           buff_queue_.pop();
-          std::cout << "Warning: Client dropped packet due to full buffer" << std::endl;
+          packets_dropped_.fetch_add(1, std::memory_order_relaxed);
+          QUANERGY_LOG_THROTTLED(WARNING, "Warning: Client dropped packet due to full buffer");
         }
+        queue_depth_ = buff_queue_.size();
         lk.unlock();
 
         // Free up the CPU to allow the consumer thread a chance to keep up.
@@ -265,13 +312,20 @@ namespace quanergy
 
         decltype(buff_queue_) local_q;
         std::swap(buff_queue_, local_q);
+        queue_depth_ = 0;
         lk.unlock();
+        buff_queue_space_conditional_.notify_one();
 
         while (!local_q.empty())
         {
-          auto packet = local_q.front();
+          auto queued = local_q.front();
           local_q.pop();
-          signal_(packet);
+
+          QUANERGY_TRACE_SCOPE("signal_packet");
+          if (queued.trace_id)
+            Tracer::instance().flowEnd("client_queue", queued.trace_id);
+
+          signal_(queued.packet);
         }
       }
     }
@@ -0,0 +1,88 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file metrics_server.h
+ *
+ *  \brief Minimal HTTP server exposing metrics for Prometheus scrapes.
+ *
+ *  Every request, whatever its path, is answered with the output of the
+ *  registered collectors. Collectors run on the server thread at scrape time,
+ *  so they only read counters; nothing is added to the data path.
+ */
+
+#ifndef QUANERGY_CLIENT_METRICS_SERVER_H
+#define QUANERGY_CLIENT_METRICS_SERVER_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// networking
+#include <boost/asio.hpp>
+
+#include <quanergy/common/metrics.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    class DLLEXPORT MetricsServer
+    {
+    public:
+      /// adds samples to the writer
+      typedef std::function<void (MetricsWriter&)> Collector;
+
+      /** \brief Constructor taking the port and the address to listen on
+       *  \param port of 0 picks a free port; see getPort
+       */
+      MetricsServer(unsigned short port, const std::string& address = "127.0.0.1");
+
+      // noncopyable
+      MetricsServer(const MetricsServer&) = delete;
+      MetricsServer& operator=(const MetricsServer&) = delete;
+
+      virtual ~MetricsServer();
+
+      /// add a collector; may be called while running
+      void addCollector(Collector collector);
+
+      /// start serving on a background thread
+      void start();
+
+      /// stop serving; called by the destructor
+      void stop();
+
+      /// port being listened on
+      unsigned short getPort() const;
+
+      /// current metrics text, as served
+      std::string scrape();
+
+    private:
+      struct Session;
+
+      void startAccept();
+
+      boost::asio::io_service                         io_service_;
+      boost::asio::ip::tcp::acceptor                  acceptor_;
+      std::unique_ptr<boost::asio::io_service::work>  work_;
+      std::thread                                     thread_;
+
+      std::mutex                                      collectors_mutex_;
+      std::vector<Collector>                          collectors_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,132 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file packet_error.h
+  * \brief Per packet error reasons and counters for the non-throwing error path.
+  *
+  * Under ErrorPolicy::CONTINUE, parsers drop packets that would otherwise throw
+  * and count them by reason. Configuration errors always throw.
+  */
+
+#ifndef QUANERGY_CLIENT_PACKET_ERROR_H
+#define QUANERGY_CLIENT_PACKET_ERROR_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace quanergy
+{
+  namespace client
+  {
+
+    /** \brief how parsers handle per packet errors */
+    enum struct ErrorPolicy
+    {
+      THROW,    ///< throw the matching exception (default)
+      CONTINUE  ///< drop the packet, count the reason and continue
+    };
+
+    /** \brief reasons a packet is dropped */
+    enum struct PacketError : std::uint8_t
+    {
+      INVALID_PACKET,              ///< no parser matches the packet
+      SIZE_MISMATCH,               ///< packet size doesn't match its contents
+      RETURN_ID_MISMATCH,          ///< return ID doesn't match the requested return selection
+      FIRMWARE_VERSION_MISMATCH,   ///< sensor status reports a firmware mismatch
+      FIRMWARE_WATCHDOG_VIOLATION, ///< sensor status reports a watchdog violation
+      NUM_ERRORS
+    };
+
+    static const std::size_t NUM_PACKET_ERRORS = static_cast<std::size_t>(PacketError::NUM_ERRORS);
+
+    /** \brief printable name of an error reason */
+    inline const char* toString(PacketError error)
+    {
+      switch (error)
+      {
+        case PacketError::INVALID_PACKET:              return "invalid packet";
+        case PacketError::SIZE_MISMATCH:               return "size mismatch";
+        case PacketError::RETURN_ID_MISMATCH:          return "return ID mismatch";
+        case PacketError::FIRMWARE_VERSION_MISMATCH:   return "firmware version mismatch";
+        case PacketError::FIRMWARE_WATCHDOG_VIOLATION: return "firmware watchdog violation";
+        default:                                       return "unknown";
+      }
+    }
+
+    /** \brief snapshot of error counts by reason */
+    struct PacketErrorCounts
+    {
+      std::uint64_t counts[NUM_PACKET_ERRORS] = {0};
+
+      std::uint64_t operator[](PacketError error) const { return counts[static_cast<std::size_t>(error)]; }
+
+      std::uint64_t total() const
+      {
+        std::uint64_t sum = 0;
+        for (auto count : counts)
+          sum += count;
+        return sum;
+      }
+
+      PacketErrorCounts& operator+=(const PacketErrorCounts& other)
+      {
+        for (std::size_t i = 0; i < NUM_PACKET_ERRORS; ++i)
+          counts[i] += other.counts[i];
+        return *this;
+      }
+    };
+
+    /** \brief error counters; incremented on the packet path and readable from any thread */
+    class PacketErrorCounters
+    {
+    public:
+      PacketErrorCounters()
+      {
+        reset();
+      }
+
+      /// copies the current counts so owners stay copyable
+      PacketErrorCounters(const PacketErrorCounters& other)
+      {
+        *this = other;
+      }
+
+      PacketErrorCounters& operator=(const PacketErrorCounters& other)
+      {
+        for (std::size_t i = 0; i < NUM_PACKET_ERRORS; ++i)
+          counts_[i].store(other.counts_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+      }
+
+      void increment(PacketError error)
+      {
+        counts_[static_cast<std::size_t>(error)].fetch_add(1, std::memory_order_relaxed);
+      }
+
+      PacketErrorCounts snapshot() const
+      {
+        PacketErrorCounts result;
+        for (std::size_t i = 0; i < NUM_PACKET_ERRORS; ++i)
+          result.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        return result;
+      }
+
+      void reset()
+      {
+        for (auto& count : counts_)
+          count.store(0, std::memory_order_relaxed);
+      }
+
+    private:
+      std::atomic<std::uint64_t> counts_[NUM_PACKET_ERRORS];
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
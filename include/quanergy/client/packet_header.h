@@ -24,7 +24,7 @@
 
 #include <quanergy/client/exceptions.h>
 
-#include <iostream>
+#include <quanergy/common/logger.h>
 
 namespace quanergy
 {
@@ -98,8 +98,8 @@ namespace quanergy
     {
       if (deserialize(object.signature) != SIGNATURE)
       {
-        std::cerr << "Invalid header signature: " << std::hex << std::showbase
-                  << object.signature << std::dec << std::noshowbase << std::endl;
+        QUANERGY_LOG_THROTTLED(ERR, "Invalid header signature: " << std::hex << std::showbase
+                               << object.signature);
 
         return false;
       }
@@ -24,10 +24,14 @@
 #include <boost/asio.hpp>
 // signals for output
 #include <boost/signals2.hpp>
+#include <quanergy/common/callback_chain.h>
 
 // exception library
 #include <quanergy/client/exceptions.h>
 
+// metrics output
+#include <quanergy/common/metrics.h>
+
 namespace quanergy
 {
   namespace client
@@ -48,6 +52,8 @@ namespace quanergy
       typedef HEADER HeaderType;
       /// The packet is output on a signal
       typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      /// or to callbacks, which are called without locking
+      typedef typename CallbackChain<ResultType>::Callback Callback;
 
       /** \brief Constructor taking a host, port, and queue size.
        */
@@ -67,12 +73,33 @@ namespace quanergy
       /** \brief Connect a slot to the signal which will be emitted when a new RESULT is available */
       boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
 
+      /** \brief Add a callback called with each packet; add callbacks before run, they can't be disconnected */
+      void connectCallback(Callback callback);
+
       /** \brief Starts processing the Quanergy packets */
       virtual void run();
 
       /** \brief Stops processing the Quanergy packets */
       virtual void stop();
 
+      /** \brief Counters since construction; safe to read from any thread */
+      std::uint64_t getPacketsReceived() const { return packets_received_; }
+      std::uint64_t getBytesReceived() const { return bytes_received_; }
+      std::uint64_t getPacketsDropped() const { return packets_dropped_; }
+      std::size_t getQueueDepth() const { return queue_depth_; }
+      /// packets the queue holds before the oldest are dropped
+      std::size_t getMaxQueueSize() const { return max_queue_size_; }
+
+      /** \brief Wait for room instead of dropping the oldest packet when the queue is full
+       *  \details the socket isn't read while waiting, so TCP holds the sensor back and no packet goes missing
+       *           from the middle of a frame; pair with SensorPipeline's shedFrames to skip whole frames instead.
+       *           Set before run
+       */
+      void setBlockWhenFull(bool block) { block_when_full_ = block; }
+
+      /** \brief Add the counters to a metrics scrape */
+      void writeMetrics(MetricsWriter& writer, const MetricLabels& labels = MetricLabels()) const;
+
     protected:
 
       /** \brief Asynchronously wait for connection. */
@@ -101,13 +128,31 @@ namespace quanergy
       /// thread for running signals
       std::unique_ptr<std::thread> signal_thread_;
 
-      std::queue<std::shared_ptr<std::vector<char>>> buff_queue_;
+      /// packet waiting for the signal thread and its trace flow id (0 when not tracing)
+      struct QueuedPacket
+      {
+        std::shared_ptr<std::vector<char>> packet;
+        std::uint64_t trace_id;
+      };
+
+      std::queue<QueuedPacket>    buff_queue_;
       std::size_t max_queue_size_;
       std::mutex                  buff_queue_mutex_;
       std::condition_variable     buff_queue_conditional_;
+      /// the read thread waits on this for room when block_when_full_
+      std::condition_variable     buff_queue_space_conditional_;
+      bool                        block_when_full_ = false;
       std::atomic<bool>           kill_; // std::atomic_bool lacks proper constructors in MSVC
 
-      Signal signal_;
+      std::atomic<std::uint64_t>  packets_received_ {0};
+      std::atomic<std::uint64_t>  bytes_received_ {0};
+      std::atomic<std::uint64_t>  packets_dropped_ {0};
+      std::atomic<std::size_t>    queue_depth_ {0};
+
+      /// when the current packet's header arrived; only set when tracing
+      std::uint64_t               read_start_ = 0;
+
+      CallbackChain<ResultType> signal_;
     };
 
   } // namespace client
@@ -0,0 +1,164 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file bounded_ring.h
+ *
+ *  \brief Bounded lock-free queue for handing values between threads.
+ *
+ *  This is Dmitry Vyukov's bounded MPMC queue: each cell carries a sequence
+ *  number that says whether it is ready to be written or read at a given
+ *  position, so producers and consumers only contend on their own position
+ *  counter. Any thread may push or pop, which also lets a producer pop the
+ *  oldest value to make room.
+ */
+
+#ifndef QUANERGY_COMMON_BOUNDED_RING_H
+#define QUANERGY_COMMON_BOUNDED_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace quanergy
+{
+  template <class Type>
+  class BoundedRing
+  {
+  public:
+    /** \brief constructor
+     *  \param capacity is the number of values the ring holds; must be at least 1
+     */
+    explicit BoundedRing(std::size_t capacity)
+      : capacity_(capacity)
+      , cell_count_(capacity < 2 ? 2 : capacity)
+    {
+      if (capacity_ == 0)
+        throw std::invalid_argument("BoundedRing capacity must be at least 1");
+
+      cells_.reset(new Cell[cell_count_]);
+      for (std::size_t i = 0; i < cell_count_; ++i)
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    std::size_t capacity() const { return capacity_; }
+
+    /// values in the ring; approximate while other threads push or pop
+    std::size_t size() const
+    {
+      std::size_t dequeue = dequeue_pos_.load(std::memory_order_relaxed);
+      std::size_t enqueue = enqueue_pos_.load(std::memory_order_relaxed);
+      return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    /// add a value; returns false, leaving value untouched, if the ring is full
+    bool push(Type&& value)
+    {
+      std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+      Cell* cell;
+      for (;;)
+      {
+        cell = &cells_[pos % cell_count_];
+        std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+
+        // the cells only bound the ring when there are capacity of them
+        if (difference == 0 && cell_count_ != capacity_ &&
+            pos - dequeue_pos_.load(std::memory_order_acquire) >= capacity_)
+        {
+          return false;
+        }
+
+        if (difference == 0)
+        {
+          if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            break;
+        }
+        else if (difference < 0)
+        {
+          return false;
+        }
+        else
+        {
+          pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+      }
+
+      cell->value = std::move(value);
+      cell->sequence.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool push(const Type& value)
+    {
+      Type copy(value);
+      return push(std::move(copy));
+    }
+
+    /// take the oldest value; returns false if the ring is empty
+    bool pop(Type& value)
+    {
+      std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+      Cell* cell;
+      for (;;)
+      {
+        cell = &cells_[pos % cell_count_];
+        std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+
+        if (difference == 0)
+        {
+          if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            break;
+        }
+        else if (difference < 0)
+        {
+          return false;
+        }
+        else
+        {
+          pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+      }
+
+      value = std::move(cell->value);
+      // release what the cell held now rather than when it is next overwritten
+      cell->value = Type();
+      cell->sequence.store(pos + cell_count_, std::memory_order_release);
+      return true;
+    }
+
+  private:
+    struct Cell
+    {
+      std::atomic<std::size_t> sequence;
+      Type value;
+    };
+
+    const std::size_t capacity_;
+    /// a cell's sequence can't tell full from empty with a single cell, so there are at least 2
+    const std::size_t cell_count_;
+    std::unique_ptr<Cell[]> cells_;
+
+    // padded onto separate cache lines so producers and consumers don't share one; padding rather
+    // than alignas since C++14 new doesn't honor over alignment
+    char pad0_[64];
+    std::atomic<std::size_t> enqueue_pos_ {0};
+    char pad1_[64];
+    std::atomic<std::size_t> dequeue_pos_ {0};
+    char pad2_[64];
+  };
+
+} // namespace quanergy
+
+#endif
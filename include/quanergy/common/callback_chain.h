@@ -0,0 +1,73 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file callback_chain.h
+ *
+ *  \brief Output of a pipeline module: callbacks called without locking plus a boost signal.
+ */
+
+#ifndef QUANERGY_COMMON_CALLBACK_CHAIN_H
+#define QUANERGY_COMMON_CALLBACK_CHAIN_H
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <boost/signals2.hpp>
+
+namespace quanergy
+{
+  /** \brief callbacks added during setup are called without locking; the signal is for subscribers that
+   *         disconnect or connect while data flows, and is only called once something is connected to it
+   */
+  template <class Result>
+  class CallbackChain
+  {
+  public:
+    using Signal = boost::signals2::signal<void (const Result&)>;
+    using Callback = std::function<void (const Result&)>;
+
+    /// connect to the signal; may be called any time and disconnected through the connection
+    boost::signals2::connection connect(const typename Signal::slot_type& subscriber)
+    {
+      signal_used_.store(true, std::memory_order_release);
+      return signal_.connect(subscriber);
+    }
+
+    /** \brief add a callback; it is called before the signal subscribers, in the order added
+     *  \note not thread safe with calls; add callbacks before data flows. They can't be removed
+     */
+    void add(Callback callback)
+    {
+      callbacks_.push_back(std::move(callback));
+    }
+
+    /// true if nothing would be called; only locks when the signal has been connected
+    bool empty() const
+    {
+      return callbacks_.empty() && (!signal_used_.load(std::memory_order_acquire) || signal_.empty());
+    }
+
+    void operator()(const Result& result) const
+    {
+      for (const auto& callback : callbacks_)
+        callback(result);
+
+      if (signal_used_.load(std::memory_order_acquire))
+        signal_(result);
+    }
+
+  private:
+    std::vector<Callback> callbacks_;
+    /// set on the first connect; the signal is left alone until then
+    std::atomic_bool signal_used_ {false};
+    Signal signal_;
+  };
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,130 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file frame_compact.h
+ *
+ *  \brief Quantized 8 byte per point frame for M-series data.
+ *
+ *  Points keep the sensor's native quantization: range in 10 micrometer units,
+ *  8 bit intensity and the ring index. Azimuth is stored in 1/65536 of a
+ *  revolution, which is finer than the 10400 encoder positions so encoder
+ *  corrected angles survive. Polar values are decoded lazily; the vertical
+ *  angle comes from the frame's per ring lookup table.
+ *  A range of 0 marks an invalid (NaN) point, as it does on the wire.
+ */
+
+#ifndef QUANERGY_COMMON_FRAME_COMPACT_H
+#define QUANERGY_COMMON_FRAME_COMPACT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <quanergy/common/pointcloud_types.h>
+#include <quanergy/client/m_series_data_packet.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  /** Quantized polar point; 8 bytes compared to 32 for PointHVDIR. */
+  struct PointCompact
+  {
+    std::uint32_t radius;     ///< range in 10 micrometer units; 0 is invalid
+    std::uint16_t azimuth;    ///< horizontal angle in 1/65536 revolution, 0 at -pi
+    std::uint8_t  intensity;  ///< laser intensity reading
+    std::uint8_t  ring;       ///< laser ring number
+  };
+
+  static_assert(sizeof(PointCompact) == 8, "PointCompact should be 8 bytes");
+
+  struct DLLEXPORT FrameCompact
+  {
+    /// meters per radius unit
+    static constexpr float RADIUS_SCALE = 0.00001f;
+    /// azimuth units per revolution
+    static constexpr std::uint32_t AZIMUTH_STEPS = 65536;
+
+    /// frame stamp (microseconds), same as the PCL header stamp
+    std::uint64_t stamp = 0;
+    std::uint32_t seq = 0;
+    std::string frame_id;
+
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    bool is_dense = true;
+
+    /// vertical angle (radians) for each ring
+    float vertical_angles[client::M_SERIES_NUM_LASERS] = {0.f};
+
+    std::vector<PointCompact> points;
+
+    std::size_t size() const { return points.size(); }
+    bool empty() const { return points.empty(); }
+    bool isOrganized() const { return height > 1; }
+    void reserve(std::size_t n) { points.reserve(n); }
+    void resize(std::size_t n) { points.resize(n); }
+
+    /// \brief lazily decoded polar values of the point at i
+    float h(std::size_t i) const { return azimuthToAngle(points[i].azimuth); }
+    float v(std::size_t i) const { return vertical_angles[points[i].ring % client::M_SERIES_NUM_LASERS]; }
+    float d(std::size_t i) const { return radiusToRange(points[i].radius); }
+    PointHVDIR at(std::size_t i) const;
+
+    static float azimuthToAngle(std::uint16_t azimuth)
+    {
+      return static_cast<float>(azimuth * (2. * M_PI / AZIMUTH_STEPS) - M_PI);
+    }
+
+    static std::uint16_t angleToAzimuth(double h)
+    {
+      // wrap to [0, 2pi) before quantizing; the cast wraps 65536 to 0
+      double n = (h + M_PI) / (2. * M_PI);
+      n -= std::floor(n);
+      return static_cast<std::uint16_t>(static_cast<std::uint32_t>(std::lround(n * AZIMUTH_STEPS)) % AZIMUTH_STEPS);
+    }
+
+    static float radiusToRange(std::uint32_t radius)
+    {
+      return radius == 0 ? std::numeric_limits<float>::quiet_NaN() : static_cast<float>(radius) * RADIUS_SCALE;
+    }
+
+    /// \brief NaN maps to 0; positive ranges never quantize to 0
+    static std::uint32_t rangeToRadius(float d)
+    {
+      if (!(d > 0.f))
+        return 0;
+
+      double radius = std::round(static_cast<double>(d) / RADIUS_SCALE);
+      if (radius >= std::numeric_limits<std::uint32_t>::max())
+        return std::numeric_limits<std::uint32_t>::max();
+
+      return std::max<std::uint32_t>(1, static_cast<std::uint32_t>(radius));
+    }
+  };
+
+  typedef std::shared_ptr<FrameCompact> FrameCompactPtr;
+  typedef std::shared_ptr<FrameCompact const> FrameCompactConstPtr;
+
+  /** \brief quantize an M-series HVDIR cloud; rings must be below M_SERIES_NUM_LASERS
+   *  \throws std::invalid_argument if a ring is out of range
+   */
+  DLLEXPORT void toFrame(const PointCloudHVDIR& cloud, FrameCompact& frame);
+
+  /** \brief decode a compact frame to a PCL HVDIR cloud */
+  DLLEXPORT void toPointCloud(const FrameCompact& frame, PointCloudHVDIR& cloud);
+
+  /** \brief decode a compact frame directly to a PCL XYZIR cloud */
+  DLLEXPORT void toPointCloud(const FrameCompact& frame, PointCloudXYZIR& cloud);
+
+} // namespace quanergy
+
+#endif
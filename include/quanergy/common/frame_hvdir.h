@@ -0,0 +1,85 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file frame_hvdir.h
+ *
+ *  \brief Structure of arrays frame of polar points.
+ *
+ *  Each field of PointHVDIR is stored in its own contiguous array so consumers
+ *  can process a field at a time (SIMD, ML preprocessing) without transposing.
+ *  Organized frames are row major with height rows of width points, matching
+ *  the layout of organized PCL clouds.
+ */
+
+#ifndef QUANERGY_COMMON_FRAME_HVDIR_H
+#define QUANERGY_COMMON_FRAME_HVDIR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <quanergy/common/pointcloud_types.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  struct DLLEXPORT FrameHVDIR
+  {
+    /// frame stamp (microseconds), same as the PCL header stamp
+    std::uint64_t stamp = 0;
+    /// frame counter
+    std::uint32_t seq = 0;
+    std::string frame_id;
+
+    /// organized frames have height > 1; unorganized frames have height 1 and width == size
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    /// false if any d is NaN
+    bool is_dense = true;
+
+    std::vector<float> h;
+    std::vector<float> v;
+    std::vector<float> d;
+    std::vector<float> intensity;
+    std::vector<std::uint16_t> ring;
+    /// optional per point stamp (microseconds); empty when not provided
+    std::vector<std::uint64_t> time;
+
+    std::size_t size() const { return d.size(); }
+    bool empty() const { return d.empty(); }
+    bool isOrganized() const { return height > 1; }
+    bool hasTime() const { return !time.empty(); }
+
+    /// index of the point at row, col of an organized frame
+    std::size_t index(std::uint32_t row, std::uint32_t col) const { return static_cast<std::size_t>(row) * width + col; }
+
+    /// clear points and layout; keeps the stamp, seq and frame id
+    void clear();
+    void reserve(std::size_t n);
+    /// resize all point arrays; time is only resized if the frame has time
+    void resize(std::size_t n);
+    void push_back(const PointHVDIR& pt);
+    void push_back(const PointHVDIR& pt, std::uint64_t point_time);
+
+    /// copy of the point at i
+    PointHVDIR at(std::size_t i) const;
+  };
+
+  typedef std::shared_ptr<FrameHVDIR> FrameHVDIRPtr;
+  typedef std::shared_ptr<FrameHVDIR const> FrameHVDIRConstPtr;
+
+  /** \brief transpose a PCL cloud into a frame, including header and layout */
+  DLLEXPORT void toFrame(const PointCloudHVDIR& cloud, FrameHVDIR& frame);
+
+  /** \brief build a PCL cloud from a frame, including header and layout; per point time is dropped */
+  DLLEXPORT void toPointCloud(const FrameHVDIR& frame, PointCloudHVDIR& cloud);
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,130 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file latency_histogram.h
+ *
+ *  \brief Low overhead latency histogram for pipeline instrumentation.
+ *
+ *  Values are nanoseconds recorded into log-linear buckets in the style of
+ *  HdrHistogram: every power of 2 is split into 64 linear sub-buckets, so
+ *  quantiles are within 1.6% of the recorded value from 1 ns up to
+ *  MAX_VALUE. Recording is a few relaxed atomic adds, so one stage can
+ *  record while another thread takes a snapshot.
+ *
+ *  Modules hold a LatencyHistogram pointer that is null by default. When it
+ *  is null, StageTimer doesn't read the clock.
+ */
+
+#ifndef QUANERGY_COMMON_LATENCY_HISTOGRAM_H
+#define QUANERGY_COMMON_LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  /** \brief quantiles of a histogram in nanoseconds */
+  struct DLLEXPORT LatencySummary
+  {
+    std::uint64_t count = 0;
+    std::uint64_t min = 0;
+    std::uint64_t p50 = 0;
+    std::uint64_t p99 = 0;
+    std::uint64_t p999 = 0;
+    std::uint64_t max = 0;
+    double mean = 0.;
+  };
+
+  class DLLEXPORT LatencyHistogram
+  {
+  public:
+    /// linear sub-buckets per power of 2
+    static const std::uint32_t SUB_BUCKETS = 64;
+    /// values up to 2^46 ns (about 19.5 hours); larger values are clamped
+    static const std::uint32_t MAX_EXPONENT = 46;
+    static const std::uint64_t MAX_VALUE = (std::uint64_t(1) << MAX_EXPONENT) - 1;
+    static const std::uint32_t NUM_BUCKETS = 2 * SUB_BUCKETS + (MAX_EXPONENT - 7) * SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    /// record a value in nanoseconds; safe to call from any thread
+    void record(std::uint64_t ns);
+
+    void record(std::chrono::steady_clock::duration duration)
+    {
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+      record(ns > 0 ? static_cast<std::uint64_t>(ns) : 0);
+    }
+
+    /// number of recorded values
+    std::uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    /// value at quantile q in [0, 1]; 0 if empty
+    std::uint64_t quantile(double q) const;
+
+    LatencySummary summary() const;
+
+    void reset();
+
+    /// bucket holding value
+    static std::uint32_t bucketIndex(std::uint64_t value);
+    /// representative (midpoint) value of a bucket
+    static std::uint64_t bucketValue(std::uint32_t index);
+
+  private:
+    std::atomic<std::uint64_t> buckets_[NUM_BUCKETS];
+    std::atomic<std::uint64_t> count_;
+    std::atomic<std::uint64_t> sum_;
+    std::atomic<std::uint64_t> min_;
+    std::atomic<std::uint64_t> max_;
+  };
+
+  /** \brief records the time between construction and stop (or destruction)
+   *  \details does nothing, including reading the clock, when the histogram is null
+   */
+  class StageTimer
+  {
+  public:
+    explicit StageTimer(LatencyHistogram* histogram)
+      : histogram_(histogram)
+    {
+      if (histogram_)
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    ~StageTimer()
+    {
+      stop();
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    /// record now; later calls do nothing
+    void stop()
+    {
+      if (histogram_)
+      {
+        histogram_->record(std::chrono::steady_clock::now() - start_);
+        histogram_ = nullptr;
+      }
+    }
+
+  private:
+    LatencyHistogram* histogram_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,178 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file logger.h
+ *
+ *  \brief Asynchronous, rate limited logger used for all library output; use the
+ *  QUANERGY_LOG macros.
+ */
+
+#ifndef QUANERGY_COMMON_LOGGER_H
+#define QUANERGY_COMMON_LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <quanergy/common/bounded_ring.h>
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  /** \brief message severity; OFF disables all output */
+  enum struct LogLevel : std::uint8_t
+  {
+    DEBUG,
+    INFO,
+    WARNING,
+    ERR,
+    OFF
+  };
+
+  /** \brief printable name of a level */
+  DLLEXPORT const char* toString(LogLevel level);
+
+  /** \brief a single log message as handed to the sink */
+  struct DLLEXPORT LogRecord
+  {
+    LogLevel level = LogLevel::INFO;
+    std::chrono::system_clock::time_point time;
+    /// call site
+    const char* file = "";
+    int line = 0;
+    std::string message;
+    /// messages from the same site suppressed by rate limiting since the previous one
+    std::uint64_t suppressed = 0;
+  };
+
+  /** \brief per call site rate limit; the logging macros create one static instance per site */
+  class DLLEXPORT LogSite
+  {
+  public:
+    /// interval used by QUANERGY_LOG_THROTTLED
+    static const std::uint32_t DEFAULT_INTERVAL_MS = 1000;
+
+    /** \param interval_ms is the minimum time between messages; 0 doesn't limit */
+    LogSite(const char* file, int line, std::uint32_t interval_ms = 0);
+
+    /** \brief check whether a message may be logged now
+     *  \param suppressed gets the number of messages suppressed since the last allowed one
+     */
+    bool allow(std::uint64_t& suppressed);
+
+    const char* file() const { return file_; }
+    int line() const { return line_; }
+
+  private:
+    const char* file_;
+    int line_;
+    std::int64_t interval_ns_;
+    std::atomic<std::int64_t> next_ns_ {0};
+    std::atomic<std::uint64_t> suppressed_ {0};
+  };
+
+  /** \brief process wide logger */
+  class DLLEXPORT Logger
+  {
+  public:
+    /// called on the writer thread for every message
+    using Sink = std::function<void (const LogRecord&)>;
+
+    /// queued messages beyond this are dropped
+    static const std::size_t QUEUE_SIZE = 1024;
+
+    static Logger& instance();
+
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /// messages below level are discarded before formatting
+    void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel getLevel() const { return level_.load(std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const { return level != LogLevel::OFF && level >= getLevel(); }
+
+    /** \brief replace the output; an empty sink discards messages
+     *  \details the default sink writes INFO and below to std::cout and the rest to std::cerr
+     */
+    void setSink(Sink sink);
+
+    /// the default sink
+    static void consoleSink(const LogRecord& record);
+
+    /** \brief queue a message without blocking; drops it if the queue is full */
+    void log(LogLevel level, const LogSite& site, std::string message, std::uint64_t suppressed = 0);
+
+    /** \brief block until all messages queued before the call have been written */
+    void flush();
+
+    /// messages dropped because the queue was full
+    std::uint64_t droppedCount() const { return dropped_total_.load(std::memory_order_relaxed); }
+
+  private:
+    Logger();
+
+    void write(const LogRecord& record);
+    void run();
+
+    BoundedRing<LogRecord> queue_;
+    /// messages queued and messages the writer has finished writing, for flush
+    std::atomic<std::uint64_t> queued_ {0};
+    std::atomic<std::uint64_t> written_ {0};
+
+    std::atomic<LogLevel> level_ {LogLevel::INFO};
+    std::atomic<std::uint64_t> dropped_ {0};
+    std::atomic<std::uint64_t> dropped_total_ {0};
+
+    std::mutex sink_mutex_;
+    Sink sink_;
+
+    /// only used to let the writer sleep; producers never take it
+    std::mutex wake_mutex_;
+    std::condition_variable wake_conditional_;
+    std::atomic_bool kill_ {false};
+    std::thread writer_;
+  };
+
+} // namespace quanergy
+
+/// log a message built with stream syntax, at most once per interval_ms from this site; nothing is formatted
+/// when the level is disabled or the site is limited
+#define QUANERGY_LOG_EVERY_MS(level, interval_ms, stream)                                          \
+  do                                                                                               \
+  {                                                                                                \
+    ::quanergy::Logger& quanergy_logger_ = ::quanergy::Logger::instance();                        \
+    if (quanergy_logger_.enabled(::quanergy::LogLevel::level))                                     \
+    {                                                                                              \
+      static ::quanergy::LogSite quanergy_log_site_(__FILE__, __LINE__, (interval_ms));            \
+      std::uint64_t quanergy_log_suppressed_ = 0;                                                  \
+      if (quanergy_log_site_.allow(quanergy_log_suppressed_))                                      \
+      {                                                                                            \
+        std::ostringstream quanergy_log_stream_;                                                   \
+        quanergy_log_stream_ << stream;                                                            \
+        quanergy_logger_.log(::quanergy::LogLevel::level, quanergy_log_site_,                      \
+                             quanergy_log_stream_.str(), quanergy_log_suppressed_);                \
+      }                                                                                            \
+    }                                                                                              \
+  } while (0)
+
+/// log a message built with stream syntax
+#define QUANERGY_LOG(level, stream) QUANERGY_LOG_EVERY_MS(level, 0, stream)
+
+/// log a message from a hot path; limited to one per LogSite::DEFAULT_INTERVAL_MS
+#define QUANERGY_LOG_THROTTLED(level, stream) \
+  QUANERGY_LOG_EVERY_MS(level, ::quanergy::LogSite::DEFAULT_INTERVAL_MS, stream)
+
+#endif
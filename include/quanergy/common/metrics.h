@@ -0,0 +1,74 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file metrics.h
+ *
+ *  \brief Builds metrics in the Prometheus text exposition format.
+ *
+ *  Rates (packets/s, bytes/s, frames/s) are exported as monotonically
+ *  increasing counters; the scraper derives rates from them. Samples of the
+ *  same metric from several sources (e.g. one per sensor) are grouped under
+ *  a single HELP/TYPE header.
+ */
+
+#ifndef QUANERGY_COMMON_METRICS_H
+#define QUANERGY_COMMON_METRICS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <quanergy/common/latency_histogram.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  /// label name and value pairs, e.g. {{"sensor", "10.0.0.3"}}
+  typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+  class DLLEXPORT MetricsWriter
+  {
+  public:
+    /// metric names are prefixed with this
+    static const char* const PREFIX;
+
+    /// monotonically increasing value
+    void counter(const std::string& name, const std::string& help,
+                 double value, const MetricLabels& labels = MetricLabels());
+
+    /// value that can go up and down
+    void gauge(const std::string& name, const std::string& help,
+               double value, const MetricLabels& labels = MetricLabels());
+
+    /// latency quantiles in seconds, with count and sum
+    void summary(const std::string& name, const std::string& help,
+                 const LatencySummary& latency, const MetricLabels& labels = MetricLabels());
+
+    /// the metrics in text exposition format
+    std::string str() const;
+
+  private:
+    struct Family
+    {
+      std::string help;
+      std::string type;
+      std::vector<std::string> samples;
+    };
+
+    Family& family(const std::string& name, const std::string& help, const char* type);
+
+    static std::string sample(const std::string& name, const MetricLabels& labels, double value);
+
+    std::map<std::string, Family> families_;
+  };
+
+} // namespace quanergy
+
+#endif
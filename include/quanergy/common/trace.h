@@ -0,0 +1,160 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file trace.h
+ *
+ *  \brief Timeline tracing of pipeline activity in Chrome trace format.
+ *
+ *  When enabled, instrumented code records spans (packet read, parse, module
+ *  slots) and queue handoffs into a per-thread ring buffer. Each buffer has
+ *  a single writer, so recording takes no lock. writeChromeTrace writes the
+ *  events in a time window as JSON that chrome://tracing and the Perfetto UI
+ *  load directly. Threads show as tracks and queue handoffs as flow arrows.
+ *
+ *  While disabled (the default), QUANERGY_TRACE_SCOPE only checks a flag.
+ */
+
+#ifndef QUANERGY_COMMON_TRACE_H
+#define QUANERGY_COMMON_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  class DLLEXPORT Tracer
+  {
+  public:
+    /// events kept per thread; older events are overwritten
+    static const std::size_t BUFFER_SIZE = 1 << 16;
+
+    static Tracer& instance();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /// turn recording on or off; safe to call from any thread
+    void enable(bool enable) { enabled_.store(enable, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /// nanoseconds on the steady clock; the time base of all events
+    static std::uint64_t now();
+
+    /// record a span on the calling thread
+    void complete(const char* name, std::uint64_t start, std::uint64_t end);
+    /// record a point in time on the calling thread
+    void instant(const char* name);
+    /// start a handoff on the calling thread; the arrow ends at flowEnd with the same id
+    void flowBegin(const char* name, std::uint64_t id);
+    void flowEnd(const char* name, std::uint64_t id);
+
+    /// unique id for a flow
+    std::uint64_t newFlowId() { return next_flow_id_.fetch_add(1, std::memory_order_relaxed); }
+
+    /// name the track of a thread; may be called from any thread, before or after it records
+    void setThreadName(std::thread::id thread, const std::string& name);
+
+    /** \brief write events with timestamps in [from, to] as Chrome trace JSON
+     *  \details safe to call while other threads record
+     *  \returns number of events written
+     */
+    std::size_t writeChromeTrace(std::ostream& out,
+                                 std::uint64_t from = 0,
+                                 std::uint64_t to = std::numeric_limits<std::uint64_t>::max()) const;
+
+    /// as above, to a file; throws std::runtime_error if the file can't be opened
+    std::size_t writeChromeTrace(const std::string& file_name,
+                                 std::uint64_t from = 0,
+                                 std::uint64_t to = std::numeric_limits<std::uint64_t>::max()) const;
+
+    /// forget events recorded so far
+    void clear() { cleared_at_.store(now(), std::memory_order_relaxed); }
+
+  private:
+    struct Event
+    {
+      const char* name;
+      std::uint64_t ts;
+      /// duration for spans, id for flows
+      std::uint64_t value;
+      /// Chrome trace phase: 'X' span, 'i' instant, 's'/'f' flow
+      char phase;
+    };
+
+    struct ThreadBuffer
+    {
+      explicit ThreadBuffer(std::thread::id thread) : thread(thread), events(BUFFER_SIZE) {}
+
+      std::thread::id thread;
+      std::vector<Event> events;
+      /// events ever written; only the owning thread writes
+      std::atomic<std::uint64_t> written {0};
+    };
+
+    Tracer() = default;
+
+    void record(char phase, const char* name, std::uint64_t ts, std::uint64_t value);
+
+    ThreadBuffer& threadBuffer();
+
+    std::atomic_bool enabled_ {false};
+    std::atomic<std::uint64_t> next_flow_id_ {1};
+    std::atomic<std::uint64_t> cleared_at_ {0};
+
+    /// buffers outlive their threads so their events can still be written
+    mutable std::mutex buffers_mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    std::map<std::thread::id, std::string> thread_names_;
+  };
+
+  /** \brief records a span from construction to destruction
+   *  \details name must outlive the tracer; use string literals
+   */
+  class TraceScope
+  {
+  public:
+    explicit TraceScope(const char* name)
+      : name_(Tracer::instance().enabled() ? name : nullptr)
+    {
+      if (name_)
+        start_ = Tracer::now();
+    }
+
+    ~TraceScope()
+    {
+      if (name_)
+        Tracer::instance().complete(name_, start_, Tracer::now());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* name_;
+    std::uint64_t start_ = 0;
+  };
+
+} // namespace quanergy
+
+#define QUANERGY_TRACE_CONCAT_IMPL(a, b) a##b
+#define QUANERGY_TRACE_CONCAT(a, b) QUANERGY_TRACE_CONCAT_IMPL(a, b)
+
+/// trace the rest of the enclosing scope as a span called name
+#define QUANERGY_TRACE_SCOPE(name) \
+  ::quanergy::TraceScope QUANERGY_TRACE_CONCAT(quanergy_trace_scope_, __LINE__)(name)
+
+#endif
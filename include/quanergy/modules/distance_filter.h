@@ -14,6 +14,7 @@
 #ifndef QUANERGY_MODULES_DISTANCE_FILTER_H
 #define QUANERGY_MODULES_DISTANCE_FILTER_H
 
+#include <limits>
 #include <memory>
 
 #include <boost/signals2.hpp>
@@ -22,6 +23,12 @@
 
 #include <quanergy/common/point_hvdir.h>
 #include <quanergy/common/pointcloud_types.h>
+#include <quanergy/common/frame_hvdir.h>
+#include <quanergy/common/frame_compact.h>
+
+#include <quanergy/common/latency_histogram.h>
+
+#include <quanergy/common/callback_chain.h>
 
 #include <quanergy/common/dll_export.h>
 
@@ -33,27 +40,61 @@ namespace quanergy
     {
       typedef std::shared_ptr<DistanceFilter> Ptr;
 
-      typedef PointCloudHVDIRPtr ResultType;
+      typedef PointCloudHVDIRConstPtr ResultType;
 
       typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
 
       DistanceFilter();
 
       boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
 
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
       void slot(PointCloudHVDIRConstPtr const &);
 
+      /// \brief filter a structure of arrays frame in place
+      void filter(FrameHVDIR& frame) const;
+
+      /// \brief filter a compact frame in place; works on the quantized ranges
+      void filter(FrameCompact& frame) const;
+
       void setMaximumDistanceThreshold(float maxThreshold);
       float getMaximumDistanceThreshold() const;
 
       void setMinimumDistanceThreshold(float minThreshold);
       float getMinimumDistanceThreshold() const;
 
+      /// record the time spent filtering each cloud; null (the default) disables timing
+      void setLatencyHistogram(LatencyHistogram* histogram) { latency_histogram_ = histogram; }
+
+      /// \brief filter one point; inline so composed pipelines can fuse it with other stages
+      PointCloudHVDIR::PointType filterByDistance(PointCloudHVDIR::PointType const & from) const
+      {
+        PointCloudHVDIR::PointType to;
+
+        to.intensity = from.intensity;
+        to.ring = from.ring;
+
+        to.h = from.h;
+        to.v = from.v;
+
+        to.d = ((from.d < min_distance_threshold_) ||
+                (from.d > max_distance_threshold_))
+          ?
+          std::numeric_limits<float>::quiet_NaN()
+          :
+          from.d;
+
+        return to;
+      }
+
     private:
 
-      PointCloudHVDIR::PointType filterByDistance(PointCloudHVDIR::PointType const & from);
+      CallbackChain<ResultType> signal_;
 
-      Signal signal_;
+      LatencyHistogram* latency_histogram_ = nullptr;
 
       float max_distance_threshold_;
       float min_distance_threshold_;
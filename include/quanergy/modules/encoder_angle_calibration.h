@@ -8,6 +8,7 @@
 #ifndef ENCODER_ANGLE_CALIBRATION_H_
 #define ENCODER_ANGLE_CALIBRATION_H_
 
+#include <cmath>
 #include <vector>
 #include <iostream>
 #include <future>
@@ -26,6 +27,8 @@
 #include <quanergy/common/point_hvdir.h>
 #include <quanergy/common/pointcloud_types.h>
 #include <quanergy/common/angle.h>
+#include <quanergy/common/latency_histogram.h>
+#include <quanergy/common/callback_chain.h>
 
 #include <quanergy/common/dll_export.h>
 
@@ -65,13 +68,18 @@ namespace quanergy
       /** 
        * @brief Result type for class
        */
-      using ResultType = PointCloudHVDIRPtr;
+      using ResultType = PointCloudHVDIRConstPtr;
 
       /** 
        * @brief Signal type
        */
       using Signal =  boost::signals2::signal<void (const ResultType&)>;
 
+      /** 
+       * @brief Callback type
+       */
+      using Callback = CallbackChain<ResultType>::Callback;
+
       /** The firing rate of the LiDAR, in Hz */
       static const double FIRING_RATE;
 
@@ -106,6 +114,15 @@ namespace quanergy
        */
       boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
 
+      /** 
+       * @brief Adds a callback to be called after this classes functionality
+       * is done. Callbacks are called without locking; add them before data
+       * flows. They can't be disconnected.
+       * 
+       * @param[in] callback Callback to be called.
+       */
+      void connectCallback(Callback callback);
+
       /** 
        * @brief Slot to be connected as a subscriber to another process. If
        * calibration is not complete, this function will add the point cloud
@@ -115,7 +132,7 @@ namespace quanergy
        * 
        * @param[in] pc Point cloud to be processed.
        */
-      void slot(PointCloudHVDIRPtr const & pc);
+      void slot(PointCloudHVDIRConstPtr const & pc);
 
       /** 
        * @brief Sets this class to only calculate the error parameters and not
@@ -124,6 +141,14 @@ namespace quanergy
        */
       void calibrateOnly();
 
+      /**
+       * @brief Sets the histogram recording the time spent applying the
+       * calibration to each cloud. Null (the default) disables timing.
+       *
+       * @param[in] histogram Histogram to record into.
+       */
+      void setLatencyHistogram(LatencyHistogram* histogram) { latency_histogram_ = histogram; }
+
       /**
        * @brief Sets number of valid calibrations to be collected before
        *averaging. Validity is determined by change in phase between current
@@ -143,6 +168,28 @@ namespace quanergy
        */
       void setParams(double amplitude, double phase);
 
+      /** 
+       * @brief Corrects one horizontal angle with the calibration parameters.
+       * Inline so composed pipelines can fuse it with other stages.
+       * 
+       * @param[in] h Horizontal angle in radians
+       * 
+       * @return Corrected angle, in [-pi, pi]
+       */
+      float correctAngle(float h) const
+      {
+        float corrected = h - (amplitude_ * std::sin(h + phase_));
+        if (corrected < -M_PI)
+        {
+          corrected += 2 * M_PI;
+        }
+        else if (corrected > M_PI)
+        {
+          corrected -= 2 * M_PI;
+        }
+        return corrected;
+      }
+
       /** 
        * @brief Function to set frame rate. Value is in frames per second. If
        * not set, the default is 10.
@@ -283,11 +330,11 @@ namespace quanergy
       void processAngles();
 
       /** 
-       * @brief Applies calibration. Applies calibration in place.
+       * @brief Applies calibration. Signals a corrected copy; the input is left as is.
        * 
        * @param[in] cloud_ptr Point cloud calibration will be applied to.
        */
-      void applyCalibration(PointCloudHVDIRPtr const & cloud_ptr) const;
+      void applyCalibration(PointCloudHVDIRConstPtr const & cloud_ptr) const;
 
       /** Once the motor has reached stead-state, the number of encoder counts per
        * revolution should be roughly the firing rate divided by the frame rate.
@@ -306,7 +353,10 @@ namespace quanergy
       double phase_convergence_threshold_ = 0.1;
 
       /** Signal object to notify next slot */
-      Signal signal_;
+      CallbackChain<ResultType> signal_;
+
+      /** Histogram for the time spent applying the calibration; null disables timing */
+      LatencyHistogram* latency_histogram_ = nullptr;
 
       /** Container for encoder angle values */
       AngleContainer encoder_angles_;
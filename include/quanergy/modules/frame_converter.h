@@ -0,0 +1,128 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file frame_converter.h
+ *
+ *  \brief Adapters between PCL HVDIR clouds and the structure of arrays and compact frames.
+ *
+ *  M-series parsers assemble FrameHVDIR directly (see DataPacketParserMSeries::assemble),
+ *  so CloudToFrameConverter is for clouds from other sources, like the 0x01 parser or
+ *  an HVDIR stage that only works on PCL clouds; FrameToCloudConverter produces PCL clouds
+ *  only for consumers that need them. The compact converters do the same for
+ *  FrameCompact, decoding straight to Cartesian when requested.
+ */
+
+#ifndef QUANERGY_MODULES_FRAME_CONVERTER_H
+#define QUANERGY_MODULES_FRAME_CONVERTER_H
+
+#include <memory>
+
+#include <boost/signals2.hpp>
+
+#include <quanergy/common/pointcloud_types.h>
+#include <quanergy/common/frame_hvdir.h>
+#include <quanergy/common/frame_compact.h>
+
+#include <quanergy/common/callback_chain.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    struct DLLEXPORT CloudToFrameConverter
+    {
+      typedef std::shared_ptr<CloudToFrameConverter> Ptr;
+
+      typedef FrameHVDIRConstPtr ResultType;
+
+      typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
+
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
+      void slot(PointCloudHVDIRConstPtr const &);
+
+    private:
+
+      CallbackChain<ResultType> signal_;
+    };
+
+    struct DLLEXPORT FrameToCloudConverter
+    {
+      typedef std::shared_ptr<FrameToCloudConverter> Ptr;
+
+      typedef PointCloudHVDIRConstPtr ResultType;
+
+      typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
+
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
+      void slot(FrameHVDIRConstPtr const &);
+
+    private:
+
+      CallbackChain<ResultType> signal_;
+    };
+
+    struct DLLEXPORT CloudToCompactConverter
+    {
+      typedef std::shared_ptr<CloudToCompactConverter> Ptr;
+
+      typedef FrameCompactConstPtr ResultType;
+
+      typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
+
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
+      void slot(PointCloudHVDIRConstPtr const &);
+
+    private:
+
+      CallbackChain<ResultType> signal_;
+    };
+
+    /** \brief decodes compact frames to XYZIR clouds without an intermediate HVDIR cloud */
+    struct DLLEXPORT CompactToCartConverter
+    {
+      typedef std::shared_ptr<CompactToCartConverter> Ptr;
+
+      typedef PointCloudXYZIRConstPtr ResultType;
+
+      typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
+
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
+      void slot(FrameCompactConstPtr const &);
+
+    private:
+
+      CallbackChain<ResultType> signal_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+
+#endif
@@ -14,6 +14,8 @@
 #ifndef QUANERGY_MODULES_POLAR_TO_CART_CONVERTER_H
 #define QUANERGY_MODULES_POLAR_TO_CART_CONVERTER_H
 
+#include <cmath>
+#include <limits>
 #include <memory>
 
 #include <boost/signals2.hpp>
@@ -24,6 +26,10 @@
 
 #include <quanergy/common/pointcloud_types.h>
 
+#include <quanergy/common/latency_histogram.h>
+
+#include <quanergy/common/callback_chain.h>
+
 #include <quanergy/common/dll_export.h>
 
 namespace quanergy
@@ -34,19 +40,58 @@ namespace quanergy
     {
       typedef std::shared_ptr<PolarToCartConverter> Ptr;
 
-      typedef PointCloudXYZIRPtr ResultType;
+      typedef PointCloudXYZIRConstPtr ResultType;
 
       typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
 
       boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
 
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
       void slot(PointCloudHVDIRConstPtr const &);
 
+      /// record the time spent converting each cloud; null (the default) disables timing
+      void setLatencyHistogram(LatencyHistogram* histogram) { latency_histogram_ = histogram; }
+
+      /// \brief convert one point; inline so composed pipelines can fuse it with other stages
+      static PointCloudXYZIR::PointType polarToCart(PointCloudHVDIR::PointType const & from)
+      {
+        PointCloudXYZIR::PointType to;
+
+        to.intensity = from.intensity;
+        to.ring = from.ring;
+
+        if (std::isnan (from.d))
+        {
+          to.x = to.y = to.z = std::numeric_limits<float>::quiet_NaN ();
+          return to;
+        }
+
+        double const cos_horizontal_angle = std::cos(from.h);
+        double const sin_horizontal_angle = std::sin(from.h);
+
+        double const cos_vertical_angle = std::cos(from.v);
+        double const sin_vertical_angle = std::sin(from.v);
+
+        // get the distance to the XY plane
+        double xy_distance = from.d * cos_vertical_angle;
+
+        to.y = static_cast<float> (xy_distance * sin_horizontal_angle);
+
+        to.x = static_cast<float> (xy_distance * cos_horizontal_angle);
+
+        to.z = static_cast<float> (from.d * sin_vertical_angle);
+
+        return to;
+      }
+
     private:
 
-      static PointCloudXYZIR::PointType polarToCart(PointCloudHVDIR::PointType const & from);
+      CallbackChain<ResultType> signal_;
 
-      Signal signal_;
+      LatencyHistogram* latency_histogram_ = nullptr;
     };
 
   } // namespace client
@@ -15,6 +15,7 @@
 #ifndef QUANERGY_MODULES_RING_INTENSITY_FILTER_H
 #define QUANERGY_MODULES_RING_INTENSITY_FILTER_H
 
+#include <limits>
 #include <memory>
 #include <cstdint>
 
@@ -24,10 +25,16 @@
 
 #include <quanergy/common/point_hvdir.h>
 #include <quanergy/common/pointcloud_types.h>
+#include <quanergy/common/frame_hvdir.h>
+#include <quanergy/common/frame_compact.h>
 
 // For M_SERIES_NUM_LASERS
 #include <quanergy/client/m_series_data_packet.h>
 
+#include <quanergy/common/latency_histogram.h>
+
+#include <quanergy/common/callback_chain.h>
+
 #include <quanergy/common/dll_export.h>
 
 namespace quanergy
@@ -38,16 +45,26 @@ namespace quanergy
     {
       typedef std::shared_ptr<RingIntensityFilter> Ptr;
 
-      typedef PointCloudHVDIRPtr ResultType;
+      typedef PointCloudHVDIRConstPtr ResultType;
 
       typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
 
       RingIntensityFilter();
 
       boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
 
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
       void slot(PointCloudHVDIRConstPtr const &);
 
+      /// \brief filter a structure of arrays frame in place
+      void filter(FrameHVDIR& frame) const;
+
+      /// \brief filter a compact frame in place; works on the quantized ranges
+      void filter(FrameCompact& frame) const;
+
       /** \brief For ring filtering: Returns the minimum range filter threshold for the given beam, in meters */
       float getRingFilterMinimumRangeThreshold (const std::uint16_t laser_beam) const;
 
@@ -64,11 +81,36 @@ namespace quanergy
         */
       void setRingFilterMinimumIntensityThreshold (const uint16_t laser_beam, const uint8_t min_threshold);
 
+      /// record the time spent filtering each cloud; null (the default) disables timing
+      void setLatencyHistogram(LatencyHistogram* histogram) { latency_histogram_ = histogram; }
+
+      /// \brief filter one point; inline so composed pipelines can fuse it with other stages
+      PointCloudHVDIR::PointType filterGhosts(PointCloudHVDIR::PointType const & from) const
+      {
+        PointCloudHVDIR::PointType to;
+
+        to.intensity = from.intensity;
+        to.ring = from.ring;
+
+        to.h = from.h;
+        to.v = from.v;
+
+        to.d = ((from.ring < M_SERIES_NUM_LASERS) &&
+                (from.d < ring_filter_range_[from.ring]) &&
+                (from.intensity < ring_filter_intensity_[from.ring]))
+          ?
+          std::numeric_limits<float>::quiet_NaN()
+          :
+          from.d;
+
+        return to;
+      }
+
     private:
 
-      PointCloudHVDIR::PointType filterGhosts(PointCloudHVDIR::PointType const & from) const;
+      CallbackChain<ResultType> signal_;
 
-      Signal signal_;
+      LatencyHistogram* latency_histogram_ = nullptr;
 
       float ring_filter_range_[M_SERIES_NUM_LASERS];
       std::uint8_t ring_filter_intensity_[M_SERIES_NUM_LASERS];
@@ -0,0 +1,85 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file self_mask.h
+ *
+ *  \brief Mask of encoder positions and rings that see the sensor's own platform.
+ *
+ *  The mask stores, for each (encoder position, ring) cell, the range within which
+ *  returns are considered to be the robot body. A range of 0 means the cell is not masked.
+ */
+
+#ifndef QUANERGY_MODULES_SELF_MASK_H
+#define QUANERGY_MODULES_SELF_MASK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// For M_SERIES_NUM_LASERS and M_SERIES_NUM_ROT_ANGLES
+#include <quanergy/parsers/data_packet_parser_m_series.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    struct DLLEXPORT SelfMask
+    {
+      SelfMask();
+
+      /** \brief convert horizontal angle (radians) back to the M-series encoder position
+       *  \details this is the inverse of the parser's horizontal angle lookup table
+       */
+      static int positionFromAngle(double h);
+
+      /// \brief true if no cell is masked
+      bool empty() const { return masked_cells_ == 0; }
+
+      /// \brief clear all cells
+      void clear();
+
+      /// \brief set the masking range for a cell; 0 unmasks the cell
+      void setRange(int position, std::uint16_t ring, float range);
+
+      /// \brief get the masking range for a cell; 0 if not masked or out of bounds
+      float getRange(int position, std::uint16_t ring) const;
+
+      /// \brief true if a return at angle h, ring and distance d falls within the mask
+      bool masks(double h, std::uint16_t ring, float d) const
+      {
+        if (ring >= M_SERIES_NUM_LASERS)
+          return false;
+
+        return d <= ranges_[static_cast<std::size_t>(positionFromAngle(h)) * M_SERIES_NUM_LASERS + ring];
+      }
+
+      /** \brief load mask from file
+       *  \details the file holds one line per masked run: ring start_position end_position range
+       *  \throws std::runtime_error if the file can't be read or is malformed
+       */
+      void load(const std::string& file_name);
+
+      /** \brief save mask to file merging consecutive cells of equal range into runs
+       *  \throws std::runtime_error if the file can't be written
+       */
+      void save(const std::string& file_name) const;
+
+    private:
+      /// range per cell indexed by position * M_SERIES_NUM_LASERS + ring
+      std::vector<float> ranges_;
+
+      /// number of cells with a non-zero range
+      std::size_t masked_cells_ = 0;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,92 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file self_mask_filter.h
+ *
+ *  \brief Filters HVDIR points that fall within a SelfMask (by setting
+ *  them to NAN).
+ *
+ *  This filter is designed to remove returns from the platform the sensor is mounted on.
+ */
+
+#ifndef QUANERGY_MODULES_SELF_MASK_FILTER_H
+#define QUANERGY_MODULES_SELF_MASK_FILTER_H
+
+#include <memory>
+#include <string>
+
+#include <boost/signals2.hpp>
+
+#include <pcl/point_cloud.h>
+
+#include <quanergy/common/point_hvdir.h>
+#include <quanergy/common/pointcloud_types.h>
+#include <quanergy/common/frame_hvdir.h>
+
+#include <quanergy/modules/self_mask.h>
+
+#include <quanergy/common/latency_histogram.h>
+
+#include <quanergy/common/callback_chain.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    struct DLLEXPORT SelfMaskFilter
+    {
+      typedef std::shared_ptr<SelfMaskFilter> Ptr;
+
+      typedef PointCloudHVDIRConstPtr ResultType;
+
+      typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
+
+      SelfMaskFilter() = default;
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
+
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
+      void slot(PointCloudHVDIRConstPtr const &);
+
+      /// \brief filter a structure of arrays frame in place
+      void filter(FrameHVDIR& frame) const;
+
+      /** \brief set the mask to apply; an empty mask passes points through unchanged
+       *  \details not synchronized with slot or filter: call it before clouds arrive or on the thread calling
+       *           slot, not across an async from it
+       */
+      void setMask(const SelfMask& mask) { mask_ = mask; }
+      const SelfMask& getMask() const { return mask_; }
+
+      /// \brief load the mask from file; see SelfMask::load
+      void loadMask(const std::string& file_name) { mask_.load(file_name); }
+
+      /// record the time spent filtering each cloud; null (the default) disables timing
+      void setLatencyHistogram(LatencyHistogram* histogram) { latency_histogram_ = histogram; }
+
+    private:
+
+      PointCloudHVDIR::PointType filterBySelfMask(PointCloudHVDIR::PointType const & from) const;
+
+      CallbackChain<ResultType> signal_;
+
+      LatencyHistogram* latency_histogram_ = nullptr;
+
+      SelfMask mask_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+
+#endif
@@ -0,0 +1,119 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file self_mask_learner.h
+ *
+ *  \brief Learns a SelfMask from HVDIR frames collected while the platform is stationary.
+ *
+ *  Each incoming cloud counts as one frame. For every (encoder position, ring) cell the
+ *  learner counts the frames with a return closer than the maximum body range. After the
+ *  requested number of frames, cells that were near often enough are masked out to the
+ *  farthest near range observed plus a margin, and the mask is emitted on the signal.
+ */
+
+#ifndef QUANERGY_MODULES_SELF_MASK_LEARNER_H
+#define QUANERGY_MODULES_SELF_MASK_LEARNER_H
+
+#include <memory>
+#include <cstdint>
+#include <vector>
+
+#include <boost/signals2.hpp>
+
+#include <quanergy/common/pointcloud_types.h>
+
+#include <quanergy/modules/self_mask.h>
+
+#include <quanergy/common/callback_chain.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    struct DLLEXPORT SelfMaskLearner
+    {
+      typedef std::shared_ptr<SelfMaskLearner> Ptr;
+
+      typedef SelfMask ResultType;
+
+      typedef boost::signals2::signal<void (const ResultType&)> Signal;
+      typedef CallbackChain<ResultType>::Callback Callback;
+
+      SelfMaskLearner();
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber);
+
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback);
+
+      void slot(PointCloudHVDIRConstPtr const &);
+
+      /// \brief restart learning, discarding accumulated statistics
+      void reset();
+
+      /// \brief true once the mask has been learned and emitted
+      bool complete() const { return complete_; }
+
+      /** \brief Set the number of frames to accumulate before producing the mask.
+        * Defaults to 100
+        */
+      void setNumFrames(std::uint16_t num_frames);
+      std::uint16_t getNumFrames() const { return num_frames_; }
+
+      /** \brief Set the range (meters) beyond which returns are never considered body.
+        * Defaults to 1.0
+        */
+      void setMaximumBodyRange(float range) { max_body_range_ = range; }
+      float getMaximumBodyRange() const { return max_body_range_; }
+
+      /** \brief Set the fraction of frames a cell must be near to be masked.
+        * Value is between 0-1. Defaults to 0.9
+        */
+      void setMinimumOccupancy(float fraction);
+      float getMinimumOccupancy() const { return min_occupancy_; }
+
+      /** \brief Set the margin (meters) added to the farthest near range of a masked cell.
+        * Defaults to 0.05
+        */
+      void setRangeMargin(float margin) { range_margin_ = margin; }
+      float getRangeMargin() const { return range_margin_; }
+
+    private:
+
+      /// per (position, ring) accumulator; kept small so memory is bounded by the cell count
+      struct Cell
+      {
+        std::uint16_t near_frames = 0;   ///< frames with at least one near return
+        std::uint16_t last_frame = 0;    ///< last frame counted (1-based) so returns count once per frame
+        float         max_range = 0.f;   ///< farthest near return seen
+      };
+
+      void accumulate(PointCloudHVDIR::PointType const & pt);
+
+      SelfMask buildMask() const;
+
+      CallbackChain<ResultType> signal_;
+
+      std::vector<Cell> cells_;
+
+      std::uint16_t num_frames_ = 100;
+      std::uint16_t frame_count_ = 0;
+      bool complete_ = false;
+
+      float max_body_range_ = 1.0f;
+      float min_occupancy_ = 0.9f;
+      float range_margin_ = 0.05f;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+
+#endif
@@ -15,10 +15,9 @@
 #ifndef QUANERGY_PARSERS_DATA_PACKET_01_H
 #define QUANERGY_PARSERS_DATA_PACKET_01_H
 
-#include <iostream>
-
 #include <quanergy/client/packet_header.h>
 
+#include <quanergy/common/logger.h>
 #include <quanergy/common/dll_export.h>
 
 namespace quanergy
@@ -91,8 +90,8 @@ namespace quanergy
           sizeof(DataHeader01) +
           object.data_header.point_count * sizeof(DataPoint01))
       {
-        std::cerr << "Invalid sizes: " << object.data_header.point_count
-                  << " points and " << object.packet_header.size << " bytes" << std::endl;
+        QUANERGY_LOG_THROTTLED(WARNING, "Invalid sizes: " << object.data_header.point_count
+                               << " points and " << object.packet_header.size << " bytes");
         throw SizeMismatchError();
       }
 
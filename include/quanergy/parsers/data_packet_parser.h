@@ -25,6 +25,8 @@ namespace quanergy
     /** \brief base class for data packet parsers */
     struct DLLEXPORT DataPacketParser : public PacketParserBase<PointCloudHVDIRPtr>
     {
+      typedef PointCloudHVDIRPtr ResultType;
+
       DataPacketParser() = default;
 
       /// common interface for setting frame_id which should be put into resulting pointcloud
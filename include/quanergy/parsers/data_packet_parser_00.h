@@ -32,7 +32,15 @@ namespace quanergy
 
       virtual bool validate(const std::vector<char>& packet) override;
 
-      virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result) override;
+      virtual void decode(const std::vector<char>& packet, DecodedType& decoded,
+                          std::uint64_t sequence) override;
+
+    private:
+      // firing loop instantiated per return selection, for whether every laser is selected
+      // and per point type, so the per laser work has no run time branches
+      template <int RETURN_SELECTION, bool ALL_LASERS, class POINTS>
+      void decodeFirings(const DataPacket00& data_packet, POINTS& points, DecodedType& decoded,
+                         std::uint64_t sequence, double distance_scaling) const;
     };
 
   } // namespace client
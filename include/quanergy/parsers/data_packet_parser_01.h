@@ -27,11 +27,31 @@ namespace quanergy
   {
     struct DLLEXPORT DataPacketParser01 : public DataPacketParser
     {
+      /// each packet is a complete cloud so decoding is the whole parse
+      typedef PointCloudHVDIRPtr DecodedType;
+
       DataPacketParser01();
 
       virtual bool validate(const std::vector<char>& packet);
 
       virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result);
+
+      /// decode a packet into a new cloud; thread safe; null if the packet was dropped
+      void decode(const std::vector<char>& packet, DecodedType& decoded, std::uint64_t /*sequence*/)
+      {
+        if (!parse(packet, decoded))
+          decoded.reset();
+      }
+
+      /// pass the decoded cloud through
+      bool assemble(const DecodedType& decoded, PointCloudHVDIRPtr& result)
+      {
+        if (!decoded)
+          return false;
+
+        result = decoded;
+        return true;
+      }
     };
 
   } // namespace client
@@ -33,7 +33,14 @@ namespace quanergy
 
       virtual bool validate(const std::vector<char>& packet) override;
   
-      virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result) override;
+      virtual void decode(const std::vector<char>& packet, DecodedType& decoded,
+                          std::uint64_t sequence) override;
+
+    private:
+      // firing loop instantiated for whether every laser is selected and per point type
+      template <bool ALL_LASERS, class POINTS>
+      void decodeFirings(const DataPacket04& data_packet, POINTS& points, DecodedType& decoded,
+                         std::uint64_t sequence) const;
 
     };
 
@@ -14,6 +14,9 @@
 #ifndef QUANERGY_CLIENT_PARSERS_DATA_PACKET_PARSER_06_H
 #define QUANERGY_CLIENT_PARSERS_DATA_PACKET_PARSER_06_H
 
+#include <algorithm>
+#include <iterator>
+
 #include <quanergy/parsers/packet_parser.h>
 
 #include <quanergy/parsers/data_packet_06.h>
@@ -33,30 +36,39 @@ namespace quanergy
 
       virtual bool validate(const std::vector<char>& packet) override;
   
-      virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result) override;
+      virtual void decode(const std::vector<char>& packet, DecodedType& decoded,
+                          std::uint64_t sequence) override;
+
+    protected:
+      // M1 has a single ring in the horizontal plane
+      virtual void compactVerticalAngles(float (&vertical_angles)[M_SERIES_NUM_LASERS]) const override
+      {
+        std::fill(std::begin(vertical_angles), std::end(vertical_angles), 0.f);
+      }
 
     private:
-      // templated parse method for M1 (only valid for 1 or 3 returns)
+      // templated decode method for M1 (only valid for 1 or 3 returns)
       template<std::uint8_t R>
-      inline typename std::enable_if<R == 1 || R == 3, bool>::type parse(
-                        const std::vector<char>& packet, PointCloudHVDIRPtr& result)
+      inline typename std::enable_if<R == 1 || R == 3>::type decode(
+                        const std::vector<char>& packet, DecodedType& decoded, std::uint64_t sequence)
       {
+        if (!checkSize(packet, sizeof(DataPacket06<R>), decoded))
+        {
+          return;
+        }
+
         // deserialize
         DataPacket06<R> data_packet;
         deserialize(packet.data(), data_packet);
 
-        // parse
-        bool result_updated = false;
-
-        // throws error if status is fatal
-        validateStatus(static_cast<StatusType>(data_packet.data_header.status));
-
         // If the return selection has been explicitly set,
         // verify that the return ID matches what has been requested
         if (R == 1 && return_selection_set_ &&
             data_packet.data_header.return_id != return_selection_)
         {
-          throw ReturnIDMismatchError();
+          decoded.valid = false;
+          reportError(PacketError::RETURN_ID_MISMATCH, ReturnIDMismatchError());
+          return;
         }
 
         // this time is used for the cloud stamp which is a 64 bit integer in units of microseconds
@@ -64,117 +76,93 @@ namespace quanergy
           static_cast<std::uint64_t>(data_packet.packet_header.seconds) * 1000000ull +
           static_cast<std::uint64_t>(data_packet.packet_header.nanoseconds) / 1000ull;
 
-        const auto& start = data_packet.data.firings[0].position;
-        const auto& mid   = data_packet.data.firings[M_SERIES_FIRING_PER_PKT/2].position;
-        const auto& end   = data_packet.data.firings[M_SERIES_FIRING_PER_PKT-1].position;
-        registerNewPacket(current_packet_stamp_ms, start, mid, end);
+        // status is validated during assembly so status changes are reported in order
+        // with height of 1, there is no need to organize
+        beginDecode(decoded, current_packet_stamp_ms,
+                    static_cast<StatusType>(data_packet.data_header.status), false);
 
-        // Tens of micrometers.
-        double distance_scaling = 0.00001;
-
-        // for each firing
-        for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
+        // select the specialized firing loop once per packet
+        // single return packets only have return 0
+        withDecodedPoints(decoded, [&](auto& points)
         {
-          M1FiringData<R> const & firing = data_packet.data.firings[firing_index];
-          firing_cloud_->clear();
-          firing_cloud_->is_dense = true;
-          PointCloudHVDIR::PointType hvdir;
-
-          // populate firing cloud
-          hvdir.h = horizontal_angle_lookup_table_[firing.position];
-          hvdir.v = 0.;
-          hvdir.ring = 0;
-
-          if (R == M_SERIES_NUM_RETURNS && return_selection_ == quanergy::client::ALL_RETURNS)
+          if (R == 1)
           {
-            // for the all case, we won't keep NaN points and we'll compare
-            // distances to illiminate duplicates
-            // index 2 could equal index 0 and/or index 1
-            // index 1 could equal index 0 but only if all 3 are equal so don't need to check that as separate case
-            std::uint32_t dist2 = firing.radius[2];
-
-            std::uint32_t dist0 = firing.radius[0];
-            if (dist0 != 0 && dist0 != dist2)
+            decodeFirings<R, 0>(data_packet, points, decoded, sequence);
+          }
+          else
+          {
+            switch (return_selection_)
             {
-              hvdir.intensity = firing.intensity[0];
-              hvdir.d = static_cast<float>(dist0) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
+              case ALL_RETURNS:
+                decodeFirings<R, ALL_RETURNS>(data_packet, points, decoded, sequence);
+                break;
+              case 0:
+                decodeFirings<R, 0>(data_packet, points, decoded, sequence);
+                break;
+              case 1:
+                decodeFirings<R, 1 % R>(data_packet, points, decoded, sequence);
+                break;
+              default:
+                decodeFirings<R, 2 % R>(data_packet, points, decoded, sequence);
+                break;
             }
+          }
+        });
 
-            std::uint32_t dist1 = firing.radius[1];
-            if (dist1 != 0 && dist1 != dist2)
-            {
-              hvdir.intensity = firing.intensity[1];
-              hvdir.d = static_cast<float>(dist1) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
+      } // decode
 
-            if (dist2 != 0)
-            {
-              hvdir.intensity = firing.intensity[2];
-              hvdir.d = static_cast<float>(dist2) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
+      // firing loop instantiated per number of returns, return selection and point type
+      template<std::uint8_t R, int RETURN_SELECTION, class POINTS>
+      void decodeFirings(const DataPacket06<R>& data_packet, POINTS& points, DecodedType& decoded,
+                         std::uint64_t sequence) const
+      {
+        using PointType = typename POINTS::value_type;
 
-          } // if (R == M_SERIES_NUM_RETURNS && return_selection_ == quanergy::client::ALL_RETURNS)
-          else if(R == M_SERIES_NUM_RETURNS)
-          {
-            // We only want 1 return, find the correct one
-            hvdir.intensity = firing.intensity[return_selection_];
+        // Tens of micrometers.
+        const auto range_scale = rangeScale(0.00001, PointType());
 
-            if (firing.radius[return_selection_] == 0)
-            {
-              hvdir.d = std::numeric_limits<float>::quiet_NaN();
-              // if the range is NaN, the cloud is not dense
-              firing_cloud_->is_dense = false;
-            }
-            else
-            {
-              hvdir.d = static_cast<float>(firing.radius[return_selection_]) * distance_scaling; // convert range to meters
-            }
+        std::uint32_t return_masks[M_SERIES_NUM_RETURNS];
+        returnMasks(return_masks);
 
-            // add the point to the current firing
-            firing_cloud_->push_back(hvdir);
+        // points of one firing
+        PointType firing_points[M_SERIES_NUM_RETURNS];
 
-          } // else if (R == M_SERIES_NUM_RETURNS)
-          else
-          {
-            // single return case
-            hvdir.intensity = firing.intensity[0];
+        // for each firing
+        for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
+        {
+          M1FiringData<R> const & firing = data_packet.data.firings[firing_index];
+          auto& decoded_firing = decoded.firings[firing_index];
 
-            if (firing.radius[0] == 0)
-            {
-              hvdir.d = std::numeric_limits<float>::quiet_NaN();
-              // if the range is NaN, the cloud is not dense
-              firing_cloud_->is_dense = false;
-            }
-            else
-            {
-              hvdir.d = static_cast<float>(firing.radius[0]) * distance_scaling; // convert range to meters
-            }
+          decoded_firing.position = firing.position;
+          decoded_firing.is_dense = true;
+          decoded_firing.begin = decoded_firing.end = static_cast<std::uint32_t>(points.size());
 
-            // add the point to the current firing
-            firing_cloud_->push_back(hvdir);
+          // skip firings outside the azimuth window or decimated away before building any points
+          decoded_firing.keep = keepFiring(firing.position, sequence * M_SERIES_FIRING_PER_PKT + firing_index);
+          if (!decoded_firing.keep)
+          {
+            continue;
+          }
 
-          } // else (R != M_SERIES_NUM_RETURNS)
+          PointType point;
+
+          // populate firing cloud
+          setPosition(point, firing.position);
+          setLaser(point, 0, 0.);
 
-          // check whether cloud is complete
-          bool complete = checkComplete(hvdir.h, result);
-          // add firing to scan
-          addFiring(firing_cloud_);
+          bool is_dense = true;
+          const int n = decodeReturns<RETURN_SELECTION>(point, firing.radius, firing.intensity, 1,
+                                                        return_masks, range_scale, firing_points, is_dense);
 
-          // with height of 1, there is no need to organize
+          points.insert(points.end(), firing_points, firing_points + n);
 
-          result_updated = result_updated || complete;
+          decoded_firing.is_dense = is_dense;
+          decoded_firing.end = static_cast<std::uint32_t>(points.size());
 
         } // for firing index
 
-        return result_updated;
+      } // decodeFirings
 
-      } // parse
 
     };
 
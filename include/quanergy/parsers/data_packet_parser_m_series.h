@@ -13,10 +13,16 @@
 #ifndef QUANERGY_PARSERS_DATA_PACKET_PARSER_M_H
 #define QUANERGY_PARSERS_DATA_PACKET_PARSER_M_H
 
+#include <atomic>
+
 #include <quanergy/parsers/data_packet_parser.h>
 
 #include <quanergy/client/m_series_data_packet.h>
 
+#include <quanergy/common/pointcloud_types.h>
+#include <quanergy/common/frame_hvdir.h>
+#include <quanergy/common/frame_compact.h>
+
 #include <quanergy/common/dll_export.h>
 
 namespace quanergy
@@ -54,14 +60,131 @@ namespace quanergy
     /** \brief limits cloud size for memory considerations; this is much larger than needed */
     static const std::int32_t MAX_CLOUD_SIZE = 1E6;
 
-    /** \brief Not a specialization because it is intended to be used by others. */
+    /** \brief Output of the stateless decode stage for one M-series packet.
+     *  \details Holds the points of every firing kept by the azimuth window and decimation settings,
+     *           ready to be assembled into clouds in packet order. Compact packets fill compact_points
+     *           instead of points.
+     */
+    struct DLLEXPORT MSeriesDecodedPacket
+    {
+      /// decoded firing; its points are [begin, end) in points
+      struct Firing
+      {
+        std::uint16_t position = 0;
+        bool          keep = false;    ///< false if skipped by the azimuth window or firing stride
+        bool          is_dense = true;
+        std::uint32_t begin = 0;
+        std::uint32_t end = 0;
+      };
+
+      /// packet stamp (microseconds)
+      std::uint64_t stamp = 0;
+      /// sensor status
+      StatusType status = StatusType::GOOD;
+      /// whether completed clouds should be organized
+      bool organize = false;
+      /// false if the packet was dropped during decode; assemble ignores it
+      bool valid = true;
+      /// whether the firings index compact_points rather than points
+      bool compact = false;
+
+      Firing firings[M_SERIES_FIRING_PER_PKT];
+      PointCloudHVDIR::VectorType points;
+      std::vector<PointCompact> compact_points;
+    };
+
+    /** \brief Not a specialization because it is intended to be used by others.
+     *  \details Parsing is split in two phases: decode is stateless per packet and may run
+     *           concurrently on several threads; assemble builds clouds and must see packets in order.
+     */
     struct DLLEXPORT DataPacketParserMSeries : public DataPacketParser
     {
+      typedef MSeriesDecodedPacket DecodedType;
+
       DataPacketParserMSeries();
 
+      /** \brief decode a packet without touching the cloud assembly state
+       *  \details thread safe as long as settings aren't changed concurrently
+       *  \param sequence is the index of the packet in the stream; used for stateless decimation
+       */
+      virtual void decode(const std::vector<char>& packet, DecodedType& decoded,
+                          std::uint64_t sequence) = 0;
+
+      /** \brief assemble a decoded packet into the cloud being built; packets must be in order
+       *  \return true if result updated
+       */
+      bool assemble(const DecodedType& decoded, PointCloudHVDIRPtr& result);
+
+      /** \brief assemble a decoded packet into a structure of arrays frame, written a column at a time
+       *  \details no PCL cloud is built; otherwise the same as assembling a cloud
+       *  \return true if result updated
+       */
+      bool assemble(const DecodedType& decoded, FrameHVDIRPtr& result);
+
+      /** \brief assemble a packet decoded compact into a FrameCompact
+       *  \details ranges, encoder positions and intensities are kept at the sensor's quantization from the
+       *           packet on; no PointHVDIR is built
+       *  \throws std::invalid_argument if the packet wasn't decoded compact; see setDecodeCompact
+       *  \return true if result updated
+       */
+      bool assemble(const DecodedType& decoded, FrameCompactPtr& result);
+
+      /// parse is decode followed by assemble on the calling thread
+      virtual bool parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result) override
+      {
+        decode(packet, decoded_, packet_sequence_++);
+        return assemble(decoded_, result);
+      }
+
+      /// parse into a structure of arrays frame; use one result type per parser
+      bool parse(const std::vector<char>& packet, FrameHVDIRPtr& result)
+      {
+        decode(packet, decoded_, packet_sequence_++);
+        return assemble(decoded_, result);
+      }
+
+      /// parse into a compact frame; needs setDecodeCompact(true)
+      bool parse(const std::vector<char>& packet, FrameCompactPtr& result)
+      {
+        decode(packet, decoded_, packet_sequence_++);
+        return assemble(decoded_, result);
+      }
+
+      /** \brief decode into PointCompact instead of PointHVDIR; required to assemble FrameCompact and
+       *         not allowed for the other results. Defaults to false
+       */
+      void setDecodeCompact(bool compact) { decode_compact_ = compact; }
+      bool getDecodeCompact() const { return decode_compact_; }
+
       void setReturnSelection(int return_selection);
       void setCloudSizeLimits(std::int32_t szmin, std::int32_t szmax);
       void setDegreesOfSweepPerCloud(double degrees_per_cloud);
+
+      /** \brief restrict parsing to firings with encoder positions in [min_position, max_position]
+       *  \details the window wraps through 0 when min_position > max_position; firings outside it are
+       *           skipped before any points are built. The full range is the default. Encoder
+       *           calibration needs full revolutions so it should not be combined with a window.
+       *  \throws std::invalid_argument if a position is outside [0, M_SERIES_NUM_ROT_ANGLES)
+       */
+      void setAzimuthWindow(std::int32_t min_position, std::int32_t max_position);
+
+      /** \brief parse only every Nth firing; 1 (default) parses every firing
+       *  \details like the azimuth window, this should not be combined with encoder calibration
+       *  \throws std::invalid_argument if stride < 1
+       */
+      void setFiringStride(int stride);
+
+      /** \brief parse only the rings whose bit is set (bit 0 is ring 0); organized clouds get one row per ring
+       *  \details only applies to 8 laser packets (0x00 and 0x04); defaults to all rings
+       *  \throws std::invalid_argument if no ring or a ring that doesn't exist is selected
+       */
+      void setRingMask(int ring_mask);
+
+      /** \brief keep only the returns whose bit is set when return selection is ALL_RETURNS
+       *  \details defaults to all returns
+       *  \throws std::invalid_argument if no return or a return that doesn't exist is selected
+       */
+      void setReturnMask(int return_mask);
       
       double getDegreesOfSweepPerCloud() const { return angle_per_cloud_*180./M_PI; }
 
@@ -70,24 +193,223 @@ namespace quanergy
       /// set vertical angles to the default values for the specified sensors
       void setVerticalAngles(SensorType sensor);
 
+      /// status of the last packet assembled; safe to call while parsing
+      StatusType getStatus() const { return previous_status_; }
+      /// number of sensor status changes seen; safe to call while parsing
+      std::uint64_t getStatusTransitions() const { return status_transitions_; }
+
     protected:
-      // validate status and throw error if appropriate, print message if changed
-      void validateStatus(const StatusType& status);
+      // check whether a firing at the encoder position is within the azimuth window
+      bool inAzimuthWindow(std::uint16_t position) const
+      {
+        return (azimuth_window_min_ <= azimuth_window_max_)
+          ? (position >= azimuth_window_min_ && position <= azimuth_window_max_)
+          : (position >= azimuth_window_min_ || position <= azimuth_window_max_);
+      }
+
+      // check whether a firing should be decoded; applies the azimuth window and firing stride
+      // firing_sequence is the index of the firing in the stream
+      bool keepFiring(std::uint16_t position, std::uint64_t firing_sequence) const
+      {
+        return inAzimuthWindow(position) && (firing_stride_ == 1 || firing_sequence % firing_stride_ == 0);
+      }
+
+      // check that packet holds exactly size bytes before it is deserialized; otherwise reports
+      // SIZE_MISMATCH, marks decoded invalid and returns false
+      bool checkSize(const std::vector<char>& packet, std::size_t size, DecodedType& decoded);
+
+      // start decoding a packet; fills the packet level fields and clears the points
+      void beginDecode(DecodedType& decoded, std::uint64_t stamp, StatusType status, bool organize) const;
+
+      // call f with the points decode fills, decoded.points or decoded.compact_points
+      template <class F>
+      static void withDecodedPoints(DecodedType& decoded, F f)
+      {
+        if (decoded.compact)
+          f(decoded.compact_points);
+        else
+          f(decoded.points);
+      }
+
+      // the decoded point fields that depend on the encoder position and laser, by point type
+      void setPosition(PointHVDIR& point, std::uint16_t position) const
+      {
+        point.h = horizontal_angle_lookup_table_[position];
+      }
+
+      void setPosition(PointCompact& point, std::uint16_t position) const
+      {
+        point.azimuth = azimuth_lookup_table_[position];
+      }
+
+      static void setLaser(PointHVDIR& point, int ring, double vertical_angle)
+      {
+        point.v = vertical_angle;
+        point.ring = ring;
+      }
+
+      static void setLaser(PointCompact& point, int ring, double)
+      {
+        point.ring = static_cast<std::uint8_t>(ring);
+      }
+
+      // what a packet range unit is worth in the point type; meters for PointHVDIR, radius units for PointCompact
+      static double rangeScale(double meters_per_unit, const PointHVDIR&)
+      {
+        return meters_per_unit;
+      }
+
+      static std::uint32_t rangeScale(double meters_per_unit, const PointCompact&)
+      {
+        return static_cast<std::uint32_t>(std::lround(meters_per_unit / FrameCompact::RADIUS_SCALE));
+      }
+
+      // vertical angle of each ring in the compact frames assembled; the lookup table by default
+      virtual void compactVerticalAngles(float (&vertical_angles)[M_SERIES_NUM_LASERS]) const;
+
+      // assemble into the frame type of result; current is the frame being built and worker is used to organize
+      template <class FRAME_PTR>
+      bool assembleFrame(const DecodedType& decoded, FRAME_PTR& current, FRAME_PTR& worker, FRAME_PTR& result);
+
+      // skip a firing outside the azimuth window; still checks for completion so clouds
+      // are cut at the same azimuth as without a window. Returns true if result updated
+      template <class FRAME_PTR>
+      bool skipFiring(std::uint16_t position, FRAME_PTR& current, FRAME_PTR& result);
+
+      // validate status and report error if appropriate, print message if changed
+      // returns false if the packet should be dropped
+      bool validateStatus(const StatusType& status);
 
       // register new packet for time and direction
       void registerNewPacket(const std::uint64_t& current_packet_stamp_ms,
         const int& start_pos, const int& mid_pos, const int& end_pos);
 
-      // check whether the cloud is complete; if so, fill result and return true
-      bool checkComplete(const float& azimuth_angle, PointCloudHVDIRPtr& result);
+      // check whether the cloud is complete; if so, fill result, start a new current and return true
+      template <class FRAME_PTR>
+      bool checkComplete(const float& azimuth_angle, FRAME_PTR& current, FRAME_PTR& result);
       
-      // add firing of data
-      void addFiring(const PointCloudHVDIRPtr& firing_cloud);
+      // add firing of decoded points
+      template <class FRAME_PTR>
+      void addFiring(const DecodedType& decoded, const DecodedType::Firing& firing, FRAME_PTR& current);
 
-      // organize current_pc with height specified; throws if size not divisible by height
-      void organizeCloud(PointCloudHVDIRPtr& current_pc,
+      // organize current_pc with height specified using worker; throws if size not divisible by height
+      template <class FRAME_PTR>
+      void organizeCloud(FRAME_PTR& current_pc, FRAME_PTR& worker,
         unsigned int height = M_SERIES_NUM_LASERS);
 
+      // all ones for each return kept by the return mask; used to zero masked returns without branching
+      void returnMasks(std::uint32_t masks[M_SERIES_NUM_RETURNS]) const
+      {
+        for (int i = 0; i < M_SERIES_NUM_RETURNS; ++i)
+          masks[i] = (return_mask_ & (1 << i)) ? 0xFFFFFFFFu : 0u;
+      }
+
+      // decode the returns of one laser into out without branching; returns the number of points written
+      // RETURN_SELECTION is ALL_RETURNS or a return index; distances and intensities are indexed by
+      // return * stride. For ALL_RETURNS, zero ranges and duplicates are dropped by writing every
+      // candidate and only advancing past kept ones; otherwise a zero range becomes NaN
+      template <int RETURN_SELECTION>
+      static inline int decodeReturns(PointHVDIR hvdir, const std::uint32_t* distances,
+                                      const std::uint8_t* intensities, int stride,
+                                      const std::uint32_t* return_masks, double distance_scaling,
+                                      PointHVDIR* out, bool& is_dense)
+      {
+        if (RETURN_SELECTION == ALL_RETURNS)
+        {
+          const std::uint32_t dist0 = distances[0] & return_masks[0];
+          const std::uint32_t dist1 = distances[stride] & return_masks[1];
+          const std::uint32_t dist2 = distances[2 * stride] & return_masks[2];
+
+          // index 2 could equal index 0 and/or index 1
+          // index 1 could equal index 0 but only if all 3 are equal
+          const int keep0 = (dist0 != 0) & (dist0 != dist1) & (dist0 != dist2);
+          const int keep1 = (dist1 != 0) & (dist1 != dist2);
+          const int keep2 = (dist2 != 0);
+
+          int n = 0;
+
+          hvdir.intensity = intensities[0];
+          hvdir.d = static_cast<float>(dist0) * distance_scaling; // convert range to meters
+          out[n] = hvdir;
+          n += keep0;
+
+          hvdir.intensity = intensities[stride];
+          hvdir.d = static_cast<float>(dist1) * distance_scaling;
+          out[n] = hvdir;
+          n += keep1;
+
+          hvdir.intensity = intensities[2 * stride];
+          hvdir.d = static_cast<float>(dist2) * distance_scaling;
+          out[n] = hvdir;
+          n += keep2;
+
+          return n;
+        }
+        else
+        {
+          const std::uint32_t dist = distances[RETURN_SELECTION * stride];
+
+          hvdir.intensity = intensities[RETURN_SELECTION * stride];
+          // if the range is 0, the point is NaN and the cloud is not dense
+          hvdir.d = (dist == 0) ? std::numeric_limits<float>::quiet_NaN()
+                                : static_cast<float>(static_cast<float>(dist) * distance_scaling);
+          is_dense = is_dense & (dist != 0);
+          out[0] = hvdir;
+
+          return 1;
+        }
+      }
+
+      // the same for compact points; range_scale converts a packet range to radius units, and a range of 0
+      // is already the invalid radius so only is_dense needs it
+      template <int RETURN_SELECTION>
+      static inline int decodeReturns(PointCompact compact, const std::uint32_t* distances,
+                                      const std::uint8_t* intensities, int stride,
+                                      const std::uint32_t* return_masks, std::uint32_t range_scale,
+                                      PointCompact* out, bool& is_dense)
+      {
+        if (RETURN_SELECTION == ALL_RETURNS)
+        {
+          const std::uint32_t dist0 = distances[0] & return_masks[0];
+          const std::uint32_t dist1 = distances[stride] & return_masks[1];
+          const std::uint32_t dist2 = distances[2 * stride] & return_masks[2];
+
+          const int keep0 = (dist0 != 0) & (dist0 != dist1) & (dist0 != dist2);
+          const int keep1 = (dist1 != 0) & (dist1 != dist2);
+          const int keep2 = (dist2 != 0);
+
+          int n = 0;
+
+          compact.intensity = intensities[0];
+          compact.radius = dist0 * range_scale;
+          out[n] = compact;
+          n += keep0;
+
+          compact.intensity = intensities[stride];
+          compact.radius = dist1 * range_scale;
+          out[n] = compact;
+          n += keep1;
+
+          compact.intensity = intensities[2 * stride];
+          compact.radius = dist2 * range_scale;
+          out[n] = compact;
+          n += keep2;
+
+          return n;
+        }
+        else
+        {
+          const std::uint32_t dist = distances[RETURN_SELECTION * stride];
+
+          compact.intensity = intensities[RETURN_SELECTION * stride];
+          compact.radius = dist * range_scale;
+          is_dense = is_dense & (dist != 0);
+          out[0] = compact;
+
+          return 1;
+        }
+      }
+
       /// global cloud counter
       std::uint32_t cloud_counter_ = 0;
 
@@ -98,16 +420,33 @@ namespace quanergy
       std::uint64_t current_packet_stamp_ms_ = 0;
       std::uint64_t previous_packet_stamp_ms_ = 0;
 
-      /// cloud used for each firing defined here to reduce construct/resize costs
-      PointCloudHVDIRPtr firing_cloud_;
+      /// decoded packet used by parse defined here to reduce construct/resize costs
+      DecodedType decoded_;
+      /// packet counter used by parse
+      std::uint64_t packet_sequence_ = 0;
+
       /// cloud that gets built up over time
       PointCloudHVDIRPtr current_cloud_;
       /// temp cloud for organization used to reduce construct and resize costs
       PointCloudHVDIRPtr worker_cloud_;
 
+      /// the same for structure of arrays frames; created when first assembled into
+      FrameHVDIRPtr current_frame_;
+      FrameHVDIRPtr worker_frame_;
+
+      /// and for compact frames
+      FrameCompactPtr current_compact_;
+      FrameCompactPtr worker_compact_;
+
+      /// whether decode fills compact points
+      bool decode_compact_ = false;
+
       /// lookup table for horizontal angle
       std::vector<double> horizontal_angle_lookup_table_;
 
+      /// lookup table for the compact azimuth of each encoder position
+      std::vector<std::uint16_t> azimuth_lookup_table_;
+
       /// lookup table for vertical angle
       std::vector<double> vertical_angle_lookup_table_;
 
@@ -124,11 +463,27 @@ namespace quanergy
       double start_azimuth_ = 0.;
       double angle_per_cloud_ = 2*M_PI;
 
+      /// azimuth window in encoder positions
+      std::int32_t azimuth_window_min_ = 0;
+      std::int32_t azimuth_window_max_ = M_SERIES_NUM_ROT_ANGLES - 1;
+
+      /// firing stride
+      int firing_stride_ = 1;
+
+      /// lasers selected by the ring mask, in order
+      int selected_lasers_[M_SERIES_NUM_LASERS] = {0, 1, 2, 3, 4, 5, 6, 7};
+      int num_selected_lasers_ = M_SERIES_NUM_LASERS;
+
+      /// returns kept for ALL_RETURNS; bit per return
+      int return_mask_ = (1 << M_SERIES_NUM_RETURNS) - 1;
+
       /// direction
       int direction_ = 1; // start with an assumed direction until we can calculate
 
-      /// previous status
-      StatusType previous_status_ = StatusType::GOOD;
+      /// previous status; atomic so it can be read while parsing
+      std::atomic<StatusType> previous_status_ {StatusType::GOOD};
+      /// number of status changes
+      std::atomic<std::uint64_t> status_transitions_ {0};
 
       /// firing number in packet
       int firing_number_ = 0;
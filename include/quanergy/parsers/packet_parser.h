@@ -16,31 +16,67 @@
 
 #include <memory>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/signals2.hpp>
 
 #include <quanergy/client/exceptions.h>
+#include <quanergy/common/callback_chain.h>
+#include <quanergy/client/packet_error.h>
 
 namespace quanergy
 {
   namespace client
   {
+    /** \brief the type parser modules publish results as
+     *  \details shared pointers become shared pointers to const so subscribers can share a result without copying
+     */
+    template <class RESULT>
+    struct ConstResult
+    {
+      typedef RESULT type;
+    };
+
+    template <class T>
+    struct ConstResult<boost::shared_ptr<T>>
+    {
+      typedef boost::shared_ptr<const T> type;
+    };
+
+    template <class T>
+    struct ConstResult<std::shared_ptr<T>>
+    {
+      typedef std::shared_ptr<const T> type;
+    };
+
     template <class PARSER>
     struct PacketParserModule : public PARSER
     {
       PacketParserModule() = default;
 
+      /// type of the published results; the parser starts a new result after publishing one
+      typedef typename ConstResult<typename PARSER::ResultType>::type PublishedType;
       /// signal type
-      typedef boost::signals2::signal<void (const typename PARSER::ResultType&)> Signal;
+      typedef boost::signals2::signal<void (const PublishedType&)> Signal;
+      /// callback type
+      typedef typename CallbackChain<PublishedType>::Callback Callback;
       /** \brief Connect a slot to the signal which will be emitted when a new RESULT is available */
       boost::signals2::connection connect(const typename Signal::slot_type& subscriber)
       {
         return signal_.connect(subscriber);
       }
 
+      /** \brief Add a callback called without locking when a new RESULT is available
+       *  \note add callbacks before packets arrive; they can't be disconnected
+       */
+      void connectCallback(Callback callback)
+      {
+        signal_.add(std::move(callback));
+      }
+
       void slot(const std::shared_ptr<std::vector<char>>& packet)
       {
         // don't do the work unless someone is listening
-        if (signal_.num_slots() == 0)
+        if (signal_.empty())
           return;
 
         if (PARSER::validateParse(*packet, result))
@@ -49,7 +85,7 @@ namespace quanergy
 
       protected:
         /// Signal that gets fired whenever a result is ready.
-        Signal signal_;
+        CallbackChain<PublishedType> signal_;
         /// result to pass to parse function
         typename PARSER::ResultType result;
     };
@@ -62,14 +98,15 @@ namespace quanergy
 
       /** \brief check packet validity and parse if a match
        *  \return true if result updated; false otherwise
-       *  \throws InvalidPacketError if not a valid packet
+       *  \throws InvalidPacketError if not a valid packet and the error policy is THROW
        */
       inline virtual bool validateParse(const std::vector<char>& packet, RESULT& result)
       {
         if (validate(packet))
           return parse(packet, result);
-        else
-          throw InvalidPacketError();
+
+        reportError(PacketError::INVALID_PACKET, InvalidPacketError());
+        return false;
       }
 
       /** \brief check packet validity
@@ -81,6 +118,30 @@ namespace quanergy
        *          (some parsers may require multiple packets before updating result)
        */
       virtual bool parse(const std::vector<char>& packet, RESULT& result) = 0;
+
+      /** \brief set how per packet errors are handled; configuration errors always throw
+       *  \details with ErrorPolicy::CONTINUE, bad packets are dropped and counted by reason
+       */
+      virtual void setErrorPolicy(ErrorPolicy policy) { error_policy_ = policy; }
+      ErrorPolicy getErrorPolicy() const { return error_policy_; }
+
+      /** \brief counts of packets dropped under ErrorPolicy::CONTINUE; safe to call from any thread */
+      virtual PacketErrorCounts getErrorCounts() const { return error_counters_.snapshot(); }
+      virtual void resetErrorCounts() { error_counters_.reset(); }
+
+    protected:
+      /// throw e under ErrorPolicy::THROW; otherwise count the error
+      template <class EXCEPTION>
+      void reportError(PacketError error, const EXCEPTION& e)
+      {
+        if (error_policy_ == ErrorPolicy::THROW)
+          throw e;
+
+        error_counters_.increment(error);
+      }
+
+      ErrorPolicy error_policy_ = ErrorPolicy::THROW;
+      PacketErrorCounters error_counters_;
     };
 
   } // namespace client
@@ -0,0 +1,358 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file parallel_packet_parser.h
+ *
+ *  \brief Provide a parser module that decodes packets on a pool of threads.
+ *
+ *  Packets are decoded concurrently into a fixed ring of jobs and assembled into clouds
+ *  strictly in arrival order, so the output is identical to PacketParserModule.
+ *  The PARSER must provide DecodedType, decode and assemble.
+ */
+
+#ifndef QUANERGY_CLIENT_PARALLEL_PACKET_PARSER_H
+#define QUANERGY_CLIENT_PARALLEL_PACKET_PARSER_H
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+
+#include <boost/signals2.hpp>
+
+#include <quanergy/parsers/packet_parser.h>
+#include <quanergy/common/latency_histogram.h>
+#include <quanergy/common/trace.h>
+#include <quanergy/common/callback_chain.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    template <class PARSER>
+    struct ParallelPacketParserModule : public PARSER
+    {
+      ParallelPacketParserModule() = default;
+
+      ~ParallelPacketParserModule()
+      {
+        stopThreads();
+      }
+
+      /// type of the published results; the parser starts a new result after publishing one
+      typedef typename ConstResult<typename PARSER::ResultType>::type PublishedType;
+      /// signal type
+      typedef boost::signals2::signal<void (const PublishedType&)> Signal;
+      /// callback type
+      typedef typename CallbackChain<PublishedType>::Callback Callback;
+      /** \brief Connect a slot to the signal which will be emitted when a new RESULT is available */
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber)
+      {
+        return signal_.connect(subscriber);
+      }
+
+      /** \brief Add a callback called without locking when a new RESULT is available
+       *  \note add callbacks before packets arrive; they can't be disconnected
+       */
+      void connectCallback(Callback callback)
+      {
+        signal_.add(std::move(callback));
+      }
+
+      /** \brief Set the number of decode threads; must be called before packets arrive
+       *  \param num_threads of 0 decodes and assembles on the calling thread (default)
+       *  \param max_in_flight bounds the packets held between slot and assembly;
+       *         0 uses twice the number of threads. slot blocks when the limit is reached
+       */
+      void setDecodeThreads(std::size_t num_threads, std::size_t max_in_flight = 0)
+      {
+        stopThreads();
+
+        kill_ = false;
+        next_sequence_ = next_decode_ = next_assemble_ = 0;
+        jobs_.clear();
+
+        if (num_threads == 0)
+          return;
+
+        jobs_.resize(max_in_flight == 0 ? 2 * num_threads : std::max(max_in_flight, num_threads));
+
+        for (std::size_t i = 0; i < num_threads; ++i)
+        {
+          workers_.emplace_back([this]{ processJobs(); });
+          Tracer::instance().setThreadName(workers_.back().get_id(), "parser_worker_" + std::to_string(i));
+        }
+      }
+
+      std::size_t getDecodeThreads() const { return workers_.size(); }
+
+      /// in place work on a result before it is published
+      typedef std::function<void (typename PARSER::ResultType::element_type&)> ResultFilter;
+
+      /** \brief run filter on each result before it is published, on the thread assembling it
+       *  \details for cheap in place work like filtering compact frames, which saves a copy compared to a
+       *           separate module. Empty (the default) publishes results as assembled. Must be called
+       *           before packets arrive
+       */
+      void setResultFilter(ResultFilter filter)
+      {
+        result_filter_ = std::move(filter);
+      }
+
+      /** \brief record the parse time of each cloud; null (the default) disables timing
+       *  \details the time is the sum of decode and assembly of the packets in the cloud,
+       *           so with decode threads it is CPU time rather than wall time.
+       *           Must be called before packets arrive
+       */
+      void setLatencyHistogram(LatencyHistogram* histogram)
+      {
+        latency_histogram_ = histogram;
+        frame_time_ = std::chrono::steady_clock::duration::zero();
+      }
+
+      void slot(const std::shared_ptr<std::vector<char>>& packet)
+      {
+        // don't do the work unless someone is listening
+        if (signal_.empty())
+          return;
+
+        if (workers_.empty())
+        {
+          QUANERGY_TRACE_SCOPE("parse_packet");
+
+          std::chrono::steady_clock::time_point start;
+          if (latency_histogram_)
+            start = std::chrono::steady_clock::now();
+
+          PARSER::decode(*packet, decoded_, next_sequence_++);
+          bool complete = PARSER::assemble(decoded_, result_);
+
+          if (latency_histogram_)
+            recordFrameTime(std::chrono::steady_clock::now() - start, complete);
+
+          if (complete)
+            publish();
+
+          return;
+        }
+
+        QUANERGY_TRACE_SCOPE("parser_push");
+
+        std::unique_lock<std::mutex> lk(mutex_);
+
+        // if an exception was caught, send it up the chain
+        if (exception_)
+        {
+          std::exception_ptr e = exception_;
+          exception_ = nullptr;
+          std::rethrow_exception(e);
+        }
+
+        // wait for room in the ring
+        space_conditional_.wait(lk, [this]{ return next_sequence_ - next_assemble_ < jobs_.size() || kill_; });
+
+        if (kill_)
+          return;
+
+        Job& job = jobs_[next_sequence_ % jobs_.size()];
+        job.packet = packet;
+        job.sequence = next_sequence_++;
+        job.done = false;
+        job.exception = nullptr;
+
+        Tracer& tracer = Tracer::instance();
+        job.trace_id = tracer.enabled() ? tracer.newFlowId() : 0;
+        if (job.trace_id)
+          tracer.flowBegin("parser_queue", job.trace_id);
+
+        lk.unlock();
+        work_conditional_.notify_one();
+      }
+
+    private:
+      /// packet in flight
+      struct Job
+      {
+        std::shared_ptr<std::vector<char>> packet;
+        typename PARSER::DecodedType decoded;
+        std::uint64_t sequence = 0;
+        /// only measured when timing is enabled
+        std::chrono::steady_clock::duration decode_time {};
+        /// trace flow id from slot to decode; 0 when not tracing
+        std::uint64_t trace_id = 0;
+        bool done = false;
+        std::exception_ptr exception;
+      };
+
+      void stopThreads()
+      {
+        {
+          std::lock_guard<std::mutex> lk(mutex_);
+          kill_ = true;
+        }
+        work_conditional_.notify_all();
+        space_conditional_.notify_all();
+
+        for (auto& worker : workers_)
+        {
+          if (worker.joinable())
+            worker.join();
+        }
+
+        workers_.clear();
+      }
+
+      /// worker loop; decode in parallel, then whichever worker is free assembles completed jobs in order
+      void processJobs()
+      {
+        for (;;)
+        {
+          std::unique_lock<std::mutex> lk(mutex_);
+          work_conditional_.wait(lk, [this]{ return next_decode_ < next_sequence_ || kill_; });
+
+          if (kill_)
+            return;
+
+          Job& job = jobs_[next_decode_++ % jobs_.size()];
+          lk.unlock();
+
+          try
+          {
+            QUANERGY_TRACE_SCOPE("decode_packet");
+            if (job.trace_id)
+              Tracer::instance().flowEnd("parser_queue", job.trace_id);
+
+            std::chrono::steady_clock::time_point start;
+            if (latency_histogram_)
+              start = std::chrono::steady_clock::now();
+
+            PARSER::decode(*job.packet, job.decoded, job.sequence);
+
+            if (latency_histogram_)
+              job.decode_time = std::chrono::steady_clock::now() - start;
+          }
+          catch (...)
+          {
+            job.exception = std::current_exception();
+          }
+
+          lk.lock();
+          job.done = true;
+
+          // only one thread assembles at a time
+          if (assembling_)
+            continue;
+
+          assembling_ = true;
+
+          while (!kill_ && next_assemble_ < next_decode_ && jobs_[next_assemble_ % jobs_.size()].done)
+          {
+            Job& ready = jobs_[next_assemble_ % jobs_.size()];
+            lk.unlock();
+
+            std::exception_ptr exception = ready.exception;
+            if (!exception)
+            {
+              try
+              {
+                QUANERGY_TRACE_SCOPE("assemble_packet");
+
+                std::chrono::steady_clock::time_point start;
+                if (latency_histogram_)
+                  start = std::chrono::steady_clock::now();
+
+                bool complete = PARSER::assemble(ready.decoded, result_);
+
+                if (latency_histogram_)
+                  recordFrameTime(ready.decode_time + (std::chrono::steady_clock::now() - start), complete);
+
+                if (complete)
+                  publish();
+              }
+              catch (...)
+              {
+                exception = std::current_exception();
+              }
+            }
+
+            ready.packet.reset();
+
+            lk.lock();
+            if (exception)
+              exception_ = exception;
+
+            ready.done = false;
+            ++next_assemble_;
+            space_conditional_.notify_one();
+          }
+
+          assembling_ = false;
+        }
+      }
+
+      /// filter and signal the result just assembled
+      void publish()
+      {
+        if (result_filter_)
+          result_filter_(*result_);
+
+        signal_(result_);
+      }
+
+      /// add a packet's parse time to the current cloud; record it when the cloud completes
+      void recordFrameTime(std::chrono::steady_clock::duration packet_time, bool complete)
+      {
+        frame_time_ += packet_time;
+        if (complete)
+        {
+          latency_histogram_->record(frame_time_);
+          frame_time_ = std::chrono::steady_clock::duration::zero();
+        }
+      }
+
+      /// Signal that gets fired whenever a result is ready.
+      CallbackChain<PublishedType> signal_;
+      /// in place work before signaling; may be empty
+      ResultFilter result_filter_;
+      /// result to pass to assemble
+      typename PARSER::ResultType result_;
+      /// decoded packet used when there are no worker threads
+      typename PARSER::DecodedType decoded_;
+
+      /// ring of jobs; sequence numbers map to jobs_[sequence % size]
+      std::vector<Job> jobs_;
+      std::vector<std::thread> workers_;
+
+      std::uint64_t next_sequence_ = 0;
+      std::uint64_t next_decode_ = 0;
+      std::uint64_t next_assemble_ = 0;
+      bool assembling_ = false;
+      bool kill_ = false;
+
+      std::exception_ptr exception_;
+
+      /// parse time histogram; null disables timing
+      LatencyHistogram* latency_histogram_ = nullptr;
+      /// parse time of the cloud being assembled; only touched by the assembling thread
+      std::chrono::steady_clock::duration frame_time_ {};
+
+      std::mutex mutex_;
+      std::condition_variable work_conditional_;
+      std::condition_variable space_conditional_;
+    };
+
+  } // namespace client
+
+} // namespace quanergy
+
+#endif
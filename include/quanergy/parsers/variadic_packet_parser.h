@@ -28,6 +28,14 @@ namespace quanergy
     {
       typedef RESULT ResultType;
 
+      /** \brief decoded packet along with the index of the parser that decoded it */
+      struct DecodedType
+      {
+        /// index of the parser; the number of parsers if the packet was dropped
+        std::size_t index = 0;
+        std::tuple<typename PARSERS::DecodedType...> decoded;
+      };
+
       VariadicPacketParser() = default;
 
       /** \brief provide access to the individual parsers */
@@ -37,6 +45,12 @@ namespace quanergy
         return std::get<I>(parsers);
       }
 
+      template <std::size_t I>
+      auto get() const -> const typename std::tuple_element<I, std::tuple<PARSERS...>>::type&
+      {
+        return std::get<I>(parsers);
+      }
+
       /** \brief iterate through parsers to find first match and parse */
       inline virtual bool validateParse(const std::vector<char>& packet, RESULT& result)
       {
@@ -64,15 +78,117 @@ namespace quanergy
         }
       }
 
+      /** \brief set the error policy of this parser and all the individual parsers */
+      virtual void setErrorPolicy(ErrorPolicy policy) override
+      {
+        PacketParserBase<RESULT>::setErrorPolicy(policy);
+        forEachParser([policy](auto& parser){ parser.setErrorPolicy(policy); });
+      }
+
+      /** \brief error counts of this parser and all the individual parsers */
+      virtual PacketErrorCounts getErrorCounts() const override
+      {
+        PacketErrorCounts counts = PacketParserBase<RESULT>::getErrorCounts();
+        const_cast<VariadicPacketParser*>(this)->forEachParser(
+          [&counts](auto& parser){ counts += parser.getErrorCounts(); });
+        return counts;
+      }
+
+      virtual void resetErrorCounts() override
+      {
+        PacketParserBase<RESULT>::resetErrorCounts();
+        forEachParser([](auto& parser){ parser.resetErrorCounts(); });
+      }
+
+      /** \brief find the matching parser and decode; only valid when all parsers support decode/assemble
+       *  \throws InvalidPacketError if no parser matches and the error policy is THROW
+       */
+      inline void decode(const std::vector<char>& packet, DecodedType& decoded, std::uint64_t sequence)
+      {
+        decode<sizeof...(PARSERS)-1>(packet, decoded, sequence);
+      }
+
+      /** \brief assemble with the parser that decoded the packet
+       *  \return true if result updated
+       */
+      inline bool assemble(const DecodedType& decoded, RESULT& result)
+      {
+        // dropped packet
+        if (decoded.index >= sizeof...(PARSERS))
+          return false;
+
+        return assemble<sizeof...(PARSERS)-1>(decoded, result);
+      }
+
     private:
+      /// call f on each individual parser
+      template <class F>
+      void forEachParser(F f)
+      {
+        forEachParser(f, std::index_sequence_for<PARSERS...>());
+      }
+
+      template <class F, std::size_t... I>
+      void forEachParser(F f, std::index_sequence<I...>)
+      {
+        int unused[] = {0, (f(std::get<I>(parsers)), 0)...};
+        (void)unused;
+      }
+
+      /// last attempt to find matching parser at I==0, if it fails throw an excp
+      template<std::size_t I = 0>
+      inline typename std::enable_if<I == 0>::type decode(const std::vector<char>& packet, DecodedType& decoded,
+                                                         std::uint64_t sequence)
+      {
+        if (!std::get<I>(parsers).validate(packet))
+        {
+          decoded.index = sizeof...(PARSERS);
+          this->reportError(PacketError::INVALID_PACKET, InvalidPacketError());
+          return;
+        }
+
+        decoded.index = I;
+        std::get<I>(parsers).decode(packet, std::get<I>(decoded.decoded), sequence);
+      }
+
+      /// find parser and recurse if I != 0
+      template<std::size_t I = 0>
+      inline typename std::enable_if<I != 0>::type decode(const std::vector<char>& packet, DecodedType& decoded,
+                                                         std::uint64_t sequence)
+      {
+        if (!std::get<I>(parsers).validate(packet))
+          return decode<I - 1>(packet, decoded, sequence);
+
+        decoded.index = I;
+        std::get<I>(parsers).decode(packet, std::get<I>(decoded.decoded), sequence);
+      }
+
+      /// assemble with the parser at I==0
+      template<std::size_t I = 0>
+      inline typename std::enable_if<I == 0, bool>::type assemble(const DecodedType& decoded, RESULT& result)
+      {
+        return std::get<I>(parsers).assemble(std::get<I>(decoded.decoded), result);
+      }
+
+      /// find the parser by index and recurse if I != 0
+      template<std::size_t I = 0>
+      inline typename std::enable_if<I != 0, bool>::type assemble(const DecodedType& decoded, RESULT& result)
+      {
+        if (decoded.index == I)
+          return std::get<I>(parsers).assemble(std::get<I>(decoded.decoded), result);
+        else
+          return assemble<I - 1>(decoded, result);
+      }
+
       /// last attempt to find matching parser at I==0, if it fails throw an excp
       template<std::size_t I = 0>
       inline typename std::enable_if<I == 0, bool>::type parse(const std::vector<char>& packet, RESULT& result)
       {
         if (std::get<I>(parsers).validate(packet))
           return std::get<I>(parsers).parse(packet, result);
-        else
-          throw InvalidPacketError();
+
+        this->reportError(PacketError::INVALID_PACKET, InvalidPacketError());
+        return false;
       }
 
       /// find parser and recurse if I != 0
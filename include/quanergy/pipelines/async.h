@@ -20,7 +20,11 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
-#include <iostream>
+#include <chrono>
+
+#include <quanergy/common/logger.h>
+#include <quanergy/common/latency_histogram.h>
+#include <quanergy/common/trace.h>
 
 namespace quanergy
 {
@@ -75,22 +79,52 @@ namespace quanergy
         return signal_.connect(subscriber);
       }
 
+      /** \brief record the time each input waits in the queue; null (the default) disables timing
+       *  \details must be called before inputs arrive
+       */
+      void setLatencyHistogram(LatencyHistogram* histogram)
+      {
+        latency_histogram_ = histogram;
+      }
+
+      /// name the signal thread in traces
+      void setTraceName(const std::string& name)
+      {
+        Tracer::instance().setThreadName(signal_thread_->get_id(), name);
+      }
+
+      /// inputs dropped because the queue was full; safe to read from any thread
+      std::uint64_t getDropped() const { return dropped_; }
+      /// inputs waiting in the queue; safe to read from any thread
+      std::size_t getQueueDepth() const { return queue_depth_; }
+
       void slot(const Type& input)
       {
         // if an exception was caught, send it up the chain
         if (exception_)
           std::rethrow_exception(exception_);
 
+        QUANERGY_TRACE_SCOPE("async_push");
+        Tracer& tracer = Tracer::instance();
+        std::uint64_t trace_id = tracer.enabled() ? tracer.newFlowId() : 0;
+        if (trace_id)
+          tracer.flowBegin("async_queue", trace_id);
+
         std::unique_lock<std::mutex> lk(input_queue_mutex_);
 
-        input_queue_.push(input);
+        input_queue_.push(Item{input,
+                               latency_histogram_ ? std::chrono::steady_clock::now()
+                                                  : std::chrono::steady_clock::time_point(),
+                               trace_id});
 
         // while shouldn't be necessary but doesn't hurt just to be sure
         while (input_queue_.size() > max_queue_size_)
         {
-          std::cerr << "Warning: AsyncModule dropped input due to full buffer" << std::endl;
+          QUANERGY_LOG_THROTTLED(WARNING, "Warning: AsyncModule dropped input due to full buffer");
           input_queue_.pop();
+          dropped_.fetch_add(1, std::memory_order_relaxed);
         }
+        queue_depth_ = input_queue_.size();
 
         lk.unlock();
         input_queue_conditional_.notify_one();
@@ -108,25 +142,46 @@ namespace quanergy
           if (kill_)
             return;
 
-          Type item = input_queue_.front();
+          Item item = input_queue_.front();
           input_queue_.pop();
+          queue_depth_ = input_queue_.size();
           lk.unlock();
 
-          signal_(item);
+          if (latency_histogram_ && item.enqueued != std::chrono::steady_clock::time_point())
+            latency_histogram_->record(std::chrono::steady_clock::now() - item.enqueued);
+
+          QUANERGY_TRACE_SCOPE("async_signal");
+          if (item.trace_id)
+            Tracer::instance().flowEnd("async_queue", item.trace_id);
+
+          signal_(item.value);
         }
       }
 
     private:
+      /// queued input, when it was queued (only set when timing) and its trace flow id (0 when not tracing)
+      struct Item
+      {
+        Type value;
+        std::chrono::steady_clock::time_point enqueued;
+        std::uint64_t trace_id;
+      };
+
       /// new thread for signal
       std::unique_ptr<std::thread> signal_thread_;
       std::exception_ptr exception_;
 
-      std::queue<Type>            input_queue_;
+      std::queue<Item>            input_queue_;
       std::size_t                 max_queue_size_;
       std::mutex                  input_queue_mutex_;
       std::condition_variable     input_queue_conditional_;
       std::atomic_bool            kill_ {false};
 
+      LatencyHistogram*           latency_histogram_ = nullptr;
+
+      std::atomic<std::uint64_t>  dropped_ {0};
+      std::atomic<std::size_t>    queue_depth_ {0};
+
       Signal signal_;
     };
 
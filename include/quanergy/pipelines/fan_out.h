@@ -0,0 +1,486 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file fan_out.h
+ *
+ *  \brief Runs each subscriber on a shared worker pool with its own queue.
+ */
+
+#ifndef QUANERGY_PIPELINES_FAN_OUT_H
+#define QUANERGY_PIPELINES_FAN_OUT_H
+
+#include <boost/optional.hpp>
+#include <boost/signals2.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <quanergy/common/bounded_ring.h>
+#include <quanergy/common/trace.h>
+#include <quanergy/pipelines/ring_async.h>
+
+namespace quanergy
+{
+  namespace pipeline
+  {
+    /// queueing of one FanOutModule subscriber
+    struct FanOutSubscriberSettings
+    {
+      /// inputs queued for the subscriber
+      std::size_t capacity = 2;
+      /// what happens to input when the subscriber's queue is full; BLOCK holds up slot and so every subscriber
+      DropPolicy drop_policy = DropPolicy::OLDEST;
+      /// workers that may run the subscriber at once; only connectOrdered work runs on more than 1
+      std::size_t concurrency = 1;
+    };
+
+    /// counters of one FanOutModule subscriber
+    struct FanOutSubscriberStats
+    {
+      std::uint64_t received = 0;
+      std::uint64_t delivered = 0;
+      std::uint64_t dropped = 0;
+      std::size_t queue_depth = 0;
+      /// inputs the subscriber's queue holds
+      std::size_t capacity = 0;
+    };
+
+    /** \brief FanOutModule gives each subscriber its own bounded queue and runs them on a worker pool
+     *  \details a subscriber never runs on two workers at once, so it sees inputs in order; inputs dropped from
+     *           a connectOrdered subscriber's queue are skipped in the order
+     */
+    template <class Type>
+    class FanOutModule
+    {
+    public:
+      using ResultType = Type;
+
+      using Signal = boost::signals2::signal<void (const ResultType&)>;
+
+      /** \brief constructor
+       *  \param num_threads is the worker pool size; see setThreads
+       */
+      FanOutModule(std::size_t num_threads = 0)
+      {
+        setThreads(num_threads);
+      }
+
+      ~FanOutModule()
+      {
+        stopThreads();
+      }
+
+      /** \brief set the worker pool size
+       *  \details 0 runs subscribers on the thread calling slot, one after another.
+       *           Must be called before inputs arrive
+       */
+      void setThreads(std::size_t num_threads)
+      {
+        stopThreads();
+
+        kill_ = false;
+        for (std::size_t i = 0; i < num_threads; ++i)
+          workers_.emplace_back([this]{ processTasks(); });
+
+        setTraceName(trace_name_);
+      }
+
+      std::size_t getThreads() const { return workers_.size(); }
+
+      /// name the workers <name>_<index> in traces
+      void setTraceName(const std::string& name)
+      {
+        trace_name_ = name;
+        for (std::size_t i = 0; i < workers_.size(); ++i)
+          Tracer::instance().setThreadName(workers_[i].get_id(), name + "_" + std::to_string(i));
+      }
+
+      /** \brief connect a subscriber with its own queue
+       *  \note settings.concurrency is ignored; the subscriber runs on one worker at a time
+       */
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber,
+                                          const FanOutSubscriberSettings& settings = FanOutSubscriberSettings())
+      {
+        FanOutSubscriberSettings serial = settings;
+        serial.concurrency = 1;
+
+        auto entry = std::make_shared<SignalSubscriber>(serial);
+        auto connection = entry->signal.connect(subscriber);
+        add(entry);
+        return connection;
+      }
+
+      /** \brief connect work that runs on up to settings.concurrency workers and a sink that gets its results in order
+       *  \param work is called for each input; calls may overlap so it must be thread safe
+       *  \param sink is called with each result in input order, one at a time
+       *  \returns the sink's connection; disconnecting it stops the work too
+       */
+      template <class Result>
+      boost::signals2::connection connectOrdered(
+          std::function<Result (const Type&)> work,
+          const typename boost::signals2::signal<void (const Result&)>::slot_type& sink,
+          const FanOutSubscriberSettings& settings = FanOutSubscriberSettings())
+      {
+        auto entry = std::make_shared<OrderedSubscriber<Result>>(settings, std::move(work));
+        auto connection = entry->sink.connect(sink);
+        add(entry);
+        return connection;
+      }
+
+      void slot(const Type& input)
+      {
+        // if a subscriber threw, send it up the chain
+        if (failed_)
+        {
+          std::lock_guard<std::mutex> lk(exception_mutex_);
+          std::rethrow_exception(exception_);
+        }
+
+        auto subscribers = std::atomic_load(&subscribers_);
+        if (!subscribers)
+          return;
+
+        for (const auto& subscriber : *subscribers)
+        {
+          if (!subscriber->connected())
+            continue;
+
+          subscriber->received.fetch_add(1, std::memory_order_relaxed);
+          Item item{input, subscriber->offered.fetch_add(1, std::memory_order_relaxed)};
+
+          if (workers_.empty())
+          {
+            run(*subscriber, item);
+            continue;
+          }
+
+          if (!enqueue(*subscriber, std::move(item)))
+            continue;
+
+          // make the push visible before checking whether a worker is on it; see drain
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          if (subscriber->acquire())
+            post(subscriber);
+        }
+      }
+
+      /// inputs dropped by all subscribers; safe to call from any thread
+      std::uint64_t getDropped() const
+      {
+        std::uint64_t dropped = 0;
+        for (const auto& stats : getSubscriberStats())
+          dropped += stats.dropped;
+        return dropped;
+      }
+
+      /// inputs queued for all subscribers; safe to call from any thread
+      std::size_t getQueueDepth() const
+      {
+        std::size_t depth = 0;
+        for (const auto& stats : getSubscriberStats())
+          depth += stats.queue_depth;
+        return depth;
+      }
+
+      /// counters of each connected subscriber in connection order; safe to call from any thread
+      std::vector<FanOutSubscriberStats> getSubscriberStats() const
+      {
+        std::vector<FanOutSubscriberStats> result;
+        auto subscribers = std::atomic_load(&subscribers_);
+        if (!subscribers)
+          return result;
+
+        for (const auto& subscriber : *subscribers)
+        {
+          if (!subscriber->connected())
+            continue;
+
+          FanOutSubscriberStats stats;
+          stats.received = subscriber->received;
+          stats.delivered = subscriber->delivered;
+          stats.dropped = subscriber->dropped;
+          stats.queue_depth = subscriber->queue.size();
+          stats.capacity = subscriber->queue.capacity();
+          result.push_back(stats);
+        }
+        return result;
+      }
+
+    private:
+      /// input and its sequence number for the subscriber it is queued for
+      struct Item
+      {
+        Type value;
+        std::uint64_t sequence;
+      };
+
+      struct Subscriber
+      {
+        Subscriber(const FanOutSubscriberSettings& s)
+          : settings(s)
+          , queue(s.capacity)
+        {}
+
+        virtual ~Subscriber() = default;
+
+        virtual bool connected() const = 0;
+        /// handle an input; called on up to settings.concurrency workers at once
+        virtual void run(const Item& item) = 0;
+        /// an input that was dropped
+        virtual void skip(std::uint64_t /*sequence*/) {}
+
+        /// claim a place among the workers running this subscriber
+        bool acquire()
+        {
+          std::size_t current = active.load();
+          while (current < settings.concurrency)
+          {
+            if (active.compare_exchange_weak(current, current + 1))
+              return true;
+          }
+          return false;
+        }
+
+        const FanOutSubscriberSettings settings;
+        BoundedRing<Item> queue;
+
+        /// workers running this subscriber
+        std::atomic<std::size_t> active {0};
+        /// next sequence number
+        std::atomic<std::uint64_t> offered {0};
+
+        std::atomic<std::uint64_t> received {0};
+        std::atomic<std::uint64_t> delivered {0};
+        std::atomic<std::uint64_t> dropped {0};
+      };
+
+      struct SignalSubscriber : public Subscriber
+      {
+        using Subscriber::Subscriber;
+
+        bool connected() const override { return !signal.empty(); }
+        void run(const Item& item) override { signal(item.value); }
+
+        Signal signal;
+      };
+
+      template <class Result>
+      struct OrderedSubscriber : public Subscriber
+      {
+        OrderedSubscriber(const FanOutSubscriberSettings& s, std::function<Result (const Type&)> w)
+          : Subscriber(s)
+          , work(std::move(w))
+        {}
+
+        bool connected() const override { return !sink.empty(); }
+
+        void run(const Item& item) override
+        {
+          complete(item.sequence, work(item.value));
+        }
+
+        void skip(std::uint64_t sequence) override
+        {
+          complete(sequence, boost::none);
+        }
+
+        /// hold results until those before them are done; the sink runs under the lock so it is never concurrent
+        void complete(std::uint64_t sequence, boost::optional<Result> result)
+        {
+          std::lock_guard<std::mutex> lk(mutex);
+          pending.emplace(sequence, std::move(result));
+
+          while (!pending.empty() && pending.begin()->first == next)
+          {
+            if (pending.begin()->second)
+              sink(*pending.begin()->second);
+            pending.erase(pending.begin());
+            ++next;
+          }
+        }
+
+        std::function<Result (const Type&)> work;
+        boost::signals2::signal<void (const Result&)> sink;
+
+        std::mutex mutex;
+        std::map<std::uint64_t, boost::optional<Result>> pending;
+        std::uint64_t next = 0;
+      };
+
+      using SubscriberList = std::vector<std::shared_ptr<Subscriber>>;
+
+      /// add a subscriber; the list is copied so slot can read it without a lock
+      void add(const std::shared_ptr<Subscriber>& subscriber)
+      {
+        std::lock_guard<std::mutex> lk(connect_mutex_);
+
+        auto current = std::atomic_load(&subscribers_);
+        auto updated = std::make_shared<SubscriberList>();
+        if (current)
+        {
+          // leave out disconnected subscribers
+          for (const auto& s : *current)
+          {
+            if (s->connected())
+              updated->push_back(s);
+          }
+        }
+        updated->push_back(subscriber);
+
+        std::atomic_store(&subscribers_, std::shared_ptr<const SubscriberList>(updated));
+      }
+
+      /// queue item for subscriber according to its drop policy; false if the item was dropped
+      bool enqueue(Subscriber& subscriber, Item&& item)
+      {
+        while (!subscriber.queue.push(std::move(item)))
+        {
+          switch (subscriber.settings.drop_policy)
+          {
+          case DropPolicy::NEWEST:
+            subscriber.dropped.fetch_add(1, std::memory_order_relaxed);
+            subscriber.skip(item.sequence);
+            return false;
+
+          case DropPolicy::OLDEST:
+          {
+            // a worker may take it first, in which case there is room anyway
+            Item oldest;
+            if (subscriber.queue.pop(oldest))
+            {
+              subscriber.dropped.fetch_add(1, std::memory_order_relaxed);
+              subscriber.skip(oldest.sequence);
+            }
+            break;
+          }
+
+          case DropPolicy::BLOCK:
+            if (kill_)
+              return false;
+            std::this_thread::yield();
+            break;
+          }
+        }
+
+        return true;
+      }
+
+      void run(Subscriber& subscriber, const Item& item)
+      {
+        QUANERGY_TRACE_SCOPE("fan_out_subscriber");
+        subscriber.run(item);
+        subscriber.delivered.fetch_add(1, std::memory_order_release);
+      }
+
+      void post(const std::shared_ptr<Subscriber>& subscriber)
+      {
+        {
+          std::lock_guard<std::mutex> lk(tasks_mutex_);
+          tasks_.push_back(subscriber);
+        }
+        tasks_conditional_.notify_one();
+      }
+
+      void processTasks()
+      {
+        for (;;)
+        {
+          std::shared_ptr<Subscriber> subscriber;
+          {
+            std::unique_lock<std::mutex> lk(tasks_mutex_);
+            tasks_conditional_.wait(lk, [this]{ return !tasks_.empty() || kill_; });
+            if (kill_)
+              return;
+
+            subscriber = std::move(tasks_.front());
+            tasks_.pop_front();
+          }
+
+          try
+          {
+            drain(*subscriber);
+          }
+          catch (...)
+          {
+            std::lock_guard<std::mutex> lk(exception_mutex_);
+            if (!exception_)
+              exception_ = std::current_exception();
+            failed_ = true;
+            subscriber->active.fetch_sub(1);
+          }
+        }
+      }
+
+      /// run the subscriber until its queue is empty, then give up its place
+      void drain(Subscriber& subscriber)
+      {
+        for (;;)
+        {
+          Item item;
+          while (!kill_ && subscriber.queue.pop(item))
+            run(subscriber, item);
+
+          subscriber.active.fetch_sub(1);
+
+          // slot may have pushed after the last pop and seen this worker still active; if so, take it back
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          if (kill_ || subscriber.queue.empty() || !subscriber.acquire())
+            return;
+        }
+      }
+
+      void stopThreads()
+      {
+        {
+          std::lock_guard<std::mutex> lk(tasks_mutex_);
+          kill_ = true;
+        }
+        tasks_conditional_.notify_all();
+
+        for (auto& worker : workers_)
+        {
+          if (worker.joinable())
+            worker.join();
+        }
+        workers_.clear();
+
+        // tasks never run give back their places
+        for (auto& task : tasks_)
+          task->active.fetch_sub(1);
+        tasks_.clear();
+      }
+
+      std::vector<std::thread> workers_;
+      std::string trace_name_ = "fan_out_worker";
+
+      std::mutex connect_mutex_;
+      std::shared_ptr<const SubscriberList> subscribers_;
+
+      /// subscribers with input and a free place, waiting for a worker
+      std::deque<std::shared_ptr<Subscriber>> tasks_;
+      std::mutex tasks_mutex_;
+      std::condition_variable tasks_conditional_;
+      std::atomic_bool kill_ {false};
+
+      std::mutex exception_mutex_;
+      std::exception_ptr exception_;
+      std::atomic_bool failed_ {false};
+    };
+
+  } // namespace pipeline
+
+} // namespace quanergy
+
+#endif
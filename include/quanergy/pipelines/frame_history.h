@@ -0,0 +1,170 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file frame_history.h
+ *
+ *  \brief Recent frames of a pipeline output, shared by the algorithms using them and looked
+ *  up by seq or stamp.
+ */
+
+#ifndef QUANERGY_PIPELINES_FRAME_HISTORY_H
+#define QUANERGY_PIPELINES_FRAME_HISTORY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/point_cloud.h>
+
+namespace quanergy
+{
+  namespace pipeline
+  {
+    struct FrameHistorySettings
+    {
+      /// frames held; 0 for no limit
+      std::size_t max_frames = 10;
+      /// seconds of header.stamp before the newest frame that are held; 0 for no limit
+      double max_age = 0.;
+      /// approximate bytes of point data held; 0 for no limit. The newest frame is always held
+      std::size_t max_bytes = 0;
+    };
+
+    /** \brief FrameHistory holds the most recent clouds passed to slot, oldest first
+     *  \details frames are expected in stamp order, as the pipeline produces them. Lookups copy references
+     *           under a lock, so they are safe from any thread while slot is called.
+     *  \tparam Point is the point type of the clouds
+     */
+    template <class Point>
+    class FrameHistory
+    {
+    public:
+      using Cloud = pcl::PointCloud<Point>;
+      using FramePtr = boost::shared_ptr<const Cloud>;
+
+      explicit FrameHistory(const FrameHistorySettings& settings = FrameHistorySettings())
+        : settings_(settings)
+      {}
+
+      FrameHistory(const FrameHistory&) = delete;
+      FrameHistory& operator=(const FrameHistory&) = delete;
+
+      const FrameHistorySettings& getSettings() const { return settings_; }
+
+      /// add the newest frame and drop the oldest ones over the limits; called by the pipeline
+      void slot(const FramePtr& frame)
+      {
+        if (!frame)
+          return;
+
+        std::vector<FramePtr> evicted;
+        {
+          std::lock_guard<std::mutex> lk(mutex_);
+          frames_.push_back(frame);
+          bytes_ += frameBytes(*frame);
+
+          std::uint64_t max_age_us = static_cast<std::uint64_t>(settings_.max_age * 1e6);
+          while (frames_.size() > 1 &&
+                 ((settings_.max_frames > 0 && frames_.size() > settings_.max_frames) ||
+                  (settings_.max_bytes > 0 && bytes_ > settings_.max_bytes) ||
+                  (max_age_us > 0 && frames_.front()->header.stamp + max_age_us < frame->header.stamp)))
+          {
+            bytes_ -= frameBytes(*frames_.front());
+            evicted.push_back(std::move(frames_.front()));
+            frames_.pop_front();
+          }
+        }
+        // evicted frames no one else references are freed here, outside the lock
+      }
+
+      /// the frame with header.seq equal to seq; null if it isn't held
+      FramePtr findBySeq(std::uint32_t seq) const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        auto it = std::find_if(frames_.rbegin(), frames_.rend(),
+                               [seq](const FramePtr& frame){ return frame->header.seq == seq; });
+        return it == frames_.rend() ? FramePtr() : *it;
+      }
+
+      /// the frame with header.stamp (microseconds) closest to stamp; null when empty
+      FramePtr findByStamp(std::uint64_t stamp) const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (frames_.empty())
+          return FramePtr();
+
+        auto it = lowerBound(stamp);
+        if (it == frames_.end())
+          return frames_.back();
+
+        if (it != frames_.begin() && stamp - (*std::prev(it))->header.stamp < (*it)->header.stamp - stamp)
+          --it;
+
+        return *it;
+      }
+
+      /// frames with header.stamp (microseconds) from begin to end inclusive, oldest first
+      std::vector<FramePtr> getRange(std::uint64_t begin, std::uint64_t end) const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        std::vector<FramePtr> ret;
+        for (auto it = lowerBound(begin); it != frames_.end() && (*it)->header.stamp <= end; ++it)
+          ret.push_back(*it);
+        return ret;
+      }
+
+      /// all frames held, oldest first
+      std::vector<FramePtr> getFrames() const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return std::vector<FramePtr>(frames_.begin(), frames_.end());
+      }
+
+      std::size_t size() const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return frames_.size();
+      }
+
+      /// approximate bytes of point data held
+      std::size_t getBytes() const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return bytes_;
+      }
+
+    private:
+      static std::size_t frameBytes(const Cloud& frame)
+      {
+        return sizeof(Cloud) + frame.points.capacity() * sizeof(Point);
+      }
+
+      /// first frame stamped at or after stamp; lock must be held
+      typename std::deque<FramePtr>::const_iterator lowerBound(std::uint64_t stamp) const
+      {
+        return std::lower_bound(frames_.begin(), frames_.end(), stamp,
+                                [](const FramePtr& frame, std::uint64_t s){ return frame->header.stamp < s; });
+      }
+
+      FrameHistorySettings settings_;
+
+      mutable std::mutex mutex_;
+      std::deque<FramePtr> frames_;
+      std::size_t bytes_ = 0;
+    };
+
+  } // namespace pipeline
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,194 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file frame_source.h
+ *
+ *  \brief Frames from a pipeline held for the application to pull; on Linux, eventFd is
+ *  readable while frames are waiting.
+ */
+
+#ifndef QUANERGY_PIPELINES_FRAME_SOURCE_H
+#define QUANERGY_PIPELINES_FRAME_SOURCE_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include <quanergy/common/bounded_ring.h>
+#include <quanergy/pipelines/ring_async.h>
+
+namespace quanergy
+{
+  namespace pipeline
+  {
+    /** \brief FrameSource holds frames for the application to pull
+     *  \details slot may be called from one pipeline thread while another thread pulls. When the ring is
+     *           full the oldest frame is dropped by default; DropPolicy::BLOCK isn't supported because it
+     *           would stall the pipeline on the application.
+     */
+    template <class Type>
+    class FrameSource
+    {
+    public:
+      using ResultType = Type;
+
+      /** \brief constructor
+       *  \param capacity is the number of frames held
+       *  \param drop_policy says which frame is dropped when the ring is full; OLDEST or NEWEST
+       */
+      explicit FrameSource(std::size_t capacity = 2, DropPolicy drop_policy = DropPolicy::OLDEST)
+        : drop_policy_(drop_policy)
+        , ring_(capacity)
+      {
+        if (drop_policy_ == DropPolicy::BLOCK)
+          throw std::invalid_argument("FrameSource doesn't support DropPolicy::BLOCK");
+
+#ifdef __linux__
+        event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd_ < 0)
+          throw std::system_error(errno, std::system_category(), "Unable to create FrameSource eventfd");
+#endif
+      }
+
+      FrameSource(const FrameSource&) = delete;
+      FrameSource& operator=(const FrameSource&) = delete;
+
+      ~FrameSource()
+      {
+#ifdef __linux__
+        ::close(event_fd_);
+#endif
+      }
+
+      /** \brief file descriptor that is readable while frames are waiting; -1 where eventfd isn't available
+       *  \details only tryPop and waitFor read it; after it polls readable, call tryPop until it returns false
+       */
+      int eventFd() const { return event_fd_; }
+
+      /// take the oldest frame waiting; false if there is none. Doesn't block
+      bool tryPop(Type& frame)
+      {
+        if (ring_.pop(frame))
+          return true;
+
+        // nothing waiting; clear the event, then look again in case a frame arrived before it was cleared.
+        // a frame arriving after the second look signals the event again
+        clearEvent();
+        return ring_.pop(frame);
+      }
+
+      /** \brief take the oldest frame, waiting up to timeout for one to arrive
+       *  \returns false if no frame arrived in time
+       */
+      template <class Rep, class Period>
+      bool waitFor(Type& frame, const std::chrono::duration<Rep, Period>& timeout)
+      {
+        if (tryPop(frame))
+          return true;
+
+        // announce the wait, then check again; slot makes its push, then checks the count.
+        // the fences order each store before the following load, so one side sees the other
+        std::unique_lock<std::mutex> lk(wait_mutex_);
+        ++waiters_;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool popped = frame_conditional_.wait_for(lk, timeout, [this, &frame]{ return tryPop(frame); });
+        --waiters_;
+
+        return popped;
+      }
+
+      /// hand a frame to the source; called by the pipeline
+      void slot(const Type& frame)
+      {
+        received_.fetch_add(1, std::memory_order_relaxed);
+
+        while (!ring_.push(frame))
+        {
+          if (drop_policy_ == DropPolicy::NEWEST)
+          {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+          }
+
+          // the application may take it first, in which case there is room anyway
+          Type oldest;
+          if (ring_.pop(oldest))
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        signalEvent();
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_ > 0)
+        {
+          // taking the mutex means the waiter is either before its check or inside wait
+          { std::lock_guard<std::mutex> lk(wait_mutex_); }
+          frame_conditional_.notify_all();
+        }
+      }
+
+      // counters; safe to read from any thread
+
+      /// frames passed to slot
+      std::uint64_t getReceived() const { return received_; }
+      /// frames dropped because the ring was full
+      std::uint64_t getDropped() const { return dropped_; }
+      /// frames waiting to be pulled
+      std::size_t getQueueDepth() const { return ring_.size(); }
+      /// frames the source holds
+      std::size_t getCapacity() const { return ring_.capacity(); }
+
+    private:
+      void signalEvent()
+      {
+#ifdef __linux__
+        std::uint64_t one = 1;
+        // can only fail if the count would overflow, in which case it is readable anyway
+        ssize_t written = ::write(event_fd_, &one, sizeof(one));
+        (void)written;
+#endif
+      }
+
+      void clearEvent()
+      {
+#ifdef __linux__
+        std::uint64_t count;
+        // fails with EAGAIN when the count is already 0
+        ssize_t read = ::read(event_fd_, &count, sizeof(count));
+        (void)read;
+#endif
+      }
+
+      DropPolicy drop_policy_;
+      BoundedRing<Type> ring_;
+
+      int event_fd_ = -1;
+
+      // waiting in waitFor
+      std::mutex wait_mutex_;
+      std::condition_variable frame_conditional_;
+      std::atomic<int> waiters_ {0};
+
+      std::atomic<std::uint64_t> received_ {0};
+      std::atomic<std::uint64_t> dropped_ {0};
+    };
+
+  } // namespace pipeline
+
+} // namespace quanergy
+
+#endif
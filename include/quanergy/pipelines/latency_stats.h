@@ -0,0 +1,77 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file latency_stats.h
+ *
+ *  \brief Named latency histograms for the stages of a pipeline, with an
+ *  optional periodic report through the logger.
+ */
+
+#ifndef QUANERGY_PIPELINES_LATENCY_STATS_H
+#define QUANERGY_PIPELINES_LATENCY_STATS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <quanergy/common/latency_histogram.h>
+
+#include <quanergy/common/dll_export.h>
+
+namespace quanergy
+{
+  namespace pipeline
+  {
+    class DLLEXPORT LatencyStats
+    {
+    public:
+      LatencyStats() = default;
+      ~LatencyStats();
+
+      LatencyStats(const LatencyStats&) = delete;
+      LatencyStats& operator=(const LatencyStats&) = delete;
+
+      /** \brief histogram for a stage; created on first use
+       *  \details the reference stays valid for the lifetime of this object
+       */
+      LatencyHistogram& histogram(const std::string& stage);
+
+      /// summary of every stage by name
+      std::map<std::string, LatencySummary> snapshot() const;
+
+      /// clear all histograms
+      void reset();
+
+      /// one line per stage with count and quantiles in microseconds
+      std::string report() const;
+
+      /** \brief log the report every period at INFO level; zero stops reporting
+       *  \param reset_after_report starts every period with empty histograms
+       */
+      void setReportPeriod(std::chrono::milliseconds period, bool reset_after_report = false);
+
+    private:
+      void stopReporting();
+
+      mutable std::mutex histograms_mutex_;
+      std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms_;
+
+      std::thread report_thread_;
+      std::mutex report_mutex_;
+      std::condition_variable report_conditional_;
+      bool kill_ = false;
+    };
+
+  } // namespace pipeline
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,80 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file latest_frame.h
+ *
+ *  \brief Newest frame of a pipeline output and its sequence number, for readers polling at
+ *  their own rate.
+ */
+
+#ifndef QUANERGY_PIPELINES_LATEST_FRAME_H
+#define QUANERGY_PIPELINES_LATEST_FRAME_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace quanergy
+{
+  namespace pipeline
+  {
+    /** \brief LatestFrame holds the newest frame passed to slot
+     *  \details the lock is only held to copy the frame handle, so Type should be cheap to copy, like a shared_ptr
+     */
+    template <class Type>
+    class LatestFrame
+    {
+    public:
+      using ResultType = Type;
+
+      LatestFrame() = default;
+
+      LatestFrame(const LatestFrame&) = delete;
+      LatestFrame& operator=(const LatestFrame&) = delete;
+
+      /// replace the frame held; called by the pipeline
+      void slot(const Type& frame)
+      {
+        Type previous = frame;
+        {
+          std::lock_guard<std::mutex> lk(mutex_);
+          std::swap(frame_, previous);
+          sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        // the replaced frame is released here, outside the lock
+      }
+
+      /// the newest frame; default constructed (null) before the first
+      Type latest() const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return frame_;
+      }
+
+      /// the newest frame and its sequence number
+      Type latest(std::uint64_t& sequence) const
+      {
+        std::lock_guard<std::mutex> lk(mutex_);
+        sequence = sequence_.load(std::memory_order_relaxed);
+        return frame_;
+      }
+
+      /// frames passed to slot so far, which is the sequence number of the newest; 0 before the first
+      std::uint64_t sequence() const { return sequence_.load(std::memory_order_acquire); }
+
+    private:
+      mutable std::mutex mutex_;
+      Type frame_;
+      std::atomic<std::uint64_t> sequence_ {0};
+    };
+
+  } // namespace pipeline
+
+} // namespace quanergy
+
+#endif
@@ -0,0 +1,372 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file ring_async.h
+ *
+ *  \brief AsyncModule variant backed by a bounded lock-free ring.
+ *
+ *  Has the connect/slot interface of AsyncModule so it can stand in for it.
+ *  slot takes no lock and only wakes the signal thread when it is asleep.
+ *  The ring capacity, what happens when it is full, how the signal thread
+ *  waits for input and batch delivery are configurable; drops are counted
+ *  rather than logged.
+ */
+
+#ifndef QUANERGY_PIPELINES_RING_ASYNC_H
+#define QUANERGY_PIPELINES_RING_ASYNC_H
+
+#include <boost/signals2.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <quanergy/common/bounded_ring.h>
+#include <quanergy/common/latency_histogram.h>
+#include <quanergy/common/trace.h>
+
+namespace quanergy
+{
+  namespace pipeline
+  {
+    /// what slot does with input when the ring is full
+    enum struct DropPolicy
+    {
+      OLDEST,   ///< drop the oldest queued input to make room; like AsyncModule
+      NEWEST,   ///< drop the input being added
+      BLOCK     ///< wait for room; slows the caller down to the consumer
+    };
+
+    /// how a thread waits for the ring: the signal thread for input, or slot for room with DropPolicy::BLOCK
+    enum struct WaitStrategy
+    {
+      SLEEP,    ///< spin briefly then sleep until woken; no CPU while idle
+      YIELD,    ///< yield the CPU between checks; low latency, a busy core while idle
+      SPIN      ///< check continuously; lowest latency, a full core while idle
+    };
+
+    struct RingAsyncSettings
+    {
+      /// inputs the ring holds; 2 is enough when the consumer keeps up
+      std::size_t capacity = 2;
+      DropPolicy drop_policy = DropPolicy::OLDEST;
+      WaitStrategy wait_strategy = WaitStrategy::SLEEP;
+    };
+
+    /** \brief RingAsyncModule moves downstream processing to another thread through a lock-free ring
+     *  \details Subscribers of connect get each input. Subscribers of connectBatch get everything
+     *           that was pending when the signal thread woke in one vector, before the inputs are
+     *           signaled individually.
+     */
+    template <class Type>
+    struct RingAsyncModule
+    {
+      using ResultType = Type;
+
+      using Signal = boost::signals2::signal<void (const ResultType&)>;
+
+      using BatchType = std::vector<Type>;
+      using BatchSignal = boost::signals2::signal<void (const BatchType&)>;
+
+      RingAsyncModule(const RingAsyncSettings& settings)
+        : settings_(settings)
+        , ring_(settings.capacity)
+      {
+        batch_.reserve(settings.capacity);
+
+        // spin up new thread to handle inputs
+        signal_thread_.reset(new std::thread([this]
+                                             {
+                                               try
+                                               {
+                                                 processInputs();
+                                               }
+                                               catch (...)
+                                               {
+                                                 {
+                                                   std::lock_guard<std::mutex> lk(exception_mutex_);
+                                                   exception_ = std::current_exception();
+                                                   failed_ = true;
+                                                 }
+                                                 // nothing will make room anymore
+                                                 wake(room_waiters_, room_conditional_);
+                                               }
+                                             }));
+      }
+
+      /** \brief constructor with AsyncModule's signature
+       *  \param max_queue_size is the ring capacity; inputs beyond it drop the oldest
+       */
+      RingAsyncModule(std::size_t max_queue_size = 2)
+        : RingAsyncModule(RingAsyncSettings{max_queue_size, DropPolicy::OLDEST, WaitStrategy::SLEEP})
+      {}
+
+      ~RingAsyncModule()
+      {
+        kill_ = true;
+        wake(input_waiters_, input_conditional_);
+        wake(room_waiters_, room_conditional_);
+
+        if (signal_thread_ && signal_thread_->joinable())
+        {
+          signal_thread_->join();
+        }
+      }
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber)
+      {
+        return signal_.connect(subscriber);
+      }
+
+      boost::signals2::connection connectBatch(const typename BatchSignal::slot_type& subscriber)
+      {
+        return batch_signal_.connect(subscriber);
+      }
+
+      /** \brief record the time each input waits in the ring; null (the default) disables timing
+       *  \details must be called before inputs arrive
+       */
+      void setLatencyHistogram(LatencyHistogram* histogram)
+      {
+        latency_histogram_ = histogram;
+      }
+
+      /// name the signal thread in traces
+      void setTraceName(const std::string& name)
+      {
+        Tracer::instance().setThreadName(signal_thread_->get_id(), name);
+      }
+
+      const RingAsyncSettings& getSettings() const { return settings_; }
+
+      // counters; safe to read from any thread
+
+      /// inputs passed to slot
+      std::uint64_t getReceived() const { return received_; }
+      /// inputs signaled to subscribers; what the subscribers did for them is visible to the caller
+      std::uint64_t getDelivered() const { return delivered_.load(std::memory_order_acquire); }
+      /// inputs dropped because the ring was full
+      std::uint64_t getDropped() const { return dropped_; }
+      /// times the signal thread woke with input; with getDelivered, the mean batch size
+      std::uint64_t getBatches() const { return batches_; }
+      /// times slot waited for room with DropPolicy::BLOCK
+      std::uint64_t getBlocked() const { return blocked_; }
+      /// inputs waiting in the ring
+      std::size_t getQueueDepth() const { return ring_.size(); }
+
+      void slot(const Type& input)
+      {
+        // if an exception was caught, send it up the chain
+        rethrowFailure();
+
+        QUANERGY_TRACE_SCOPE("async_push");
+        Tracer& tracer = Tracer::instance();
+        std::uint64_t trace_id = tracer.enabled() ? tracer.newFlowId() : 0;
+        if (trace_id)
+          tracer.flowBegin("async_queue", trace_id);
+
+        received_.fetch_add(1, std::memory_order_relaxed);
+
+        Item item{input,
+                  latency_histogram_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point(),
+                  trace_id};
+
+        bool blocked = false;
+        while (!ring_.push(std::move(item)))
+        {
+          if (settings_.drop_policy == DropPolicy::NEWEST)
+          {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+          }
+
+          if (settings_.drop_policy == DropPolicy::OLDEST)
+          {
+            // the signal thread may take it first, in which case there is room anyway
+            Item oldest;
+            if (ring_.pop(oldest))
+              dropped_.fetch_add(1, std::memory_order_relaxed);
+          }
+          else
+          {
+            if (!blocked)
+              blocked_.fetch_add(1, std::memory_order_relaxed);
+            blocked = true;
+
+            wait(room_waiters_, room_conditional_,
+                 [this]{ return ring_.size() < ring_.capacity() || kill_ || failed_; });
+            if (kill_)
+              return;
+            rethrowFailure();
+          }
+        }
+
+        wake(input_waiters_, input_conditional_);
+      }
+
+      void processInputs()
+      {
+        for (;;)
+        {
+          wait(input_waiters_, input_conditional_, [this]{ return !ring_.empty() || kill_; });
+
+          if (kill_)
+            return;
+
+          // take everything pending so a batch is one wake up
+          items_.clear();
+          Item item;
+          while (items_.size() < settings_.capacity && ring_.pop(item))
+            items_.push_back(std::move(item));
+
+          if (items_.empty())
+            continue;
+
+          batches_.fetch_add(1, std::memory_order_relaxed);
+          if (settings_.drop_policy == DropPolicy::BLOCK)
+            wake(room_waiters_, room_conditional_);
+
+          if (latency_histogram_)
+          {
+            auto now = std::chrono::steady_clock::now();
+            for (const auto& i : items_)
+            {
+              if (i.enqueued != std::chrono::steady_clock::time_point())
+                latency_histogram_->record(now - i.enqueued);
+            }
+          }
+
+          QUANERGY_TRACE_SCOPE("async_signal");
+          for (const auto& i : items_)
+          {
+            if (i.trace_id)
+              Tracer::instance().flowEnd("async_queue", i.trace_id);
+          }
+
+          if (!batch_signal_.empty())
+          {
+            batch_.clear();
+            for (const auto& i : items_)
+              batch_.push_back(i.value);
+
+            batch_signal_(batch_);
+            batch_.clear();
+          }
+
+          for (const auto& i : items_)
+          {
+            signal_(i.value);
+            delivered_.fetch_add(1, std::memory_order_release);
+          }
+          items_.clear();
+        }
+      }
+
+    private:
+      /// queued input, when it was queued (only set when timing) and its trace flow id (0 when not tracing)
+      struct Item
+      {
+        Type value;
+        std::chrono::steady_clock::time_point enqueued;
+        std::uint64_t trace_id;
+      };
+
+      /// rethrow what the signal thread threw, if it did
+      void rethrowFailure()
+      {
+        if (failed_)
+        {
+          std::lock_guard<std::mutex> lk(exception_mutex_);
+          std::rethrow_exception(exception_);
+        }
+      }
+
+      /// spins before sleeping with WaitStrategy::SLEEP; about the cost of a wake up
+      static const int SLEEP_SPINS = 100;
+
+      /// wait until ready() with the configured strategy
+      template <class Predicate>
+      void wait(std::atomic<int>& waiters, std::condition_variable& conditional, Predicate ready)
+      {
+        int spins = 0;
+        while (!ready())
+        {
+          if (settings_.wait_strategy == WaitStrategy::SPIN)
+            continue;
+
+          if (settings_.wait_strategy == WaitStrategy::YIELD || spins < SLEEP_SPINS)
+          {
+            spins += spins < SLEEP_SPINS;
+            std::this_thread::yield();
+            continue;
+          }
+
+          // announce the sleep, then check again; wake() makes its change, then checks the flag.
+          // the fences order each store before the following load, so one side sees the other
+          std::unique_lock<std::mutex> lk(wait_mutex_);
+          ++waiters;
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          conditional.wait(lk, ready);
+          --waiters;
+        }
+      }
+
+      /// wake the threads sleeping in wait(); only touches the mutex if any are
+      void wake(std::atomic<int>& waiters, std::condition_variable& conditional)
+      {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters > 0)
+        {
+          // taking the mutex means the waiter is either before its check or inside wait
+          { std::lock_guard<std::mutex> lk(wait_mutex_); }
+          conditional.notify_all();
+        }
+      }
+
+      RingAsyncSettings settings_;
+      BoundedRing<Item> ring_;
+
+      /// new thread for signal
+      std::unique_ptr<std::thread> signal_thread_;
+      std::atomic_bool kill_ {false};
+
+      /// what the signal thread threw; failed_ is set once it is
+      std::mutex exception_mutex_;
+      std::exception_ptr exception_;
+      std::atomic_bool failed_ {false};
+
+      // sleeping with WaitStrategy::SLEEP; counted since several producers can wait for room
+      std::mutex wait_mutex_;
+      std::condition_variable input_conditional_;
+      std::condition_variable room_conditional_;
+      std::atomic<int> input_waiters_ {0};
+      std::atomic<int> room_waiters_ {0};
+
+      /// inputs being signaled; kept to reuse their allocation
+      std::vector<Item> items_;
+      BatchType batch_;
+
+      LatencyHistogram* latency_histogram_ = nullptr;
+
+      std::atomic<std::uint64_t> received_ {0};
+      std::atomic<std::uint64_t> delivered_ {0};
+      std::atomic<std::uint64_t> dropped_ {0};
+      std::atomic<std::uint64_t> batches_ {0};
+      std::atomic<std::uint64_t> blocked_ {0};
+
+      Signal signal_;
+      BatchSignal batch_signal_;
+    };
+
+  } // namespace pipeline
+
+} // namespace quanergy
+
+#endif
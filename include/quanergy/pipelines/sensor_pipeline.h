@@ -8,10 +8,13 @@
 #ifndef QUANERGY_CLIENT_SENSOR_PIPELINE_H
 #define QUANERGY_CLIENT_SENSOR_PIPELINE_H
 
+#include <functional>
+#include <future>
 #include <memory>
 
 // parsers for the data packets we want to support
 #include <quanergy/parsers/variadic_packet_parser.h>
+#include <quanergy/parsers/parallel_packet_parser.h>
 #include <quanergy/parsers/data_packet_parser_00.h>
 #include <quanergy/parsers/data_packet_parser_01.h>
 #include <quanergy/parsers/data_packet_parser_04.h>
@@ -20,19 +23,39 @@
 // filters
 #include <quanergy/modules/distance_filter.h>
 #include <quanergy/modules/ring_intensity_filter.h>
+#include <quanergy/modules/self_mask_filter.h>
+
+// learns the self mask from stationary data
+#include <quanergy/modules/self_mask_learner.h>
 
 // conversion module from polar to Cartesian
 #include <quanergy/modules/polar_to_cart_converter.h>
+// and from compact frames
+#include <quanergy/modules/frame_converter.h>
 
 // module to apply encoder correction
 #include <quanergy/modules/encoder_angle_calibration.h>
 
-// async module for multithreading
+// async modules for multithreading
 #include <quanergy/pipelines/async.h>
+#include <quanergy/pipelines/ring_async.h>
+#include <quanergy/pipelines/fan_out.h>
+#include <quanergy/pipelines/frame_history.h>
+#include <quanergy/pipelines/frame_source.h>
+#include <quanergy/pipelines/latest_frame.h>
+
+// per stage latency histograms
+#include <quanergy/pipelines/latency_stats.h>
+
+// metrics output
+#include <quanergy/common/metrics.h>
 
 // for setting file
 #include <quanergy/pipelines/sensor_pipeline_settings.h>
 
+// sensor description used to configure the pipeline
+#include <quanergy/client/device_info.h>
+
 #include <quanergy/common/dll_export.h>
 
 namespace quanergy
@@ -62,7 +85,26 @@ namespace quanergy
       };
 
       // the parser module type
-      using ParserModule = quanergy::client::PacketParserModule<Parser>;
+      using ParserModule = quanergy::client::ParallelPacketParserModule<Parser>;
+
+      // parser for settings.output compact or both; assembles FrameCompact straight from M-series packets
+      using CompactParser = quanergy::client::VariadicPacketParser<quanergy::FrameCompactPtr,       // return type
+                                                           quanergy::client::DataPacketParser00,    // COMPACT_PARSER_00_INDEX
+                                                           quanergy::client::DataPacketParser04,    // COMPACT_PARSER_04_INDEX
+                                                           quanergy::client::DataPacketParser06>;   // COMPACT_PARSER_06_INDEX
+
+      enum
+      {
+        COMPACT_PARSER_00_INDEX = 0,
+        COMPACT_PARSER_04_INDEX = 1,
+        COMPACT_PARSER_06_INDEX = 2
+      };
+
+      using CompactParserModule = quanergy::client::ParallelPacketParserModule<CompactParser>;
+
+      // latency histograms by stage (empty unless instrumentation is enabled); declared before
+      // the modules so it outlives them
+      LatencyStats latency_stats;
 
       // the parser module; converts raw packets to a polar PCL point cloud
       ParserModule parser;
@@ -72,49 +114,169 @@ namespace quanergy
       quanergy::client::DistanceFilter distance_filter;
       // ring intensity filter; allows filtering by a combination of range and intensity
       quanergy::client::RingIntensityFilter ring_intensity_filter;
+      // self mask filter; removes returns from the platform the sensor is mounted on (only connected if configured)
+      quanergy::client::SelfMaskFilter self_mask_filter;
+      // self mask learner; builds the self mask from stationary data (only connected if configured)
+      quanergy::client::SelfMaskLearner self_mask_learner;
+      // the learned mask being written to settings.self_mask_file off the frame path; destroying it waits for
+      // the write
+      std::future<void> self_mask_saved;
       // polar to cart converter; converts from the polar PCL cloud to a Cartesian one
       quanergy::client::PolarToCartConverter cartesian_converter;
-      // async modules to put the processing of the output cloud on a separate thread
-      using CloudAsyncType = quanergy::pipeline::AsyncModule<boost::shared_ptr<pcl::PointCloud<quanergy::PointXYZIR>>>;
+      // compact parser; only fed packets with settings.output compact or both. The distance and ring intensity
+      // filters run on its frames in place when it is the only output
+      CompactParserModule compact_parser;
+      // decodes compact frames to Cartesian clouds for the cloud outputs when compact is the only output
+      quanergy::client::CompactToCartConverter compact_converter;
+      // async module to put the processing of the compact frames on a separate thread
+      using CompactAsyncType = quanergy::pipeline::RingAsyncModule<quanergy::FrameCompactConstPtr>;
+      CompactAsyncType compact_async;
+      // hands the clouds from cloud_async to the connect_cloud subscribers; each gets its own queue when
+      // settings.cloud_subscriber_threads > 0, otherwise they run in turn on the cloud_async thread.
+      // declared before cloud_async so it outlives the thread calling it
+      using CloudFanOutType = quanergy::pipeline::FanOutModule<quanergy::PointCloudXYZIRConstPtr>;
+      CloudFanOutType cloud_fan_out;
+      // Cartesian clouds to pull with tryPop or waitFor, or when its eventFd is readable; fed on the pipeline
+      // thread without going through cloud_async. null unless settings.cloud_source_capacity > 0
+      using CloudSourceType = quanergy::pipeline::FrameSource<quanergy::PointCloudXYZIRConstPtr>;
+      std::unique_ptr<CloudSourceType> cloud_source;
+      // newest Cartesian cloud and polar scan with their sequence numbers, for readers polling at their own rate;
+      // updated on the pipeline thread
+      using LatestCloudType = quanergy::pipeline::LatestFrame<quanergy::PointCloudXYZIRConstPtr>;
+      LatestCloudType latest_cloud;
+      using LatestScanType = quanergy::pipeline::LatestFrame<quanergy::PointCloudHVDIRConstPtr>;
+      LatestScanType latest_scan;
+      // recent Cartesian clouds by seq or stamp, shared by multi-frame algorithms instead of each keeping copies;
+      // updated on the pipeline thread. null unless a settings.history_* limit is set
+      using CloudHistoryType = quanergy::pipeline::FrameHistory<quanergy::PointXYZIR>;
+      std::unique_ptr<CloudHistoryType> cloud_history;
+      // async modules to put the processing of the output cloud on a separate thread; each holds 2 clouds
+      // and drops the oldest when full
+      using CloudAsyncType = quanergy::pipeline::RingAsyncModule<quanergy::PointCloudXYZIRConstPtr>;
       CloudAsyncType cloud_async;
 
-      using ScanAsyncType = quanergy::pipeline::AsyncModule<boost::shared_ptr<pcl::PointCloud<quanergy::PointHVDIR>>>;
+      using ScanAsyncType = quanergy::pipeline::RingAsyncModule<quanergy::PointCloudHVDIRConstPtr>;
       ScanAsyncType scan_async;
 
+      // async boundaries between stages from the async entries in the stage list; declared after the
+      // modules so their threads stop before the modules they call go away
+      std::vector<std::unique_ptr<ScanAsyncType>> stage_asyncs;
+
+      // the stages connected, in order; settings.stages or defaultStages less any that don't apply to the sensor
+      std::vector<std::string> stages;
 
       // vector to hold connections for better cleanup
       std::vector<boost::signals2::connection> connections;
 
+      // with settings.shed_frames, optionally reports packets backing up before the pipeline so whole frames are
+      // skipped while it catches up, e.g. the queue depth of a TCPClient set to block when full; called once per
+      // frame on the parser thread. Set before packets arrive
+      std::function<bool ()> packet_backlog;
+
+      // which parsers are fed packets, from settings.output
+      bool parse_cloud = true;
+      bool parse_compact = false;
+
+      // clouds and points out of the parser, or compact frames when compact is the only output; updated on the
+      // parser thread, safe to read from any thread
+      std::atomic<std::uint64_t> frame_count {0};
+      // frames skipped after the parser with settings.shed_frames
+      std::atomic<std::uint64_t> frames_shed {0};
+      std::atomic<std::uint64_t> point_count {0};
+      std::atomic<std::uint64_t> last_frame_size {0};
+
+      // whether frames are shed and whether the current one is; the latter only used on the parser thread
+      // and the compact parser thread
+      bool shed_frames = false;
+      bool shedding = false;
+      bool compact_shedding = false;
+
+      // Chrome trace written on destruction when not empty, and the seconds up to then it covers (0 for all)
+      std::string trace_file;
+      double trace_window = 0.;
+
       /** \brief constructor configures the pipeline based on the provided settings
        *  \param settings is the settings to use
        */
       SensorPipeline(const SensorPipelineSettings& settings);
 
-      /// \brief destructor
+      /** \brief constructor using device info already retrieved instead of querying settings.host
+       *  \param settings is the settings to use
+       *  \param device_info describes the sensor; useful for recorded or synthetic data
+       */
+      SensorPipeline(const SensorPipelineSettings& settings, const quanergy::client::DeviceInfo& device_info);
+
+      /// \brief destructor; writes the trace if tracing
       virtual ~SensorPipeline();
 
-      /** \brief slot simply calls the parser slot
+      /** \brief the stages used when settings.stages is empty
+       *  \details M-series sensors get encoder_corrector, self_mask when a mask file is set, distance_filter,
+       *           ring_intensity_filter and cartesian_converter; other sensors get distance_filter and
+       *           cartesian_converter. Filters whose settings can't remove a point are left out
+       */
+      static std::vector<std::string> defaultStages(const SensorPipelineSettings& settings, bool m_series);
+
+      /** \brief record per cloud stage times and async queue waits in latency_stats
+       *  \details stages are named parser, compact_parser, encoder_corrector, self_mask_filter, distance_filter,
+       *           ring_intensity_filter, cartesian_converter, cloud_async_wait, scan_async_wait,
+       *           compact_async_wait and stage_async_N_wait for each async in the stage list.
+       *           Disabled, each stage only checks a null pointer. Call before packets arrive
+       */
+      void setLatencyInstrumentation(bool enable);
+
+      /** \brief whether consumers are behind: an async queue the frames go through, a cloud subscriber's queue
+       *         or cloud_source is full, or packet_backlog reports packets backing up
+       *  \details with settings.shed_frames, frames out of the parser are skipped while this is true, so a
+       *           cloud_source should be pulled from whenever it has clouds
+       */
+      bool congested() const;
+
+      /** \brief add frame counts, drops, queue depths, sensor status and stage latencies to a metrics scrape
+       *  \param labels are added to every sample; typically identifies the sensor
+       */
+      void writeMetrics(MetricsWriter& writer, const MetricLabels& labels = MetricLabels()) const;
+
+      /** \brief slot calls the slot of each parser in use
        *  \param the raw packet data
        */
       void slot(const std::shared_ptr<std::vector<char>>& packet)
       {
-        parser.slot(packet);
+        if (parse_cloud)
+          parser.slot(packet);
+        if (parse_compact)
+          compact_parser.slot(packet);
       }
 
-      /** \brief connect is just a convenience calling the polar to cart converters connect method
+      /** \brief connect a subscriber to the Cartesian clouds
        *  \param subscriber is the slot to call; it is a function consuming
-       *         const boost::shared_ptr<pcl::PointCloud<quanergy::PointXYZIR>>&
+       *         const quanergy::PointCloudXYZIRConstPtr&
+       *  \param settings are the subscriber's queue size and drop policy; only used with cloud subscriber threads
        *  \returns connection object created
        */
       boost::signals2::connection connect_cloud(
-          const typename CloudAsyncType::Signal::slot_type& subscriber)
+          const typename CloudFanOutType::Signal::slot_type& subscriber,
+          const FanOutSubscriberSettings& settings = FanOutSubscriberSettings())
       {
-        return cloud_async.connect(subscriber);
+        return cloud_fan_out.connect(subscriber, settings);
       }
 
-      /** \brief connect is just a convenience calling the ring intensity filter's connect method
+      /** \brief connect work on the Cartesian clouds that may run on several cloud subscriber threads at once
+       *         and a sink that gets its results in cloud order
+       *  \details see FanOutModule::connectOrdered
+       */
+      template <class Result>
+      boost::signals2::connection connect_cloud_ordered(
+          std::function<Result (const CloudFanOutType::ResultType&)> work,
+          const typename boost::signals2::signal<void (const Result&)>::slot_type& sink,
+          const FanOutSubscriberSettings& settings = FanOutSubscriberSettings())
+      {
+        return cloud_fan_out.template connectOrdered<Result>(std::move(work), sink, settings);
+      }
+
+      /** \brief connect is just a convenience calling scan_async's connect method; scan_async is fed the polar
+       *         clouds out of the last polar stage in the stage list
        *  \param subscriber is the slot to call; it is a function consuming
-       *         const boost::shared_ptr<pcl::PointCloud<quanergy::PointHVDIR>>&
+       *         const quanergy::PointCloudHVDIRConstPtr&
        *  \returns connection object created
        */
       boost::signals2::connection connect_scan(
@@ -122,6 +284,17 @@ namespace quanergy
       {
         return scan_async.connect(subscriber);
       }
+
+      /** \brief connect a subscriber to the compact frames; only called with settings.output compact or both
+       *  \param subscriber is the slot to call; it is a function consuming
+       *         const quanergy::FrameCompactConstPtr&
+       *  \returns connection object created
+       */
+      boost::signals2::connection connect_compact(
+          const typename CompactAsyncType::Signal::slot_type& subscriber)
+      {
+        return compact_async.connect(subscriber);
+      }
     };
   }
 }
@@ -10,6 +10,9 @@
 
 #include <quanergy/parsers/data_packet_parser_m_series.h>
 
+#include <string>
+#include <vector>
+
 // for setting file
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
@@ -58,12 +61,90 @@ namespace quanergy
       std::int32_t min_cloud_size = 0;
       std::int32_t max_cloud_size = quanergy::client::MAX_CLOUD_SIZE;
 
+      // azimuth window in encoder positions; firings outside are skipped by the parser
+      // wraps through 0 when min > max; defaults cover the full revolution
+      // only relevant for M-series
+      std::int32_t azimuth_window_min = 0;
+      std::int32_t azimuth_window_max = quanergy::client::M_SERIES_NUM_ROT_ANGLES - 1;
+
+      // parse-time decimation; reduces the work of every stage downstream of the parser
+      // only relevant for M-series
+      // parse only every Nth firing
+      int firing_stride = 1;
+      // bit per ring to parse (bit 0 is ring 0); organized clouds get one row per ring; 8 laser sensors only
+      int ring_mask = (1 << quanergy::client::M_SERIES_NUM_LASERS) - 1;
+      // bit per return to keep when return selection is all
+      int return_mask = (1 << quanergy::client::M_SERIES_NUM_RETURNS) - 1;
+
+      // threads used to decode packets; clouds are still assembled in packet order
+      // 0 parses on the packet thread
+      std::uint16_t decode_threads = 0;
+
+      // threads running connect_cloud subscribers, each with its own queue so a slow one only drops its own clouds
+      // 0 runs them one after another on the cloud_async thread
+      std::uint16_t cloud_subscriber_threads = 0;
+
+      // Cartesian clouds held in SensorPipeline::cloud_source for the application to pull, e.g. from an epoll loop;
+      // the oldest is dropped when full. 0 doesn't create the source
+      std::uint16_t cloud_source_capacity = 0;
+
+      // recent Cartesian clouds held in SensorPipeline::cloud_history, shared by multi-frame algorithms;
+      // frames, seconds of stamps and approximate bytes held, 0 for no limit. All 0 doesn't create the history
+      std::uint32_t history_frames = 0;
+      double history_seconds = 0.;
+      std::uint64_t history_max_bytes = 0;
+
+      // skip whole frames right after the parser while consumers are behind (an async queue is full) or
+      // SensorPipeline::packet_backlog reports packets backing up, instead of losing them further along; the
+      // client feeding the pipeline should then block rather than drop (TCPClient::setBlockWhenFull)
+      bool shed_frames = false;
+
+      // drop bad packets and count them by reason instead of throwing
+      bool continue_on_packet_error = false;
+
+      // record per stage latency histograms in SensorPipeline::latency_stats
+      bool latency_instrumentation = false;
+      // seconds between latency reports in the log; 0 doesn't report
+      double latency_report_period = 0.;
+
+      // local port serving metrics in Prometheus text format; 0 doesn't serve
+      // the application creates the server; see apps/dynamic_connection.cpp
+      std::uint16_t metrics_port = 0;
+
+      // Chrome trace JSON written when the pipeline is destroyed; empty doesn't trace
+      std::string trace_file;
+      // seconds of activity, up to the end, to write to the trace; 0 writes all that is retained
+      double trace_window = 0.;
+
+      // polar stages run on each cloud, in order, between the parser and the Cartesian conversion
+      // names: encoder_corrector, self_mask, distance_filter, ring_intensity_filter and cartesian_converter,
+      //   which must be last and can be left out when only connect_scan is used;
+      //   async runs the stages after it on another thread
+      // empty uses defaultStages: the M-series chain without filters whose settings can't remove anything
+      std::vector<std::string> stages;
+
+      // frames the pipeline assembles from the packets: cloud (PCL HVDIR clouds through the stages above),
+      // compact (FrameCompact for connect_compact, decoded straight from the packets) or both
+      // compact is M-series only; on its own, distance_filter and ring_intensity_filter are applied to the
+      //   compact frames and cartesian_converter decodes them for connect_cloud, while the other stages are skipped
+      std::string output = "cloud";
+
       // Ring filter; generally this is not needed
       // Only can be configured in settings file
       // only relevant for M-series
       float ring_range[quanergy::client::M_SERIES_NUM_LASERS] = {0.f};
       std::uint16_t ring_intensity[quanergy::client::M_SERIES_NUM_LASERS] = {0};
 
+      // Self mask; removes returns from the platform the sensor is mounted on
+      // only relevant for M-series
+      // file to load the mask from; empty disables the mask
+      std::string self_mask_file;
+      // when > 0, learn the mask over this many frames (platform must be stationary)
+      // and write it to self_mask_file instead of loading it
+      std::uint16_t self_mask_learn_frames = 0;
+      // returns farther than this (meters) are never considered part of the platform when learning
+      float self_mask_max_range = 1.0f;
+
       /** \brief load settings from SettingsFileLoader
        *  \param settings SettingsFileLoader to load from
        */
@@ -0,0 +1,253 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file static_pipeline.h
+ *
+ *  \brief Parser and per point stages composed at compile time and applied in a single pass
+ *  over each parsed cloud.
+ */
+
+#ifndef QUANERGY_PIPELINES_STATIC_PIPELINE_H
+#define QUANERGY_PIPELINES_STATIC_PIPELINE_H
+
+#include <cmath>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/point_cloud.h>
+
+#include <quanergy/common/callback_chain.h>
+#include <quanergy/common/latency_histogram.h>
+#include <quanergy/common/point_hvdir.h>
+#include <quanergy/common/point_xyzir.h>
+#include <quanergy/common/trace.h>
+
+#include <quanergy/modules/distance_filter.h>
+#include <quanergy/modules/ring_intensity_filter.h>
+#include <quanergy/modules/polar_to_cart_converter.h>
+#include <quanergy/modules/encoder_angle_calibration.h>
+
+namespace quanergy
+{
+  namespace pipeline
+  {
+    /** \brief how StaticPipeline applies a stage to one point
+     *  \details calls the stage by default; specialize for types with a differently named per point function
+     */
+    template <class Stage>
+    struct PointStage
+    {
+      template <class Point>
+      static auto apply(const Stage& stage, const Point& point) -> decltype(stage(point))
+      {
+        return stage(point);
+      }
+    };
+
+    template <>
+    struct PointStage<client::DistanceFilter>
+    {
+      static PointHVDIR apply(const client::DistanceFilter& stage, const PointHVDIR& point)
+      {
+        return stage.filterByDistance(point);
+      }
+    };
+
+    template <>
+    struct PointStage<client::RingIntensityFilter>
+    {
+      static PointHVDIR apply(const client::RingIntensityFilter& stage, const PointHVDIR& point)
+      {
+        return stage.filterGhosts(point);
+      }
+    };
+
+    template <>
+    struct PointStage<client::PolarToCartConverter>
+    {
+      static PointXYZIR apply(const client::PolarToCartConverter&, const PointHVDIR& point)
+      {
+        return client::PolarToCartConverter::polarToCart(point);
+      }
+    };
+
+    /// applies the parameters given to setParams; the automatic calibration needs the module's slot
+    template <>
+    struct PointStage<calibration::EncoderAngleCalibration>
+    {
+      static PointHVDIR apply(const calibration::EncoderAngleCalibration& stage, const PointHVDIR& point)
+      {
+        PointHVDIR corrected = point;
+        corrected.h = stage.correctAngle(point.h);
+        return corrected;
+      }
+    };
+
+    /// point type after applying Stages in order to Point
+    template <class Point, class... Stages>
+    struct StageOutput
+    {
+      using type = Point;
+    };
+
+    template <class Point, class Stage, class... Rest>
+    struct StageOutput<Point, Stage, Rest...>
+    {
+      using type = typename StageOutput<
+        typename std::decay<decltype(PointStage<Stage>::apply(std::declval<const Stage&>(),
+                                                              std::declval<const Point&>()))>::type,
+        Rest...>::type;
+    };
+
+    /// false for points a stage has dropped; they stay in the cloud so organized clouds keep their shape
+    inline bool isValidPoint(const PointHVDIR& point) { return !std::isnan(point.d); }
+    inline bool isValidPoint(const PointXYZIR& point)
+    {
+      return !std::isnan(point.x) && !std::isnan(point.y) && !std::isnan(point.z);
+    }
+
+    /** \brief packets in, clouds of the last stage's point type out
+     *  \tparam Parser is a packet parser such as DataPacketParser04 or SensorPipeline::Parser
+     *  \tparam Stages are applied to each point in order: modules with a per point function PointStage knows,
+     *          or types with a const call operator taking the previous stage's point
+     */
+    template <class Parser, class... Stages>
+    class StaticPipeline
+    {
+    public:
+      using ParserResultType = typename Parser::ResultType;
+      using InputPoint = typename ParserResultType::element_type::PointType;
+      using OutputPoint = typename StageOutput<InputPoint, Stages...>::type;
+      using Cloud = pcl::PointCloud<OutputPoint>;
+      /// clouds are published const so subscribers can share them
+      using ResultType = boost::shared_ptr<const Cloud>;
+
+      using Signal = typename CallbackChain<ResultType>::Signal;
+      using Callback = typename CallbackChain<ResultType>::Callback;
+
+      /// default constructs the parser and stages; configure them through parser() and get()
+      StaticPipeline() = default;
+
+      /// constructs the stages from arguments; for stages that aren't default constructible, like lambdas
+      template <class... Args>
+      explicit StaticPipeline(Args&&... stages)
+        : stages_(std::forward<Args>(stages)...)
+      {}
+
+      StaticPipeline(const StaticPipeline&) = delete;
+      StaticPipeline& operator=(const StaticPipeline&) = delete;
+
+      Parser& parser() { return parser_; }
+      const Parser& parser() const { return parser_; }
+
+      /// stage I, for configuration; not thread safe with slot
+      template <std::size_t I>
+      typename std::tuple_element<I, std::tuple<Stages...>>::type& get()
+      {
+        return std::get<I>(stages_);
+      }
+
+      template <std::size_t I>
+      const typename std::tuple_element<I, std::tuple<Stages...>>::type& get() const
+      {
+        return std::get<I>(stages_);
+      }
+
+      boost::signals2::connection connect(const typename Signal::slot_type& subscriber)
+      {
+        return signal_.connect(subscriber);
+      }
+
+      /// add a callback called without locking; only before data flows, and it can't be disconnected
+      void connectCallback(Callback callback)
+      {
+        signal_.add(std::move(callback));
+      }
+
+      /// record the time spent running the stages on each cloud; null (the default) disables timing
+      void setLatencyHistogram(LatencyHistogram* histogram) { latency_histogram_ = histogram; }
+
+      /// parse a packet and, when it completes a cloud, run the stages on it
+      void slot(const std::shared_ptr<std::vector<char>>& packet)
+      {
+        // don't do the work unless someone is listening
+        if (signal_.empty())
+          return;
+
+        if (parser_.validateParse(*packet, parsed_) && parsed_)
+          signal_(process(*parsed_));
+      }
+
+      /// run the stages on a cloud from elsewhere, e.g. a SensorPipeline parser
+      ResultType process(const pcl::PointCloud<InputPoint>& cloud) const
+      {
+        QUANERGY_TRACE_SCOPE("static_pipeline");
+        StageTimer timer(latency_histogram_);
+
+        boost::shared_ptr<Cloud> result_ptr(new Cloud());
+        Cloud& result = *result_ptr;
+
+        result.header = cloud.header;
+        result.points.reserve(cloud.size());
+
+        bool is_dense = cloud.is_dense;
+        for (const auto& point : cloud.points)
+        {
+          result.points.push_back(apply(point));
+          is_dense = is_dense && isValidPoint(result.points.back());
+        }
+
+        result.width = cloud.width;
+        result.height = cloud.height;
+        result.is_dense = is_dense;
+
+        return result_ptr;
+      }
+
+      /// run the stages on one point
+      OutputPoint apply(const InputPoint& point) const
+      {
+        return applyStages<0>(point, std::integral_constant<bool, sizeof...(Stages) == 0>());
+      }
+
+    private:
+      /// stage I on point, then the rest; unrolled at compile time
+      template <std::size_t I, class Point>
+      auto applyStages(const Point& point, std::false_type /*done*/) const
+      {
+        using Stage = typename std::tuple_element<I, std::tuple<Stages...>>::type;
+        return applyStages<I + 1>(PointStage<Stage>::apply(std::get<I>(stages_), point),
+                                  std::integral_constant<bool, I + 1 == sizeof...(Stages)>());
+      }
+
+      template <std::size_t I, class Point>
+      Point applyStages(const Point& point, std::true_type /*done*/) const
+      {
+        return point;
+      }
+
+      Parser parser_;
+      std::tuple<Stages...> stages_;
+
+      /// parser output; the parser points it at each cloud it completes
+      ParserResultType parsed_;
+
+      LatencyHistogram* latency_histogram_ = nullptr;
+
+      CallbackChain<ResultType> signal_;
+    };
+
+  } // namespace pipeline
+
+} // namespace quanergy
+
+#endif
@@ -11,7 +11,7 @@
 #include <quanergy/client/http_client.h>
 
 // to output some status
-#include <iostream>
+#include <quanergy/common/logger.h>
 
 // for parsing device info
 #include <boost/property_tree/ptree.hpp>
@@ -25,10 +25,21 @@ DeviceInfo::DeviceInfo(const std::string& host)
   std::stringstream device_info_stream;
 
   // get deviceInfo from sensor for calibration
-  std::cout << "Attempting to get device info from " << host << std::endl;
+  QUANERGY_LOG(INFO, "Attempting to get device info from " << host);
   http_client.read(device_info_path_, device_info_stream);
+
+  load(device_info_stream);
+} // constructor
+
+DeviceInfo::DeviceInfo(std::istream& device_info_xml)
+{
+  load(device_info_xml);
+} // constructor
+
+void DeviceInfo::load(std::istream& device_info_xml)
+{
   boost::property_tree::ptree device_info_tree;
-  boost::property_tree::read_xml(device_info_stream, device_info_tree);
+  boost::property_tree::read_xml(device_info_xml, device_info_tree);
 
   // get model
   model_ = device_info_tree.get<std::string>("DeviceInfo.model");
@@ -64,7 +75,7 @@ DeviceInfo::DeviceInfo(const std::string& host)
 
   } // if cal data
 
-} // constructor
+} // load
 
 
 
@@ -0,0 +1,158 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/client/metrics_server.h>
+
+#include <quanergy/common/logger.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+    /// one scrape; read the request head, write the metrics and close
+    struct MetricsServer::Session : public std::enable_shared_from_this<MetricsServer::Session>
+    {
+      Session(boost::asio::io_service& io_service, MetricsServer& server)
+        : socket(io_service)
+        , request(MAX_REQUEST_SIZE)
+        , server(server)
+      {
+      }
+
+      void start()
+      {
+        auto self = shared_from_this();
+        boost::asio::async_read_until(socket, request, "\r\n\r\n",
+                                      [self](const boost::system::error_code& error, std::size_t)
+                                      {
+                                        if (!error)
+                                          self->respond();
+                                      });
+      }
+
+      void respond()
+      {
+        std::string body;
+        const char* status = "200 OK";
+        try
+        {
+          body = server.scrape();
+        }
+        catch (std::exception& e)
+        {
+          QUANERGY_LOG_THROTTLED(ERR, "Metrics collection failed: " << e.what());
+          status = "500 Internal Server Error";
+        }
+
+        response = std::string("HTTP/1.0 ") + status + "\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                   "Connection: close\r\n\r\n" + body;
+
+        auto self = shared_from_this();
+        boost::asio::async_write(socket, boost::asio::buffer(response),
+                                 [self](const boost::system::error_code&, std::size_t)
+                                 {
+                                   boost::system::error_code ignored;
+                                   self->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+                                 });
+      }
+
+      /// scrapes are GET requests with a handful of headers
+      static const std::size_t MAX_REQUEST_SIZE = 8192;
+
+      boost::asio::ip::tcp::socket socket;
+      boost::asio::streambuf request;
+      std::string response;
+      MetricsServer& server;
+    };
+
+    MetricsServer::MetricsServer(unsigned short port, const std::string& address)
+      : acceptor_(io_service_,
+                  boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(address), port))
+    {
+    }
+
+    MetricsServer::~MetricsServer()
+    {
+      stop();
+    }
+
+    void MetricsServer::addCollector(Collector collector)
+    {
+      std::lock_guard<std::mutex> lk(collectors_mutex_);
+      collectors_.push_back(std::move(collector));
+    }
+
+    void MetricsServer::start()
+    {
+      if (thread_.joinable())
+        return;
+
+      io_service_.reset();
+      work_.reset(new boost::asio::io_service::work(io_service_));
+      startAccept();
+
+      thread_ = std::thread([this]
+                            {
+                              try
+                              {
+                                io_service_.run();
+                              }
+                              catch (std::exception& e)
+                              {
+                                QUANERGY_LOG(ERR, "Metrics server stopped: " << e.what());
+                              }
+                            });
+
+      QUANERGY_LOG(INFO, "Serving metrics on " << acceptor_.local_endpoint());
+    }
+
+    void MetricsServer::stop()
+    {
+      work_.reset();
+      io_service_.stop();
+
+      if (thread_.joinable())
+        thread_.join();
+    }
+
+    unsigned short MetricsServer::getPort() const
+    {
+      return acceptor_.local_endpoint().port();
+    }
+
+    std::string MetricsServer::scrape()
+    {
+      MetricsWriter writer;
+      {
+        std::lock_guard<std::mutex> lk(collectors_mutex_);
+        for (auto& collector : collectors_)
+          collector(writer);
+      }
+      return writer.str();
+    }
+
+    void MetricsServer::startAccept()
+    {
+      auto session = std::make_shared<Session>(io_service_, *this);
+      acceptor_.async_accept(session->socket,
+                             [this, session](const boost::system::error_code& error)
+                             {
+                               if (!acceptor_.is_open())
+                                 return;
+
+                               if (!error)
+                                 session->start();
+
+                               startAccept();
+                             });
+    }
+
+  } // namespace client
+
+} // namespace quanergy
@@ -0,0 +1,132 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/frame_compact.h>
+
+#include <stdexcept>
+
+namespace quanergy
+{
+
+  constexpr float FrameCompact::RADIUS_SCALE;
+  constexpr std::uint32_t FrameCompact::AZIMUTH_STEPS;
+
+  PointHVDIR FrameCompact::at(std::size_t i) const
+  {
+    const PointCompact& from = points.at(i);
+
+    PointHVDIR to;
+    to.h = azimuthToAngle(from.azimuth);
+    to.v = vertical_angles[from.ring % client::M_SERIES_NUM_LASERS];
+    to.d = radiusToRange(from.radius);
+    to.intensity = from.intensity;
+    to.ring = from.ring;
+    return to;
+  }
+
+  void toFrame(const PointCloudHVDIR& cloud, FrameCompact& frame)
+  {
+    frame.stamp = cloud.header.stamp;
+    frame.seq = cloud.header.seq;
+    frame.frame_id = cloud.header.frame_id;
+
+    frame.points.resize(cloud.size());
+
+    for (std::size_t i = 0; i < cloud.size(); ++i)
+    {
+      const PointHVDIR& from = cloud.points[i];
+      PointCompact& to = frame.points[i];
+
+      if (from.ring >= client::M_SERIES_NUM_LASERS)
+      {
+        throw std::invalid_argument("FrameCompact only supports M-series ring numbers");
+      }
+
+      to.radius = FrameCompact::rangeToRadius(from.d);
+      to.azimuth = FrameCompact::angleToAzimuth(from.h);
+      to.intensity = static_cast<std::uint8_t>(std::min(255.f, std::max(0.f, std::round(from.intensity))));
+      to.ring = static_cast<std::uint8_t>(from.ring);
+
+      // vertical angle is constant per ring for M-series
+      frame.vertical_angles[from.ring] = from.v;
+    }
+
+    frame.width = cloud.width;
+    frame.height = cloud.height;
+    frame.is_dense = cloud.is_dense;
+  }
+
+  void toPointCloud(const FrameCompact& frame, PointCloudHVDIR& cloud)
+  {
+    cloud.header.stamp = frame.stamp;
+    cloud.header.seq = frame.seq;
+    cloud.header.frame_id = frame.frame_id;
+
+    cloud.resize(frame.size());
+
+    for (std::size_t i = 0; i < frame.size(); ++i)
+    {
+      cloud.points[i] = frame.at(i);
+    }
+
+    cloud.width = frame.width;
+    cloud.height = frame.height;
+    cloud.is_dense = frame.is_dense;
+  }
+
+  void toPointCloud(const FrameCompact& frame, PointCloudXYZIR& cloud)
+  {
+    cloud.header.stamp = frame.stamp;
+    cloud.header.seq = frame.seq;
+    cloud.header.frame_id = frame.frame_id;
+
+    cloud.resize(frame.size());
+
+    // vertical trig only depends on the ring
+    double cos_v[client::M_SERIES_NUM_LASERS];
+    double sin_v[client::M_SERIES_NUM_LASERS];
+    for (int ring = 0; ring < client::M_SERIES_NUM_LASERS; ++ring)
+    {
+      cos_v[ring] = std::cos(frame.vertical_angles[ring]);
+      sin_v[ring] = std::sin(frame.vertical_angles[ring]);
+    }
+
+    bool is_dense = frame.is_dense;
+
+    for (std::size_t i = 0; i < frame.size(); ++i)
+    {
+      const PointCompact& from = frame.points[i];
+      PointXYZIR& to = cloud.points[i];
+
+      to.intensity = from.intensity;
+      to.ring = from.ring;
+
+      if (from.radius == 0)
+      {
+        to.x = to.y = to.z = std::numeric_limits<float>::quiet_NaN();
+        is_dense = false;
+        continue;
+      }
+
+      const int ring = from.ring % client::M_SERIES_NUM_LASERS;
+      const double d = FrameCompact::radiusToRange(from.radius);
+      const double h = FrameCompact::azimuthToAngle(from.azimuth);
+
+      // get the distance to the XY plane
+      const double xy_distance = d * cos_v[ring];
+
+      to.x = static_cast<float>(xy_distance * std::cos(h));
+      to.y = static_cast<float>(xy_distance * std::sin(h));
+      to.z = static_cast<float>(d * sin_v[ring]);
+    }
+
+    cloud.width = frame.width;
+    cloud.height = frame.height;
+    cloud.is_dense = is_dense;
+  }
+
+} // namespace quanergy
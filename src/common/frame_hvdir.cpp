@@ -0,0 +1,126 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/frame_hvdir.h>
+
+namespace quanergy
+{
+
+  void FrameHVDIR::clear()
+  {
+    h.clear();
+    v.clear();
+    d.clear();
+    intensity.clear();
+    ring.clear();
+    time.clear();
+
+    width = 0;
+    height = 0;
+    is_dense = true;
+  }
+
+  void FrameHVDIR::reserve(std::size_t n)
+  {
+    h.reserve(n);
+    v.reserve(n);
+    d.reserve(n);
+    intensity.reserve(n);
+    ring.reserve(n);
+  }
+
+  void FrameHVDIR::resize(std::size_t n)
+  {
+    h.resize(n);
+    v.resize(n);
+    d.resize(n);
+    intensity.resize(n);
+    ring.resize(n);
+
+    if (hasTime())
+      time.resize(n);
+  }
+
+  void FrameHVDIR::push_back(const PointHVDIR& pt)
+  {
+    h.push_back(pt.h);
+    v.push_back(pt.v);
+    d.push_back(pt.d);
+    intensity.push_back(pt.intensity);
+    ring.push_back(pt.ring);
+  }
+
+  void FrameHVDIR::push_back(const PointHVDIR& pt, std::uint64_t point_time)
+  {
+    push_back(pt);
+    time.push_back(point_time);
+  }
+
+  PointHVDIR FrameHVDIR::at(std::size_t i) const
+  {
+    PointHVDIR pt;
+    pt.h = h.at(i);
+    pt.v = v[i];
+    pt.d = d[i];
+    pt.intensity = intensity[i];
+    pt.ring = ring[i];
+    return pt;
+  }
+
+  void toFrame(const PointCloudHVDIR& cloud, FrameHVDIR& frame)
+  {
+    frame.stamp = cloud.header.stamp;
+    frame.seq = cloud.header.seq;
+    frame.frame_id = cloud.header.frame_id;
+
+    const std::size_t n = cloud.size();
+
+    frame.time.clear();
+    frame.resize(n);
+
+    // one pass per field keeps each output array streaming
+    for (std::size_t i = 0; i < n; ++i)
+      frame.h[i] = cloud.points[i].h;
+    for (std::size_t i = 0; i < n; ++i)
+      frame.v[i] = cloud.points[i].v;
+    for (std::size_t i = 0; i < n; ++i)
+      frame.d[i] = cloud.points[i].d;
+    for (std::size_t i = 0; i < n; ++i)
+      frame.intensity[i] = cloud.points[i].intensity;
+    for (std::size_t i = 0; i < n; ++i)
+      frame.ring[i] = cloud.points[i].ring;
+
+    frame.width = cloud.width;
+    frame.height = cloud.height;
+    frame.is_dense = cloud.is_dense;
+  }
+
+  void toPointCloud(const FrameHVDIR& frame, PointCloudHVDIR& cloud)
+  {
+    cloud.header.stamp = frame.stamp;
+    cloud.header.seq = frame.seq;
+    cloud.header.frame_id = frame.frame_id;
+
+    const std::size_t n = frame.size();
+    cloud.resize(n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      PointHVDIR& pt = cloud.points[i];
+      pt.h = frame.h[i];
+      pt.v = frame.v[i];
+      pt.d = frame.d[i];
+      pt.intensity = frame.intensity[i];
+      pt.ring = frame.ring[i];
+    }
+
+    cloud.width = frame.width;
+    cloud.height = frame.height;
+    cloud.is_dense = frame.is_dense;
+  }
+
+} // namespace quanergy
@@ -0,0 +1,145 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/latency_histogram.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace quanergy
+{
+  const std::uint32_t LatencyHistogram::SUB_BUCKETS;
+  const std::uint32_t LatencyHistogram::MAX_EXPONENT;
+  const std::uint64_t LatencyHistogram::MAX_VALUE;
+  const std::uint32_t LatencyHistogram::NUM_BUCKETS;
+
+  namespace
+  {
+    /// index of the most significant set bit; value must be non zero
+    inline std::uint32_t mostSignificantBit(std::uint64_t value)
+    {
+#ifdef _MSC_VER
+      unsigned long index;
+      _BitScanReverse64(&index, value);
+      return index;
+#else
+      return 63 - __builtin_clzll(value);
+#endif
+    }
+
+    /// atomically lower (or raise) target to value
+    template <class COMPARE>
+    inline void updateExtreme(std::atomic<std::uint64_t>& target, std::uint64_t value, COMPARE better)
+    {
+      std::uint64_t current = target.load(std::memory_order_relaxed);
+      while (better(value, current) &&
+             !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+      {
+      }
+    }
+  }
+
+  LatencyHistogram::LatencyHistogram()
+  {
+    reset();
+  }
+
+  std::uint32_t LatencyHistogram::bucketIndex(std::uint64_t value)
+  {
+    value = std::min(value, MAX_VALUE);
+
+    // values below 2 * SUB_BUCKETS get a bucket each
+    if (value < 2 * SUB_BUCKETS)
+      return static_cast<std::uint32_t>(value);
+
+    // shift so the value lands in [SUB_BUCKETS, 2 * SUB_BUCKETS)
+    const std::uint32_t shift = mostSignificantBit(value) - 6;
+    return 2 * SUB_BUCKETS + (shift - 1) * SUB_BUCKETS
+           + static_cast<std::uint32_t>((value >> shift) - SUB_BUCKETS);
+  }
+
+  std::uint64_t LatencyHistogram::bucketValue(std::uint32_t index)
+  {
+    if (index < 2 * SUB_BUCKETS)
+      return index;
+
+    const std::uint32_t shift = (index - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+    const std::uint64_t sub = (index - 2 * SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+    return (sub << shift) + (std::uint64_t(1) << (shift - 1));
+  }
+
+  void LatencyHistogram::record(std::uint64_t ns)
+  {
+    buckets_[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+    updateExtreme(min_, ns, std::less<std::uint64_t>());
+    updateExtreme(max_, ns, std::greater<std::uint64_t>());
+  }
+
+  std::uint64_t LatencyHistogram::quantile(double q) const
+  {
+    // count from the buckets so the result is consistent with them
+    std::uint64_t total = 0;
+    for (const auto& bucket : buckets_)
+      total += bucket.load(std::memory_order_relaxed);
+
+    if (total == 0)
+      return 0;
+
+    q = std::max(0., std::min(1., q));
+    const std::uint64_t target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * total)));
+
+    std::uint64_t cumulative = 0;
+    for (std::uint32_t i = 0; i < NUM_BUCKETS; ++i)
+    {
+      cumulative += buckets_[i].load(std::memory_order_relaxed);
+      if (cumulative >= target)
+      {
+        // the exact extremes are known
+        return std::max(min_.load(std::memory_order_relaxed),
+                        std::min(bucketValue(i), max_.load(std::memory_order_relaxed)));
+      }
+    }
+
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  LatencySummary LatencyHistogram::summary() const
+  {
+    LatencySummary result;
+    result.count = count();
+    if (result.count == 0)
+      return result;
+
+    result.min = min_.load(std::memory_order_relaxed);
+    result.max = max_.load(std::memory_order_relaxed);
+    result.p50 = quantile(0.5);
+    result.p99 = quantile(0.99);
+    result.p999 = quantile(0.999);
+    result.mean = static_cast<double>(sum_.load(std::memory_order_relaxed)) / result.count;
+    return result;
+  }
+
+  void LatencyHistogram::reset()
+  {
+    for (auto& bucket : buckets_)
+      bucket.store(0, std::memory_order_relaxed);
+
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+} // namespace quanergy
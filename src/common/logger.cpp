@@ -0,0 +1,195 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/logger.h>
+
+#include <iostream>
+
+namespace quanergy
+{
+  const std::uint32_t LogSite::DEFAULT_INTERVAL_MS;
+  const std::size_t Logger::QUEUE_SIZE;
+
+  namespace
+  {
+    /// how long the writer sleeps when it isn't woken
+    const std::chrono::milliseconds WRITER_IDLE(50);
+  }
+
+  const char* toString(LogLevel level)
+  {
+    switch (level)
+    {
+      case LogLevel::DEBUG:   return "DEBUG";
+      case LogLevel::INFO:    return "INFO";
+      case LogLevel::WARNING: return "WARNING";
+      case LogLevel::ERR:     return "ERROR";
+      default:                return "OFF";
+    }
+  }
+
+  LogSite::LogSite(const char* file, int line, std::uint32_t interval_ms)
+    : file_(file)
+    , line_(line)
+    , interval_ns_(static_cast<std::int64_t>(interval_ms) * 1000000)
+  {
+  }
+
+  bool LogSite::allow(std::uint64_t& suppressed)
+  {
+    if (interval_ns_ > 0)
+    {
+      std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+      std::int64_t next = next_ns_.load(std::memory_order_relaxed);
+
+      // only one thread wins the slot
+      if (now < next || !next_ns_.compare_exchange_strong(next, now + interval_ns_, std::memory_order_relaxed))
+      {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  Logger& Logger::instance()
+  {
+    static Logger logger;
+    return logger;
+  }
+
+  Logger::Logger()
+    : queue_(QUEUE_SIZE)
+    , sink_(&Logger::consoleSink)
+  {
+    writer_ = std::thread([this]{ run(); });
+  }
+
+  Logger::~Logger()
+  {
+    {
+      std::lock_guard<std::mutex> lk(wake_mutex_);
+      kill_ = true;
+    }
+    wake_conditional_.notify_one();
+
+    if (writer_.joinable())
+      writer_.join();
+  }
+
+  void Logger::setSink(Sink sink)
+  {
+    std::lock_guard<std::mutex> lk(sink_mutex_);
+    sink_ = std::move(sink);
+  }
+
+  void Logger::consoleSink(const LogRecord& record)
+  {
+    std::ostream& out = record.level <= LogLevel::INFO ? std::cout : std::cerr;
+
+    out << record.message;
+    if (record.suppressed > 0)
+      out << " (" << record.suppressed << " similar messages suppressed)";
+    out << std::endl;
+  }
+
+  void Logger::log(LogLevel level, const LogSite& site, std::string message, std::uint64_t suppressed)
+  {
+    LogRecord record;
+    record.level = level;
+    record.time = std::chrono::system_clock::now();
+    record.file = site.file();
+    record.line = site.line();
+    record.message = std::move(message);
+    record.suppressed = suppressed;
+
+    if (!queue_.push(std::move(record)))
+    {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      dropped_total_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    queued_.fetch_add(1, std::memory_order_release);
+
+    // errors are written promptly, as is a backlog; everything else waits for the writer's next pass
+    if (level >= LogLevel::ERR || queue_.size() > QUEUE_SIZE / 2)
+      wake_conditional_.notify_one();
+  }
+
+  void Logger::flush()
+  {
+    const std::uint64_t target = queued_.load(std::memory_order_acquire);
+
+    while (written_.load(std::memory_order_acquire) < target && writer_.joinable())
+    {
+      wake_conditional_.notify_one();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  void Logger::write(const LogRecord& record)
+  {
+    std::lock_guard<std::mutex> lk(sink_mutex_);
+    if (!sink_)
+      return;
+
+    try
+    {
+      sink_(record);
+    }
+    catch (...)
+    {
+      // a failing sink must not take down the writer
+    }
+  }
+
+  void Logger::run()
+  {
+    LogRecord record;
+
+    for (;;)
+    {
+      while (queue_.pop(record))
+      {
+        write(record);
+        written_.fetch_add(1, std::memory_order_release);
+      }
+
+      std::uint64_t dropped = dropped_.exchange(0, std::memory_order_relaxed);
+      if (dropped > 0)
+      {
+        LogRecord dropped_record;
+        dropped_record.level = LogLevel::WARNING;
+        dropped_record.time = std::chrono::system_clock::now();
+        dropped_record.file = __FILE__;
+        dropped_record.line = __LINE__;
+        dropped_record.message = "Logger dropped " + std::to_string(dropped) + " messages due to full queue";
+        write(dropped_record);
+      }
+
+      std::unique_lock<std::mutex> lk(wake_mutex_);
+      if (kill_)
+      {
+        lk.unlock();
+        // drain anything queued while shutting down
+        while (queue_.pop(record))
+        {
+          write(record);
+          written_.fetch_add(1, std::memory_order_release);
+        }
+        return;
+      }
+
+      wake_conditional_.wait_for(lk, WRITER_IDLE);
+    }
+  }
+
+} // namespace quanergy
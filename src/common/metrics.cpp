@@ -0,0 +1,126 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/metrics.h>
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace quanergy
+{
+  const char* const MetricsWriter::PREFIX = "quanergy_";
+
+  namespace
+  {
+    /// escape a label value per the exposition format
+    std::string escape(const std::string& value)
+    {
+      std::string result;
+      result.reserve(value.size());
+      for (char c : value)
+      {
+        if (c == '\\' || c == '"')
+          result += '\\';
+
+        if (c == '\n')
+          result += "\\n";
+        else
+          result += c;
+      }
+      return result;
+    }
+  }
+
+  void MetricsWriter::counter(const std::string& name, const std::string& help,
+                              double value, const MetricLabels& labels)
+  {
+    family(name, help, "counter").samples.push_back(sample(PREFIX + name, labels, value));
+  }
+
+  void MetricsWriter::gauge(const std::string& name, const std::string& help,
+                            double value, const MetricLabels& labels)
+  {
+    family(name, help, "gauge").samples.push_back(sample(PREFIX + name, labels, value));
+  }
+
+  void MetricsWriter::summary(const std::string& name, const std::string& help,
+                              const LatencySummary& latency, const MetricLabels& labels)
+  {
+    Family& f = family(name, help, "summary");
+    const std::string full_name = PREFIX + name;
+
+    const std::pair<const char*, std::uint64_t> quantiles[] = {
+      {"0.5", latency.p50}, {"0.99", latency.p99}, {"0.999", latency.p999}, {"1", latency.max}
+    };
+
+    for (const auto& quantile : quantiles)
+    {
+      MetricLabels quantile_labels = labels;
+      quantile_labels.emplace_back("quantile", quantile.first);
+      f.samples.push_back(sample(full_name, quantile_labels,
+                                 latency.count > 0 ? quantile.second * 1e-9
+                                                   : std::numeric_limits<double>::quiet_NaN()));
+    }
+
+    f.samples.push_back(sample(full_name + "_sum", labels, latency.mean * latency.count * 1e-9));
+    f.samples.push_back(sample(full_name + "_count", labels, static_cast<double>(latency.count)));
+  }
+
+  std::string MetricsWriter::str() const
+  {
+    std::ostringstream out;
+    for (const auto& f : families_)
+    {
+      out << "# HELP " << PREFIX << f.first << " " << f.second.help << "\n";
+      out << "# TYPE " << PREFIX << f.first << " " << f.second.type << "\n";
+      for (const auto& s : f.second.samples)
+        out << s << "\n";
+    }
+    return out.str();
+  }
+
+  MetricsWriter::Family& MetricsWriter::family(const std::string& name, const std::string& help, const char* type)
+  {
+    Family& f = families_[name];
+    if (f.type.empty())
+    {
+      f.help = help;
+      f.type = type;
+    }
+    return f;
+  }
+
+  std::string MetricsWriter::sample(const std::string& name, const MetricLabels& labels, double value)
+  {
+    std::ostringstream out;
+    // enough for exact counters up to 10^15
+    out.precision(15);
+    out << name;
+
+    if (!labels.empty())
+    {
+      out << "{";
+      for (std::size_t i = 0; i < labels.size(); ++i)
+      {
+        if (i > 0)
+          out << ",";
+        out << labels[i].first << "=\"" << escape(labels[i].second) << "\"";
+      }
+      out << "}";
+    }
+
+    out << " ";
+    if (std::isnan(value))
+      out << "NaN";
+    else
+      out << value;
+
+    return out.str();
+  }
+
+} // namespace quanergy
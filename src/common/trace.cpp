@@ -0,0 +1,188 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/common/trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace quanergy
+{
+  namespace
+  {
+    /// escape a string for JSON
+    std::string escape(const std::string& value)
+    {
+      std::string result;
+      result.reserve(value.size());
+      for (char c : value)
+      {
+        if (c == '\\' || c == '"')
+        {
+          result += '\\';
+          result += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+          char code[8];
+          std::snprintf(code, sizeof(code), "\\u%04x", c);
+          result += code;
+        }
+        else
+        {
+          result += c;
+        }
+      }
+      return result;
+    }
+
+    /// nanoseconds to the microseconds Chrome trace expects
+    std::string micros(std::uint64_t ns)
+    {
+      char buffer[32];
+      std::snprintf(buffer, sizeof(buffer), "%llu.%03u",
+                    static_cast<unsigned long long>(ns / 1000), static_cast<unsigned>(ns % 1000));
+      return buffer;
+    }
+  }
+
+  Tracer& Tracer::instance()
+  {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  std::uint64_t Tracer::now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void Tracer::complete(const char* name, std::uint64_t start, std::uint64_t end)
+  {
+    record('X', name, start, end > start ? end - start : 0);
+  }
+
+  void Tracer::instant(const char* name)
+  {
+    if (enabled())
+      record('i', name, now(), 0);
+  }
+
+  void Tracer::flowBegin(const char* name, std::uint64_t id)
+  {
+    if (enabled())
+      record('s', name, now(), id);
+  }
+
+  void Tracer::flowEnd(const char* name, std::uint64_t id)
+  {
+    if (enabled())
+      record('f', name, now(), id);
+  }
+
+  void Tracer::setThreadName(std::thread::id thread, const std::string& name)
+  {
+    std::lock_guard<std::mutex> lk(buffers_mutex_);
+    thread_names_[thread] = name;
+  }
+
+  void Tracer::record(char phase, const char* name, std::uint64_t ts, std::uint64_t value)
+  {
+    ThreadBuffer& buffer = threadBuffer();
+
+    std::uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index % BUFFER_SIZE] = Event{name, ts, value, phase};
+    buffer.written.store(index + 1, std::memory_order_release);
+  }
+
+  Tracer::ThreadBuffer& Tracer::threadBuffer()
+  {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+      std::lock_guard<std::mutex> lk(buffers_mutex_);
+      buffers_.emplace_back(new ThreadBuffer(std::this_thread::get_id()));
+      buffer = buffers_.back().get();
+    }
+
+    return *buffer;
+  }
+
+  std::size_t Tracer::writeChromeTrace(std::ostream& out, std::uint64_t from, std::uint64_t to) const
+  {
+    from = std::max(from, cleared_at_.load(std::memory_order_relaxed));
+
+    std::lock_guard<std::mutex> lk(buffers_mutex_);
+
+    std::size_t count = 0;
+    const char* separator = "\n";
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    for (std::size_t tid = 0; tid < buffers_.size(); ++tid)
+    {
+      const ThreadBuffer& buffer = *buffers_[tid];
+
+      auto name = thread_names_.find(buffer.thread);
+      if (name != thread_names_.end())
+      {
+        out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"" << escape(name->second) << "\"}}";
+        separator = ",\n";
+      }
+
+      // copy what the owning thread has written, then drop anything it overwrote during the copy
+      std::uint64_t end = buffer.written.load(std::memory_order_acquire);
+      std::uint64_t begin = end > BUFFER_SIZE ? end - BUFFER_SIZE : 0;
+
+      std::vector<Event> events;
+      events.reserve(end - begin);
+      for (std::uint64_t i = begin; i < end; ++i)
+        events.push_back(buffer.events[i % BUFFER_SIZE]);
+
+      std::uint64_t overwritten = buffer.written.load(std::memory_order_acquire);
+      std::uint64_t first_valid = overwritten > BUFFER_SIZE ? overwritten - BUFFER_SIZE : 0;
+
+      for (std::uint64_t i = std::max(begin, first_valid); i < end; ++i)
+      {
+        const Event& event = events[i - begin];
+        if (event.ts < from || event.ts > to)
+          continue;
+
+        out << separator << "{\"name\":\"" << escape(event.name) << "\",\"cat\":\"quanergy\",\"ph\":\""
+            << event.phase << "\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << micros(event.ts);
+
+        if (event.phase == 'X')
+          out << ",\"dur\":" << micros(event.value);
+        else if (event.phase == 'i')
+          out << ",\"s\":\"t\"";
+        else
+          out << ",\"id\":" << event.value << (event.phase == 'f' ? ",\"bp\":\"e\"" : "");
+
+        out << "}";
+        separator = ",\n";
+        ++count;
+      }
+    }
+
+    out << "\n]}\n";
+    return count;
+  }
+
+  std::size_t Tracer::writeChromeTrace(const std::string& file_name, std::uint64_t from, std::uint64_t to) const
+  {
+    std::ofstream out(file_name);
+    if (!out)
+      throw std::runtime_error("Unable to open trace file " + file_name);
+
+    return writeChromeTrace(out, from, to);
+  }
+
+} // namespace quanergy
@@ -7,6 +7,10 @@
 
 #include <quanergy/modules/distance_filter.h>
 
+#include <quanergy/common/trace.h>
+
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
 namespace quanergy
@@ -24,13 +28,21 @@ namespace quanergy
       return signal_.connect(subscriber);
     }
 
+    void DistanceFilter::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
 
     void DistanceFilter::slot(PointCloudHVDIRConstPtr const & cloudPtr)
     {
       if (!cloudPtr) return;
 
       // Don't do the work unless someone is listening.
-      if (signal_.num_slots() == 0) return;
+      if (signal_.empty()) return;
+
+      QUANERGY_TRACE_SCOPE("distance_filter");
+      StageTimer timer(latency_histogram_);
 
       PointCloudHVDIR const & cloud = *cloudPtr;
 
@@ -65,29 +77,49 @@ namespace quanergy
       result.height = cloud.height;
       result.is_dense = is_dense;
 
+      timer.stop();
       signal_(resultPtr);
     }
 
-    PointCloudHVDIR::PointType DistanceFilter::filterByDistance(PointCloudHVDIR::PointType const & from)
+    void DistanceFilter::filter(FrameHVDIR& frame) const
     {
-      PointCloudHVDIR::PointType to;
-
-      to.intensity = from.intensity;
-      to.ring = from.ring;
+      const std::size_t n = frame.size();
+      float* d = frame.d.data();
 
-      to.h = from.h;
-      to.v = from.v;
+      bool is_dense = frame.is_dense;
 
-      to.d = ((from.d < min_distance_threshold_) ||
-              (from.d > max_distance_threshold_))
-        ?
-        std::numeric_limits<float>::quiet_NaN()
-        :
-        from.d;
+      // branch free over the range array so the loop vectorizes
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        const bool drop = (d[i] < min_distance_threshold_) || (d[i] > max_distance_threshold_);
+        d[i] = drop ? std::numeric_limits<float>::quiet_NaN() : d[i];
+        is_dense = is_dense && !drop;
+      }
 
-      return to;
+      frame.is_dense = is_dense;
     }
 
+    void DistanceFilter::filter(FrameCompact& frame) const
+    {
+      // convert the thresholds to radius units once instead of decoding every range
+      const double max_radius_d = std::floor(static_cast<double>(max_distance_threshold_) / FrameCompact::RADIUS_SCALE);
+      const std::uint32_t min_radius = static_cast<std::uint32_t>(
+        std::max(0., std::ceil(static_cast<double>(min_distance_threshold_) / FrameCompact::RADIUS_SCALE)));
+      const std::uint32_t max_radius = max_radius_d >= std::numeric_limits<std::uint32_t>::max()
+        ? std::numeric_limits<std::uint32_t>::max()
+        : static_cast<std::uint32_t>(std::max(0., max_radius_d));
+
+      bool is_dense = frame.is_dense;
+
+      for (auto& pt : frame.points)
+      {
+        const bool drop = (pt.radius < min_radius) || (pt.radius > max_radius);
+        pt.radius = drop ? 0 : pt.radius;
+        is_dense = is_dense && pt.radius != 0;
+      }
+
+      frame.is_dense = is_dense;
+    }
 
     void DistanceFilter::setMaximumDistanceThreshold(float maxThreshold) {
       max_distance_threshold_ = maxThreshold;
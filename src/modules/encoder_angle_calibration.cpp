@@ -14,6 +14,9 @@
 
 #include <quanergy/modules/encoder_angle_calibration.h>
 
+#include <quanergy/common/logger.h>
+#include <quanergy/common/trace.h>
+
 #include <Eigen/Dense>
 
 namespace quanergy
@@ -85,16 +88,23 @@ namespace quanergy
       return signal_.connect(subscriber);
     }
 
+    void EncoderAngleCalibration::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
     void EncoderAngleCalibration::setRequiredNumSamples(double num_samples)
     {
       required_samples_ = num_samples;
     }
 
-    void EncoderAngleCalibration::slot(PointCloudHVDIRPtr const & cloud_ptr)
+    void EncoderAngleCalibration::slot(PointCloudHVDIRConstPtr const & cloud_ptr)
     {
       if (!cloud_ptr)
         return;
 
+      QUANERGY_TRACE_SCOPE("encoder_corrector");
+
       if (calibration_complete_)
       {
         applyCalibration(cloud_ptr);
@@ -118,9 +128,9 @@ namespace quanergy
       {
         if (!started_calibration_)
         {
-          std::cout << "QuanergyClient: Starting encoder calibration. This may take up to "
-                    << std::chrono::duration_cast<std::chrono::seconds>(timeout_).count()
-                    << " seconds to complete..." << std::endl;
+          QUANERGY_LOG(INFO, "QuanergyClient: Starting encoder calibration. This may take up to "
+                       << std::chrono::duration_cast<std::chrono::seconds>(timeout_).count()
+                       << " seconds to complete...");
           started_calibration_ = true;
           time_started_ = std::chrono::system_clock::now();
         }
@@ -140,10 +150,8 @@ namespace quanergy
             std::lock_guard<decltype(container_mutex_)> lock(container_mutex_);
             if (ba::mean(amplitude_accumulator_) < amplitude_threshold_)
             {
-              std::stringstream msg;
-              msg << "QuanergyClient: Encoder calibration not required for this sensor.\n"
-                "Average amplitude calculated: " << ba::mean(amplitude_accumulator_);
-              std::cout << msg.str() << std::endl;
+              QUANERGY_LOG(INFO, "QuanergyClient: Encoder calibration not required for this sensor.\n"
+                           "Average amplitude calculated: " << ba::mean(amplitude_accumulator_));
 
               calibration_complete_ = true;
               amplitude_ = 0.;
@@ -211,32 +219,34 @@ namespace quanergy
       calibration_complete_ = true;
     }
 
-    void EncoderAngleCalibration::applyCalibration(PointCloudHVDIRPtr const & cloud_ptr) const
+    void EncoderAngleCalibration::applyCalibration(PointCloudHVDIRConstPtr const & cloud_ptr) const
     {
       if (!cloud_ptr)
         return;
 
       // return immediately if there are no slots
-      if (signal_.num_slots() == 0)
+      if (signal_.empty())
         return;
 
-      PointCloudHVDIR & cloud = *cloud_ptr;
+      // no correction to apply; subscribers share the input
+      if (amplitude_ == 0.)
+      {
+        signal_(cloud_ptr);
+        return;
+      }
+
+      StageTimer timer(latency_histogram_);
 
-      for (auto& point : cloud)
+      // the input is shared with other subscribers of the parser so the corrected angles go in a new cloud
+      PointCloudHVDIRPtr result_ptr(new PointCloudHVDIR(*cloud_ptr));
+
+      for (auto& point : result_ptr->points)
       {
-        // corrects in place, saves copying other values
-        point.h = point.h - (amplitude_ * std::sin(point.h + phase_));
-        if (point.h < -M_PI)
-        {
-          point.h += 2 * M_PI;
-        }
-        else if (point.h > M_PI)
-        {
-          point.h -= 2 * M_PI;
-        }
+        point.h = correctAngle(point.h);
       }
 
-      signal_(cloud_ptr);
+      timer.stop();
+      signal_(result_ptr);
     }
 
     void EncoderAngleCalibration::processAngles()
@@ -244,6 +254,8 @@ namespace quanergy
 
       using namespace quanergy::common;
 
+      Tracer::instance().setThreadName(std::this_thread::get_id(), "encoder_calibration");
+
       while (!calibration_complete_ && num_valid_samples_ < required_samples_)
       {
         AngleContainer encoder_angles;
@@ -266,6 +278,8 @@ namespace quanergy
           period_queue_.pop();
         }
         
+        QUANERGY_TRACE_SCOPE("encoder_calibration");
+
         // calculate the amplitude and phase and display to user
         auto sine_parameters = calculate(encoder_angles);
 
@@ -275,15 +289,11 @@ namespace quanergy
         {
           if (first_run_)
           {
-            std::cout << "QuanergyClient: AMPLITUDE(rads), PHASE(rads)" << std::endl;
+            QUANERGY_LOG(INFO, "QuanergyClient: AMPLITUDE(rads), PHASE(rads)");
             first_run_ = false;
           }
 
-          std::stringstream output;
-          output << sine_parameters.first << "," << sine_parameters.second
-                 << std::endl;
-
-          std::cout << output.str();
+          QUANERGY_LOG(INFO, sine_parameters.first << "," << sine_parameters.second);
           continue;
         }
 
@@ -321,9 +331,9 @@ namespace quanergy
             amplitude_ = ba::mean(amplitude_accumulator_);
             phase_ = phase_averager_.avg();
 
-            std::cout << "QuanergyClient: Calibration complete." << std::endl
-              << "  amplitude : " << amplitude_ << std::endl
-              << "  phase     : " << phase_ << std::endl;
+            QUANERGY_LOG(INFO, "QuanergyClient: Calibration complete.\n"
+                         << "  amplitude : " << amplitude_ << "\n"
+                         << "  phase     : " << phase_);
 
             calibration_complete_ = true;
             
@@ -0,0 +1,109 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/modules/frame_converter.h>
+
+namespace quanergy
+{
+  namespace client
+  {
+
+    boost::signals2::connection CloudToFrameConverter::connect(const typename Signal::slot_type& subscriber)
+    {
+      return signal_.connect(subscriber);
+    }
+
+    void CloudToFrameConverter::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
+    void CloudToFrameConverter::slot(PointCloudHVDIRConstPtr const & cloudPtr)
+    {
+      if (!cloudPtr) return;
+
+      // Don't do the work unless someone is listening.
+      if (signal_.empty()) return;
+
+      FrameHVDIRPtr resultPtr(new FrameHVDIR());
+      toFrame(*cloudPtr, *resultPtr);
+
+      signal_(resultPtr);
+    }
+
+    boost::signals2::connection FrameToCloudConverter::connect(const typename Signal::slot_type& subscriber)
+    {
+      return signal_.connect(subscriber);
+    }
+
+    void FrameToCloudConverter::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
+    void FrameToCloudConverter::slot(FrameHVDIRConstPtr const & framePtr)
+    {
+      if (!framePtr) return;
+
+      // Don't do the work unless someone is listening.
+      if (signal_.empty()) return;
+
+      PointCloudHVDIRPtr resultPtr(new PointCloudHVDIR());
+      toPointCloud(*framePtr, *resultPtr);
+
+      signal_(resultPtr);
+    }
+
+    boost::signals2::connection CloudToCompactConverter::connect(const typename Signal::slot_type& subscriber)
+    {
+      return signal_.connect(subscriber);
+    }
+
+    void CloudToCompactConverter::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
+    void CloudToCompactConverter::slot(PointCloudHVDIRConstPtr const & cloudPtr)
+    {
+      if (!cloudPtr) return;
+
+      // Don't do the work unless someone is listening.
+      if (signal_.empty()) return;
+
+      FrameCompactPtr resultPtr(new FrameCompact());
+      toFrame(*cloudPtr, *resultPtr);
+
+      signal_(resultPtr);
+    }
+
+    boost::signals2::connection CompactToCartConverter::connect(const typename Signal::slot_type& subscriber)
+    {
+      return signal_.connect(subscriber);
+    }
+
+    void CompactToCartConverter::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
+    void CompactToCartConverter::slot(FrameCompactConstPtr const & framePtr)
+    {
+      if (!framePtr) return;
+
+      // Don't do the work unless someone is listening.
+      if (signal_.empty()) return;
+
+      PointCloudXYZIRPtr resultPtr(new PointCloudXYZIR());
+      toPointCloud(*framePtr, *resultPtr);
+
+      signal_(resultPtr);
+    }
+
+  } // namespace client
+
+} // namespace quanergy
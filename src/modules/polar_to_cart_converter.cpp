@@ -7,6 +7,8 @@
 
 #include <quanergy/modules/polar_to_cart_converter.h>
 
+#include <quanergy/common/trace.h>
+
 namespace quanergy
 {
   namespace client
@@ -17,12 +19,20 @@ namespace quanergy
       return signal_.connect(subscriber);
     }
 
+    void PolarToCartConverter::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
     void PolarToCartConverter::slot(PointCloudHVDIRConstPtr const & cloudPtr)
     {
       if (!cloudPtr) return;
 
       // Don't do the work unless someone is listening.
-      if (signal_.num_slots() == 0) return;
+      if (signal_.empty()) return;
+
+      QUANERGY_TRACE_SCOPE("cartesian_converter");
+      StageTimer timer(latency_histogram_);
 
       PointCloudHVDIR const & cloud = *cloudPtr;
 
@@ -59,40 +69,10 @@ namespace quanergy
       result.height = cloud.height;
       result.is_dense = is_dense;
 
+      timer.stop();
       signal_(resultPtr);
     }
 
-    PointCloudXYZIR::PointType PolarToCartConverter::polarToCart(PointCloudHVDIR::PointType const & from)
-    {
-      PointCloudXYZIR::PointType to;
-
-      to.intensity = from.intensity;
-      to.ring = from.ring;
-
-      if (std::isnan (from.d))
-      {
-        to.x = to.y = to.z = std::numeric_limits<float>::quiet_NaN ();
-        return to;
-      }
-
-      double const cos_horizontal_angle = std::cos(from.h);
-      double const sin_horizontal_angle = std::sin(from.h);
-
-      double const cos_vertical_angle = std::cos(from.v);
-      double const sin_vertical_angle = std::sin(from.v);
-
-      // get the distance to the XY plane
-      double xy_distance = from.d * cos_vertical_angle;
-
-      to.y = static_cast<float> (xy_distance * sin_horizontal_angle);
-
-      to.x = static_cast<float> (xy_distance * cos_horizontal_angle);
-
-      to.z = static_cast<float> (from.d * sin_vertical_angle);
-
-      return to;
-    }
-
   } // namespace client
 
 } // namespace quanergy
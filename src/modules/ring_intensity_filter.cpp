@@ -7,6 +7,9 @@
 
 #include <quanergy/modules/ring_intensity_filter.h>
 
+#include <quanergy/common/logger.h>
+#include <quanergy/common/trace.h>
+
 namespace quanergy
 {
   namespace client
@@ -26,13 +29,21 @@ namespace quanergy
       return signal_.connect(subscriber);
     }
 
+    void RingIntensityFilter::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
 
     void RingIntensityFilter::slot(PointCloudHVDIRConstPtr const & cloudPtr)
     {
       if (!cloudPtr) return;
 
       // Don't do the work unless someone is listening.
-      if (signal_.num_slots() == 0) return;
+      if (signal_.empty()) return;
+
+      QUANERGY_TRACE_SCOPE("ring_intensity_filter");
+      StageTimer timer(latency_histogram_);
 
       PointCloudHVDIR const & cloud = *cloudPtr;
 
@@ -67,37 +78,60 @@ namespace quanergy
       result.height = cloud.height;
       result.is_dense = is_dense;
 
+      timer.stop();
       signal_(resultPtr);
     }
 
 
-    PointCloudHVDIR::PointType RingIntensityFilter::filterGhosts(PointCloudHVDIR::PointType const & from) const
+    void RingIntensityFilter::filter(FrameHVDIR& frame) const
     {
-      PointCloudHVDIR::PointType to;
+      const std::size_t n = frame.size();
+      float* d = frame.d.data();
+      const float* intensity = frame.intensity.data();
+      const std::uint16_t* ring = frame.ring.data();
 
-      to.intensity = from.intensity;
-      to.ring = from.ring;
+      bool is_dense = frame.is_dense;
 
-      to.h = from.h;
-      to.v = from.v;
-
-      to.d = ((from.ring < M_SERIES_NUM_LASERS) &&
-              (from.d < ring_filter_range_[from.ring]) &&
-              (from.intensity < ring_filter_intensity_[from.ring]))
-        ?
-        std::numeric_limits<float>::quiet_NaN()
-        :
-        from.d;
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        const bool drop = (ring[i] < M_SERIES_NUM_LASERS) &&
+                          (d[i] < ring_filter_range_[ring[i]]) &&
+                          (intensity[i] < ring_filter_intensity_[ring[i]]);
+        d[i] = drop ? std::numeric_limits<float>::quiet_NaN() : d[i];
+        is_dense = is_dense && !drop;
+      }
 
-      return to;
+      frame.is_dense = is_dense;
     }
 
+    void RingIntensityFilter::filter(FrameCompact& frame) const
+    {
+      // ranges below the threshold in radius units; points must also be below the intensity threshold
+      std::uint32_t max_radius[M_SERIES_NUM_LASERS];
+      for (int ring = 0; ring < M_SERIES_NUM_LASERS; ++ring)
+      {
+        max_radius[ring] = FrameCompact::rangeToRadius(ring_filter_range_[ring]);
+      }
+
+      bool is_dense = frame.is_dense;
+
+      for (auto& pt : frame.points)
+      {
+        const bool drop = (pt.ring < M_SERIES_NUM_LASERS) &&
+                          (pt.radius < max_radius[pt.ring]) &&
+                          (pt.intensity < ring_filter_intensity_[pt.ring]);
+        pt.radius = drop ? 0 : pt.radius;
+        is_dense = is_dense && pt.radius != 0;
+      }
+
+      frame.is_dense = is_dense;
+    }
 
     float RingIntensityFilter::getRingFilterMinimumRangeThreshold (const std::uint16_t laser_beam) const
     {
       if (laser_beam >= M_SERIES_NUM_LASERS)
       {
-        std::cerr << "Index out of bound! Beam index should be between 0 and " << M_SERIES_NUM_LASERS << std::endl;
+        QUANERGY_LOG(ERR, "Index out of bound! Beam index should be between 0 and " << M_SERIES_NUM_LASERS);
         return std::numeric_limits<float>::quiet_NaN();
       }
 
@@ -110,8 +144,7 @@ namespace quanergy
     {
       if (laser_beam >= M_SERIES_NUM_LASERS)
       {
-        std::cerr << "Index out of bound! Beam index should be between 0 and " 
-                  << M_SERIES_NUM_LASERS << std::endl;
+        QUANERGY_LOG(ERR, "Index out of bound! Beam index should be between 0 and " << M_SERIES_NUM_LASERS);
       }
       else
       {
@@ -124,8 +157,7 @@ namespace quanergy
     {
       if (laser_beam >= M_SERIES_NUM_LASERS)
       {
-        std::cerr << "Index out of bound! Beam index should be between 0 and " 
-                  << M_SERIES_NUM_LASERS << std::endl;
+        QUANERGY_LOG(ERR, "Index out of bound! Beam index should be between 0 and " << M_SERIES_NUM_LASERS);
         return -1;
       }
 
@@ -138,7 +170,7 @@ namespace quanergy
     {
       if (laser_beam >= M_SERIES_NUM_LASERS)
       {
-        std::cerr << "Index out of bound! Beam index should be between 0 and " << M_SERIES_NUM_LASERS << std::endl;
+        QUANERGY_LOG(ERR, "Index out of bound! Beam index should be between 0 and " << M_SERIES_NUM_LASERS);
       }
       else
       {
@@ -0,0 +1,146 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/modules/self_mask.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace quanergy
+{
+  namespace client
+  {
+
+    SelfMask::SelfMask()
+      : ranges_(static_cast<std::size_t>(M_SERIES_NUM_ROT_ANGLES) * M_SERIES_NUM_LASERS, 0.f)
+    {
+    }
+
+    int SelfMask::positionFromAngle(double h)
+    {
+      int position = static_cast<int>(std::lround(h * M_SERIES_NUM_ROT_ANGLES / (2. * M_PI)));
+
+      // the lookup table maps positions above half a revolution to negative angles
+      position %= M_SERIES_NUM_ROT_ANGLES;
+      if (position < 0)
+        position += M_SERIES_NUM_ROT_ANGLES;
+
+      return position;
+    }
+
+    void SelfMask::clear()
+    {
+      std::fill(ranges_.begin(), ranges_.end(), 0.f);
+      masked_cells_ = 0;
+    }
+
+    void SelfMask::setRange(int position, std::uint16_t ring, float range)
+    {
+      if (position < 0 || position >= M_SERIES_NUM_ROT_ANGLES || ring >= M_SERIES_NUM_LASERS)
+      {
+        throw std::out_of_range("SelfMask cell out of range");
+      }
+
+      float& cell = ranges_[static_cast<std::size_t>(position) * M_SERIES_NUM_LASERS + ring];
+
+      if (cell > 0.f)
+        --masked_cells_;
+
+      cell = std::max(0.f, range);
+
+      if (cell > 0.f)
+        ++masked_cells_;
+    }
+
+    float SelfMask::getRange(int position, std::uint16_t ring) const
+    {
+      if (position < 0 || position >= M_SERIES_NUM_ROT_ANGLES || ring >= M_SERIES_NUM_LASERS)
+        return 0.f;
+
+      return ranges_[static_cast<std::size_t>(position) * M_SERIES_NUM_LASERS + ring];
+    }
+
+    void SelfMask::load(const std::string& file_name)
+    {
+      std::ifstream file(file_name);
+      if (!file)
+      {
+        throw std::runtime_error("Unable to open self mask file: " + file_name);
+      }
+
+      clear();
+
+      std::string line;
+      while (std::getline(file, line))
+      {
+        // skip comments and blank lines
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+          continue;
+
+        std::istringstream ss(line);
+        int ring, start, end;
+        float range;
+        if (!(ss >> ring >> start >> end >> range) || ring < 0 || ring >= M_SERIES_NUM_LASERS
+            || start < 0 || end < start || end >= M_SERIES_NUM_ROT_ANGLES)
+        {
+          throw std::runtime_error("Malformed self mask line: " + line);
+        }
+
+        for (int position = start; position <= end; ++position)
+        {
+          setRange(position, static_cast<std::uint16_t>(ring), range);
+        }
+      }
+    }
+
+    void SelfMask::save(const std::string& file_name) const
+    {
+      std::ofstream file(file_name);
+      if (!file)
+      {
+        throw std::runtime_error("Unable to write self mask file: " + file_name);
+      }
+
+      file << "# ring start_position end_position range(m)\n";
+
+      for (std::uint16_t ring = 0; ring < M_SERIES_NUM_LASERS; ++ring)
+      {
+        int start = -1;
+        float run_range = 0.f;
+
+        for (int position = 0; position <= M_SERIES_NUM_ROT_ANGLES; ++position)
+        {
+          float range = (position < M_SERIES_NUM_ROT_ANGLES) ? getRange(position, ring) : 0.f;
+
+          // close the current run when the range changes
+          if (start >= 0 && range != run_range)
+          {
+            file << ring << " " << start << " " << position - 1 << " " << run_range << "\n";
+            start = -1;
+          }
+
+          if (start < 0 && range > 0.f)
+          {
+            start = position;
+            run_range = range;
+          }
+        }
+      }
+
+      if (!file)
+      {
+        throw std::runtime_error("Error writing self mask file: " + file_name);
+      }
+    }
+
+  } // namespace client
+
+} // namespace quanergy
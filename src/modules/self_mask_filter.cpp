@@ -0,0 +1,119 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/modules/self_mask_filter.h>
+
+#include <quanergy/common/trace.h>
+
+#include <limits>
+
+namespace quanergy
+{
+  namespace client
+  {
+
+    boost::signals2::connection SelfMaskFilter::connect(const typename Signal::slot_type& subscriber)
+    {
+      return signal_.connect(subscriber);
+    }
+
+    void SelfMaskFilter::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
+
+    void SelfMaskFilter::slot(PointCloudHVDIRConstPtr const & cloudPtr)
+    {
+      if (!cloudPtr) return;
+
+      // Don't do the work unless someone is listening.
+      if (signal_.empty()) return;
+
+      QUANERGY_TRACE_SCOPE("self_mask_filter");
+      StageTimer timer(latency_histogram_);
+
+      PointCloudHVDIR const & cloud = *cloudPtr;
+
+      PointCloudHVDIRPtr resultPtr = PointCloudHVDIRPtr(new PointCloudHVDIR());
+
+      PointCloudHVDIR & result = *resultPtr;
+
+      result.header.stamp = cloud.header.stamp;
+      result.header.seq = cloud.header.seq;
+      result.header.frame_id = cloud.header.frame_id;
+
+      result.reserve(cloud.size());
+
+      bool is_dense = cloud.is_dense;
+
+      for (PointCloudHVDIR::const_iterator i = cloud.points.begin();
+           i != cloud.points.end();
+           ++i)
+      {
+        PointCloudHVDIR::PointType pt = filterBySelfMask(*i);
+
+        result.points.push_back(pt);
+
+        // Check if the resulting point cloud is no longer dense
+        if (std::isnan(pt.d))
+        {
+            is_dense = false;
+        }
+      }
+
+      result.width = cloud.width;
+      result.height = cloud.height;
+      result.is_dense = is_dense;
+
+      timer.stop();
+      signal_(resultPtr);
+    }
+
+
+    void SelfMaskFilter::filter(FrameHVDIR& frame) const
+    {
+      if (mask_.empty()) return;
+
+      const std::size_t n = frame.size();
+
+      bool is_dense = frame.is_dense;
+
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        if (mask_.masks(frame.h[i], frame.ring[i], frame.d[i]))
+        {
+          frame.d[i] = std::numeric_limits<float>::quiet_NaN();
+          is_dense = false;
+        }
+      }
+
+      frame.is_dense = is_dense;
+    }
+
+    PointCloudHVDIR::PointType SelfMaskFilter::filterBySelfMask(PointCloudHVDIR::PointType const & from) const
+    {
+      PointCloudHVDIR::PointType to;
+
+      to.intensity = from.intensity;
+      to.ring = from.ring;
+
+      to.h = from.h;
+      to.v = from.v;
+
+      to.d = mask_.masks(from.h, from.ring, from.d)
+        ?
+        std::numeric_limits<float>::quiet_NaN()
+        :
+        from.d;
+
+      return to;
+    }
+
+  } // namespace client
+
+} // namespace quanergy
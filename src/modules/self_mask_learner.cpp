@@ -0,0 +1,148 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/modules/self_mask_learner.h>
+
+#include <quanergy/common/trace.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace quanergy
+{
+  namespace client
+  {
+
+    SelfMaskLearner::SelfMaskLearner()
+      : cells_(static_cast<std::size_t>(M_SERIES_NUM_ROT_ANGLES) * M_SERIES_NUM_LASERS)
+    {
+    }
+
+    boost::signals2::connection SelfMaskLearner::connect(const typename Signal::slot_type& subscriber)
+    {
+      return signal_.connect(subscriber);
+    }
+
+    void SelfMaskLearner::connectCallback(Callback callback)
+    {
+      signal_.add(std::move(callback));
+    }
+
+    void SelfMaskLearner::reset()
+    {
+      std::fill(cells_.begin(), cells_.end(), Cell());
+      frame_count_ = 0;
+      complete_ = false;
+    }
+
+    void SelfMaskLearner::setNumFrames(std::uint16_t num_frames)
+    {
+      if (num_frames == 0)
+      {
+        throw std::invalid_argument("SelfMaskLearner requires at least one frame");
+      }
+
+      num_frames_ = num_frames;
+    }
+
+    void SelfMaskLearner::setMinimumOccupancy(float fraction)
+    {
+      if (fraction <= 0.f || fraction > 1.f)
+      {
+        throw std::invalid_argument("SelfMaskLearner occupancy must be in (0, 1]");
+      }
+
+      min_occupancy_ = fraction;
+    }
+
+    void SelfMaskLearner::slot(PointCloudHVDIRConstPtr const & cloudPtr)
+    {
+      if (!cloudPtr || complete_) return;
+
+      QUANERGY_TRACE_SCOPE("self_mask_learner");
+
+      ++frame_count_;
+
+      for (const auto& pt : *cloudPtr)
+      {
+        accumulate(pt);
+      }
+
+      if (frame_count_ >= num_frames_)
+      {
+        complete_ = true;
+
+        SelfMask mask = buildMask();
+        signal_(mask);
+      }
+    }
+
+    void SelfMaskLearner::accumulate(PointCloudHVDIR::PointType const & pt)
+    {
+      // NaN ranges fail this comparison and are skipped
+      if (pt.ring >= M_SERIES_NUM_LASERS || !(pt.d <= max_body_range_))
+        return;
+
+      Cell& cell = cells_[static_cast<std::size_t>(SelfMask::positionFromAngle(pt.h)) * M_SERIES_NUM_LASERS + pt.ring];
+
+      // with multiple returns, only count the frame once
+      if (cell.last_frame != frame_count_)
+      {
+        cell.last_frame = frame_count_;
+        ++cell.near_frames;
+      }
+
+      cell.max_range = std::max(cell.max_range, pt.d);
+    }
+
+    SelfMask SelfMaskLearner::buildMask() const
+    {
+      SelfMask mask;
+
+      const float required_frames = min_occupancy_ * static_cast<float>(frame_count_);
+
+      for (std::uint16_t ring = 0; ring < M_SERIES_NUM_LASERS; ++ring)
+      {
+        // masked runs get a single range so the saved mask stays compact
+        int start = -1;
+        float run_range = 0.f;
+
+        for (int position = 0; position <= M_SERIES_NUM_ROT_ANGLES; ++position)
+        {
+          bool masked = false;
+          if (position < M_SERIES_NUM_ROT_ANGLES)
+          {
+            const Cell& cell = cells_[static_cast<std::size_t>(position) * M_SERIES_NUM_LASERS + ring];
+            masked = cell.near_frames > 0 && static_cast<float>(cell.near_frames) >= required_frames;
+            if (masked)
+            {
+              if (start < 0)
+                start = position;
+              run_range = std::max(run_range, cell.max_range + range_margin_);
+            }
+          }
+
+          if (!masked && start >= 0)
+          {
+            for (int p = start; p < position; ++p)
+            {
+              mask.setRange(p, ring, run_range);
+            }
+
+            start = -1;
+            run_range = 0.f;
+          }
+        }
+      }
+
+      return mask;
+    }
+
+  } // namespace client
+
+} // namespace quanergy
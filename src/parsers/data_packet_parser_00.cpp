@@ -22,18 +22,18 @@ namespace quanergy
               && deserialize(h->version_patch) == 0x00);
     }
 
-    bool DataPacketParser00::parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result)
+    void DataPacketParser00::decode(const std::vector<char>& packet, DecodedType& decoded,
+                                    std::uint64_t sequence)
     {
+      if (!checkSize(packet, sizeof(DataPacket00), decoded))
+      {
+        return;
+      }
+
       // deserialize
       DataPacket00 data_packet;
       deserialize(packet.data(), data_packet);
 
-      // parse
-      bool result_updated = false;
-
-      // throws error if status is fatal
-      validateStatus(static_cast<StatusType>(data_packet.data_body.status));
-
       // check that vertical angles have been defined
       if (vertical_angle_lookup_table_.empty())
       {
@@ -54,10 +54,10 @@ namespace quanergy
                                + static_cast<std::uint64_t>(data_packet.packet_header.nanoseconds) / 1000ull;
       }
 
-      const auto& start = data_packet.data_body.data[0].position;
-      const auto& mid   = data_packet.data_body.data[M_SERIES_FIRING_PER_PKT/2].position;
-      const auto& end   = data_packet.data_body.data[M_SERIES_FIRING_PER_PKT-1].position;
-      registerNewPacket(current_packet_stamp_ms, start, mid, end);
+      // status is validated during assembly so status changes are reported in order
+      beginDecode(decoded, current_packet_stamp_ms,
+                  static_cast<StatusType>(data_packet.data_body.status),
+                  return_selection_ != quanergy::client::ALL_RETURNS);
 
       double distance_scaling = 0.01;
       if (data_packet.data_body.version >= 5)
@@ -65,100 +65,94 @@ namespace quanergy
         distance_scaling = 0.00001;
       }
 
+      // select the specialized firing loop once per packet
+      const bool all_lasers = (num_selected_lasers_ == M_SERIES_NUM_LASERS);
+      withDecodedPoints(decoded, [&](auto& points)
+      {
+        switch (return_selection_)
+        {
+          case ALL_RETURNS:
+            all_lasers ? decodeFirings<ALL_RETURNS, true>(data_packet, points, decoded, sequence, distance_scaling)
+                       : decodeFirings<ALL_RETURNS, false>(data_packet, points, decoded, sequence, distance_scaling);
+            break;
+          case 0:
+            all_lasers ? decodeFirings<0, true>(data_packet, points, decoded, sequence, distance_scaling)
+                       : decodeFirings<0, false>(data_packet, points, decoded, sequence, distance_scaling);
+            break;
+          case 1:
+            all_lasers ? decodeFirings<1, true>(data_packet, points, decoded, sequence, distance_scaling)
+                       : decodeFirings<1, false>(data_packet, points, decoded, sequence, distance_scaling);
+            break;
+          default:
+            all_lasers ? decodeFirings<2, true>(data_packet, points, decoded, sequence, distance_scaling)
+                       : decodeFirings<2, false>(data_packet, points, decoded, sequence, distance_scaling);
+            break;
+        }
+      });
+
+    } // decode
+
+    template <int RETURN_SELECTION, bool ALL_LASERS, class POINTS>
+    void DataPacketParser00::decodeFirings(const DataPacket00& data_packet, POINTS& points, DecodedType& decoded,
+                                           std::uint64_t sequence, double distance_scaling) const
+    {
+      using PointType = typename POINTS::value_type;
+
+      const auto range_scale = rangeScale(distance_scaling, PointType());
+
+      const int num_lasers = ALL_LASERS ? M_SERIES_NUM_LASERS : num_selected_lasers_;
+
+      std::uint32_t return_masks[M_SERIES_NUM_RETURNS];
+      returnMasks(return_masks);
+
+      // points of one firing; written unconditionally and then appended
+      PointType firing_points[M_SERIES_NUM_LASERS * M_SERIES_NUM_RETURNS];
+
       // for each firing
       for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
       {
         const MSeriesFiringData &firing = data_packet.data_body.data[firing_index];
-        firing_cloud_->clear();
-        firing_cloud_->is_dense = true;
-        PointCloudHVDIR::PointType hvdir;
+        auto& decoded_firing = decoded.firings[firing_index];
 
-        // populate firing cloud
-        hvdir.h = horizontal_angle_lookup_table_[firing.position];
+        decoded_firing.position = firing.position;
+        decoded_firing.is_dense = true;
+        decoded_firing.begin = decoded_firing.end = static_cast<std::uint32_t>(points.size());
 
-        // for each laser
-        for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; laser_index++)
+        // skip firings outside the azimuth window or decimated away before building any points
+        decoded_firing.keep = keepFiring(firing.position, sequence * M_SERIES_FIRING_PER_PKT + firing_index);
+        if (!decoded_firing.keep)
         {
-          hvdir.v = vertical_angle_lookup_table_[laser_index];
-          hvdir.ring = laser_index;
-
-          if (return_selection_ == quanergy::client::ALL_RETURNS)
-          {
-            // for the all case, we won't keep NaN points and we'll compare
-            // distances to illiminate duplicates
-            // index 2 could equal index 0 and/or index 1
-            // index 1 could equal index 0 but only if all 3 are equal so don't need to check that as separate case
-            std::uint32_t dist2 = firing.returns_distances[2][laser_index];
-
-            std::uint32_t dist0 = firing.returns_distances[0][laser_index];
-            if (dist0 != 0 && dist0 != dist2)
-            {
-              hvdir.intensity = firing.returns_intensities[0][laser_index];
-              hvdir.d = static_cast<float>(dist0) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
-
-            std::uint32_t dist1 = firing.returns_distances[1][laser_index];
-            if (dist1 != 0 && dist1 != dist2)
-            {
-              hvdir.intensity = firing.returns_intensities[1][laser_index];
-              hvdir.d = static_cast<float>(dist1) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
-
-            if (dist2 != 0)
-            {
-              hvdir.intensity = firing.returns_intensities[2][laser_index];
-              hvdir.d = static_cast<float>(dist2) * distance_scaling; // convert range to meters
-              // add the point to the current firing
-              firing_cloud_->push_back(hvdir);
-            }
-
-          } // if (return_selection_ == quanergy::client::ALL_RETURNS)
-          else
-          {
-            // just want a single return case
-            hvdir.intensity = firing.returns_intensities[return_selection_][laser_index];
-
-            if (firing.returns_distances[return_selection_][laser_index] == 0)
-            {
-              hvdir.d = std::numeric_limits<float>::quiet_NaN();
-              // if the range is NaN, the cloud is not dense
-              firing_cloud_->is_dense = false;
-            }
-            else
-            {
-              hvdir.d = static_cast<float>(firing.returns_distances[return_selection_][laser_index]) * distance_scaling; // convert range to meters
-            }
-
-            // add the point to the current firing
-            firing_cloud_->push_back(hvdir);
-
-          } // else (return_selection_ != quanergy::client::ALL_RETURNS)
+          continue;
+        }
 
-        } // for laser index
+        PointType point;
 
-        // check whether cloud is complete
-        bool complete = checkComplete(hvdir.h, result);
+        // populate firing cloud
+        setPosition(point, firing.position);
 
-        // add firing to scan
-        addFiring(firing_cloud_);
+        int n = 0;
+        bool is_dense = true;
 
-        // organize if appropriate
-        if (complete && return_selection_ != quanergy::client::ALL_RETURNS)
+        // for each selected laser
+        for (int selected_index = 0; selected_index < num_lasers; ++selected_index)
         {
-          organizeCloud(result, M_SERIES_NUM_LASERS);
-        }
-
-        result_updated = result_updated || complete;
+          const int laser_index = ALL_LASERS ? selected_index : selected_lasers_[selected_index];
+          setLaser(point, laser_index, vertical_angle_lookup_table_[laser_index]);
+
+          n += decodeReturns<RETURN_SELECTION>(point,
+                                               &firing.returns_distances[0][laser_index],
+                                               &firing.returns_intensities[0][laser_index],
+                                               M_SERIES_NUM_LASERS, return_masks, range_scale,
+                                               firing_points + n, is_dense);
+        } // for laser index
 
-      } // for firing index
+        points.insert(points.end(), firing_points, firing_points + n);
 
-      return result_updated;
+        decoded_firing.is_dense = is_dense;
+        decoded_firing.end = static_cast<std::uint32_t>(points.size());
 
-    } // parse
+      } // for firing index
+    }
 
   } // namespace client
 
@@ -7,6 +7,8 @@
 
 #include <quanergy/parsers/data_packet_parser_01.h>
 
+#include <quanergy/common/logger.h>
+
 #define RING_VERTICAL_ANGLE_RESOLUTION 0.1 * 3.14 / 180 //anything point closer in vertical angle that this are considered to still be the same ring
 
 namespace quanergy
@@ -30,6 +32,21 @@ namespace quanergy
 
     bool DataPacketParser01::parse(const std::vector<char>& packet, PointCloudHVDIRPtr& result)
     {
+      // check the size before deserializing so a mismatch can be dropped without throwing
+      PacketHeader packet_header;
+      DataHeader01 data_header;
+      deserialize(packet.data(), packet_header);
+      deserialize(packet.data() + sizeof(PacketHeader), data_header);
+
+      if (packet_header.size != sizeof(PacketHeader) + sizeof(DataHeader01) +
+                                data_header.point_count * sizeof(DataPoint01))
+      {
+        QUANERGY_LOG_THROTTLED(WARNING, "Invalid sizes: " << data_header.point_count
+                               << " points and " << packet_header.size << " bytes");
+        reportError(PacketError::SIZE_MISMATCH, SizeMismatchError());
+        return false;
+      }
+
       DataPacket01 data_packet;
       deserialize(packet.data(), data_packet);
 
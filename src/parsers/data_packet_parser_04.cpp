@@ -22,18 +22,18 @@ namespace quanergy
               && deserialize(h->version_patch) == 0x00);
     }
 
-    bool DataPacketParser04::parse(const std::vector<char>& packet, PointCloudHVDIRPtr & result)
+    void DataPacketParser04::decode(const std::vector<char>& packet, DecodedType& decoded,
+                                    std::uint64_t sequence)
     {
+      if (!checkSize(packet, sizeof(DataPacket04), decoded))
+      {
+        return;
+      }
+
       // deserialize
       DataPacket04 data_packet;
       deserialize(packet.data(), data_packet);
 
-      // parse
-      bool result_updated = false;
-
-      // check status
-      validateStatus(static_cast<StatusType>(data_packet.data.data_header.status));
-
       // check that vertical angles have been defined
       if (vertical_angle_lookup_table_.empty())
       {
@@ -46,7 +46,9 @@ namespace quanergy
           return_selection_ != quanergy::client::ALL_RETURNS &&
           data_packet.data.data_header.return_id != return_selection_)
       {
-        throw ReturnIDMismatchError();
+        decoded.valid = false;
+        reportError(PacketError::RETURN_ID_MISMATCH, ReturnIDMismatchError());
+        return;
       }
 
       // this time is used for the cloud stamp which is a 64 bit integer in units of microseconds
@@ -54,66 +56,81 @@ namespace quanergy
         static_cast<std::uint64_t>(data_packet.packet_header.seconds) * 1000000ull +
         static_cast<std::uint64_t>(data_packet.packet_header.nanoseconds) / 1000ull;
 
-      const auto& start = data_packet.data.firings[0].position;
-      const auto& mid   = data_packet.data.firings[M_SERIES_FIRING_PER_PKT/2].position;
-      const auto& end   = data_packet.data.firings[M_SERIES_FIRING_PER_PKT-1].position;
-      registerNewPacket(current_packet_stamp, start, mid, end);
+      // status is validated during assembly so status changes are reported in order
+      beginDecode(decoded, current_packet_stamp,
+                  static_cast<StatusType>(data_packet.data.data_header.status), true);
+
+      // select the specialized firing loop once per packet
+      withDecodedPoints(decoded, [&](auto& points)
+      {
+        if (num_selected_lasers_ == M_SERIES_NUM_LASERS)
+        {
+          decodeFirings<true>(data_packet, points, decoded, sequence);
+        }
+        else
+        {
+          decodeFirings<false>(data_packet, points, decoded, sequence);
+        }
+      });
+
+    } // decode
+
+    template <bool ALL_LASERS, class POINTS>
+    void DataPacketParser04::decodeFirings(const DataPacket04& data_packet, POINTS& points, DecodedType& decoded,
+                                           std::uint64_t sequence) const
+    {
+      using PointType = typename POINTS::value_type;
+
+      const int num_lasers = ALL_LASERS ? M_SERIES_NUM_LASERS : num_selected_lasers_;
 
       // Tens of micrometers.
-      double distance_scaling = 0.00001;
+      const auto range_scale = rangeScale(0.00001, PointType());
+
+      // points of one firing
+      PointType firing_points[M_SERIES_NUM_LASERS];
 
       // for each firing
       for (int firing_index = 0; firing_index < M_SERIES_FIRING_PER_PKT; ++firing_index)
       {
         MSeriesFiringData04 const & firing = data_packet.data.firings[firing_index];
-        firing_cloud_->clear();
-        firing_cloud_->is_dense = true;
-        PointCloudHVDIR::PointType hvdir;
+        auto& decoded_firing = decoded.firings[firing_index];
 
-        // populate firing cloud
-        hvdir.h = horizontal_angle_lookup_table_[firing.position];
+        decoded_firing.position = firing.position;
+        decoded_firing.is_dense = true;
+        decoded_firing.begin = decoded_firing.end = static_cast<std::uint32_t>(points.size());
 
-        // for each laser
-        for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; laser_index++)
+        // skip firings outside the azimuth window or decimated away before building any points
+        decoded_firing.keep = keepFiring(firing.position, sequence * M_SERIES_FIRING_PER_PKT + firing_index);
+        if (!decoded_firing.keep)
         {
-          hvdir.v = vertical_angle_lookup_table_[laser_index];
-          hvdir.ring = laser_index;
-          hvdir.intensity = firing.intensity[laser_index];
-
-          if (firing.radius[laser_index] == 0)
-          {
-            hvdir.d = std::numeric_limits<float>::quiet_NaN();
-            // if the range is NaN, the cloud is not dense
-            firing_cloud_->is_dense = false;
-          }
-          else
-          {
-            hvdir.d = static_cast<float>(firing.radius[laser_index]) * distance_scaling; // convert range to meters
-          }
-
-          // add the point to the current firing
-          firing_cloud_->push_back(hvdir);
+          continue;
+        }
 
-        } // for laser index
+        PointType point;
 
-        // check whether cloud is complete
-        bool complete = checkComplete(hvdir.h, result);
-        // add firing to scan
-        addFiring(firing_cloud_);
+        // populate firing cloud
+        setPosition(point, firing.position);
 
-        // organize if appropriate
-        if (complete)
+        bool is_dense = true;
+
+        // for each selected laser
+        for (int selected_index = 0; selected_index < num_lasers; ++selected_index)
         {
-          organizeCloud(result, M_SERIES_NUM_LASERS);
-        }
+          const int laser_index = ALL_LASERS ? selected_index : selected_lasers_[selected_index];
+          setLaser(point, laser_index, vertical_angle_lookup_table_[laser_index]);
 
-        result_updated = result_updated || complete;
+          // single return packets; the return mask doesn't apply
+          decodeReturns<0>(point, &firing.radius[laser_index], &firing.intensity[laser_index], 1,
+                           nullptr, range_scale, firing_points + selected_index, is_dense);
+        } // for laser index
 
-      } // for firing index
+        points.insert(points.end(), firing_points, firing_points + num_lasers);
 
-      return result_updated;
+        decoded_firing.is_dense = is_dense;
+        decoded_firing.end = static_cast<std::uint32_t>(points.size());
 
-    } // parse
+      } // for firing index
+    }
 
   } // namespace client
 
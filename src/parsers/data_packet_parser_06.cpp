@@ -23,22 +23,20 @@ namespace quanergy
 
     }
 
-    bool DataPacketParser06::parse(const std::vector<char>& packet, PointCloudHVDIRPtr & result)
+    void DataPacketParser06::decode(const std::vector<char>& packet, DecodedType& decoded,
+                                    std::uint64_t sequence)
     {
-      bool retval = false;
-
       const M1DataHeader* h = reinterpret_cast<const M1DataHeader*>(packet.data()+sizeof(PacketHeader));
 
-      if (deserialize(h->return_id) == 3)
+      // a packet too short to hold the data header fails the size check of decode<1>
+      if (packet.size() >= sizeof(PacketHeader) + sizeof(M1DataHeader) && deserialize(h->return_id) == 3)
       {
-        retval = parse<3>(packet, result); 
+        decode<3>(packet, decoded, sequence);
       }
       else
       {
-        retval = parse<1>(packet, result);
+        decode<1>(packet, decoded, sequence);
       }
-
-      return retval;
     }
 
   } // namespace client
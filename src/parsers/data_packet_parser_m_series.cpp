@@ -7,20 +7,115 @@
 
 #include <quanergy/parsers/data_packet_parser_m_series.h>
 
+#include <quanergy/common/logger.h>
+
 namespace quanergy
 {
   namespace client
   {
 
+    namespace
+    {
+      // what the frame templates need that differs between PCL clouds and frames
+
+      void setHeader(PointCloudHVDIR& cloud, std::uint64_t stamp, std::uint32_t seq, const std::string& frame_id)
+      {
+        cloud.header.stamp = stamp;
+        cloud.header.seq = seq;
+        cloud.header.frame_id = frame_id;
+      }
+
+      template <class FRAME>
+      void setHeader(FRAME& frame, std::uint64_t stamp, std::uint32_t seq, const std::string& frame_id)
+      {
+        frame.stamp = stamp;
+        frame.seq = seq;
+        frame.frame_id = frame_id;
+      }
+
+      // append decoded points [begin, end)
+      void appendPoints(const MSeriesDecodedPacket& decoded, std::uint32_t begin, std::uint32_t end,
+                        PointCloudHVDIR& cloud)
+      {
+        cloud.points.insert(cloud.points.end(), decoded.points.begin() + begin, decoded.points.begin() + end);
+      }
+
+      void appendPoints(const MSeriesDecodedPacket& decoded, std::uint32_t begin, std::uint32_t end,
+                        FrameHVDIR& frame)
+      {
+        // the decoded points of a packet are cache resident, so fill a column at a time
+        for (auto i = begin; i < end; ++i)
+          frame.h.push_back(decoded.points[i].h);
+        for (auto i = begin; i < end; ++i)
+          frame.v.push_back(decoded.points[i].v);
+        for (auto i = begin; i < end; ++i)
+          frame.d.push_back(decoded.points[i].d);
+        for (auto i = begin; i < end; ++i)
+          frame.intensity.push_back(decoded.points[i].intensity);
+        for (auto i = begin; i < end; ++i)
+          frame.ring.push_back(decoded.points[i].ring);
+      }
+
+      void appendPoints(const MSeriesDecodedPacket& decoded, std::uint32_t begin, std::uint32_t end,
+                        FrameCompact& frame)
+      {
+        frame.points.insert(frame.points.end(),
+                            decoded.compact_points.begin() + begin, decoded.compact_points.begin() + end);
+      }
+
+      // transpose from collect and laser order to one row per laser from the top down
+      template <class COLUMN>
+      void transposeColumn(const COLUMN& from, COLUMN& to, unsigned int width, unsigned int height)
+      {
+        std::size_t index = 0;
+        for (int i = height - 1; i >= 0; --i)
+        {
+          for (unsigned int j = 0; j < width; ++j)
+          {
+            to[index++] = from[j * height + i];
+          }
+        }
+      }
+
+      void transpose(const PointCloudHVDIR& from, PointCloudHVDIR& to, unsigned int width, unsigned int height)
+      {
+        to.header = from.header;
+        to.is_dense = from.is_dense;
+        to.points.resize(from.size());
+        transposeColumn(from.points, to.points, width, height);
+      }
+
+      void transpose(const FrameHVDIR& from, FrameHVDIR& to, unsigned int width, unsigned int height)
+      {
+        setHeader(to, from.stamp, from.seq, from.frame_id);
+        to.is_dense = from.is_dense;
+        to.resize(from.size());
+        transposeColumn(from.h, to.h, width, height);
+        transposeColumn(from.v, to.v, width, height);
+        transposeColumn(from.d, to.d, width, height);
+        transposeColumn(from.intensity, to.intensity, width, height);
+        transposeColumn(from.ring, to.ring, width, height);
+      }
+
+      void transpose(const FrameCompact& from, FrameCompact& to, unsigned int width, unsigned int height)
+      {
+        setHeader(to, from.stamp, from.seq, from.frame_id);
+        to.is_dense = from.is_dense;
+        to.resize(from.size());
+        transposeColumn(from.points, to.points, width, height);
+      }
+    }
+
     DataPacketParserMSeries::DataPacketParserMSeries()
-      : firing_cloud_(new PointCloudHVDIR())
-      , current_cloud_(new PointCloudHVDIR())
+      : current_cloud_(new PointCloudHVDIR())
       , worker_cloud_(new PointCloudHVDIR())
       , horizontal_angle_lookup_table_(M_SERIES_NUM_ROT_ANGLES+1)
+      , azimuth_lookup_table_(M_SERIES_NUM_ROT_ANGLES+1)
     {
       // Reserve space ahead of time for incoming data
       current_cloud_->reserve(maximum_cloud_size_);
       worker_cloud_->reserve(maximum_cloud_size_);
+      decoded_.points.reserve(M_SERIES_FIRING_PER_PKT * M_SERIES_NUM_LASERS * M_SERIES_NUM_RETURNS);
 
       for (std::uint32_t i = 0; i <= M_SERIES_NUM_ROT_ANGLES; i++)
       {
@@ -33,6 +128,7 @@ namespace quanergy
         double rad = n * M_PI * 2.0 - M_PI;
 
         horizontal_angle_lookup_table_[i] = rad;
+        azimuth_lookup_table_[i] = FrameCompact::angleToAzimuth(rad);
       }
     }
 
@@ -71,6 +167,58 @@ namespace quanergy
       angle_per_cloud_ = degrees_per_cloud*M_PI/180.;
     }
 
+    void DataPacketParserMSeries::setAzimuthWindow(std::int32_t min_position, std::int32_t max_position)
+    {
+      if (min_position < 0 || min_position >= M_SERIES_NUM_ROT_ANGLES ||
+          max_position < 0 || max_position >= M_SERIES_NUM_ROT_ANGLES)
+      {
+        throw std::invalid_argument(std::string("Azimuth window positions must be between 0 and ")
+                                    + std::to_string(M_SERIES_NUM_ROT_ANGLES - 1));
+      }
+
+      azimuth_window_min_ = min_position;
+      azimuth_window_max_ = max_position;
+    }
+
+    void DataPacketParserMSeries::setFiringStride(int stride)
+    {
+      if (stride < 1)
+      {
+        throw std::invalid_argument("Firing stride must be at least 1");
+      }
+
+      firing_stride_ = stride;
+    }
+
+    void DataPacketParserMSeries::setRingMask(int ring_mask)
+    {
+      if (ring_mask <= 0 || ring_mask >= (1 << M_SERIES_NUM_LASERS))
+      {
+        throw std::invalid_argument(std::string("Ring mask must select at least one of ")
+                                    + std::to_string(M_SERIES_NUM_LASERS) + " rings");
+      }
+
+      num_selected_lasers_ = 0;
+      for (int laser_index = 0; laser_index < M_SERIES_NUM_LASERS; ++laser_index)
+      {
+        if (ring_mask & (1 << laser_index))
+        {
+          selected_lasers_[num_selected_lasers_++] = laser_index;
+        }
+      }
+    }
+
+    void DataPacketParserMSeries::setReturnMask(int return_mask)
+    {
+      if (return_mask <= 0 || return_mask >= (1 << M_SERIES_NUM_RETURNS))
+      {
+        throw std::invalid_argument(std::string("Return mask must select at least one of ")
+                                    + std::to_string(M_SERIES_NUM_RETURNS) + " returns");
+      }
+
+      return_mask_ = return_mask;
+    }
+
     void DataPacketParserMSeries::setVerticalAngles(const std::vector<double> &vertical_angles)
     {
       // this is only intended for M8/MQ8
@@ -102,17 +250,167 @@ namespace quanergy
       }
     }
 
-    void DataPacketParserMSeries::validateStatus(const StatusType& status)
+    bool DataPacketParserMSeries::assemble(const DecodedType& decoded, PointCloudHVDIRPtr& result)
+    {
+      if (decoded.compact)
+      {
+        throw std::invalid_argument("Compact decoded packets can only be assembled into FrameCompact");
+      }
+
+      return assembleFrame(decoded, current_cloud_, worker_cloud_, result);
+    }
+
+    bool DataPacketParserMSeries::assemble(const DecodedType& decoded, FrameHVDIRPtr& result)
+    {
+      if (decoded.compact)
+      {
+        throw std::invalid_argument("Compact decoded packets can only be assembled into FrameCompact");
+      }
+
+      if (!current_frame_)
+      {
+        current_frame_.reset(new FrameHVDIR());
+        current_frame_->reserve(maximum_cloud_size_);
+        worker_frame_.reset(new FrameHVDIR());
+      }
+
+      return assembleFrame(decoded, current_frame_, worker_frame_, result);
+    }
+
+    bool DataPacketParserMSeries::assemble(const DecodedType& decoded, FrameCompactPtr& result)
+    {
+      if (decoded.valid && !decoded.compact)
+      {
+        throw std::invalid_argument("FrameCompact can only be assembled from compact decoded packets; "
+                                    "call setDecodeCompact(true)");
+      }
+
+      if (!current_compact_)
+      {
+        current_compact_.reset(new FrameCompact());
+        current_compact_->reserve(maximum_cloud_size_);
+        worker_compact_.reset(new FrameCompact());
+      }
+
+      if (!assembleFrame(decoded, current_compact_, worker_compact_, result))
+      {
+        return false;
+      }
+
+      compactVerticalAngles(result->vertical_angles);
+      return true;
+    }
+
+    void DataPacketParserMSeries::compactVerticalAngles(float (&vertical_angles)[M_SERIES_NUM_LASERS]) const
+    {
+      for (std::size_t i = 0; i < M_SERIES_NUM_LASERS && i < vertical_angle_lookup_table_.size(); ++i)
+      {
+        vertical_angles[i] = static_cast<float>(vertical_angle_lookup_table_[i]);
+      }
+    }
+
+    template <class FRAME_PTR>
+    bool DataPacketParserMSeries::assembleFrame(const DecodedType& decoded, FRAME_PTR& current,
+                                                FRAME_PTR& worker, FRAME_PTR& result)
+    {
+      bool result_updated = false;
+
+      // packet dropped during decode
+      if (!decoded.valid)
+      {
+        return false;
+      }
+
+      // reports error if status is fatal
+      if (!validateStatus(decoded.status))
+      {
+        return false;
+      }
+
+      const auto& start = decoded.firings[0].position;
+      const auto& mid   = decoded.firings[M_SERIES_FIRING_PER_PKT/2].position;
+      const auto& end   = decoded.firings[M_SERIES_FIRING_PER_PKT-1].position;
+      registerNewPacket(decoded.stamp, start, mid, end);
+
+      // for each firing
+      for (const auto& firing : decoded.firings)
+      {
+        bool complete;
+
+        if (!firing.keep)
+        {
+          complete = skipFiring(firing.position, current, result);
+        }
+        else
+        {
+          // check whether cloud is complete
+          complete = checkComplete(horizontal_angle_lookup_table_[firing.position], current, result);
+
+          // add firing to scan
+          addFiring(decoded, firing, current);
+        }
+
+        // organize if appropriate
+        if (complete && decoded.organize)
+        {
+          organizeCloud(result, worker, num_selected_lasers_);
+        }
+
+        result_updated = result_updated || complete;
+      }
+
+      return result_updated;
+    }
+
+    bool DataPacketParserMSeries::checkSize(const std::vector<char>& packet, std::size_t size,
+                                            DecodedType& decoded)
+    {
+      if (packet.size() == size)
+      {
+        return true;
+      }
+
+      QUANERGY_LOG_THROTTLED(WARNING, "Invalid size: " << packet.size() << " bytes for a packet of "
+                             << size << " bytes");
+      decoded.valid = false;
+      reportError(PacketError::SIZE_MISMATCH, SizeMismatchError());
+      return false;
+    }
+
+    void DataPacketParserMSeries::beginDecode(DecodedType& decoded, std::uint64_t stamp,
+                                              StatusType status, bool organize) const
+    {
+      decoded.stamp = stamp;
+      decoded.status = status;
+      decoded.organize = organize;
+      decoded.valid = true;
+      decoded.compact = decode_compact_;
+      decoded.points.clear();
+      decoded.compact_points.clear();
+    }
+
+    bool DataPacketParserMSeries::validateStatus(const StatusType& status)
     {
+      if (status != previous_status_)
+      {
+        // only logged on change so it isn't rate limited
+        QUANERGY_LOG(WARNING, "Sensor status: " << std::uint16_t(status));
+
+        previous_status_ = status;
+        status_transitions_.fetch_add(1, std::memory_order_relaxed);
+      }
+
       if (status != StatusType::GOOD)
       {
         if (static_cast<std::uint16_t>(status) & static_cast<std::uint16_t>(StatusType::SENSOR_SW_FW_MISMATCH))
         {
-          throw FirmwareVersionMismatchError();
+          reportError(PacketError::FIRMWARE_VERSION_MISMATCH, FirmwareVersionMismatchError());
+          return false;
         }
         else if (static_cast<std::uint16_t>(status) & static_cast<std::uint16_t>(StatusType::WATCHDOG_VIOLATION))
         {
-          throw FirmwareWatchdogViolationError();
+          reportError(PacketError::FIRMWARE_WATCHDOG_VIOLATION, FirmwareWatchdogViolationError());
+          return false;
         }
 
         // Status flag is set, but the value is not currently known in
@@ -121,12 +419,7 @@ namespace quanergy
         // nothing.
       }
 
-      if (status != previous_status_)
-      {
-        std::cerr << "Sensor status: " << std::uint16_t(status) << std::endl;
-
-        previous_status_ = status;
-      }
+      return true;
     }
 
     // register new packet for time and direction
@@ -159,11 +452,12 @@ namespace quanergy
       firing_number_ = 0;
     }
 
-    bool DataPacketParserMSeries::checkComplete(const float& azimuth_angle, PointCloudHVDIRPtr& result)
+    template <class FRAME_PTR>
+    bool DataPacketParserMSeries::checkComplete(const float& azimuth_angle, FRAME_PTR& current, FRAME_PTR& result)
     {
       bool result_updated = false;
 
-      bool cloudfull = (current_cloud_->size() >= maximum_cloud_size_);
+      bool cloudfull = (current->size() >= maximum_cloud_size_);
 
       // get swept angle
       double delta_angle = 0;
@@ -185,14 +479,14 @@ namespace quanergy
       if (delta_angle >= angle_per_cloud_ || (angle_per_cloud_==2*M_PI && (direction_*azimuth_angle < direction_*last_azimuth_)))
       {
         start_azimuth_ = azimuth_angle;
-        if (current_cloud_->size () > minimum_cloud_size_)
+        if (current->size () > minimum_cloud_size_)
         {
           // we have a successful packet
 
           if(cloudfull)
           {
-            std::cout << "Warning: Maximum cloud size limit of ("
-                << maximum_cloud_size_ << ") exceeded" << std::endl;
+            QUANERGY_LOG_THROTTLED(WARNING, "Warning: Maximum cloud size limit of ("
+                                   << maximum_cloud_size_ << ") exceeded");
           }
 
           // interpolate the timestamp from the previous packet timestamp to the timestamp of this firing
@@ -202,30 +496,28 @@ namespace quanergy
           const std::uint64_t current_firing_stamp = previous_packet_stamp_ms_
               + static_cast<std::uint64_t>(std::round(time_since_previous_packet_ms));
 
-          current_cloud_->header.stamp = current_firing_stamp;
-          current_cloud_->header.seq = cloud_counter_;
-          current_cloud_->header.frame_id = frame_id_;
+          setHeader(*current, current_firing_stamp, cloud_counter_, frame_id_);
 
           ++cloud_counter_;
 
           // fire the signal that we have a new cloud
-          result = current_cloud_;
+          result = current;
           // set the size which until organized is 1 x num_points
           result->height = 1;
           result->width = result->size();
           result_updated = true;
         }
-        else if(current_cloud_->size() > 0)
+        else if(current->size() > 0)
         {
-          std::cout << "Warning: Minimum cloud size limit of (" << minimum_cloud_size_
-              << ") not reached (" << current_cloud_->size() << ")" << std::endl;
+          QUANERGY_LOG_THROTTLED(WARNING, "Warning: Minimum cloud size limit of (" << minimum_cloud_size_
+                                 << ") not reached (" << current->size() << ")");
         }
 
         // start a new cloud
-        current_cloud_.reset(new PointCloudHVDIR());
+        current.reset(new typename FRAME_PTR::element_type());
         // at first we assume it is dense
-        current_cloud_->is_dense = true;
-        current_cloud_->reserve(maximum_cloud_size_);
+        current->is_dense = true;
+        current->reserve(maximum_cloud_size_);
         cloudfull = false;
       }
 
@@ -234,26 +526,39 @@ namespace quanergy
       return result_updated;
     }
 
-    void DataPacketParserMSeries::addFiring(const PointCloudHVDIRPtr& firing_cloud)
+    template <class FRAME_PTR>
+    bool DataPacketParserMSeries::skipFiring(std::uint16_t position, FRAME_PTR& current, FRAME_PTR& result)
+    {
+      bool complete = checkComplete(horizontal_angle_lookup_table_[position], current, result);
+
+      // keep counting firings so the cloud timestamp interpolation stays correct
+      ++firing_number_;
+
+      return complete;
+    }
+
+    template <class FRAME_PTR>
+    void DataPacketParserMSeries::addFiring(const DecodedType& decoded, const DecodedType::Firing& firing,
+                                            FRAME_PTR& current)
     {
-      if (firing_cloud_->empty())
+      if (firing.begin == firing.end)
         return;
 
-      bool cloudfull = (current_cloud_->size() >= maximum_cloud_size_);
+      bool cloudfull = (current->size() >= maximum_cloud_size_);
 
       // if the cloud isn't full, add the firing
       if (!cloudfull)
       {
         ++firing_number_;
 
-        current_cloud_->points.insert(current_cloud_->points.end(),
-          firing_cloud->points.begin(), firing_cloud->points.end());
+        appendPoints(decoded, firing.begin, firing.end, *current);
 
-        current_cloud_->is_dense = current_cloud_->is_dense && firing_cloud->is_dense;
+        current->is_dense = current->is_dense && firing.is_dense;
       }
     }
 
-    void DataPacketParserMSeries::organizeCloud(PointCloudHVDIRPtr& current_pc, 
+    template <class FRAME_PTR>
+    void DataPacketParserMSeries::organizeCloud(FRAME_PTR& current_pc, FRAME_PTR& worker,
                                                 unsigned int height)
     {
       if (height == 0 || current_pc->size() % height != 0)
@@ -266,38 +571,19 @@ namespace quanergy
       // if height is 1, there is no need to transpose the cloud
       if (height != 1)
       {
-        // transpose the cloud
-        worker_cloud_->clear();
-
-        worker_cloud_->header.stamp = current_pc->header.stamp;
-        worker_cloud_->header.seq = current_pc->header.seq;
-        worker_cloud_->header.frame_id = current_pc->header.frame_id;
-
-        // reserve space
-        worker_cloud_->reserve(current_pc->size());
+        transpose(*current_pc, *worker, width, height);
 
-        unsigned int temp_index;
-
-        // iterate through each ring from top down
-        for (int i = height - 1; i >= 0; --i)
-        {
-          // iterate through width in collect order
-          for (unsigned int j = 0; j < width; ++j)
-          {
-            // original data is in collect order and laser order
-            temp_index = j * height + i;
-
-            worker_cloud_->push_back(current_pc->points[temp_index]);
-          }
-        }
-
-        current_pc.swap(worker_cloud_);
+        current_pc.swap(worker);
       }
 
       current_pc->height = height;
       current_pc->width  = width;
     }
 
+    // organizeCloud is also used directly by the benchmarks
+    template void DataPacketParserMSeries::organizeCloud(PointCloudHVDIRPtr&, PointCloudHVDIRPtr&, unsigned int);
+    template void DataPacketParserMSeries::organizeCloud(FrameHVDIRPtr&, FrameHVDIRPtr&, unsigned int);
+
   } // namespace client
 
 } // namespace quanergy
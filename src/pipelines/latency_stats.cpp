@@ -0,0 +1,110 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <quanergy/pipelines/latency_stats.h>
+
+#include <iomanip>
+#include <sstream>
+
+#include <quanergy/common/logger.h>
+
+namespace quanergy
+{
+  namespace pipeline
+  {
+
+    LatencyStats::~LatencyStats()
+    {
+      stopReporting();
+    }
+
+    LatencyHistogram& LatencyStats::histogram(const std::string& stage)
+    {
+      std::lock_guard<std::mutex> lk(histograms_mutex_);
+
+      auto& histogram = histograms_[stage];
+      if (!histogram)
+        histogram.reset(new LatencyHistogram());
+
+      return *histogram;
+    }
+
+    std::map<std::string, LatencySummary> LatencyStats::snapshot() const
+    {
+      std::lock_guard<std::mutex> lk(histograms_mutex_);
+
+      std::map<std::string, LatencySummary> result;
+      for (const auto& histogram : histograms_)
+        result[histogram.first] = histogram.second->summary();
+
+      return result;
+    }
+
+    void LatencyStats::reset()
+    {
+      std::lock_guard<std::mutex> lk(histograms_mutex_);
+
+      for (auto& histogram : histograms_)
+        histogram.second->reset();
+    }
+
+    std::string LatencyStats::report() const
+    {
+      std::ostringstream out;
+      out << std::fixed << std::setprecision(1);
+
+      for (const auto& stage : snapshot())
+      {
+        const LatencySummary& s = stage.second;
+        if (out.tellp() > 0)
+          out << "\n";
+
+        out << stage.first << ": count " << s.count
+            << " p50 " << s.p50 * 1e-3 << "us"
+            << " p99 " << s.p99 * 1e-3 << "us"
+            << " p999 " << s.p999 * 1e-3 << "us"
+            << " max " << s.max * 1e-3 << "us";
+      }
+
+      return out.str();
+    }
+
+    void LatencyStats::setReportPeriod(std::chrono::milliseconds period, bool reset_after_report)
+    {
+      stopReporting();
+
+      if (period <= std::chrono::milliseconds::zero())
+        return;
+
+      kill_ = false;
+      report_thread_ = std::thread([this, period, reset_after_report]
+                                   {
+                                     std::unique_lock<std::mutex> lk(report_mutex_);
+                                     while (!report_conditional_.wait_for(lk, period, [this]{ return kill_; }))
+                                     {
+                                       QUANERGY_LOG(INFO, "Pipeline latency\n" << report());
+                                       if (reset_after_report)
+                                         reset();
+                                     }
+                                   });
+    }
+
+    void LatencyStats::stopReporting()
+    {
+      {
+        std::lock_guard<std::mutex> lk(report_mutex_);
+        kill_ = true;
+      }
+      report_conditional_.notify_one();
+
+      if (report_thread_.joinable())
+        report_thread_.join();
+    }
+
+  } // namespace pipeline
+
+} // namespace quanergy
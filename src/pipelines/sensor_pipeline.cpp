@@ -7,21 +7,30 @@
 
 #include <quanergy/pipelines/sensor_pipeline.h>
 
-#include <quanergy/client/device_info.h>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
 #include <quanergy/client/exceptions.h>
+#include <quanergy/common/logger.h>
+#include <quanergy/common/trace.h>
 
 namespace quanergy
 {
   namespace pipeline
   {
     SensorPipeline::SensorPipeline(const SensorPipelineSettings& settings)
-    {
       // get deviceInfo from sensor and apply calibration
-      quanergy::client::DeviceInfo device_info(settings.host);
+      : SensorPipeline(settings, quanergy::client::DeviceInfo(settings.host))
+    {
+    }
 
+    SensorPipeline::SensorPipeline(const SensorPipelineSettings& settings,
+                                   const quanergy::client::DeviceInfo& device_info)
+    {
       // get sensor type
       auto model = device_info.model();
-      std::cout << "got model from device info: " << model << std::endl;
+      QUANERGY_LOG(INFO, "got model from device info: " << model);
 
       // 'model.rfind(sub, 0) == 0' checks only the first position (the beginning) of model for sub
       // and is true if sub was found there
@@ -29,27 +38,39 @@ namespace quanergy
                               || model.rfind("M8", 0) == 0
                               || model.rfind("M1", 0) == 0;
 
+      if (settings.output != "cloud" && settings.output != "compact" && settings.output != "both")
+      {
+        throw std::invalid_argument("Invalid pipeline output: " + settings.output);
+      }
+
+      parse_cloud = settings.output != "compact";
+      parse_compact = settings.output != "cloud";
+      if (parse_compact && !m_series)
+      {
+        throw std::invalid_argument("Compact pipeline output is only supported for M-series sensors");
+      }
+
       if (m_series)
       {
         // encoder params
         if (settings.calibrate)
         {
-          std::cout << "Encoder calibration will be performed" << std::endl;
+          QUANERGY_LOG(INFO, "Encoder calibration will be performed");
           encoder_corrector.setFrameRate(settings.frame_rate);
         }
         else if (settings.override_encoder_params)
         {
-          std::cout << "Encoder calibration parameters provided will be applied" << std::endl;
+          QUANERGY_LOG(INFO, "Encoder calibration parameters provided will be applied");
           encoder_corrector.setParams(settings.amplitude, settings.phase);
         }
         else if (device_info.amplitude() && device_info.phase())
         {
-          std::cout << "Encoder calibration parameters from the sensor will be applied" << std::endl;
+          QUANERGY_LOG(INFO, "Encoder calibration parameters from the sensor will be applied");
           encoder_corrector.setParams(*device_info.amplitude(), *device_info.phase());
         }
         else
         {
-          std::cout << "No encoder calibration will be applied" << std::endl;
+          QUANERGY_LOG(INFO, "No encoder calibration will be applied");
           encoder_corrector.setParams(0.f, 0.f); // turns off calibration procedure
         }
 
@@ -64,14 +85,18 @@ namespace quanergy
           // send the vertical angles to the parsers
           parser.get<PARSER_00_INDEX>().setVerticalAngles(vertical_angles);
           parser.get<PARSER_04_INDEX>().setVerticalAngles(vertical_angles);
+          compact_parser.get<COMPACT_PARSER_00_INDEX>().setVerticalAngles(vertical_angles);
+          compact_parser.get<COMPACT_PARSER_04_INDEX>().setVerticalAngles(vertical_angles);
         }
         else if (model.rfind("M8", 0) == 0)
         {
-          std::cout << "No vertical angle calibration information available on sensor, proceeding with M8 defaults" << std::endl;
+          QUANERGY_LOG(INFO, "No vertical angle calibration information available on sensor, proceeding with M8 defaults");
 
           // tell parsers to use M8 defaults
           parser.get<PARSER_00_INDEX>().setVerticalAngles(quanergy::client::SensorType::M8);
           parser.get<PARSER_04_INDEX>().setVerticalAngles(quanergy::client::SensorType::M8);
+          compact_parser.get<COMPACT_PARSER_00_INDEX>().setVerticalAngles(quanergy::client::SensorType::M8);
+          compact_parser.get<COMPACT_PARSER_04_INDEX>().setVerticalAngles(quanergy::client::SensorType::M8);
         }
         else if (model.rfind("MQ", 0) == 0)
         {
@@ -81,44 +106,97 @@ namespace quanergy
       }
 
       // Setup modules
-      // Parsers
-      auto &parser00 = parser.get<PARSER_00_INDEX>();
-      auto &parser01 = parser.get<PARSER_01_INDEX>();
-      auto &parser04 = parser.get<PARSER_04_INDEX>();
-      auto &parser06 = parser.get<PARSER_06_INDEX>();
-
-      // Parser 00
-      parser00.setFrameId(settings.frame);
-      parser00.setReturnSelection(settings.return_selection);
-      parser00.setCloudSizeLimits(
-        settings.min_cloud_size,
-        settings.max_cloud_size
-      );
+      // Parsers; the compact parser has the same M-series parsers, configured the same way
+      auto configure_m_series = [&settings](quanergy::client::DataPacketParserMSeries& parser00,
+                                            quanergy::client::DataPacketParserMSeries& parser04,
+                                            quanergy::client::DataPacketParserMSeries& parser06)
+      {
+        // Parser 00
+        parser00.setFrameId(settings.frame);
+        parser00.setReturnSelection(settings.return_selection);
+        parser00.setCloudSizeLimits(
+          settings.min_cloud_size,
+          settings.max_cloud_size
+        );
+        parser00.setAzimuthWindow(
+          settings.azimuth_window_min,
+          settings.azimuth_window_max
+        );
+        parser00.setFiringStride(settings.firing_stride);
+        parser00.setRingMask(settings.ring_mask);
+        parser00.setReturnMask(settings.return_mask);
+
+        // Parser 04
+        parser04.setFrameId(settings.frame);
+        if (settings.return_selection_set)
+        {
+          parser04.setReturnSelection(settings.return_selection);
+        }
+        parser04.setCloudSizeLimits(
+          settings.min_cloud_size,
+          settings.max_cloud_size
+        );
+        parser04.setAzimuthWindow(
+          settings.azimuth_window_min,
+          settings.azimuth_window_max
+        );
+        parser04.setFiringStride(settings.firing_stride);
+        parser04.setRingMask(settings.ring_mask);
+
+        // Parser 06
+        parser06.setFrameId(settings.frame);
+        if (settings.return_selection_set)
+        {
+          parser06.setReturnSelection(settings.return_selection);
+        }
+        parser06.setCloudSizeLimits(
+          settings.min_cloud_size,
+          settings.max_cloud_size
+        );
+        parser06.setAzimuthWindow(
+          settings.azimuth_window_min,
+          settings.azimuth_window_max
+        );
+        parser06.setFiringStride(settings.firing_stride);
+        parser06.setReturnMask(settings.return_mask);
+      };
+
+      configure_m_series(parser.get<PARSER_00_INDEX>(), parser.get<PARSER_04_INDEX>(), parser.get<PARSER_06_INDEX>());
 
       // Parser 01
-      parser01.setFrameId(settings.frame);
+      parser.get<PARSER_01_INDEX>().setFrameId(settings.frame);
 
-      // Parser 04
-      parser04.setFrameId(settings.frame);
-      if (settings.return_selection_set)
-      {
-        parser04.setReturnSelection(settings.return_selection);
-      }
-      parser04.setCloudSizeLimits(
-        settings.min_cloud_size,
-        settings.max_cloud_size
-      );
+      configure_m_series(compact_parser.get<COMPACT_PARSER_00_INDEX>(),
+                         compact_parser.get<COMPACT_PARSER_04_INDEX>(),
+                         compact_parser.get<COMPACT_PARSER_06_INDEX>());
+      compact_parser.get<COMPACT_PARSER_00_INDEX>().setDecodeCompact(true);
+      compact_parser.get<COMPACT_PARSER_04_INDEX>().setDecodeCompact(true);
+      compact_parser.get<COMPACT_PARSER_06_INDEX>().setDecodeCompact(true);
 
-      // Parser 06
-      parser06.setFrameId(settings.frame);
-      if (settings.return_selection_set)
+      parser.setErrorPolicy(settings.continue_on_packet_error ?
+                            quanergy::client::ErrorPolicy::CONTINUE :
+                            quanergy::client::ErrorPolicy::THROW);
+      compact_parser.setErrorPolicy(parser.getErrorPolicy());
+
+      // timeline tracing
+      cloud_async.setTraceName("cloud_async");
+      scan_async.setTraceName("scan_async");
+      compact_async.setTraceName("compact_async");
+      cloud_fan_out.setThreads(settings.cloud_subscriber_threads);
+      cloud_fan_out.setTraceName("cloud_subscriber");
+      trace_file = settings.trace_file;
+      trace_window = settings.trace_window;
+      if (!trace_file.empty())
       {
-        parser06.setReturnSelection(settings.return_selection);
+        QUANERGY_LOG(INFO, "Tracing pipeline activity to " << trace_file);
+        Tracer::instance().enable(true);
       }
-      parser06.setCloudSizeLimits(
-        settings.min_cloud_size,
-        settings.max_cloud_size
-      );
+
+      // start decode threads once the parsers are configured
+      if (parse_cloud)
+        parser.setDecodeThreads(settings.decode_threads);
+      if (parse_compact)
+        compact_parser.setDecodeThreads(settings.decode_threads);
 
       // Filters
       // Distance Filter
@@ -136,73 +214,531 @@ namespace quanergy
         );
       }
 
-      if (m_series)
+      // the modules are wired with callbacks, which don't lock per call; they live as long as the
+      // pipeline so nothing needs disconnecting
+
+      // count frames for metrics and decide whether this one is shed; frame_shedding is the flag of the
+      // parser calling
+      shed_frames = settings.shed_frames;
+      auto count_frame = [this](bool& frame_shedding, const auto& frame)
       {
-        // Connect modules for m_series
-        // Parser to Encoder Corrector
-        connections.push_back(
-          parser.connect(
-            [this](const ParserModule::ResultType& pc)
-            { encoder_corrector.slot(pc); }
-          )
-        );
+        frame_shedding = shed_frames && congested();
+        if (frame_shedding)
+          frames_shed.fetch_add(1, std::memory_order_relaxed);
 
-        // Encoder Corrector to Distance Filter
-        connections.push_back(
-          encoder_corrector.connect(
-            [this](const quanergy::calibration::EncoderAngleCalibration::ResultType& pc)
-            { distance_filter.slot(pc); }
-          )
-        );
+        if (!frame)
+          return;
 
-        // Distance Filter to Ring Intensity Filter
-        connections.push_back(
-          distance_filter.connect(
-            [this](const quanergy::client::DistanceFilter::ResultType& pc)
-            { ring_intensity_filter.slot(pc); }
-          )
-        );
+        frame_count.fetch_add(1, std::memory_order_relaxed);
+        point_count.fetch_add(frame->size(), std::memory_order_relaxed);
+        last_frame_size.store(frame->size(), std::memory_order_relaxed);
+      };
 
-        // Ring Intensity Filter to Polar->Cartesian Converter
-        connections.push_back(
-          ring_intensity_filter.connect(
-            [this](const quanergy::client::RingIntensityFilter::ResultType& pc)
-            { cartesian_converter.slot(pc); }
-          )
+      parser.connectCallback(
+        [this, count_frame](const ParserModule::PublishedType& pc){ count_frame(shedding, pc); }
+      );
+
+      // connect the stages in order; attach connects a callback to the output of the last stage connected
+      using PolarCallback = std::function<void (const ParserModule::PublishedType&)>;
+      std::function<void (PolarCallback)> attach = [this](PolarCallback callback)
+      {
+        // the single point frames are shed at, before any stage has done work on them
+        parser.connectCallback(
+          [this, callback](const ParserModule::PublishedType& pc)
+          {
+            if (!shedding)
+              callback(pc);
+          }
         );
+      };
+
+      const std::vector<std::string>& stage_list = settings.stages.empty() ? defaultStages(settings, m_series)
+                                                                           : settings.stages;
+
+      // self mask; only set up when the stage runs
+      bool use_self_mask = m_series && !settings.self_mask_file.empty()
+                           && std::find(stage_list.begin(), stage_list.end(), "self_mask") != stage_list.end();
+      if (use_self_mask)
+      {
+        if (settings.self_mask_learn_frames > 0)
+        {
+          QUANERGY_LOG(INFO, "Self mask will be learned over " << settings.self_mask_learn_frames
+                       << " frames and written to " << settings.self_mask_file);
+          self_mask_learner.setNumFrames(settings.self_mask_learn_frames);
+          self_mask_learner.setMaximumBodyRange(settings.self_mask_max_range);
+        }
+        else
+        {
+          QUANERGY_LOG(INFO, "Self mask will be loaded from " << settings.self_mask_file);
+          self_mask_filter.loadMask(settings.self_mask_file);
+        }
       }
-      else
+
+      bool cartesian = false;
+      for (const auto& stage : stage_list)
+      {
+        if (cartesian)
+        {
+          throw std::invalid_argument("cartesian_converter must be the last pipeline stage");
+        }
+
+        if (stage != "async" && std::find(stages.begin(), stages.end(), stage) != stages.end())
+        {
+          throw std::invalid_argument("Pipeline stage " + stage + " appears more than once");
+        }
+
+        if (stage == "encoder_corrector" || stage == "self_mask" || stage == "ring_intensity_filter")
+        {
+          if (!m_series)
+          {
+            QUANERGY_LOG(WARNING, "Pipeline stage " << stage << " only applies to M-series; skipping it");
+            continue;
+          }
+        }
+        else if (stage != "distance_filter" && stage != "async" && stage != "cartesian_converter")
+        {
+          throw std::invalid_argument("Invalid pipeline stage: " + stage);
+        }
+
+        if (stage == "encoder_corrector")
+        {
+          attach([this](const ParserModule::PublishedType& pc){ encoder_corrector.slot(pc); });
+          attach = [this](PolarCallback callback){ encoder_corrector.connectCallback(std::move(callback)); };
+        }
+        else if (stage == "self_mask")
+        {
+          if (settings.self_mask_file.empty())
+          {
+            QUANERGY_LOG(WARNING, "Pipeline stage self_mask needs a self mask file; skipping it");
+            continue;
+          }
+
+          if (settings.self_mask_learn_frames > 0)
+          {
+            // the learner sees the same clouds as the filter, just before it on the same thread, so it can hand
+            // the filter the mask without a lock. the file is written on another thread
+            attach([this](const ParserModule::PublishedType& pc){ self_mask_learner.slot(pc); });
+
+            std::string self_mask_file = settings.self_mask_file;
+            self_mask_learner.connectCallback(
+              [this, self_mask_file](const quanergy::client::SelfMaskLearner::ResultType& mask)
+              {
+                self_mask_filter.setMask(mask);
+                self_mask_saved = std::async(std::launch::async, [mask, self_mask_file]
+                {
+                  try
+                  {
+                    mask.save(self_mask_file);
+                    QUANERGY_LOG(INFO, "Self mask learned and written to " << self_mask_file);
+                  }
+                  catch (std::exception& e)
+                  {
+                    QUANERGY_LOG(ERR, "Self mask learned but not saved: " << e.what());
+                  }
+                });
+              }
+            );
+          }
+
+          attach([this](const ParserModule::PublishedType& pc){ self_mask_filter.slot(pc); });
+          attach = [this](PolarCallback callback){ self_mask_filter.connectCallback(std::move(callback)); };
+        }
+        else if (stage == "distance_filter")
+        {
+          attach([this](const ParserModule::PublishedType& pc){ distance_filter.slot(pc); });
+          attach = [this](PolarCallback callback){ distance_filter.connectCallback(std::move(callback)); };
+        }
+        else if (stage == "ring_intensity_filter")
+        {
+          attach([this](const ParserModule::PublishedType& pc){ ring_intensity_filter.slot(pc); });
+          attach = [this](PolarCallback callback){ ring_intensity_filter.connectCallback(std::move(callback)); };
+        }
+        else if (stage == "async")
+        {
+          stage_asyncs.emplace_back(new ScanAsyncType());
+          ScanAsyncType* async = stage_asyncs.back().get();
+          async->setTraceName("stage_async_" + std::to_string(stage_asyncs.size() - 1));
+
+          attach([async](const ParserModule::PublishedType& pc){ async->slot(pc); });
+          attach = [this, async](PolarCallback callback)
+          {
+            connections.push_back(async->connect(std::move(callback)));
+          };
+        }
+        else if (stage == "cartesian_converter")
+        {
+          // the Cartesian clouds come from the polar clouds, or from the compact frames when those are the
+          // only output
+          using CartesianCallback = quanergy::client::PolarToCartConverter::Callback;
+          std::function<void (CartesianCallback)> cartesian_output;
+          if (parse_cloud)
+          {
+            attach([this](const ParserModule::PublishedType& pc){ cartesian_converter.slot(pc); });
+            cartesian_output = [this](CartesianCallback callback)
+            {
+              cartesian_converter.connectCallback(std::move(callback));
+            };
+          }
+          else
+          {
+            cartesian_output = [this](CartesianCallback callback)
+            {
+              compact_converter.connectCallback(std::move(callback));
+            };
+          }
+
+          // connect to an async module so downstream work happens on a separate thread
+          cartesian_output(
+              [this](const quanergy::client::PolarToCartConverter::ResultType& pc){ cloud_async.slot(pc); }
+          );
+
+          // and on to the cloud subscribers
+          connections.push_back(cloud_async.connect(
+              [this](const CloudAsyncType::ResultType& pc){ cloud_fan_out.slot(pc); }
+          ));
+
+          // keep the newest for polling readers
+          cartesian_output(
+              [this](const quanergy::client::PolarToCartConverter::ResultType& pc){ latest_cloud.slot(pc); }
+          );
+
+          // and the history
+          if (settings.history_frames > 0 || settings.history_seconds > 0. || settings.history_max_bytes > 0)
+          {
+            FrameHistorySettings history_settings;
+            history_settings.max_frames = settings.history_frames;
+            history_settings.max_age = settings.history_seconds;
+            history_settings.max_bytes = settings.history_max_bytes;
+            cloud_history.reset(new CloudHistoryType(history_settings));
+            CloudHistoryType* history = cloud_history.get();
+            cartesian_output(
+                [history](const quanergy::client::PolarToCartConverter::ResultType& pc){ history->slot(pc); }
+            );
+          }
+
+          // and to the pull source, without the thread hop
+          if (settings.cloud_source_capacity > 0)
+          {
+            cloud_source.reset(new CloudSourceType(settings.cloud_source_capacity));
+            CloudSourceType* source = cloud_source.get();
+            cartesian_output(
+                [source](const quanergy::client::PolarToCartConverter::ResultType& pc){ source->slot(pc); }
+            );
+          }
+
+          cartesian = true;
+        }
+
+        stages.push_back(stage);
+      }
+
+      if (!cartesian)
+      {
+        QUANERGY_LOG(INFO, "No cartesian_converter stage; connect_cloud subscribers won't get clouds");
+      }
+
+      // also make the polar-frame data after the last polar stage available to downstream worker threads
+      attach([this](const ParserModule::PublishedType& pc){ scan_async.slot(pc); });
+      attach([this](const ParserModule::PublishedType& pc){ latest_scan.slot(pc); });
+
+      if (parse_compact)
       {
-        // Parser to Distance Filter
-        connections.push_back(
-          parser.connect(
-            [this](const ParserModule::ResultType& pc)
-            { distance_filter.slot(pc); }
-          )
+        if (!parse_cloud)
+        {
+          QUANERGY_LOG(INFO, "Compact pipeline output only; connect_scan subscribers won't get scans");
+
+          // the compact frames stand in for the clouds; the filters that work on them run in place, in stage order
+          std::vector<std::function<void (quanergy::FrameCompact&)>> compact_filters;
+          for (const auto& stage : stages)
+          {
+            if (stage == "distance_filter")
+            {
+              compact_filters.push_back([this](quanergy::FrameCompact& frame){ distance_filter.filter(frame); });
+            }
+            else if (stage == "ring_intensity_filter")
+            {
+              compact_filters.push_back([this](quanergy::FrameCompact& frame){ ring_intensity_filter.filter(frame); });
+            }
+            else if (stage != "cartesian_converter")
+            {
+              QUANERGY_LOG(WARNING, "Pipeline stage " << stage << " doesn't apply to compact frames; skipping it");
+            }
+          }
+
+          if (!compact_filters.empty())
+          {
+            compact_parser.setResultFilter(
+              [compact_filters](quanergy::FrameCompact& frame)
+              {
+                for (const auto& filter : compact_filters)
+                  filter(frame);
+              }
+            );
+          }
+        }
+
+        compact_parser.connectCallback(
+          [this, count_frame](const CompactParserModule::PublishedType& frame)
+          {
+            if (parse_cloud)
+              compact_shedding = shed_frames && congested();
+            else
+              count_frame(compact_shedding, frame);
+          }
         );
 
-        // Distance Filter to Polar->Cartesian Converter
-        connections.push_back(
-          distance_filter.connect(
-            [this](const quanergy::client::DistanceFilter::ResultType& pc)
-            { cartesian_converter.slot(pc); }
-          )
+        compact_parser.connectCallback(
+          [this](const CompactParserModule::PublishedType& frame)
+          {
+            if (!compact_shedding)
+              compact_async.slot(frame);
+          }
         );
+
+        if (!parse_cloud && cartesian)
+        {
+          compact_parser.connectCallback(
+            [this](const CompactParserModule::PublishedType& frame)
+            {
+              if (!compact_shedding)
+                compact_converter.slot(frame);
+            }
+          );
+        }
+      }
+
+      std::string stage_names;
+      for (const auto& stage : stages)
+      {
+        stage_names += (stage_names.empty() ? "" : " ") + stage;
+      }
+      QUANERGY_LOG(INFO, "Pipeline stages: parser " << stage_names << "; output " << settings.output);
+
+      setLatencyInstrumentation(settings.latency_instrumentation);
+      if (settings.latency_report_period > 0.)
+      {
+        latency_stats.setReportPeriod(std::chrono::milliseconds(
+          static_cast<std::int64_t>(settings.latency_report_period * 1000.)));
+      }
+
+    }
+
+    std::vector<std::string> SensorPipeline::defaultStages(const SensorPipelineSettings& settings, bool m_series)
+    {
+      std::vector<std::string> ret;
+
+      if (m_series)
+      {
+        ret.push_back("encoder_corrector");
+
+        if (!settings.self_mask_file.empty())
+        {
+          ret.push_back("self_mask");
+        }
       }
 
-      // connect to an async module so downstream work happens on a separate thread
-      connections.push_back(cartesian_converter.connect(
-          [this](const quanergy::client::PolarToCartConverter::ResultType& pc){ cloud_async.slot(pc); }
-      ));
+      // the default distance limits don't remove anything
+      if (settings.min_distance > 0.f || settings.max_distance < SensorPipelineSettings().max_distance)
+      {
+        ret.push_back("distance_filter");
+      }
 
-      // also make the polar-frame data available to downstream worker threads
-      connections.push_back(ring_intensity_filter.connect(
-          [this](const quanergy::client::RingIntensityFilter::ResultType& pc){ scan_async.slot(pc); }
-      ));
+      // a ring only removes points when both of its thresholds are set
+      if (m_series)
+      {
+        for (int i = 0; i < quanergy::client::M_SERIES_NUM_LASERS; ++i)
+        {
+          if (settings.ring_range[i] > 0.f && settings.ring_intensity[i] > 0)
+          {
+            ret.push_back("ring_intensity_filter");
+            break;
+          }
+        }
+      }
+
+      ret.push_back("cartesian_converter");
+
+      return ret;
+    }
+
+    bool SensorPipeline::congested() const
+    {
+      auto full = [](const ScanAsyncType& async)
+      {
+        return async.getQueueDepth() >= async.getSettings().capacity;
+      };
+
+      if (cloud_async.getQueueDepth() >= cloud_async.getSettings().capacity || full(scan_async))
+        return true;
+
+      if (compact_async.getQueueDepth() >= compact_async.getSettings().capacity)
+        return true;
+
+      for (const auto& async : stage_asyncs)
+      {
+        if (full(*async))
+          return true;
+      }
+
+      // the Cartesian clouds also wait in each subscriber's queue and for the application to pull them
+      for (const auto& stats : cloud_fan_out.getSubscriberStats())
+      {
+        if (stats.queue_depth >= stats.capacity)
+          return true;
+      }
+
+      if (cloud_source && cloud_source->getQueueDepth() >= cloud_source->getCapacity())
+        return true;
+
+      return packet_backlog && packet_backlog();
+    }
+
+    void SensorPipeline::setLatencyInstrumentation(bool enable)
+    {
+      auto histogram = [this, enable](const std::string& stage)
+      {
+        return enable ? &latency_stats.histogram(stage) : nullptr;
+      };
+
+      parser.setLatencyHistogram(histogram("parser"));
+      compact_parser.setLatencyHistogram(parse_compact ? histogram("compact_parser") : nullptr);
+      encoder_corrector.setLatencyHistogram(histogram("encoder_corrector"));
+      self_mask_filter.setLatencyHistogram(histogram("self_mask_filter"));
+      distance_filter.setLatencyHistogram(histogram("distance_filter"));
+      ring_intensity_filter.setLatencyHistogram(histogram("ring_intensity_filter"));
+      cartesian_converter.setLatencyHistogram(histogram("cartesian_converter"));
+      cloud_async.setLatencyHistogram(histogram("cloud_async_wait"));
+      scan_async.setLatencyHistogram(histogram("scan_async_wait"));
+      compact_async.setLatencyHistogram(parse_compact ? histogram("compact_async_wait") : nullptr);
+      for (std::size_t i = 0; i < stage_asyncs.size(); ++i)
+      {
+        stage_asyncs[i]->setLatencyHistogram(histogram("stage_async_" + std::to_string(i) + "_wait"));
+      }
+    }
+
+    void SensorPipeline::writeMetrics(MetricsWriter& writer, const MetricLabels& labels) const
+    {
+      auto with = [&labels](const std::string& name, const std::string& value)
+      {
+        MetricLabels result = labels;
+        result.emplace_back(name, value);
+        return result;
+      };
+
+      writer.counter("frames_total", "Point clouds produced by the parser", frame_count, labels);
+      writer.counter("points_total", "Points in the clouds produced by the parser", point_count, labels);
+      writer.gauge("frame_points", "Points in the last cloud produced by the parser", last_frame_size, labels);
+
+      auto errors = parse_cloud ? parser.getErrorCounts() : compact_parser.getErrorCounts();
+      for (std::size_t i = 0; i < quanergy::client::NUM_PACKET_ERRORS; ++i)
+      {
+        auto error = static_cast<quanergy::client::PacketError>(i);
+        writer.counter("packet_errors_total", "Packets dropped by the parser by reason",
+                       errors[error], with("reason", quanergy::client::toString(error)));
+      }
+
+      writer.counter("frames_shed_total", "Frames skipped after the parser because consumers were behind",
+                     frames_shed, labels);
+      writer.counter("frames_dropped_total", "Clouds dropped because an async queue was full",
+                     cloud_async.getDropped(), with("queue", "cloud_async"));
+      writer.counter("frames_dropped_total", "Clouds dropped because an async queue was full",
+                     scan_async.getDropped(), with("queue", "scan_async"));
+      writer.gauge("queue_depth", "Clouds waiting in an async queue",
+                   cloud_async.getQueueDepth(), with("queue", "cloud_async"));
+      writer.gauge("queue_depth", "Clouds waiting in an async queue",
+                   scan_async.getQueueDepth(), with("queue", "scan_async"));
+
+      if (parse_compact)
+      {
+        auto queue = with("queue", "compact_async");
+        writer.counter("frames_dropped_total", "Clouds dropped because an async queue was full",
+                       compact_async.getDropped(), queue);
+        writer.gauge("queue_depth", "Clouds waiting in an async queue", compact_async.getQueueDepth(), queue);
+      }
+
+      for (std::size_t i = 0; i < stage_asyncs.size(); ++i)
+      {
+        auto queue = with("queue", "stage_async_" + std::to_string(i));
+        writer.counter("frames_dropped_total", "Clouds dropped because an async queue was full",
+                       stage_asyncs[i]->getDropped(), queue);
+        writer.gauge("queue_depth", "Clouds waiting in an async queue", stage_asyncs[i]->getQueueDepth(), queue);
+      }
+
+      if (cloud_source)
+      {
+        auto queue = with("queue", "cloud_source");
+        writer.counter("frames_dropped_total", "Clouds dropped because an async queue was full",
+                       cloud_source->getDropped(), queue);
+        writer.gauge("queue_depth", "Clouds waiting in an async queue", cloud_source->getQueueDepth(), queue);
+      }
+
+      if (cloud_history)
+      {
+        writer.gauge("history_frames", "Clouds held in the frame history", cloud_history->size(), labels);
+        writer.gauge("history_bytes", "Approximate bytes of clouds held in the frame history",
+                     cloud_history->getBytes(), labels);
+      }
+
+      auto subscribers = cloud_fan_out.getSubscriberStats();
+      for (std::size_t i = 0; i < subscribers.size(); ++i)
+      {
+        auto queue = with("queue", "cloud_subscriber_" + std::to_string(i));
+        writer.counter("frames_dropped_total", "Clouds dropped because an async queue was full",
+                       subscribers[i].dropped, queue);
+        writer.gauge("queue_depth", "Clouds waiting in an async queue", subscribers[i].queue_depth, queue);
+      }
+
+      // only the M-series parsers report status; the compact ones see the same packets when both are used
+      const quanergy::client::DataPacketParserMSeries* m_series_parsers[] = {
+        &parser.get<PARSER_00_INDEX>(), &parser.get<PARSER_04_INDEX>(), &parser.get<PARSER_06_INDEX>()
+      };
+      if (!parse_cloud)
+      {
+        m_series_parsers[0] = &compact_parser.get<COMPACT_PARSER_00_INDEX>();
+        m_series_parsers[1] = &compact_parser.get<COMPACT_PARSER_04_INDEX>();
+        m_series_parsers[2] = &compact_parser.get<COMPACT_PARSER_06_INDEX>();
+      }
+
+      std::uint64_t transitions = 0;
+      std::uint16_t status = 0;
+      for (auto m_series_parser : m_series_parsers)
+      {
+        transitions += m_series_parser->getStatusTransitions();
+        status |= static_cast<std::uint16_t>(m_series_parser->getStatus());
+      }
+
+      writer.gauge("sensor_status", "Sensor status flags of the last packet; 0 is good", status, labels);
+      writer.counter("sensor_status_transitions_total", "Sensor status changes", transitions, labels);
+
+      for (const auto& stage : latency_stats.snapshot())
+      {
+        writer.summary("stage_latency_seconds", "Per cloud processing time or queue wait by stage",
+                       stage.second, with("stage", stage.first));
+      }
     }
 
     SensorPipeline::~SensorPipeline()
     {
+      // stop decode threads before the modules they signal go away
+      parser.setDecodeThreads(0);
+      compact_parser.setDecodeThreads(0);
+
+      if (!trace_file.empty())
+      {
+        Tracer& tracer = Tracer::instance();
+        std::uint64_t end = Tracer::now();
+        std::uint64_t window = static_cast<std::uint64_t>(trace_window * 1e9);
+        try
+        {
+          std::size_t count = tracer.writeChromeTrace(trace_file, window > 0 && window < end ? end - window : 0, end);
+          QUANERGY_LOG(INFO, "Wrote " << count << " trace events to " << trace_file);
+        }
+        catch (std::exception& e)
+        {
+          QUANERGY_LOG(ERR, "Unable to write trace: " << e.what());
+        }
+      }
+
       // Clean up
       for (auto &connection : connections)
       {
@@ -7,6 +7,10 @@
 
 #include <quanergy/pipelines/sensor_pipeline_settings.h>
 
+#include <algorithm>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
 #include <boost/lexical_cast.hpp>
 
 using namespace quanergy::pipeline;
@@ -81,6 +85,45 @@ void SensorPipelineSettings::load(const SettingsFileLoader& settings)
   min_cloud_size = settings.get("Settings.minCloudSize", min_cloud_size);
   max_cloud_size = settings.get("Settings.maxCloudSize", max_cloud_size);
 
+  azimuth_window_min = settings.get("Settings.AzimuthWindow.min", azimuth_window_min);
+  azimuth_window_max = settings.get("Settings.AzimuthWindow.max", azimuth_window_max);
+
+  firing_stride = settings.get("Settings.Decimation.firingStride", firing_stride);
+  ring_mask = settings.get("Settings.Decimation.ringMask", ring_mask);
+  return_mask = settings.get("Settings.Decimation.returnMask", return_mask);
+
+  decode_threads = settings.get("Settings.decodeThreads", decode_threads);
+  cloud_subscriber_threads = settings.get("Settings.cloudSubscriberThreads", cloud_subscriber_threads);
+  cloud_source_capacity = settings.get("Settings.cloudSourceCapacity", cloud_source_capacity);
+
+  history_frames = settings.get("Settings.History.frames", history_frames);
+  history_seconds = settings.get("Settings.History.seconds", history_seconds);
+  history_max_bytes = settings.get("Settings.History.maxBytes", history_max_bytes);
+
+  shed_frames = settings.get("Settings.shedFrames", shed_frames);
+
+  continue_on_packet_error = settings.get("Settings.continueOnPacketError", continue_on_packet_error);
+
+  latency_instrumentation = settings.get("Settings.LatencyStats.enable", latency_instrumentation);
+  latency_report_period = settings.get("Settings.LatencyStats.reportPeriod", latency_report_period);
+
+  metrics_port = settings.get("Settings.metricsPort", metrics_port);
+
+  // stage names separated by spaces, commas or new lines
+  std::string stage_list = settings.get("Settings.Pipeline.stages", std::string());
+  std::vector<std::string> stage_names;
+  boost::split(stage_names, stage_list, boost::is_any_of(" ,\t\r\n"), boost::token_compress_on);
+  stage_names.erase(std::remove(stage_names.begin(), stage_names.end(), std::string()), stage_names.end());
+  if (!stage_names.empty())
+  {
+    stages = stage_names;
+  }
+
+  output = settings.get("Settings.Pipeline.output", output);
+
+  trace_file = settings.get("Settings.Trace.file", trace_file);
+  trace_window = settings.get("Settings.Trace.window", trace_window);
+
   /// ring filter settings only relevant for M-series
   for (int i = 0; i < quanergy::client::M_SERIES_NUM_LASERS; i++)
   {
@@ -93,4 +136,8 @@ void SensorPipelineSettings::load(const SettingsFileLoader& settings)
     ring_intensity[i] = settings.get(intensity_param, ring_intensity[i]);
   }
 
+  self_mask_file = settings.get("Settings.SelfMask.file", self_mask_file);
+  self_mask_learn_frames = settings.get("Settings.SelfMask.learnFrames", self_mask_learn_frames);
+  self_mask_max_range = settings.get("Settings.SelfMask.maxRange", self_mask_max_range);
+
 }
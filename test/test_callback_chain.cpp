@@ -0,0 +1,76 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/common/callback_chain.h>
+#include <quanergy/modules/distance_filter.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    TEST(TestCallbackChain, Test_callbacksThenSignal)
+    {
+      CallbackChain<int> chain;
+      std::vector<int> calls;
+      EXPECT_TRUE(chain.empty());
+
+      auto connection = chain.connect([&calls](int value){ calls.push_back(100 + value); });
+      chain.add([&calls](int value){ calls.push_back(value); });
+      chain.add([&calls](int value){ calls.push_back(10 + value); });
+      EXPECT_FALSE(chain.empty());
+
+      chain(1);
+      EXPECT_EQ(calls, (std::vector<int>{1, 11, 101}));
+
+      // disconnecting only affects the signal
+      connection.disconnect();
+      calls.clear();
+      chain(2);
+      EXPECT_EQ(calls, (std::vector<int>{2, 12}));
+
+      CallbackChain<int> signal_only;
+      connection = signal_only.connect([&calls](int){});
+      EXPECT_FALSE(signal_only.empty());
+      connection.disconnect();
+      EXPECT_TRUE(signal_only.empty());
+    }
+
+    TEST(TestCallbackChain, Test_moduleAcceptsBoth)
+    {
+      client::DistanceFilter filter;
+      filter.setMaximumDistanceThreshold(5.f);
+
+      PointCloudHVDIRPtr cloud(new PointCloudHVDIR());
+      PointHVDIR point;
+      point.d = 10.f;
+      cloud->push_back(point);
+
+      // no subscribers, no work
+      filter.slot(cloud);
+
+      int callbacks = 0;
+      int signals = 0;
+      filter.connectCallback([&callbacks](const client::DistanceFilter::ResultType& result)
+      {
+        ++callbacks;
+        EXPECT_TRUE(std::isnan(result->points[0].d));
+      });
+      auto connection = filter.connect([&signals](const client::DistanceFilter::ResultType&){ ++signals; });
+
+      filter.slot(cloud);
+      connection.disconnect();
+      filter.slot(cloud);
+
+      EXPECT_EQ(callbacks, 2);
+      EXPECT_EQ(signals, 1);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
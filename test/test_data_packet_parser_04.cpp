@@ -0,0 +1,740 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <thread>
+#include <gtest/gtest.h>
+#include <quanergy/parsers/data_packet_parser_00.h>
+#include <quanergy/parsers/data_packet_parser_04.h>
+#include <quanergy/parsers/data_packet_parser_06.h>
+#include <quanergy/parsers/parallel_packet_parser.h>
+#include <quanergy/parsers/variadic_packet_parser.h>
+
+#include "test_packets.h"
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestDataPacketParser04 : public ::testing::Test
+    {
+    public:
+
+      TestDataPacketParser04()
+      {
+        parser_.setVerticalAngles(client::SensorType::M8);
+      }
+
+      /// feed revolutions starting at the -pi wrap and collect the resulting clouds
+      std::vector<PointCloudHVDIRPtr> parseRevolutions(int revolutions)
+      {
+        std::vector<PointCloudHVDIRPtr> clouds;
+        PointCloudHVDIRPtr result;
+
+        const int packets = revolutions * FIRINGS_PER_REV / client::M_SERIES_FIRING_PER_PKT;
+        for (int p = 0; p < packets; ++p)
+        {
+          auto packet = revolutionPacket04(p);
+          EXPECT_TRUE(parser_.validate(packet));
+          if (parser_.parse(packet, result))
+            clouds.push_back(result);
+        }
+
+        return clouds;
+      }
+
+      client::DataPacketParser04 parser_;
+    };
+
+    TEST_F(TestDataPacketParser04, Test_fullRevolution)
+    {
+      auto clouds = parseRevolutions(3);
+
+      ASSERT_GE(clouds.size(), 2u);
+      EXPECT_EQ(clouds[0]->height, client::M_SERIES_NUM_LASERS);
+      EXPECT_EQ(clouds[0]->width, FIRINGS_PER_REV);
+      EXPECT_NEAR(clouds[0]->points[0].d, client::M_SERIES_NUM_LASERS, 1e-4); // top row is the last laser
+    }
+
+    TEST_F(TestDataPacketParser04, Test_azimuthWindow)
+    {
+      // positions [0, 5199] cover h in [0, pi)
+      parser_.setAzimuthWindow(0, client::M_SERIES_NUM_ROT_ANGLES / 2 - 1);
+
+      auto clouds = parseRevolutions(3);
+
+      ASSERT_GE(clouds.size(), 2u);
+      EXPECT_EQ(clouds[0]->height, client::M_SERIES_NUM_LASERS);
+      EXPECT_EQ(clouds[0]->width, FIRINGS_PER_REV / 2);
+      for (const auto& pt : *clouds[0])
+      {
+        EXPECT_GE(pt.h, 0.f);
+        EXPECT_LT(pt.h, M_PI);
+      }
+
+      EXPECT_THROW(parser_.setAzimuthWindow(0, client::M_SERIES_NUM_ROT_ANGLES), std::invalid_argument);
+    }
+
+    TEST_F(TestDataPacketParser04, Test_decimation)
+    {
+      parser_.setFiringStride(2);
+      parser_.setRingMask(0x0F);
+
+      auto clouds = parseRevolutions(3);
+
+      ASSERT_GE(clouds.size(), 2u);
+      EXPECT_EQ(clouds[0]->height, 4u);
+      EXPECT_EQ(clouds[0]->width, FIRINGS_PER_REV / 2);
+      for (const auto& pt : *clouds[0])
+      {
+        EXPECT_LT(pt.ring, 4);
+      }
+
+      EXPECT_THROW(parser_.setRingMask(0), std::invalid_argument);
+      EXPECT_THROW(parser_.setFiringStride(0), std::invalid_argument);
+    }
+
+    TEST_F(TestDataPacketParser04, Test_parallelDecode)
+    {
+      parser_.setFiringStride(3);
+      auto expected = parseRevolutions(4);
+      ASSERT_GE(expected.size(), 3u);
+
+      std::vector<PointCloudHVDIRConstPtr> clouds;
+      std::atomic<std::size_t> count {0};
+      {
+        client::ParallelPacketParserModule<client::DataPacketParser04> parallel;
+        parallel.setVerticalAngles(client::SensorType::M8);
+        parallel.setFiringStride(3);
+        parallel.connect([&clouds, &count](const PointCloudHVDIRConstPtr& pc){ clouds.push_back(pc); ++count; });
+        parallel.setDecodeThreads(3, 4);
+
+        const int packets = 4 * FIRINGS_PER_REV / client::M_SERIES_FIRING_PER_PKT;
+        for (int p = 0; p < packets; ++p)
+        {
+          parallel.slot(std::make_shared<std::vector<char>>(revolutionPacket04(p)));
+        }
+
+        // stop the threads once everything has been assembled
+        for (int i = 0; i < 1000 && count < expected.size(); ++i)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      ASSERT_EQ(clouds.size(), expected.size());
+      for (std::size_t i = 0; i < clouds.size(); ++i)
+      {
+        EXPECT_EQ(clouds[i]->header.stamp, expected[i]->header.stamp);
+        ASSERT_EQ(clouds[i]->size(), expected[i]->size());
+        for (std::size_t j = 0; j < clouds[i]->size(); ++j)
+        {
+          EXPECT_EQ(clouds[i]->points[j].h, expected[i]->points[j].h);
+          EXPECT_EQ(clouds[i]->points[j].d, expected[i]->points[j].d);
+        }
+      }
+    }
+
+    TEST_F(TestDataPacketParser04, Test_errorPolicy)
+    {
+      // packets are built with return ID 0
+      parser_.setReturnSelection(1);
+      PointCloudHVDIRPtr result;
+      auto packet = makePacket04(0);
+
+      EXPECT_THROW(parser_.parse(packet, result), client::ReturnIDMismatchError);
+
+      parser_.setErrorPolicy(client::ErrorPolicy::CONTINUE);
+      EXPECT_FALSE(parser_.parse(packet, result));
+      EXPECT_FALSE(parser_.parse(packet, result));
+
+      // watchdog violation in the status
+      parser_.setReturnSelection(client::ALL_RETURNS);
+      reinterpret_cast<client::DataPacket04*>(packet.data())->data.data_header.status =
+        htons(static_cast<std::uint16_t>(client::StatusType::WATCHDOG_VIOLATION));
+      EXPECT_FALSE(parser_.parse(packet, result));
+
+      auto counts = parser_.getErrorCounts();
+      EXPECT_EQ(counts[client::PacketError::RETURN_ID_MISMATCH], 2u);
+      EXPECT_EQ(counts[client::PacketError::FIRMWARE_WATCHDOG_VIOLATION], 1u);
+      EXPECT_EQ(counts.total(), 3u);
+
+      parser_.resetErrorCounts();
+      EXPECT_EQ(parser_.getErrorCounts().total(), 0u);
+    }
+
+    TEST_F(TestDataPacketParser04, Test_assembleFrame)
+    {
+      for (int ring_mask : {0xFF, 0x0F})
+      {
+        client::DataPacketParser04 cloud_parser;
+        cloud_parser.setVerticalAngles(client::SensorType::M8);
+        cloud_parser.setRingMask(ring_mask);
+
+        client::DataPacketParser04 parser;
+        parser.setVerticalAngles(client::SensorType::M8);
+        parser.setRingMask(ring_mask);
+
+        // the same packets through the variadic parser, as a pipeline would use it
+        client::VariadicPacketParser<FrameHVDIRPtr, client::DataPacketParser04> variadic;
+        variadic.get<0>().setVerticalAngles(client::SensorType::M8);
+        variadic.get<0>().setRingMask(ring_mask);
+
+        std::vector<PointCloudHVDIRPtr> clouds;
+        std::vector<FrameHVDIRPtr> frames;
+        std::vector<FrameHVDIRPtr> variadic_frames;
+        PointCloudHVDIRPtr cloud;
+        FrameHVDIRPtr frame;
+        FrameHVDIRPtr variadic_frame;
+
+        const int packets = 3 * FIRINGS_PER_REV / client::M_SERIES_FIRING_PER_PKT;
+        for (int p = 0; p < packets; ++p)
+        {
+          auto packet = revolutionPacket04(p);
+          if (cloud_parser.parse(packet, cloud))
+            clouds.push_back(cloud);
+          if (parser.parse(packet, frame))
+            frames.push_back(frame);
+          if (variadic.parse(packet, variadic_frame))
+            variadic_frames.push_back(variadic_frame);
+        }
+
+        ASSERT_GE(clouds.size(), 2u);
+        ASSERT_EQ(frames.size(), clouds.size());
+        ASSERT_EQ(variadic_frames.size(), clouds.size());
+        for (std::size_t i = 0; i < clouds.size(); ++i)
+        {
+          const auto& expected = *clouds[i];
+          for (const auto& f : {frames[i], variadic_frames[i]})
+          {
+            EXPECT_EQ(f->stamp, expected.header.stamp);
+            EXPECT_EQ(f->seq, expected.header.seq);
+            EXPECT_EQ(f->frame_id, expected.header.frame_id);
+            EXPECT_EQ(f->width, expected.width);
+            EXPECT_EQ(f->height, expected.height);
+            EXPECT_EQ(f->is_dense, expected.is_dense);
+            ASSERT_EQ(f->size(), expected.size());
+            for (std::size_t j = 0; j < expected.size(); ++j)
+            {
+              EXPECT_EQ(f->h[j], expected.points[j].h);
+              EXPECT_EQ(f->v[j], expected.points[j].v);
+              EXPECT_EQ(f->d[j], expected.points[j].d);
+              EXPECT_EQ(f->intensity[j], expected.points[j].intensity);
+              EXPECT_EQ(f->ring[j], expected.points[j].ring);
+            }
+          }
+        }
+      }
+    }
+
+    TEST_F(TestDataPacketParser04, Test_assembleCompact)
+    {
+      for (int ring_mask : {0xFF, 0x0F})
+      {
+        client::DataPacketParser04 cloud_parser;
+        cloud_parser.setVerticalAngles(client::SensorType::M8);
+        cloud_parser.setRingMask(ring_mask);
+
+        client::VariadicPacketParser<FrameCompactPtr, client::DataPacketParser04> parser;
+        parser.get<0>().setVerticalAngles(client::SensorType::M8);
+        parser.get<0>().setRingMask(ring_mask);
+        parser.get<0>().setDecodeCompact(true);
+
+        std::vector<PointCloudHVDIRPtr> clouds;
+        std::vector<FrameCompactPtr> frames;
+        PointCloudHVDIRPtr cloud;
+        FrameCompactPtr frame;
+
+        const int packets = 3 * FIRINGS_PER_REV / client::M_SERIES_FIRING_PER_PKT;
+        for (int p = 0; p < packets; ++p)
+        {
+          auto packet = revolutionPacket04(p);
+          if (cloud_parser.parse(packet, cloud))
+            clouds.push_back(cloud);
+          if (parser.parse(packet, frame))
+            frames.push_back(frame);
+        }
+
+        ASSERT_GE(clouds.size(), 2u);
+        ASSERT_EQ(frames.size(), clouds.size());
+        for (std::size_t i = 0; i < clouds.size(); ++i)
+        {
+          const auto& expected = *clouds[i];
+          const auto& f = *frames[i];
+          EXPECT_EQ(f.stamp, expected.header.stamp);
+          EXPECT_EQ(f.seq, expected.header.seq);
+          EXPECT_EQ(f.width, expected.width);
+          EXPECT_EQ(f.height, expected.height);
+          EXPECT_EQ(f.is_dense, expected.is_dense);
+          ASSERT_EQ(f.size(), expected.size());
+          for (std::size_t j = 0; j < expected.size(); ++j)
+          {
+            const auto& pt = expected.points[j];
+            EXPECT_EQ(f.points[j].azimuth, FrameCompact::angleToAzimuth(pt.h));
+            EXPECT_EQ(f.points[j].radius, FrameCompact::rangeToRadius(pt.d));
+            EXPECT_EQ(f.points[j].intensity, pt.intensity);
+            EXPECT_EQ(f.points[j].ring, pt.ring);
+            EXPECT_FLOAT_EQ(f.v(j), pt.v);
+          }
+        }
+      }
+
+      // compact frames need compact decoding and the other results don't allow it
+      client::DataPacketParser04 parser;
+      parser.setVerticalAngles(client::SensorType::M8);
+      FrameCompactPtr frame;
+      EXPECT_THROW(parser.parse(makePacket04(0), frame), std::invalid_argument);
+
+      parser.setDecodeCompact(true);
+      PointCloudHVDIRPtr cloud;
+      EXPECT_THROW(parser.parse(makePacket04(0), cloud), std::invalid_argument);
+    }
+
+    /** \brief compares the specialized decoders against the branchy per-laser decode they replaced
+     *  \details random packets are full of zero and repeated ranges so every keep/drop path of ALL_RETURNS is hit
+     */
+    class TestDecodeReference : public ::testing::Test
+    {
+    public:
+
+      /// what the reference decode expects of one firing; ranges are the packet ranges of points
+      struct ReferenceFiring
+      {
+        std::uint16_t position = 0;
+        bool is_dense = true;
+        std::vector<PointHVDIR> points;
+        std::vector<std::uint32_t> ranges;
+      };
+
+      /// radius units of a 10 mm range (0x00 before version 5) and of a 10 um range
+      static const std::uint32_t RADIUS_PER_10MM = 1000;
+      static const std::uint32_t RADIUS_PER_10UM = 1;
+
+      TestDecodeReference()
+        : rng_(20200101)
+      {}
+
+      /// horizontal angle of an encoder position
+      static double positionAngle(std::uint16_t position)
+      {
+        std::uint32_t j = (position + client::M_SERIES_NUM_ROT_ANGLES / 2) % client::M_SERIES_NUM_ROT_ANGLES;
+        return static_cast<double>(j) / static_cast<double>(client::M_SERIES_NUM_ROT_ANGLES) * M_PI * 2.0 - M_PI;
+      }
+
+      /** \brief the returns of one laser as the branchy decoders produced them
+       *  \details distances and intensities are indexed by return * stride; with one return the selection is ignored
+       */
+      static void referenceReturns(PointHVDIR hvdir, const std::uint32_t* distances, const std::uint8_t* intensities,
+                                   int stride, int num_returns, int return_selection, int return_mask,
+                                   double distance_scaling, ReferenceFiring& firing)
+      {
+        auto push = [&](std::uint32_t dist, int r)
+        {
+          hvdir.intensity = intensities[r * stride];
+          hvdir.d = static_cast<float>(dist) * distance_scaling;
+          firing.points.push_back(hvdir);
+          firing.ranges.push_back(dist);
+        };
+
+        if (num_returns == client::M_SERIES_NUM_RETURNS && return_selection == client::ALL_RETURNS)
+        {
+          std::uint32_t dist2 = (return_mask & 4) ? distances[2 * stride] : 0;
+          std::uint32_t dist1 = (return_mask & 2) ? distances[stride] : 0;
+          std::uint32_t dist0 = (return_mask & 1) ? distances[0] : 0;
+
+          if (dist0 != 0 && dist0 != dist1 && dist0 != dist2)
+            push(dist0, 0);
+          if (dist1 != 0 && dist1 != dist2)
+            push(dist1, 1);
+          if (dist2 != 0)
+            push(dist2, 2);
+        }
+        else
+        {
+          int r = num_returns == client::M_SERIES_NUM_RETURNS ? return_selection : 0;
+          std::uint32_t dist = distances[r * stride];
+          push(dist, r);
+          if (dist == 0)
+          {
+            firing.points.back().d = std::numeric_limits<float>::quiet_NaN();
+            firing.is_dense = false;
+          }
+        }
+      }
+
+      static std::vector<ReferenceFiring> reference00(const client::DataPacket00& packet, int return_selection,
+                                                      int ring_mask, int return_mask)
+      {
+        double distance_scaling = packet.data_body.version >= 5 ? 0.00001 : 0.01;
+
+        std::vector<ReferenceFiring> firings(client::M_SERIES_FIRING_PER_PKT);
+        for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+        {
+          const auto& firing = packet.data_body.data[i];
+          firings[i].position = firing.position;
+
+          PointHVDIR hvdir;
+          hvdir.h = positionAngle(firing.position);
+          for (int laser = 0; laser < client::M_SERIES_NUM_LASERS; ++laser)
+          {
+            if (!(ring_mask & (1 << laser)))
+              continue;
+
+            hvdir.v = client::M8_VERTICAL_ANGLES[laser];
+            hvdir.ring = laser;
+            referenceReturns(hvdir, &firing.returns_distances[0][laser], &firing.returns_intensities[0][laser],
+                             client::M_SERIES_NUM_LASERS, client::M_SERIES_NUM_RETURNS,
+                             return_selection, return_mask, distance_scaling, firings[i]);
+          }
+        }
+
+        return firings;
+      }
+
+      static std::vector<ReferenceFiring> reference04(const client::DataPacket04& packet, int ring_mask)
+      {
+        std::vector<ReferenceFiring> firings(client::M_SERIES_FIRING_PER_PKT);
+        for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+        {
+          const auto& firing = packet.data.firings[i];
+          firings[i].position = firing.position;
+
+          PointHVDIR hvdir;
+          hvdir.h = positionAngle(firing.position);
+          for (int laser = 0; laser < client::M_SERIES_NUM_LASERS; ++laser)
+          {
+            if (!(ring_mask & (1 << laser)))
+              continue;
+
+            hvdir.v = client::M8_VERTICAL_ANGLES[laser];
+            hvdir.ring = laser;
+            referenceReturns(hvdir, &firing.radius[laser], &firing.intensity[laser], 0, 1,
+                             0, 0, 0.00001, firings[i]);
+          }
+        }
+
+        return firings;
+      }
+
+      template <std::uint8_t R>
+      static std::vector<ReferenceFiring> reference06(const client::DataPacket06<R>& packet, int return_selection,
+                                                      int return_mask)
+      {
+        std::vector<ReferenceFiring> firings(client::M_SERIES_FIRING_PER_PKT);
+        for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+        {
+          const auto& firing = packet.data.firings[i];
+          firings[i].position = firing.position;
+
+          PointHVDIR hvdir;
+          hvdir.h = positionAngle(firing.position);
+          hvdir.v = 0.;
+          hvdir.ring = 0;
+          referenceReturns(hvdir, firing.radius, firing.intensity, 1, R,
+                           return_selection, return_mask, 0.00001, firings[i]);
+        }
+
+        return firings;
+      }
+
+      /// a range that is often 0 or the laser's shared range, so returns repeat
+      std::uint32_t randomRange(std::uint32_t shared)
+      {
+        switch (std::uniform_int_distribution<int>(0, 3)(rng_))
+        {
+          case 0:
+            return 0;
+          case 1:
+            return shared;
+          default:
+            return std::uniform_int_distribution<std::uint32_t>(1, 20000000)(rng_);
+        }
+      }
+
+      std::uint16_t randomPosition()
+      {
+        return static_cast<std::uint16_t>(
+          std::uniform_int_distribution<int>(0, client::M_SERIES_NUM_ROT_ANGLES)(rng_));
+      }
+
+      std::uint8_t randomIntensity()
+      {
+        return static_cast<std::uint8_t>(std::uniform_int_distribution<int>(0, 255)(rng_));
+      }
+
+      /// network order packet as sent by the sensor
+      template <class PACKET>
+      static std::vector<char> toBuffer(PACKET& packet, std::uint8_t packet_type)
+      {
+        packet.packet_header.signature = htonl(client::SIGNATURE);
+        packet.packet_header.size = htonl(sizeof(packet));
+        packet.packet_header.version_minor = 0x01;
+        packet.packet_header.packet_type = packet_type;
+
+        std::vector<char> buffer(sizeof(packet));
+        std::memcpy(buffer.data(), &packet, sizeof(packet));
+        return buffer;
+      }
+
+      std::vector<char> randomPacket00(std::uint16_t version)
+      {
+        client::DataPacket00 packet{};
+        packet.data_body.version = htons(version);
+
+        for (auto& firing : packet.data_body.data)
+        {
+          firing.position = htons(randomPosition());
+          for (int laser = 0; laser < client::M_SERIES_NUM_LASERS; ++laser)
+          {
+            std::uint32_t shared = randomRange(1);
+            for (int r = 0; r < client::M_SERIES_NUM_RETURNS; ++r)
+            {
+              firing.returns_distances[r][laser] = htonl(randomRange(shared));
+              firing.returns_intensities[r][laser] = randomIntensity();
+            }
+          }
+        }
+
+        return toBuffer(packet, 0x00);
+      }
+
+      std::vector<char> randomPacket04()
+      {
+        client::DataPacket04 packet{};
+
+        for (auto& firing : packet.data.firings)
+        {
+          firing.position = htons(randomPosition());
+          for (int laser = 0; laser < client::M_SERIES_NUM_LASERS; ++laser)
+          {
+            firing.radius[laser] = htonl(randomRange(0));
+            firing.intensity[laser] = randomIntensity();
+          }
+        }
+
+        return toBuffer(packet, 0x04);
+      }
+
+      template <std::uint8_t R>
+      std::vector<char> randomPacket06()
+      {
+        client::DataPacket06<R> packet{};
+        packet.data_header.return_id = R == 1 ? 0 : R;
+
+        for (auto& firing : packet.data.firings)
+        {
+          firing.position = htons(randomPosition());
+          std::uint32_t shared = randomRange(1);
+          for (int r = 0; r < R; ++r)
+          {
+            firing.radius[r] = htonl(randomRange(shared));
+            firing.intensity[r] = randomIntensity();
+          }
+        }
+
+        return toBuffer(packet, 0x06);
+      }
+
+      /// a ring or return mask that leaves some out
+      int randomPartialMask(int bits)
+      {
+        return std::uniform_int_distribution<int>(1, (1 << bits) - 2)(rng_);
+      }
+
+      /// decode packet both as points and compact and compare every firing with expected
+      static void expectDecodes(client::DataPacketParserMSeries& parser, const std::vector<char>& packet,
+                                const std::vector<ReferenceFiring>& expected, std::uint32_t radius_per_range)
+      {
+        client::MSeriesDecodedPacket decoded;
+
+        parser.setDecodeCompact(false);
+        parser.decode(packet, decoded, 0);
+        ASSERT_TRUE(decoded.valid);
+        for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+        {
+          const auto& firing = decoded.firings[i];
+          const auto& ref = expected[i];
+          ASSERT_TRUE(firing.keep);
+          EXPECT_EQ(firing.position, ref.position);
+          EXPECT_EQ(firing.is_dense, ref.is_dense);
+          ASSERT_EQ(firing.end - firing.begin, ref.points.size());
+          for (std::size_t j = 0; j < ref.points.size(); ++j)
+          {
+            const auto& pt = decoded.points[firing.begin + j];
+            const auto& ref_pt = ref.points[j];
+            EXPECT_EQ(pt.h, ref_pt.h);
+            EXPECT_EQ(pt.v, ref_pt.v);
+            EXPECT_EQ(pt.ring, ref_pt.ring);
+            EXPECT_EQ(pt.intensity, ref_pt.intensity);
+            if (std::isnan(ref_pt.d))
+              EXPECT_TRUE(std::isnan(pt.d));
+            else
+              EXPECT_EQ(pt.d, ref_pt.d);
+          }
+        }
+
+        parser.setDecodeCompact(true);
+        parser.decode(packet, decoded, 0);
+        ASSERT_TRUE(decoded.compact);
+        for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+        {
+          const auto& firing = decoded.firings[i];
+          const auto& ref = expected[i];
+          EXPECT_EQ(firing.is_dense, ref.is_dense);
+          ASSERT_EQ(firing.end - firing.begin, ref.points.size());
+          for (std::size_t j = 0; j < ref.points.size(); ++j)
+          {
+            const auto& pt = decoded.compact_points[firing.begin + j];
+            EXPECT_EQ(pt.azimuth, FrameCompact::angleToAzimuth(positionAngle(ref.position)));
+            EXPECT_EQ(pt.radius, ref.ranges[j] * radius_per_range);
+            EXPECT_EQ(pt.ring, ref.points[j].ring);
+            EXPECT_EQ(pt.intensity, ref.points[j].intensity);
+          }
+        }
+      }
+
+      /// deserialized copy of a network order packet for the reference decode
+      template <class PACKET>
+      static PACKET deserialized(const std::vector<char>& buffer)
+      {
+        PACKET packet;
+        client::deserialize(buffer.data(), packet);
+        return packet;
+      }
+
+    protected:
+      std::mt19937 rng_;
+    };
+
+    TEST_F(TestDecodeReference, Test_packet00)
+    {
+      for (int trial = 0; trial < 10; ++trial)
+      {
+        for (std::uint16_t version : {4, 5})
+        {
+          auto packet = randomPacket00(version);
+          auto host = deserialized<client::DataPacket00>(packet);
+          std::uint32_t radius_per_range = version >= 5 ? RADIUS_PER_10UM : RADIUS_PER_10MM;
+
+          for (int return_selection : {client::ALL_RETURNS, 0, 1, 2})
+          {
+            for (int ring_mask : {0xFF, randomPartialMask(client::M_SERIES_NUM_LASERS)})
+            {
+              for (int return_mask : {0x7, randomPartialMask(client::M_SERIES_NUM_RETURNS)})
+              {
+                SCOPED_TRACE(testing::Message() << "version " << version << " return " << return_selection
+                             << " ring mask " << ring_mask << " return mask " << return_mask);
+
+                client::DataPacketParser00 parser;
+                parser.setVerticalAngles(client::SensorType::M8);
+                parser.setReturnSelection(return_selection);
+                parser.setRingMask(ring_mask);
+                parser.setReturnMask(return_mask);
+
+                expectDecodes(parser, packet, reference00(host, return_selection, ring_mask, return_mask),
+                              radius_per_range);
+              }
+            }
+          }
+        }
+      }
+    }
+
+    TEST_F(TestDecodeReference, Test_packet04)
+    {
+      for (int trial = 0; trial < 10; ++trial)
+      {
+        auto packet = randomPacket04();
+        auto host = deserialized<client::DataPacket04>(packet);
+
+        for (int ring_mask : {0xFF, randomPartialMask(client::M_SERIES_NUM_LASERS)})
+        {
+          SCOPED_TRACE(testing::Message() << "ring mask " << ring_mask);
+
+          client::DataPacketParser04 parser;
+          parser.setVerticalAngles(client::SensorType::M8);
+          parser.setRingMask(ring_mask);
+
+          expectDecodes(parser, packet, reference04(host, ring_mask), RADIUS_PER_10UM);
+        }
+      }
+    }
+
+    TEST_F(TestDecodeReference, Test_packet06)
+    {
+      for (int trial = 0; trial < 10; ++trial)
+      {
+        auto packet = randomPacket06<3>();
+        auto host = deserialized<client::DataPacket06<3>>(packet);
+
+        for (int return_selection : {client::ALL_RETURNS, 0, 1, 2})
+        {
+          for (int return_mask : {0x7, randomPartialMask(client::M_SERIES_NUM_RETURNS)})
+          {
+            SCOPED_TRACE(testing::Message() << "return " << return_selection << " return mask " << return_mask);
+
+            client::DataPacketParser06 parser;
+            parser.setReturnSelection(return_selection);
+            parser.setReturnMask(return_mask);
+
+            expectDecodes(parser, packet, reference06(host, return_selection, return_mask), RADIUS_PER_10UM);
+          }
+        }
+
+        // single return packets
+        auto single = randomPacket06<1>();
+        client::DataPacketParser06 parser;
+        expectDecodes(parser, single, reference06(deserialized<client::DataPacket06<1>>(single), 0, 0x7),
+                      RADIUS_PER_10UM);
+      }
+    }
+
+    TEST_F(TestDecodeReference, Test_sizeMismatch)
+    {
+      client::DataPacketParser00 parser00;
+      parser00.setVerticalAngles(client::SensorType::M8);
+      client::DataPacketParser04 parser04;
+      parser04.setVerticalAngles(client::SensorType::M8);
+      client::DataPacketParser06 parser06;
+
+      std::vector<std::pair<client::DataPacketParserMSeries*, std::vector<char>>> cases = {
+        {&parser00, randomPacket00(5)},
+        {&parser04, randomPacket04()},
+        {&parser06, randomPacket06<1>()},
+        {&parser06, randomPacket06<3>()}};
+
+      for (auto& c : cases)
+      {
+        auto& parser = *c.first;
+        auto& packet = c.second;
+        packet.pop_back();
+
+        PointCloudHVDIRPtr result;
+        EXPECT_THROW(parser.parse(packet, result), client::SizeMismatchError);
+
+        parser.setErrorPolicy(client::ErrorPolicy::CONTINUE);
+        client::MSeriesDecodedPacket decoded;
+        parser.decode(packet, decoded, 0);
+        EXPECT_FALSE(decoded.valid);
+        EXPECT_FALSE(parser.parse(packet, result));
+
+        // too short for the 0x06 data header too
+        packet.resize(sizeof(client::PacketHeader));
+        EXPECT_FALSE(parser.parse(packet, result));
+        parser.setErrorPolicy(client::ErrorPolicy::THROW);
+      }
+
+      EXPECT_EQ(parser00.getErrorCounts()[client::PacketError::SIZE_MISMATCH], 3u);
+      EXPECT_EQ(parser04.getErrorCounts()[client::PacketError::SIZE_MISMATCH], 3u);
+      EXPECT_EQ(parser06.getErrorCounts()[client::PacketError::SIZE_MISMATCH], 6u);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -97,6 +97,34 @@ namespace quanergy
                    std::runtime_error);
     };
 
+    TEST_F(TestEncoderCalibration, Test_applyLeavesInputUnchanged)
+    {
+      PointCloudHVDIRPtr cloud(new PointCloudHVDIR());
+      PointHVDIR point;
+      point.h = 1.f;
+      point.v = 0.f;
+      point.d = 10.f;
+      point.intensity = 100;
+      point.ring = 0;
+      cloud->push_back(point);
+
+      PointCloudHVDIRConstPtr corrected;
+      encoder_calibration_.connect([&corrected](const PointCloudHVDIRConstPtr& pc){ corrected = pc; });
+      encoder_calibration_.setParams(0.02f, -2.f);
+      encoder_calibration_.slot(cloud);
+
+      // other subscribers of the parser may share the input
+      ASSERT_TRUE(corrected);
+      EXPECT_NE(corrected, cloud);
+      EXPECT_EQ(cloud->points[0].h, 1.f);
+      EXPECT_FLOAT_EQ(corrected->points[0].h, encoder_calibration_.correctAngle(1.f));
+
+      // with no correction the input is passed on
+      encoder_calibration_.setParams(0.f, 0.f);
+      encoder_calibration_.slot(cloud);
+      EXPECT_EQ(corrected, cloud);
+    }
+
   }/** end test namespace */
 }/** end quanergy namespace */
 
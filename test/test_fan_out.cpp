@@ -0,0 +1,192 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/pipelines/fan_out.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestFanOut : public ::testing::Test
+    {
+    public:
+      /// wait up to a second for condition
+      template <class Condition>
+      static bool waitFor(Condition condition)
+      {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (!condition() && std::chrono::steady_clock::now() < deadline)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return condition();
+      }
+
+      /// holds whoever calls wait() until released
+      struct Gate
+      {
+        void wait()
+        {
+          std::unique_lock<std::mutex> lk(mutex);
+          ++waiting;
+          conditional.wait(lk, [this]{ return open; });
+        }
+
+        void release()
+        {
+          { std::lock_guard<std::mutex> lk(mutex); open = true; }
+          conditional.notify_all();
+        }
+
+        std::mutex mutex;
+        std::condition_variable conditional;
+        std::atomic<int> waiting {0};
+        bool open = false;
+      };
+    };
+
+    TEST_F(TestFanOut, Test_slowSubscriberDoesNotStarveOthers)
+    {
+      Gate gate;
+      std::vector<int> slow_values;
+      std::vector<int> fast_values;
+
+      pipeline::FanOutModule<int> fan_out(2);
+      fan_out.connect([&](int value){ gate.wait(); slow_values.push_back(value); });
+      pipeline::FanOutSubscriberSettings fast_settings;
+      fast_settings.capacity = 16;
+      fast_settings.drop_policy = pipeline::DropPolicy::BLOCK;
+      fan_out.connect([&](int value){ fast_values.push_back(value); }, fast_settings);
+
+      // hold the slow subscriber on its first input before queueing the rest
+      fan_out.slot(0);
+      EXPECT_TRUE(waitFor([&]{ return gate.waiting == 1; }));
+      for (int i = 1; i < 100; ++i)
+        fan_out.slot(i);
+
+      // the fast subscriber gets everything while the slow one is stuck on its first input;
+      // no ASSERT until the gate is released or the worker would never be joined
+      EXPECT_TRUE(waitFor([&]{ return fan_out.getSubscriberStats()[1].delivered == 100; }));
+      EXPECT_EQ(fast_values.size(), 100u);
+      EXPECT_EQ(gate.waiting, 1);
+
+      auto stats = fan_out.getSubscriberStats();
+      EXPECT_EQ(stats[0].received, 100u);
+      EXPECT_EQ(stats[0].dropped, 97u);
+      EXPECT_EQ(stats[1].dropped, 0u);
+      EXPECT_EQ(fan_out.getDropped(), 97u);
+
+      // the slow subscriber keeps the newest inputs
+      gate.release();
+      ASSERT_TRUE(waitFor([&]{ return fan_out.getSubscriberStats()[0].delivered == 3; }));
+      EXPECT_EQ(slow_values, (std::vector<int>{0, 98, 99}));
+    }
+
+    TEST_F(TestFanOut, Test_orderedMerge)
+    {
+      std::vector<int> results;
+
+      pipeline::FanOutModule<int> fan_out(4);
+      pipeline::FanOutSubscriberSettings settings;
+      settings.capacity = 16;
+      settings.drop_policy = pipeline::DropPolicy::BLOCK;
+      settings.concurrency = 4;
+
+      // later inputs finish first
+      std::function<int (const int&)> work = [](const int& value)
+      {
+        std::this_thread::sleep_for(std::chrono::microseconds(100 * (value % 4 == 0 ? 3 : 0)));
+        return 2 * value;
+      };
+      fan_out.connectOrdered<int>(work, [&results](const int& result){ results.push_back(result); }, settings);
+
+      for (int i = 0; i < 200; ++i)
+        fan_out.slot(i);
+
+      ASSERT_TRUE(waitFor([&]{ return fan_out.getSubscriberStats()[0].delivered == 200; }));
+      for (int i = 0; i < 200; ++i)
+        EXPECT_EQ(results[i], 2 * i);
+    }
+
+    TEST_F(TestFanOut, Test_orderedMergeSkipsDrops)
+    {
+      Gate gate;
+      std::vector<int> results;
+
+      pipeline::FanOutModule<int> fan_out(1);
+      pipeline::FanOutSubscriberSettings settings;
+      settings.capacity = 1;
+      settings.drop_policy = pipeline::DropPolicy::NEWEST;
+
+      std::function<int (const int&)> work = [&gate](const int& value)
+      {
+        if (value == 0)
+          gate.wait();
+        return value;
+      };
+      fan_out.connectOrdered<int>(work, [&results](const int& result){ results.push_back(result); }, settings);
+
+      fan_out.slot(0);
+      ASSERT_TRUE(waitFor([&]{ return gate.waiting == 1; }));
+      for (int i = 1; i < 5; ++i)
+        fan_out.slot(i);
+
+      gate.release();
+      ASSERT_TRUE(waitFor([&]{ return fan_out.getSubscriberStats()[0].delivered == 2; }));
+      EXPECT_EQ(results, (std::vector<int>{0, 1}));
+      EXPECT_EQ(fan_out.getDropped(), 3u);
+
+      // the order continues past the dropped inputs
+      fan_out.slot(5);
+      ASSERT_TRUE(waitFor([&]{ return fan_out.getSubscriberStats()[0].delivered == 3; }));
+      EXPECT_EQ(results, (std::vector<int>{0, 1, 5}));
+    }
+
+    TEST_F(TestFanOut, Test_inlineAndDisconnect)
+    {
+      std::vector<int> values;
+
+      pipeline::FanOutModule<int> fan_out;
+      auto connection = fan_out.connect([&values](int value){ values.push_back(value); });
+
+      fan_out.slot(1);
+      fan_out.slot(2);
+      EXPECT_EQ(values, (std::vector<int>{1, 2}));
+
+      connection.disconnect();
+      fan_out.slot(3);
+      EXPECT_EQ(values, (std::vector<int>{1, 2}));
+      EXPECT_TRUE(fan_out.getSubscriberStats().empty());
+    }
+
+    TEST_F(TestFanOut, Test_exceptionPropagates)
+    {
+      pipeline::FanOutModule<int> fan_out(1);
+      fan_out.connect([](int){ throw std::runtime_error("subscriber failed"); });
+
+      fan_out.slot(0);
+      EXPECT_TRUE(waitFor([&]
+      {
+        try
+        {
+          fan_out.slot(1);
+          return false;
+        }
+        catch (std::runtime_error&)
+        {
+          return true;
+        }
+      }));
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
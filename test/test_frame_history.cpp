@@ -0,0 +1,92 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <gtest/gtest.h>
+#include <quanergy/common/point_xyzir.h>
+#include <quanergy/pipelines/frame_history.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestFrameHistory : public ::testing::Test
+    {
+    public:
+      using History = pipeline::FrameHistory<PointXYZIR>;
+
+      /// cloud of one point stamped seq * 100 ms
+      static History::FramePtr makeFrame(std::uint32_t seq)
+      {
+        boost::shared_ptr<History::Cloud> cloud(new History::Cloud());
+        cloud->header.seq = seq;
+        cloud->header.stamp = seq * 100000;
+        cloud->points.resize(1);
+        return cloud;
+      }
+    };
+
+    TEST_F(TestFrameHistory, Test_limits)
+    {
+      pipeline::FrameHistorySettings settings;
+      settings.max_frames = 3;
+      History by_count(settings);
+
+      settings.max_frames = 0;
+      settings.max_age = 0.25;
+      History by_age(settings);
+
+      for (std::uint32_t i = 0; i < 10; ++i)
+      {
+        by_count.slot(makeFrame(i));
+        by_age.slot(makeFrame(i));
+      }
+
+      auto frames = by_count.getFrames();
+      ASSERT_EQ(frames.size(), 3u);
+      EXPECT_EQ(frames.front()->header.seq, 7u);
+      EXPECT_EQ(frames.back()->header.seq, 9u);
+
+      // 250 ms before the newest at 900 ms
+      frames = by_age.getFrames();
+      ASSERT_EQ(frames.size(), 3u);
+      EXPECT_EQ(frames.front()->header.seq, 7u);
+
+      // the newest is held even when it alone is over the memory cap
+      settings.max_age = 0.;
+      settings.max_bytes = 1;
+      History by_bytes(settings);
+      by_bytes.slot(makeFrame(0));
+      by_bytes.slot(makeFrame(1));
+      ASSERT_EQ(by_bytes.size(), 1u);
+      EXPECT_EQ(by_bytes.getFrames().front()->header.seq, 1u);
+    }
+
+    TEST_F(TestFrameHistory, Test_lookup)
+    {
+      History history;
+      EXPECT_FALSE(history.findByStamp(0));
+
+      for (std::uint32_t i = 0; i < 5; ++i)
+        history.slot(makeFrame(i));
+
+      ASSERT_TRUE(history.findBySeq(3));
+      EXPECT_EQ(history.findBySeq(3)->header.seq, 3u);
+      EXPECT_FALSE(history.findBySeq(7));
+
+      EXPECT_EQ(history.findByStamp(0)->header.seq, 0u);
+      EXPECT_EQ(history.findByStamp(140000)->header.seq, 1u);
+      EXPECT_EQ(history.findByStamp(160000)->header.seq, 2u);
+      EXPECT_EQ(history.findByStamp(1000000)->header.seq, 4u);
+
+      auto range = history.getRange(100000, 300000);
+      ASSERT_EQ(range.size(), 3u);
+      EXPECT_EQ(range.front()->header.seq, 1u);
+      EXPECT_EQ(range.back()->header.seq, 3u);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,190 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <cmath>
+#include <limits>
+#include <gtest/gtest.h>
+#include <quanergy/modules/frame_converter.h>
+#include <quanergy/modules/distance_filter.h>
+#include <quanergy/modules/ring_intensity_filter.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestFrameHVDIR : public ::testing::Test
+    {
+    public:
+
+      /// organized cloud with one row per ring and ranges increasing along each row
+      static PointCloudHVDIRPtr makeCloud(std::uint32_t width, std::uint32_t height)
+      {
+        PointCloudHVDIRPtr cloud(new PointCloudHVDIR());
+        for (std::uint32_t row = 0; row < height; ++row)
+        {
+          for (std::uint32_t col = 0; col < width; ++col)
+          {
+            PointHVDIR pt;
+            pt.h = 0.01f * col;
+            pt.v = 0.02f * row;
+            pt.d = 0.5f * (col + 1);
+            pt.intensity = static_cast<float>(col % 10);
+            pt.ring = static_cast<std::uint16_t>(row);
+            cloud->points.push_back(pt);
+          }
+        }
+        cloud->width = width;
+        cloud->height = height;
+        cloud->is_dense = true;
+        cloud->header.stamp = 123456;
+        cloud->header.seq = 7;
+        cloud->header.frame_id = "quanergy";
+        return cloud;
+      }
+
+      static void expectSameD(const PointCloudHVDIR& cloud, const FrameHVDIR& frame)
+      {
+        ASSERT_EQ(cloud.size(), frame.size());
+        for (std::size_t i = 0; i < frame.size(); ++i)
+        {
+          if (std::isnan(cloud.points[i].d))
+            EXPECT_TRUE(std::isnan(frame.d[i]));
+          else
+            EXPECT_EQ(cloud.points[i].d, frame.d[i]);
+        }
+        EXPECT_EQ(cloud.is_dense, frame.is_dense);
+      }
+    };
+
+    TEST_F(TestFrameHVDIR, Test_roundTrip)
+    {
+      auto cloud = makeCloud(20, 8);
+
+      FrameHVDIR frame;
+      toFrame(*cloud, frame);
+
+      EXPECT_EQ(frame.size(), cloud->size());
+      EXPECT_TRUE(frame.isOrganized());
+      EXPECT_FALSE(frame.hasTime());
+      EXPECT_EQ(frame.stamp, cloud->header.stamp);
+      EXPECT_EQ(frame.seq, cloud->header.seq);
+      EXPECT_EQ(frame.frame_id, cloud->header.frame_id);
+      EXPECT_EQ(frame.ring[frame.index(3, 5)], 3);
+      EXPECT_EQ(frame.d[frame.index(3, 5)], (*cloud)[3 * 20 + 5].d);
+
+      PointCloudHVDIR back;
+      toPointCloud(frame, back);
+
+      ASSERT_EQ(back.size(), cloud->size());
+      EXPECT_EQ(back.width, cloud->width);
+      EXPECT_EQ(back.height, cloud->height);
+      EXPECT_EQ(back.header.stamp, cloud->header.stamp);
+      for (std::size_t i = 0; i < back.size(); ++i)
+      {
+        EXPECT_EQ(back.points[i].h, cloud->points[i].h);
+        EXPECT_EQ(back.points[i].v, cloud->points[i].v);
+        EXPECT_EQ(back.points[i].d, cloud->points[i].d);
+        EXPECT_EQ(back.points[i].intensity, cloud->points[i].intensity);
+        EXPECT_EQ(back.points[i].ring, cloud->points[i].ring);
+      }
+    }
+
+    TEST_F(TestFrameHVDIR, Test_filtersMatchCloudFilters)
+    {
+      auto cloud = makeCloud(40, 8);
+
+      client::DistanceFilter distance_filter;
+      distance_filter.setMinimumDistanceThreshold(2.f);
+      distance_filter.setMaximumDistanceThreshold(15.f);
+
+      client::RingIntensityFilter ring_filter;
+      ring_filter.setRingFilterMinimumRangeThreshold(2, 10.f);
+      ring_filter.setRingFilterMinimumIntensityThreshold(2, 5.f);
+
+      // cloud pipeline
+      PointCloudHVDIRConstPtr filtered;
+      distance_filter.connect([&ring_filter](const PointCloudHVDIRConstPtr& pc){ ring_filter.slot(pc); });
+      ring_filter.connect([&filtered](const PointCloudHVDIRConstPtr& pc){ filtered = pc; });
+      distance_filter.slot(cloud);
+      ASSERT_TRUE(filtered);
+
+      // frame pipeline
+      FrameHVDIRConstPtr frame;
+      client::CloudToFrameConverter to_frame;
+      to_frame.connect([&frame](const FrameHVDIRConstPtr& f){ frame = f; });
+      to_frame.slot(cloud);
+      ASSERT_TRUE(frame);
+
+      // published frames are shared, so filter a copy
+      FrameHVDIR filtered_frame = *frame;
+      distance_filter.filter(filtered_frame);
+      ring_filter.filter(filtered_frame);
+
+      expectSameD(*filtered, filtered_frame);
+      EXPECT_FALSE(filtered_frame.is_dense);
+    }
+
+    TEST_F(TestFrameHVDIR, Test_compactRoundTrip)
+    {
+      auto cloud = makeCloud(40, 8);
+      (*cloud)[5].d = std::numeric_limits<float>::quiet_NaN();
+      cloud->is_dense = false;
+
+      FrameCompact frame;
+      toFrame(*cloud, frame);
+
+      EXPECT_EQ(frame.size(), cloud->size());
+      EXPECT_EQ(frame.width, cloud->width);
+      EXPECT_EQ(frame.height, cloud->height);
+
+      PointCloudHVDIR back;
+      toPointCloud(frame, back);
+
+      ASSERT_EQ(back.size(), cloud->size());
+      EXPECT_TRUE(std::isnan(back[5].d));
+      for (std::size_t i = 0; i < back.size(); ++i)
+      {
+        if (i == 5) continue;
+        EXPECT_NEAR(back.points[i].h, cloud->points[i].h, M_PI / FrameCompact::AZIMUTH_STEPS);
+        EXPECT_EQ(back.points[i].v, cloud->points[i].v);
+        EXPECT_NEAR(back.points[i].d, cloud->points[i].d, FrameCompact::RADIUS_SCALE);
+        EXPECT_EQ(back.points[i].intensity, cloud->points[i].intensity);
+        EXPECT_EQ(back.points[i].ring, cloud->points[i].ring);
+      }
+
+      // -pi and just under pi both survive quantization
+      EXPECT_NEAR(FrameCompact::azimuthToAngle(FrameCompact::angleToAzimuth(-M_PI)), -M_PI, 1e-5);
+      EXPECT_EQ(FrameCompact::angleToAzimuth(M_PI), 0);
+    }
+
+    TEST_F(TestFrameHVDIR, Test_compactFiltersMatchCloudFilters)
+    {
+      auto cloud = makeCloud(40, 8);
+
+      client::DistanceFilter distance_filter;
+      distance_filter.setMinimumDistanceThreshold(2.25f);
+      distance_filter.setMaximumDistanceThreshold(15.25f);
+
+      PointCloudHVDIRConstPtr filtered;
+      distance_filter.connect([&filtered](const PointCloudHVDIRConstPtr& pc){ filtered = pc; });
+      distance_filter.slot(cloud);
+      ASSERT_TRUE(filtered);
+
+      FrameCompact frame;
+      toFrame(*cloud, frame);
+      distance_filter.filter(frame);
+
+      ASSERT_EQ(frame.size(), filtered->size());
+      for (std::size_t i = 0; i < frame.size(); ++i)
+      {
+        EXPECT_EQ(std::isnan(frame.d(i)), std::isnan(filtered->points[i].d));
+      }
+      EXPECT_FALSE(frame.is_dense);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,106 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include <quanergy/pipelines/frame_source.h>
+
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestFrameSource : public ::testing::Test
+    {
+    public:
+      /// whether fd polls readable without waiting; always false without eventfd
+      static bool readable(int fd)
+      {
+#ifdef __linux__
+        pollfd poll_fd{fd, POLLIN, 0};
+        return ::poll(&poll_fd, 1, 0) == 1 && (poll_fd.revents & POLLIN);
+#else
+        (void)fd;
+        return false;
+#endif
+      }
+    };
+
+    TEST_F(TestFrameSource, Test_tryPopDropsOldest)
+    {
+      pipeline::FrameSource<int> source(2);
+      int frame = -1;
+
+      EXPECT_FALSE(source.tryPop(frame));
+
+      for (int i = 0; i < 5; ++i)
+        source.slot(i);
+
+      EXPECT_EQ(source.getReceived(), 5u);
+      EXPECT_EQ(source.getDropped(), 3u);
+      EXPECT_EQ(source.getQueueDepth(), 2u);
+
+      ASSERT_TRUE(source.tryPop(frame));
+      EXPECT_EQ(frame, 3);
+      ASSERT_TRUE(source.tryPop(frame));
+      EXPECT_EQ(frame, 4);
+      EXPECT_FALSE(source.tryPop(frame));
+    }
+
+    TEST_F(TestFrameSource, Test_eventFd)
+    {
+      pipeline::FrameSource<int> source(4, pipeline::DropPolicy::NEWEST);
+#ifdef __linux__
+      ASSERT_GE(source.eventFd(), 0);
+#endif
+      EXPECT_FALSE(readable(source.eventFd()));
+
+      source.slot(1);
+      source.slot(2);
+#ifdef __linux__
+      EXPECT_TRUE(readable(source.eventFd()));
+#endif
+
+      // readable until the source has been drained
+      int frame = -1;
+      ASSERT_TRUE(source.tryPop(frame));
+      EXPECT_EQ(frame, 1);
+      ASSERT_TRUE(source.tryPop(frame));
+      EXPECT_EQ(frame, 2);
+      EXPECT_FALSE(source.tryPop(frame));
+      EXPECT_FALSE(readable(source.eventFd()));
+
+      source.slot(3);
+#ifdef __linux__
+      EXPECT_TRUE(readable(source.eventFd()));
+#endif
+    }
+
+    TEST_F(TestFrameSource, Test_waitFor)
+    {
+      pipeline::FrameSource<int> source;
+      int frame = -1;
+
+      EXPECT_FALSE(source.waitFor(frame, std::chrono::milliseconds(1)));
+
+      std::thread producer([&source]
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        source.slot(7);
+      });
+
+      EXPECT_TRUE(source.waitFor(frame, std::chrono::seconds(5)));
+      EXPECT_EQ(frame, 7);
+      producer.join();
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,101 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/common/latency_histogram.h>
+#include <quanergy/pipelines/latency_stats.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestLatencyHistogram : public ::testing::Test
+    {
+    public:
+      LatencyHistogram histogram_;
+    };
+
+    TEST_F(TestLatencyHistogram, Test_bucketPrecision)
+    {
+      for (std::uint64_t value = 1; value < LatencyHistogram::MAX_VALUE; value = value * 3 + 1)
+      {
+        std::uint32_t index = LatencyHistogram::bucketIndex(value);
+        ASSERT_LT(index, LatencyHistogram::NUM_BUCKETS);
+
+        double error = std::abs(static_cast<double>(LatencyHistogram::bucketValue(index)) - value) / value;
+        EXPECT_LE(error, 1. / LatencyHistogram::SUB_BUCKETS) << value;
+      }
+
+      EXPECT_EQ(LatencyHistogram::bucketIndex(std::uint64_t(-1)), LatencyHistogram::NUM_BUCKETS - 1);
+    }
+
+    TEST_F(TestLatencyHistogram, Test_quantiles)
+    {
+      EXPECT_EQ(histogram_.summary().count, 0u);
+
+      for (std::uint64_t value = 1; value <= 100000; ++value)
+        histogram_.record(value * 1000);
+
+      LatencySummary summary = histogram_.summary();
+      EXPECT_EQ(summary.count, 100000u);
+      EXPECT_EQ(summary.min, 1000u);
+      EXPECT_EQ(summary.max, 100000000u);
+      EXPECT_NEAR(summary.p50, 50000000., 50000000. / 64);
+      EXPECT_NEAR(summary.p99, 99000000., 99000000. / 64);
+      EXPECT_NEAR(summary.p999, 99900000., 99900000. / 64);
+      EXPECT_NEAR(summary.mean, 50000500., 1.);
+
+      histogram_.reset();
+      EXPECT_EQ(histogram_.count(), 0u);
+      EXPECT_EQ(histogram_.quantile(0.5), 0u);
+    }
+
+    TEST_F(TestLatencyHistogram, Test_concurrentRecord)
+    {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t)
+      {
+        threads.emplace_back([this]
+                             {
+                               for (int i = 0; i < 10000; ++i)
+                                 histogram_.record(std::uint64_t(i));
+                             });
+      }
+
+      for (auto& thread : threads)
+        thread.join();
+
+      EXPECT_EQ(histogram_.count(), 40000u);
+      EXPECT_EQ(histogram_.summary().max, 9999u);
+    }
+
+    TEST_F(TestLatencyHistogram, Test_stageTimer)
+    {
+      {
+        StageTimer disabled(nullptr);
+        StageTimer timer(&histogram_);
+        timer.stop();
+        timer.stop();
+      }
+
+      EXPECT_EQ(histogram_.count(), 1u);
+
+      pipeline::LatencyStats stats;
+      stats.histogram("parser").record(std::uint64_t(2000));
+      EXPECT_EQ(&stats.histogram("parser"), &stats.histogram("parser"));
+
+      auto snapshot = stats.snapshot();
+      ASSERT_EQ(snapshot.count("parser"), 1u);
+      EXPECT_EQ(snapshot["parser"].p50, 2000u);
+      EXPECT_NE(stats.report().find("parser: count 1"), std::string::npos);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,47 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <memory>
+#include <gtest/gtest.h>
+#include <quanergy/pipelines/latest_frame.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    TEST(TestLatestFrame, Test_keepsNewest)
+    {
+      pipeline::LatestFrame<std::shared_ptr<int>> latest;
+
+      std::uint64_t sequence = 1;
+      EXPECT_FALSE(latest.latest(sequence));
+      EXPECT_EQ(sequence, 0u);
+      EXPECT_EQ(latest.sequence(), 0u);
+
+      std::weak_ptr<int> first;
+      {
+        auto frame = std::make_shared<int>(1);
+        first = frame;
+        latest.slot(frame);
+      }
+      EXPECT_EQ(*latest.latest(), 1);
+
+      latest.slot(std::make_shared<int>(2));
+      latest.slot(std::make_shared<int>(3));
+
+      // skipped frames aren't held
+      EXPECT_TRUE(first.expired());
+
+      auto frame = latest.latest(sequence);
+      ASSERT_TRUE(frame);
+      EXPECT_EQ(*frame, 3);
+      EXPECT_EQ(sequence, 3u);
+      EXPECT_EQ(latest.sequence(), 3u);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
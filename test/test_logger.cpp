@@ -0,0 +1,106 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/common/logger.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestLogger : public ::testing::Test
+    {
+    public:
+
+      TestLogger()
+      {
+        Logger::instance().setLevel(LogLevel::DEBUG);
+        Logger::instance().setSink([this](const LogRecord& record)
+                                   {
+                                     std::lock_guard<std::mutex> lk(mutex_);
+                                     records_.push_back(record);
+                                   });
+      }
+
+      ~TestLogger()
+      {
+        Logger::instance().flush();
+        Logger::instance().setSink(&Logger::consoleSink);
+        Logger::instance().setLevel(LogLevel::INFO);
+      }
+
+      std::vector<LogRecord> records()
+      {
+        Logger::instance().flush();
+        std::lock_guard<std::mutex> lk(mutex_);
+        return records_;
+      }
+
+      std::mutex mutex_;
+      std::vector<LogRecord> records_;
+    };
+
+    TEST_F(TestLogger, Test_levels)
+    {
+      Logger::instance().setLevel(LogLevel::WARNING);
+
+      QUANERGY_LOG(INFO, "hidden");
+      QUANERGY_LOG(WARNING, "value " << 42);
+      QUANERGY_LOG(ERR, "error");
+
+      auto logged = records();
+      ASSERT_EQ(logged.size(), 2u);
+      EXPECT_EQ(logged[0].level, LogLevel::WARNING);
+      EXPECT_EQ(logged[0].message, "value 42");
+      EXPECT_EQ(logged[1].level, LogLevel::ERR);
+    }
+
+    TEST_F(TestLogger, Test_rateLimit)
+    {
+      for (int i = 0; i < 100; ++i)
+        QUANERGY_LOG_EVERY_MS(WARNING, 60000, "dropped " << i);
+
+      auto logged = records();
+      ASSERT_EQ(logged.size(), 1u);
+      EXPECT_EQ(logged[0].message, "dropped 0");
+      EXPECT_EQ(logged[0].suppressed, 0u);
+
+      LogSite site(__FILE__, __LINE__, 0);
+      std::uint64_t suppressed = 0;
+      EXPECT_TRUE(site.allow(suppressed));
+      EXPECT_TRUE(site.allow(suppressed));
+    }
+
+    TEST_F(TestLogger, Test_concurrentProducers)
+    {
+      const int threads = 4;
+      const int per_thread = 100;
+
+      std::vector<std::thread> producers;
+      for (int t = 0; t < threads; ++t)
+      {
+        producers.emplace_back([]
+                               {
+                                 for (int i = 0; i < per_thread; ++i)
+                                   QUANERGY_LOG(DEBUG, "message " << i);
+                               });
+      }
+
+      for (auto& producer : producers)
+        producer.join();
+
+      auto logged = records();
+      // well under the queue size so nothing is dropped
+      EXPECT_EQ(logged.size(), static_cast<std::size_t>(threads * per_thread));
+      EXPECT_EQ(Logger::instance().droppedCount(), 0u);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
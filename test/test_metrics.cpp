@@ -0,0 +1,85 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <string>
+#include <gtest/gtest.h>
+#include <boost/asio.hpp>
+#include <quanergy/common/metrics.h>
+#include <quanergy/client/metrics_server.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestMetrics : public ::testing::Test
+    {
+    public:
+      MetricsWriter writer_;
+    };
+
+    TEST_F(TestMetrics, Test_writerFormat)
+    {
+      writer_.counter("frames_total", "Frames published.", 10, {{"sensor", "a"}});
+      writer_.gauge("queue_depth", "Queued items.", 2);
+      writer_.counter("frames_total", "Frames published.", 20, {{"sensor", "b\""}});
+
+      LatencySummary latency;
+      latency.count = 2;
+      latency.p50 = latency.p99 = latency.p999 = latency.max = 1000000;
+      latency.mean = 1000000.;
+      writer_.summary("stage_latency_seconds", "Stage latency.", latency, {{"stage", "parser"}});
+
+      const std::string text = writer_.str();
+
+      // one header per family, samples grouped under it
+      const std::string frames =
+          "# HELP quanergy_frames_total Frames published.\n"
+          "# TYPE quanergy_frames_total counter\n"
+          "quanergy_frames_total{sensor=\"a\"} 10\n"
+          "quanergy_frames_total{sensor=\"b\\\"\"} 20\n";
+      EXPECT_NE(text.find(frames), std::string::npos) << text;
+      EXPECT_NE(text.find("quanergy_queue_depth 2\n"), std::string::npos) << text;
+      EXPECT_NE(text.find("quanergy_stage_latency_seconds{stage=\"parser\",quantile=\"0.99\"} 0.001\n"),
+                std::string::npos) << text;
+      EXPECT_NE(text.find("quanergy_stage_latency_seconds_sum{stage=\"parser\"} 0.002\n"),
+                std::string::npos) << text;
+      EXPECT_NE(text.find("quanergy_stage_latency_seconds_count{stage=\"parser\"} 2\n"),
+                std::string::npos) << text;
+    }
+
+    TEST_F(TestMetrics, Test_serverScrape)
+    {
+      client::MetricsServer server(0);
+      server.addCollector([](MetricsWriter& writer)
+                          {
+                            writer.counter("packets_received_total", "Packets received.", 42);
+                          });
+      server.start();
+
+      boost::asio::io_service io_service;
+      boost::asio::ip::tcp::socket socket(io_service);
+      socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"),
+                                                    server.getPort()));
+
+      const std::string request = "GET /metrics HTTP/1.0\r\n\r\n";
+      boost::asio::write(socket, boost::asio::buffer(request));
+
+      boost::asio::streambuf response;
+      boost::system::error_code error;
+      boost::asio::read(socket, response, error);
+      EXPECT_EQ(error, boost::asio::error::eof);
+
+      const std::string text((std::istreambuf_iterator<char>(&response)), std::istreambuf_iterator<char>());
+      EXPECT_EQ(text.find("HTTP/1.0 200 OK\r\n"), 0u) << text;
+      EXPECT_NE(text.find("\r\n\r\n# HELP quanergy_packets_received_total"), std::string::npos) << text;
+      EXPECT_NE(text.find("quanergy_packets_received_total 42\n"), std::string::npos) << text;
+
+      server.stop();
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,68 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+/** \file test_packets.h
+ *
+ *  \brief Network order M-series packets shared by the unit tests.
+ */
+
+#ifndef QUANERGY_TEST_TEST_PACKETS_H
+#define QUANERGY_TEST_TEST_PACKETS_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <quanergy/parsers/data_packet_04.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    /// encoder positions advance this much per firing
+    const int POSITION_STEP = 2;
+    /// firings in one revolution
+    const std::uint32_t FIRINGS_PER_REV = client::M_SERIES_NUM_ROT_ANGLES / POSITION_STEP;
+
+    /// build a network order 0x04 packet with firings starting at the encoder position; laser i is at i + 1 meters
+    inline std::vector<char> makePacket04(int start_position)
+    {
+      client::DataPacket04 packet{};
+
+      packet.packet_header.signature = htonl(client::SIGNATURE);
+      packet.packet_header.size = htonl(sizeof(packet));
+      packet.packet_header.version_minor = 0x01;
+      packet.packet_header.packet_type = 0x04;
+
+      for (int i = 0; i < client::M_SERIES_FIRING_PER_PKT; ++i)
+      {
+        auto& firing = packet.data.firings[i];
+        int position = (start_position + i * POSITION_STEP) % client::M_SERIES_NUM_ROT_ANGLES;
+        firing.position = htons(static_cast<std::uint16_t>(position));
+        for (int laser = 0; laser < client::M_SERIES_NUM_LASERS; ++laser)
+        {
+          firing.radius[laser] = htonl(100000 * (laser + 1));
+          firing.intensity[laser] = 100;
+        }
+      }
+
+      std::vector<char> buffer(sizeof(packet));
+      std::memcpy(buffer.data(), &packet, sizeof(packet));
+      return buffer;
+    }
+
+    /// packet number p of 0x04 revolutions starting at the -pi wrap
+    inline std::vector<char> revolutionPacket04(int p)
+    {
+      return makePacket04(client::M_SERIES_NUM_ROT_ANGLES / 2 + p * client::M_SERIES_FIRING_PER_PKT * POSITION_STEP);
+    }
+
+  } // namespace test
+
+} // namespace quanergy
+
+#endif
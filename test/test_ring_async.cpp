@@ -0,0 +1,274 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/common/bounded_ring.h>
+#include <quanergy/pipelines/ring_async.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestRingAsync : public ::testing::Test
+    {
+    public:
+      /// wait up to a second for condition
+      template <class Condition>
+      static bool waitFor(Condition condition)
+      {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (!condition() && std::chrono::steady_clock::now() < deadline)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return condition();
+      }
+
+      /// consumer that records values and holds the signal thread until released
+      struct GatedConsumer
+      {
+        void operator()(int value)
+        {
+          std::unique_lock<std::mutex> lk(mutex);
+          entered = true;
+          conditional.wait(lk, [this]{ return open; });
+          values.push_back(value);
+        }
+
+        void release()
+        {
+          { std::lock_guard<std::mutex> lk(mutex); open = true; }
+          conditional.notify_all();
+        }
+
+        std::mutex mutex;
+        std::condition_variable conditional;
+        std::atomic_bool entered {false};
+        bool open = false;
+        std::vector<int> values;
+      };
+    };
+
+    TEST_F(TestRingAsync, Test_boundedRing)
+    {
+      BoundedRing<int> ring(3);
+      int value = 0;
+
+      EXPECT_FALSE(ring.pop(value));
+      for (int i = 0; i < 3; ++i)
+        EXPECT_TRUE(ring.push(i));
+      EXPECT_FALSE(ring.push(3));
+      EXPECT_EQ(ring.size(), 3u);
+
+      // wraps around the cells
+      for (int round = 0; round < 5; ++round)
+      {
+        ASSERT_TRUE(ring.pop(value));
+        EXPECT_EQ(value, round);
+        EXPECT_TRUE(ring.push(round + 3));
+      }
+      EXPECT_EQ(ring.size(), 3u);
+
+      BoundedRing<int> single(1);
+      for (int round = 0; round < 3; ++round)
+      {
+        EXPECT_TRUE(single.push(round));
+        EXPECT_FALSE(single.push(round));
+        ASSERT_TRUE(single.pop(value));
+        EXPECT_EQ(value, round);
+        EXPECT_FALSE(single.pop(value));
+      }
+
+      EXPECT_THROW(BoundedRing<int>(0), std::invalid_argument);
+    }
+
+    TEST_F(TestRingAsync, Test_deliversInOrder)
+    {
+      for (auto wait : {pipeline::WaitStrategy::SLEEP, pipeline::WaitStrategy::YIELD, pipeline::WaitStrategy::SPIN})
+      {
+        std::vector<int> values;
+        {
+          pipeline::RingAsyncModule<int> async(pipeline::RingAsyncSettings{4, pipeline::DropPolicy::BLOCK, wait});
+          async.connect([&values](int value){ values.push_back(value); });
+
+          for (int i = 0; i < 200; ++i)
+            async.slot(i);
+
+          ASSERT_TRUE(waitFor([&]{ return async.getDelivered() == 200; }));
+          EXPECT_EQ(async.getReceived(), 200u);
+          EXPECT_EQ(async.getDropped(), 0u);
+          EXPECT_LE(async.getBatches(), 200u);
+        }
+
+        ASSERT_EQ(values.size(), 200u);
+        for (int i = 0; i < 200; ++i)
+          EXPECT_EQ(values[i], i);
+      }
+    }
+
+    TEST_F(TestRingAsync, Test_dropPolicies)
+    {
+      // with the consumer held on input 0, inputs 1 to 4 go to a ring of 2
+      auto run = [](pipeline::DropPolicy policy, std::uint64_t& dropped)
+      {
+        GatedConsumer consumer;
+        {
+          pipeline::RingAsyncModule<int> async(pipeline::RingAsyncSettings{2, policy, pipeline::WaitStrategy::SLEEP});
+          async.connect([&consumer](int value){ consumer(value); });
+
+          async.slot(0);
+          EXPECT_TRUE(waitFor([&]{ return consumer.entered.load(); }));
+          for (int i = 1; i < 5; ++i)
+            async.slot(i);
+
+          consumer.release();
+          EXPECT_TRUE(waitFor([&]{ return async.getDelivered() == 3; }));
+          dropped = async.getDropped();
+        }
+        return consumer.values;
+      };
+
+      std::uint64_t dropped = 0;
+      EXPECT_EQ(run(pipeline::DropPolicy::OLDEST, dropped), (std::vector<int>{0, 3, 4}));
+      EXPECT_EQ(dropped, 2u);
+      EXPECT_EQ(run(pipeline::DropPolicy::NEWEST, dropped), (std::vector<int>{0, 1, 2}));
+      EXPECT_EQ(dropped, 2u);
+    }
+
+    TEST_F(TestRingAsync, Test_blockPolicy)
+    {
+      GatedConsumer consumer;
+      pipeline::RingAsyncModule<int> async(
+        pipeline::RingAsyncSettings{2, pipeline::DropPolicy::BLOCK, pipeline::WaitStrategy::SLEEP});
+      async.connect([&consumer](int value){ consumer(value); });
+
+      async.slot(0);
+      ASSERT_TRUE(waitFor([&]{ return consumer.entered.load(); }));
+      async.slot(1);
+      async.slot(2);
+
+      // the ring is full so the next input waits for room
+      std::atomic_bool pushed {false};
+      std::thread producer([&]{ async.slot(3); pushed = true; });
+      EXPECT_TRUE(waitFor([&]{ return async.getBlocked() == 1; }));
+      EXPECT_FALSE(pushed);
+
+      consumer.release();
+      producer.join();
+      EXPECT_TRUE(waitFor([&]{ return async.getDelivered() == 4; }));
+      EXPECT_EQ(consumer.values, (std::vector<int>{0, 1, 2, 3}));
+      EXPECT_EQ(async.getDropped(), 0u);
+    }
+
+    TEST_F(TestRingAsync, Test_blockPolicyProducers)
+    {
+      // each input out makes room for one of the two waiting producers; the other has to be woken for the next
+      for (int round = 0; round < 100; ++round)
+      {
+        GatedConsumer consumer;
+        std::unique_ptr<pipeline::RingAsyncModule<int>> async(new pipeline::RingAsyncModule<int>(
+          pipeline::RingAsyncSettings{1, pipeline::DropPolicy::BLOCK, pipeline::WaitStrategy::SLEEP}));
+        async->connect([&consumer](int value){ consumer(value); });
+
+        async->slot(0);
+        ASSERT_TRUE(waitFor([&]{ return consumer.entered.load(); }));
+        async->slot(1);
+
+        std::vector<std::thread> producers;
+        for (int i = 2; i < 4; ++i)
+          producers.emplace_back([&async, i]{ async->slot(i); });
+        EXPECT_TRUE(waitFor([&]{ return async->getBlocked() == 2; }));
+
+        consumer.release();
+        if (!waitFor([&]{ return async->getDelivered() == 4; }))
+        {
+          // a producer missed its wake up and sleeps in the module, which can't be destroyed under it
+          for (auto& producer : producers)
+            producer.detach();
+          async.release();
+          FAIL() << "a producer was never woken in round " << round;
+        }
+
+        for (auto& producer : producers)
+          producer.join();
+        EXPECT_EQ(async->getDropped(), 0u);
+        async.reset();
+
+        std::sort(consumer.values.begin(), consumer.values.end());
+        EXPECT_EQ(consumer.values, (std::vector<int>{0, 1, 2, 3}));
+      }
+    }
+
+    TEST_F(TestRingAsync, Test_batchDelivery)
+    {
+      GatedConsumer consumer;
+      std::vector<std::vector<int>> batches;
+
+      pipeline::RingAsyncModule<int> async(
+        pipeline::RingAsyncSettings{8, pipeline::DropPolicy::BLOCK, pipeline::WaitStrategy::SLEEP});
+      async.connectBatch([&batches](const std::vector<int>& batch){ batches.push_back(batch); });
+      async.connect([&consumer](int value){ consumer(value); });
+
+      async.slot(0);
+      ASSERT_TRUE(waitFor([&]{ return consumer.entered.load(); }));
+      for (int i = 1; i < 6; ++i)
+        async.slot(i);
+
+      // everything pending when the signal thread comes back is one batch
+      consumer.release();
+      ASSERT_TRUE(waitFor([&]{ return async.getDelivered() == 6; }));
+      EXPECT_EQ(batches, (std::vector<std::vector<int>>{{0}, {1, 2, 3, 4, 5}}));
+      EXPECT_EQ(async.getBatches(), 2u);
+      EXPECT_EQ(consumer.values, (std::vector<int>{0, 1, 2, 3, 4, 5}));
+    }
+
+    TEST_F(TestRingAsync, Test_subscriberException)
+    {
+      GatedConsumer consumer;
+      pipeline::RingAsyncModule<int> async(
+        pipeline::RingAsyncSettings{2, pipeline::DropPolicy::BLOCK, pipeline::WaitStrategy::SLEEP});
+      async.connect([&consumer](int value)
+      {
+        consumer(value);
+        throw std::runtime_error("subscriber failed");
+      });
+
+      async.slot(0);
+      ASSERT_TRUE(waitFor([&]{ return consumer.entered.load(); }));
+      async.slot(1);
+      async.slot(2);
+
+      // a producer waiting for room gets the exception instead of waiting forever
+      std::atomic_bool rethrown {false};
+      std::thread producer([&]
+      {
+        try
+        {
+          async.slot(3);
+        }
+        catch (std::runtime_error&)
+        {
+          rethrown = true;
+        }
+      });
+      EXPECT_TRUE(waitFor([&]{ return async.getBlocked() == 1; }));
+
+      consumer.release();
+      producer.join();
+      EXPECT_TRUE(rethrown);
+      EXPECT_THROW(async.slot(4), std::runtime_error);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,129 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <cmath>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <quanergy/modules/self_mask_learner.h>
+#include <quanergy/modules/self_mask_filter.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestSelfMask : public ::testing::Test
+    {
+    public:
+
+      /// angle the M-series parser produces for an encoder position
+      static double angleFromPosition(int position)
+      {
+        double h = position * 2. * M_PI / client::M_SERIES_NUM_ROT_ANGLES;
+        if (h >= M_PI)
+          h -= 2. * M_PI;
+        return h;
+      }
+
+      /// build a full revolution where positions [body_start, body_end] on ring 0 see the body
+      static PointCloudHVDIRPtr makeFrame(int body_start, int body_end, float body_range)
+      {
+        PointCloudHVDIRPtr cloud(new PointCloudHVDIR());
+        for (int position = 0; position < client::M_SERIES_NUM_ROT_ANGLES; ++position)
+        {
+          for (std::uint16_t ring = 0; ring < client::M_SERIES_NUM_LASERS; ++ring)
+          {
+            PointHVDIR pt;
+            pt.h = angleFromPosition(position);
+            pt.v = 0.f;
+            pt.ring = ring;
+            pt.intensity = 10.f;
+            pt.d = (ring == 0 && position >= body_start && position <= body_end) ? body_range : 20.f;
+            cloud->points.push_back(pt);
+          }
+        }
+        cloud->width = cloud->size();
+        cloud->height = 1;
+        return cloud;
+      }
+
+      client::SelfMaskLearner learner_;
+    };
+
+    TEST_F(TestSelfMask, Test_positionFromAngle)
+    {
+      for (int position : {0, 1, 2599, 5199, 5200, 5201, 10399})
+      {
+        EXPECT_EQ(client::SelfMask::positionFromAngle(angleFromPosition(position)), position);
+      }
+    }
+
+    TEST_F(TestSelfMask, Test_learnAndFilter)
+    {
+      const int num_frames = 5;
+      learner_.setNumFrames(num_frames);
+
+      client::SelfMask learned;
+      learner_.connect([&learned](const client::SelfMask& mask){ learned = mask; });
+
+      for (int i = 0; i < num_frames; ++i)
+      {
+        ASSERT_FALSE(learner_.complete());
+        learner_.slot(makeFrame(0, 100, 0.4f));
+      }
+
+      ASSERT_TRUE(learner_.complete());
+      ASSERT_FALSE(learned.empty());
+
+      // positions 0-100 on ring 0 see the body
+      EXPECT_NEAR(learned.getRange(50, 0), 0.4f + learner_.getRangeMargin(), 1e-5);
+      EXPECT_EQ(learned.getRange(50, 1), 0.f);
+      EXPECT_EQ(learned.getRange(5000, 0), 0.f);
+
+      client::SelfMaskFilter filter;
+      filter.setMask(learned);
+
+      PointCloudHVDIRConstPtr filtered;
+      filter.connect([&filtered](const PointCloudHVDIRConstPtr& pc){ filtered = pc; });
+      filter.slot(makeFrame(0, 100, 0.4f));
+
+      ASSERT_TRUE(filtered);
+      ASSERT_EQ(filtered->size(), client::M_SERIES_NUM_ROT_ANGLES * client::M_SERIES_NUM_LASERS);
+      EXPECT_FALSE(filtered->is_dense);
+      EXPECT_TRUE(std::isnan(filtered->points[50 * client::M_SERIES_NUM_LASERS].d));
+      EXPECT_FALSE(std::isnan(filtered->points[50 * client::M_SERIES_NUM_LASERS + 1].d));
+      EXPECT_FALSE(std::isnan(filtered->points[5000 * client::M_SERIES_NUM_LASERS].d));
+    }
+
+    TEST_F(TestSelfMask, Test_saveLoad)
+    {
+      client::SelfMask mask;
+      for (int position = 100; position <= 200; ++position)
+        mask.setRange(position, 3, 0.5f);
+      mask.setRange(client::M_SERIES_NUM_ROT_ANGLES - 1, 7, 0.25f);
+
+      const std::string file_name = "test_self_mask.txt";
+      mask.save(file_name);
+
+      client::SelfMask loaded;
+      loaded.load(file_name);
+      std::remove(file_name.c_str());
+
+      EXPECT_EQ(loaded.getRange(99, 3), 0.f);
+      EXPECT_EQ(loaded.getRange(100, 3), 0.5f);
+      EXPECT_EQ(loaded.getRange(200, 3), 0.5f);
+      EXPECT_EQ(loaded.getRange(201, 3), 0.f);
+      EXPECT_EQ(loaded.getRange(client::M_SERIES_NUM_ROT_ANGLES - 1, 7), 0.25f);
+    }
+
+    TEST_F(TestSelfMask, Test_loadMissingFile)
+    {
+      client::SelfMask mask;
+      EXPECT_THROW(mask.load("does_not_exist.txt"), std::runtime_error);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
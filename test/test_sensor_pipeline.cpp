@@ -0,0 +1,505 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include <quanergy/client/sensor_client.h>
+#include <quanergy/pipelines/sensor_pipeline.h>
+
+#include "test_packets.h"
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestSensorPipeline : public ::testing::Test
+    {
+    public:
+
+      static client::DeviceInfo deviceInfo(const std::string& model)
+      {
+        std::istringstream xml("<DeviceInfo><model>" + model + "</model></DeviceInfo>");
+        return client::DeviceInfo(xml);
+      }
+
+      /// feed revolutions starting at the -pi wrap
+      static void feed(pipeline::SensorPipeline& pipeline, int revolutions)
+      {
+        const int packets = revolutions * FIRINGS_PER_REV / client::M_SERIES_FIRING_PER_PKT;
+        for (int p = 0; p < packets; ++p)
+        {
+          pipeline.slot(std::make_shared<std::vector<char>>(revolutionPacket04(p)));
+        }
+      }
+
+      /// wait for the async outputs to deliver count frames
+      template <class Frames>
+      static void waitFor(std::mutex& mutex, const Frames& frames, std::size_t count)
+      {
+        for (int i = 0; i < 5000; ++i)
+        {
+          {
+            std::lock_guard<std::mutex> lk(mutex);
+            if (frames.size() >= count)
+              return;
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+    };
+
+    TEST_F(TestSensorPipeline, Test_compactOutput)
+    {
+      pipeline::SensorPipelineSettings settings;
+      settings.output = "compact";
+      settings.max_distance = 4.5f;
+
+      pipeline::SensorPipeline pipeline(settings, deviceInfo("M8"));
+      EXPECT_FALSE(pipeline.parse_cloud);
+      EXPECT_TRUE(pipeline.parse_compact);
+
+      std::mutex mutex;
+      std::vector<FrameCompactConstPtr> frames;
+      std::vector<PointCloudXYZIRConstPtr> clouds;
+      pipeline.connect_compact([&](const FrameCompactConstPtr& frame)
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        frames.push_back(frame);
+      });
+      pipeline.connect_cloud([&](const PointCloudXYZIRConstPtr& cloud)
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        clouds.push_back(cloud);
+      });
+
+      // one revolution at a time so the async outputs don't drop any
+      for (int i = 0; i < 3; ++i)
+      {
+        feed(pipeline, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+      waitFor(mutex, frames, 2);
+      waitFor(mutex, clouds, 2);
+
+      std::lock_guard<std::mutex> lk(mutex);
+      ASSERT_GE(frames.size(), 2u);
+      ASSERT_GE(clouds.size(), 2u);
+      EXPECT_EQ(pipeline.frame_count, frames.size());
+
+      // the distance filter ran on the compact frames: lasers past 4.5 m are invalid
+      const auto& frame = *frames[0];
+      EXPECT_EQ(frame.height, client::M_SERIES_NUM_LASERS);
+      EXPECT_EQ(frame.width, FIRINGS_PER_REV);
+      EXPECT_FALSE(frame.is_dense);
+      for (const auto& pt : frame.points)
+      {
+        if (pt.ring < 4)
+          EXPECT_EQ(pt.radius, 100000u * (pt.ring + 1));
+        else
+          EXPECT_EQ(pt.radius, 0u);
+      }
+
+      // and the Cartesian clouds are decoded from them
+      const auto& cloud = *clouds[0];
+      ASSERT_EQ(cloud.size(), frame.size());
+      EXPECT_EQ(cloud.header.stamp, frame.stamp);
+      for (std::size_t i = 0; i < cloud.size(); ++i)
+      {
+        EXPECT_EQ(std::isnan(cloud.points[i].x), frame.points[i].radius == 0);
+      }
+    }
+
+    TEST_F(TestSensorPipeline, Test_bothOutputs)
+    {
+      pipeline::SensorPipelineSettings settings;
+      settings.output = "both";
+
+      pipeline::SensorPipeline pipeline(settings, deviceInfo("M8"));
+
+      std::mutex mutex;
+      std::vector<FrameCompactConstPtr> frames;
+      std::vector<PointCloudHVDIRConstPtr> scans;
+      pipeline.connect_compact([&](const FrameCompactConstPtr& frame)
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        frames.push_back(frame);
+      });
+      pipeline.connect_scan([&](const PointCloudHVDIRConstPtr& scan)
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        scans.push_back(scan);
+      });
+
+      for (int i = 0; i < 3; ++i)
+      {
+        feed(pipeline, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+      waitFor(mutex, frames, 2);
+      waitFor(mutex, scans, 2);
+
+      std::lock_guard<std::mutex> lk(mutex);
+      ASSERT_GE(frames.size(), 2u);
+      ASSERT_GE(scans.size(), 2u);
+      EXPECT_EQ(frames[0]->stamp, scans[0]->header.stamp);
+      ASSERT_EQ(frames[0]->size(), scans[0]->size());
+      EXPECT_EQ(frames[0]->points[0].radius, FrameCompact::rangeToRadius(scans[0]->points[0].d));
+    }
+
+    TEST_F(TestSensorPipeline, Test_invalidOutput)
+    {
+      pipeline::SensorPipelineSettings settings;
+      settings.output = "polar";
+      EXPECT_THROW(pipeline::SensorPipeline(settings, deviceInfo("M8")), std::invalid_argument);
+
+      // compact frames are M-series only
+      settings.output = "compact";
+      EXPECT_THROW(pipeline::SensorPipeline(settings, deviceInfo("S3-2NSI-S00")), std::invalid_argument);
+    }
+
+    TEST_F(TestSensorPipeline, Test_defaultStages)
+    {
+      using Stages = std::vector<std::string>;
+      pipeline::SensorPipelineSettings settings;
+
+      // filters whose settings can't remove a point are left out
+      EXPECT_EQ(pipeline::SensorPipeline::defaultStages(settings, true),
+                (Stages{"encoder_corrector", "cartesian_converter"}));
+      EXPECT_EQ(pipeline::SensorPipeline::defaultStages(settings, false), (Stages{"cartesian_converter"}));
+
+      // a ring needs both thresholds to remove anything
+      settings.ring_range[3] = 2.f;
+      EXPECT_EQ(pipeline::SensorPipeline::defaultStages(settings, true),
+                (Stages{"encoder_corrector", "cartesian_converter"}));
+      settings.ring_intensity[3] = 10;
+      EXPECT_EQ(pipeline::SensorPipeline::defaultStages(settings, true),
+                (Stages{"encoder_corrector", "ring_intensity_filter", "cartesian_converter"}));
+      EXPECT_EQ(pipeline::SensorPipeline::defaultStages(settings, false), (Stages{"cartesian_converter"}));
+
+      settings.max_distance = 4.5f;
+      EXPECT_EQ(pipeline::SensorPipeline::defaultStages(settings, true),
+                (Stages{"encoder_corrector", "distance_filter", "ring_intensity_filter", "cartesian_converter"}));
+
+      settings = pipeline::SensorPipelineSettings();
+      settings.min_distance = 0.5f;
+      EXPECT_EQ(pipeline::SensorPipeline::defaultStages(settings, false),
+                (Stages{"distance_filter", "cartesian_converter"}));
+
+      // and what the pipeline connects by default
+      pipeline::SensorPipeline pipeline(pipeline::SensorPipelineSettings(), deviceInfo("M8"));
+      EXPECT_EQ(pipeline.stages, (Stages{"encoder_corrector", "cartesian_converter"}));
+      EXPECT_TRUE(pipeline.stage_asyncs.empty());
+    }
+
+    TEST_F(TestSensorPipeline, Test_invalidStages)
+    {
+      pipeline::SensorPipelineSettings settings;
+
+      settings.stages = {"cartesian_converter", "distance_filter"};
+      EXPECT_THROW(pipeline::SensorPipeline(settings, deviceInfo("M8")), std::invalid_argument);
+
+      settings.stages = {"distance_filter", "distance_filter", "cartesian_converter"};
+      EXPECT_THROW(pipeline::SensorPipeline(settings, deviceInfo("M8")), std::invalid_argument);
+
+      settings.stages = {"distance_filter", "voxel_grid", "cartesian_converter"};
+      EXPECT_THROW(pipeline::SensorPipeline(settings, deviceInfo("M8")), std::invalid_argument);
+
+      // async may appear any number of times
+      settings.stages = {"async", "distance_filter", "async", "cartesian_converter"};
+      EXPECT_NO_THROW(pipeline::SensorPipeline(settings, deviceInfo("M8")));
+
+      // the self mask is only loaded when its stage runs
+      settings.self_mask_file = "missing_self_mask.txt";
+      EXPECT_NO_THROW(pipeline::SensorPipeline(settings, deviceInfo("M8")));
+      settings.stages = {"self_mask", "cartesian_converter"};
+      EXPECT_THROW(pipeline::SensorPipeline(settings, deviceInfo("M8")), std::runtime_error);
+    }
+
+    TEST_F(TestSensorPipeline, Test_asyncStages)
+    {
+      pipeline::SensorPipelineSettings settings;
+      settings.stages = {"encoder_corrector", "async", "distance_filter", "async", "cartesian_converter"};
+      settings.max_distance = 4.5f;
+
+      pipeline::SensorPipeline pipeline(settings, deviceInfo("M8"));
+      EXPECT_EQ(pipeline.stages, settings.stages);
+      ASSERT_EQ(pipeline.stage_asyncs.size(), 2u);
+
+      std::mutex mutex;
+      std::vector<PointCloudHVDIRConstPtr> scans;
+      std::vector<PointCloudXYZIRConstPtr> clouds;
+      pipeline.connect_scan([&](const PointCloudHVDIRConstPtr& scan)
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        scans.push_back(scan);
+      });
+      pipeline.connect_cloud([&](const PointCloudXYZIRConstPtr& cloud)
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        clouds.push_back(cloud);
+      });
+
+      for (int i = 0; i < 3; ++i)
+      {
+        feed(pipeline, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+      waitFor(mutex, scans, 2);
+      waitFor(mutex, clouds, 2);
+
+      // the frames went through both boundaries
+      EXPECT_GE(pipeline.stage_asyncs[0]->getDelivered(), 2u);
+      EXPECT_GE(pipeline.stage_asyncs[1]->getDelivered(), 2u);
+
+      std::lock_guard<std::mutex> lk(mutex);
+      ASSERT_GE(scans.size(), 2u);
+      ASSERT_GE(clouds.size(), 2u);
+
+      // the scans come from the last polar stage, so the distance filter has run on them
+      const auto& scan = *scans[0];
+      EXPECT_FALSE(scan.is_dense);
+      for (const auto& pt : scan.points)
+      {
+        EXPECT_EQ(std::isnan(pt.d), pt.ring >= 4);
+      }
+    }
+
+    TEST_F(TestSensorPipeline, Test_learnSelfMask)
+    {
+      pipeline::SensorPipelineSettings settings;
+      settings.self_mask_file = "test_pipeline_self_mask.txt";
+      settings.self_mask_learn_frames = 2;
+      // laser 0 is at 1 m, the others are farther
+      settings.self_mask_max_range = 1.5f;
+
+      {
+        pipeline::SensorPipeline pipeline(settings, deviceInfo("M8"));
+        EXPECT_EQ(pipeline.stages, (std::vector<std::string>{"encoder_corrector", "self_mask", "cartesian_converter"}));
+
+        std::mutex mutex;
+        std::vector<PointCloudHVDIRConstPtr> scans;
+        pipeline.connect_scan([&](const PointCloudHVDIRConstPtr& scan)
+        {
+          std::lock_guard<std::mutex> lk(mutex);
+          scans.push_back(scan);
+        });
+
+        for (int i = 0; i < 5; ++i)
+        {
+          feed(pipeline, 1);
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        waitFor(mutex, scans, 4);
+
+        // once learned, the filter removes laser 0
+        std::lock_guard<std::mutex> lk(mutex);
+        ASSERT_GE(scans.size(), 4u);
+        for (const auto& pt : scans.back()->points)
+        {
+          EXPECT_EQ(std::isnan(pt.d), pt.ring == 0);
+        }
+      }
+
+      // the mask was written off the frame path, and by the time the pipeline is gone
+      client::SelfMask mask;
+      ASSERT_NO_THROW(mask.load(settings.self_mask_file));
+      std::remove(settings.self_mask_file.c_str());
+      EXPECT_GT(mask.getRange(100, 0), 1.f);
+      EXPECT_EQ(mask.getRange(100, 1), 0.f);
+    }
+
+    TEST_F(TestSensorPipeline, Test_shedFrames)
+    {
+      pipeline::SensorPipelineSettings settings;
+      settings.shed_frames = true;
+      settings.cloud_source_capacity = 1;
+
+      pipeline::SensorPipeline pipeline(settings, deviceInfo("M8"));
+      ASSERT_TRUE(pipeline.cloud_source);
+      auto& source = *pipeline.cloud_source;
+
+      // nothing pulls from the source, so once it holds a cloud every frame after is shed
+      feed(pipeline, 4);
+      ASSERT_GE(pipeline.frame_count, 3u);
+      EXPECT_EQ(source.getReceived(), 1u);
+      EXPECT_EQ(pipeline.frames_shed, pipeline.frame_count - 1);
+      EXPECT_EQ(source.getDropped(), 0u);
+
+      // pulling makes room, and the next frame gets through whole
+      PointCloudXYZIRConstPtr cloud;
+      ASSERT_TRUE(source.tryPop(cloud));
+      EXPECT_EQ(cloud->size(), FIRINGS_PER_REV * client::M_SERIES_NUM_LASERS);
+
+      std::uint64_t frames = pipeline.frame_count;
+      std::uint64_t shed = pipeline.frames_shed;
+      feed(pipeline, 1);
+      EXPECT_EQ(pipeline.frame_count, frames + 1);
+      EXPECT_EQ(pipeline.frames_shed, shed);
+      EXPECT_EQ(source.getReceived(), 2u);
+      ASSERT_TRUE(source.tryPop(cloud));
+      EXPECT_EQ(cloud->size(), FIRINGS_PER_REV * client::M_SERIES_NUM_LASERS);
+    }
+
+    TEST_F(TestSensorPipeline, Test_shedForSlowSubscriber)
+    {
+      pipeline::SensorPipelineSettings settings;
+      settings.shed_frames = true;
+      settings.cloud_subscriber_threads = 1;
+
+      pipeline::SensorPipeline pipeline(settings, deviceInfo("M8"));
+
+      // the subscriber holds its thread until released, so its queue fills
+      std::mutex mutex;
+      std::condition_variable conditional;
+      bool open = false;
+      std::vector<PointCloudXYZIRConstPtr> clouds;
+      pipeline.connect_cloud([&](const PointCloudXYZIRConstPtr& cloud)
+      {
+        std::unique_lock<std::mutex> lk(mutex);
+        conditional.wait(lk, [&]{ return open; });
+        clouds.push_back(cloud);
+      });
+
+      for (int i = 0; i < 8; ++i)
+      {
+        feed(pipeline, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+      EXPECT_GT(pipeline.frames_shed, 0u);
+      EXPECT_EQ(pipeline.cloud_fan_out.getDropped(), 0u);
+
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        open = true;
+      }
+      conditional.notify_all();
+
+      // every frame that wasn't shed reaches the subscriber whole
+      std::uint64_t expected = pipeline.frame_count - pipeline.frames_shed;
+      waitFor(mutex, clouds, expected);
+      std::lock_guard<std::mutex> lk(mutex);
+      EXPECT_EQ(clouds.size(), expected);
+      for (const auto& cloud : clouds)
+      {
+        EXPECT_EQ(cloud->size(), FIRINGS_PER_REV * client::M_SERIES_NUM_LASERS);
+      }
+    }
+
+    TEST_F(TestSensorPipeline, Test_clientBlocksWhenShedding)
+    {
+      const int revolutions = 4;
+      const int packets = revolutions * FIRINGS_PER_REV / client::M_SERIES_FIRING_PER_PKT;
+
+      // a local sensor sending every packet as fast as the socket takes them
+      boost::asio::io_service service;
+      boost::asio::ip::tcp::acceptor acceptor(
+          service, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+      std::mutex done_mutex;
+      std::condition_variable done_conditional;
+      bool done = false;
+      std::thread sensor([&]
+      {
+        boost::asio::ip::tcp::socket socket(service);
+        acceptor.accept(socket);
+        boost::system::error_code error;
+        for (int p = 0; p < packets && !error; ++p)
+        {
+          boost::asio::write(socket, boost::asio::buffer(revolutionPacket04(p)), error);
+        }
+        // keep the connection up until the client stops
+        std::unique_lock<std::mutex> lk(done_mutex);
+        done_conditional.wait(lk, [&]{ return done; });
+      });
+
+      const std::size_t queue_size = 8;
+      client::SensorClient sensor_client("127.0.0.1", std::to_string(acceptor.local_endpoint().port()), queue_size);
+      sensor_client.setBlockWhenFull(true);
+
+      pipeline::SensorPipelineSettings settings;
+      settings.shed_frames = true;
+      pipeline::SensorPipeline pipeline(settings, deviceInfo("M8"));
+      pipeline.packet_backlog = [&]{ return sensor_client.getQueueDepth() > sensor_client.getMaxQueueSize() / 2; };
+
+      std::mutex mutex;
+      std::vector<PointCloudXYZIRConstPtr> clouds;
+      pipeline.connect_cloud([&](const PointCloudXYZIRConstPtr& cloud)
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        clouds.push_back(cloud);
+      });
+
+      // the pipeline is held up until the gate opens, so the client queue fills
+      std::condition_variable gate_conditional;
+      bool open = false;
+      sensor_client.connectCallback([&](const std::shared_ptr<std::vector<char>>& packet)
+      {
+        {
+          std::unique_lock<std::mutex> lk(mutex);
+          gate_conditional.wait(lk, [&]{ return open; });
+        }
+        pipeline.slot(packet);
+      });
+
+      std::thread client_thread([&]{ EXPECT_NO_THROW(sensor_client.run()); });
+
+      auto wait_until = [](std::function<bool ()> condition)
+      {
+        for (int i = 0; i < 5000 && !condition(); ++i)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      };
+
+      wait_until([&]{ return sensor_client.getQueueDepth() == queue_size; });
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      EXPECT_EQ(sensor_client.getQueueDepth(), queue_size);
+      EXPECT_LT(sensor_client.getPacketsReceived(), static_cast<std::uint64_t>(packets));
+
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        open = true;
+      }
+      gate_conditional.notify_all();
+
+      // every packet gets through, and every frame is either shed or published whole
+      wait_until([&]{ return sensor_client.getPacketsReceived() == static_cast<std::uint64_t>(packets)
+                             && sensor_client.getQueueDepth() == 0; });
+      wait_until([&]
+      {
+        std::lock_guard<std::mutex> lk(mutex);
+        return pipeline.frame_count >= revolutions - 1
+               && clouds.size() == pipeline.frame_count - pipeline.frames_shed;
+      });
+
+      sensor_client.stop();
+      client_thread.join();
+      {
+        std::lock_guard<std::mutex> lk(done_mutex);
+        done = true;
+      }
+      done_conditional.notify_all();
+      sensor.join();
+
+      EXPECT_EQ(sensor_client.getPacketsReceived(), static_cast<std::uint64_t>(packets));
+      EXPECT_EQ(sensor_client.getPacketsDropped(), 0u);
+      EXPECT_GE(pipeline.frame_count, static_cast<std::uint64_t>(revolutions - 1));
+
+      std::lock_guard<std::mutex> lk(mutex);
+      EXPECT_EQ(clouds.size(), pipeline.frame_count - pipeline.frames_shed);
+      for (const auto& cloud : clouds)
+      {
+        EXPECT_EQ(cloud->size(), FIRINGS_PER_REV * client::M_SERIES_NUM_LASERS);
+      }
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,176 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <quanergy/pipelines/static_pipeline.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestStaticPipeline : public ::testing::Test
+    {
+    public:
+      /// random points with some in front of and beyond the filter thresholds
+      static PointCloudHVDIRPtr makeCloud(std::size_t size)
+      {
+        std::default_random_engine engine;
+        std::uniform_real_distribution<float> angle(-M_PI, M_PI);
+        std::uniform_real_distribution<float> range(0.f, 20.f);
+        std::uniform_int_distribution<int> intensity(0, 255);
+
+        PointCloudHVDIRPtr cloud(new PointCloudHVDIR());
+        for (std::size_t i = 0; i < size; ++i)
+        {
+          PointHVDIR pt;
+          pt.h = angle(engine);
+          pt.v = angle(engine) / 8.f;
+          pt.d = range(engine);
+          pt.intensity = intensity(engine);
+          pt.ring = i % client::M_SERIES_NUM_LASERS;
+          cloud->points.push_back(pt);
+        }
+        cloud->width = cloud->size();
+        cloud->height = 1;
+        cloud->is_dense = true;
+        cloud->header.seq = 7;
+        return cloud;
+      }
+
+      /// stands in for a packet parser; completes a cloud every other packet
+      struct PairParser
+      {
+        using ResultType = PointCloudHVDIRPtr;
+
+        bool validateParse(const std::vector<char>& packet, ResultType& result)
+        {
+          cloud->points.push_back(PointHVDIR());
+          cloud->points.back().d = static_cast<float>(packet.size());
+          if (cloud->size() < 2)
+            return false;
+
+          cloud->width = 2;
+          cloud->height = 1;
+          result = cloud;
+          cloud.reset(new PointCloudHVDIR());
+          return true;
+        }
+
+        PointCloudHVDIRPtr cloud {new PointCloudHVDIR()};
+      };
+
+      /// custom stage
+      struct DoubleRange
+      {
+        PointHVDIR operator()(const PointHVDIR& point) const
+        {
+          PointHVDIR result = point;
+          result.d *= 2.f;
+          return result;
+        }
+      };
+    };
+
+    TEST_F(TestStaticPipeline, Test_matchesModules)
+    {
+      auto cloud = makeCloud(1000);
+
+      // the modules connected at run time
+      calibration::EncoderAngleCalibration encoder;
+      client::DistanceFilter distance_filter;
+      client::RingIntensityFilter ring_filter;
+      client::PolarToCartConverter converter;
+
+      encoder.setParams(0.02, -2.0);
+      distance_filter.setMinimumDistanceThreshold(1.f);
+      distance_filter.setMaximumDistanceThreshold(15.f);
+      for (int ring = 0; ring < client::M_SERIES_NUM_LASERS; ++ring)
+      {
+        ring_filter.setRingFilterMinimumRangeThreshold(ring, 5.f);
+        ring_filter.setRingFilterMinimumIntensityThreshold(ring, 100);
+      }
+
+      PointCloudXYZIRConstPtr expected;
+      encoder.connectCallback([&](const PointCloudHVDIRConstPtr& pc){ distance_filter.slot(pc); });
+      distance_filter.connectCallback([&](const PointCloudHVDIRConstPtr& pc){ ring_filter.slot(pc); });
+      ring_filter.connectCallback([&](const PointCloudHVDIRConstPtr& pc){ converter.slot(pc); });
+      converter.connectCallback([&](const PointCloudXYZIRConstPtr& pc){ expected = pc; });
+
+      // the same stages composed at compile time; applied first so the encoder's in place correction doesn't affect it
+      pipeline::StaticPipeline<PairParser,
+                               calibration::EncoderAngleCalibration,
+                               client::DistanceFilter,
+                               client::RingIntensityFilter,
+                               client::PolarToCartConverter> composed;
+      composed.get<0>().setParams(0.02, -2.0);
+      composed.get<1>().setMinimumDistanceThreshold(1.f);
+      composed.get<1>().setMaximumDistanceThreshold(15.f);
+      for (int ring = 0; ring < client::M_SERIES_NUM_LASERS; ++ring)
+      {
+        composed.get<2>().setRingFilterMinimumRangeThreshold(ring, 5.f);
+        composed.get<2>().setRingFilterMinimumIntensityThreshold(ring, 100);
+      }
+
+      auto result = composed.process(*cloud);
+      encoder.slot(cloud);
+
+      ASSERT_TRUE(expected);
+      ASSERT_EQ(result->size(), expected->size());
+      EXPECT_EQ(result->is_dense, expected->is_dense);
+      EXPECT_FALSE(result->is_dense);
+      EXPECT_EQ(result->header.seq, 7u);
+      EXPECT_EQ(result->width, expected->width);
+
+      for (std::size_t i = 0; i < result->size(); ++i)
+      {
+        const auto& a = result->points[i];
+        const auto& b = expected->points[i];
+        EXPECT_EQ(std::isnan(a.x), std::isnan(b.x));
+        if (!std::isnan(b.x))
+        {
+          EXPECT_FLOAT_EQ(a.x, b.x);
+          EXPECT_FLOAT_EQ(a.y, b.y);
+          EXPECT_FLOAT_EQ(a.z, b.z);
+        }
+        EXPECT_EQ(a.intensity, b.intensity);
+        EXPECT_EQ(a.ring, b.ring);
+      }
+    }
+
+    TEST_F(TestStaticPipeline, Test_parserAndCustomStage)
+    {
+      using Pipeline = pipeline::StaticPipeline<PairParser, DoubleRange, client::DistanceFilter>;
+      static_assert(std::is_same<Pipeline::OutputPoint, PointHVDIR>::value, "stages keep polar points");
+
+      Pipeline composed;
+      composed.get<1>().setMaximumDistanceThreshold(5.f);
+
+      std::vector<Pipeline::ResultType> results;
+      composed.connectCallback([&results](const Pipeline::ResultType& pc){ results.push_back(pc); });
+
+      for (std::size_t size : {1, 3, 2, 4})
+        composed.slot(std::make_shared<std::vector<char>>(size));
+
+      ASSERT_EQ(results.size(), 2u);
+      EXPECT_FLOAT_EQ(results[0]->points[0].d, 2.f);
+      EXPECT_TRUE(std::isnan(results[0]->points[1].d));
+      EXPECT_FLOAT_EQ(results[1]->points[0].d, 4.f);
+      EXPECT_TRUE(std::isnan(results[1]->points[1].d));
+
+      // stages constructed from arguments
+      auto offset = [](const PointHVDIR& point){ PointHVDIR result = point; result.d += 1.f; return result; };
+      pipeline::StaticPipeline<PairParser, decltype(offset)> with_lambda(offset);
+      PointHVDIR point;
+      point.d = 1.f;
+      EXPECT_FLOAT_EQ(with_lambda.apply(point).d, 2.f);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */
@@ -0,0 +1,85 @@
+/****************************************************************
+ **                                                            **
+ **  Copyright(C) 2020 Quanergy Systems. All Rights Reserved.  **
+ **  Contact: http://www.quanergy.com                          **
+ **                                                            **
+ ****************************************************************/
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include <quanergy/common/trace.h>
+#include <quanergy/pipelines/async.h>
+
+namespace quanergy
+{
+  namespace test
+  {
+    class TestTrace : public ::testing::Test
+    {
+    public:
+      void SetUp() override
+      {
+        Tracer::instance().clear();
+        Tracer::instance().enable(true);
+      }
+
+      void TearDown() override
+      {
+        Tracer::instance().enable(false);
+      }
+
+      static std::size_t occurrences(const std::string& text, const std::string& pattern)
+      {
+        std::size_t count = 0;
+        for (auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+          ++count;
+        return count;
+      }
+    };
+
+    TEST_F(TestTrace, Test_disabled)
+    {
+      Tracer::instance().enable(false);
+      {
+        QUANERGY_TRACE_SCOPE("not_recorded");
+      }
+
+      std::ostringstream out;
+      EXPECT_EQ(Tracer::instance().writeChromeTrace(out), 0u);
+      EXPECT_EQ(out.str().find("not_recorded"), std::string::npos);
+    }
+
+    TEST_F(TestTrace, Test_asyncHandoff)
+    {
+      std::uint64_t start = Tracer::now();
+      {
+        pipeline::AsyncModule<int> async;
+        async.setTraceName("test_async");
+        async.connect([](int){ QUANERGY_TRACE_SCOPE("consumer"); });
+
+        for (int i = 0; i < 2; ++i)
+        {
+          async.slot(i);
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+      }
+
+      std::ostringstream out;
+      EXPECT_GT(Tracer::instance().writeChromeTrace(out, start), 0u);
+      const std::string text = out.str();
+
+      EXPECT_EQ(text.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+      EXPECT_EQ(occurrences(text, "\"name\":\"consumer\",\"cat\":\"quanergy\",\"ph\":\"X\""), 2u) << text;
+      EXPECT_EQ(occurrences(text, "\"name\":\"async_queue\",\"cat\":\"quanergy\",\"ph\":\"s\""), 2u) << text;
+      EXPECT_EQ(occurrences(text, "\"name\":\"async_queue\",\"cat\":\"quanergy\",\"ph\":\"f\""), 2u) << text;
+      EXPECT_NE(text.find("\"args\":{\"name\":\"test_async\"}"), std::string::npos) << text;
+
+      // a window ending before the events excludes them
+      std::ostringstream empty;
+      EXPECT_EQ(Tracer::instance().writeChromeTrace(empty, 0, start - 1), 0u);
+    }
+
+  }/** end test namespace */
+}/** end quanergy namespace */